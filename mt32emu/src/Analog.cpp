@@ -20,8 +20,13 @@
 #include "internals.h"
 
 #include "Analog.h"
+#include "StateStream.h"
 #include "Synth.h"
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace MT32Emu {
 
 #if MT32EMU_USE_FLOAT_SAMPLES
@@ -99,112 +104,358 @@ static const float CM32L_REVERB_TO_LA32_ANALOG_OUTPUT_GAIN_FACTOR = 0.68f;
 static const unsigned int OUTPUT_GAIN_FRACTION_BITS = 8;
 static const float OUTPUT_GAIN_MULTIPLIER = float(1 << OUTPUT_GAIN_FRACTION_BITS);
 
-static const unsigned int COARSE_LPF_DELAY_LINE_LENGTH = 8; // Must be a power of 2
-static const unsigned int ACCURATE_LPF_DELAY_LINE_LENGTH = 16; // Must be a power of 2
+static const unsigned int COARSE_LPF_DELAY_LINE_LENGTH = 8;
+static const unsigned int ACCURATE_LPF_DELAY_LINE_LENGTH = 16;
 static const unsigned int ACCURATE_LPF_NUMBER_OF_PHASES = 3; // Upsampling factor
 static const unsigned int ACCURATE_LPF_PHASE_INCREMENT_REGULAR = 2; // Downsampling factor
 static const unsigned int ACCURATE_LPF_PHASE_INCREMENT_OVERSAMPLED = 1; // No downsampling
 static const Bit32u ACCURATE_LPF_DELTAS_REGULAR[][ACCURATE_LPF_NUMBER_OF_PHASES] = { { 0, 0, 0 }, { 1, 1, 0 }, { 1, 2, 1 } };
 static const Bit32u ACCURATE_LPF_DELTAS_OVERSAMPLED[][ACCURATE_LPF_NUMBER_OF_PHASES] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 } };
 
+// Number of taps applied per output sample in each phase, including the one for the sample that leaves the delay line
+static const unsigned int ACCURATE_LPF_PHASE_TAPS_LENGTH = ACCURATE_LPF_DELAY_LINE_LENGTH + 1;
+
+// Maximum number of output frames the filters process at once. As the filters never upsample the input, the number
+// of input frames doesn't exceed this either.
+static const Bit32u LPF_MAX_BLOCK_LENGTH = 256;
+
+/* The filters process interleaved stereo frames in blocks. Instead of a ring buffer, the delay line is a linear history
+ * which is appended by each block and the tail of which is moved to the beginning afterwards. This way, the samples
+ * the taps apply to are contiguous, so that the SIMD versions compute the left and right channels of adjacent output frames
+ * in different vector lanes. As each lane performs exactly the same sequence of floating point operations as the plain C++
+ * code does, the output remains bit-identical regardless of the code path selected for the CPU at runtime.
+ */
+
+typedef void (*CoarseLPFKernel)(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount);
+typedef void (*AccurateLPFKernel)(float *sums, const float *history, const float *phaseTaps, const Bit32u *framePositions, const Bit32u *framePhases, Bit32u frameCount);
+
 class AbstractLowPassFilter {
 public:
-	static AbstractLowPassFilter &createLowPassFilter(AnalogOutputMode mode, bool oldMT32AnalogLPF);
+	static AbstractLowPassFilter &createLowPassFilter(AnalogOutputMode mode, bool oldMT32AnalogLPF, SIMDLevel simdLevel);
 
 	virtual ~AbstractLowPassFilter() {}
-	virtual SampleEx process(SampleEx sample) = 0;
-	virtual bool hasNextSample() const;
+	// Produces outLength filtered stereo frames consuming estimateInSampleCount(outLength) frames of the input.
+	virtual void process(Sample *outStream, const SampleEx *inStream, Bit32u outLength) = 0;
 	virtual unsigned int getOutputSampleRate() const;
 	virtual unsigned int estimateInSampleCount(unsigned int outSamples) const;
 	virtual void addPositionIncrement(unsigned int) {}
+	// The stored length of the delay line makes sure the state is loaded into the filter of the same kind
+	virtual void saveState(StateWriter &writer) const;
+	virtual void loadState(StateReader &reader);
 };
 
 class NullLowPassFilter : public AbstractLowPassFilter {
 public:
-	SampleEx process(SampleEx sample);
+	void process(Sample *outStream, const SampleEx *inStream, Bit32u outLength);
 };
 
 class CoarseLowPassFilter : public AbstractLowPassFilter {
 private:
 	const SampleEx * const LPF_TAPS;
-	SampleEx ringBuffer[COARSE_LPF_DELAY_LINE_LENGTH];
-	unsigned int ringBufferPosition;
+	const CoarseLPFKernel kernel;
+	// Clipped input frames, starts with the last COARSE_LPF_DELAY_LINE_LENGTH frames of the previous block
+	Sample history[2 * (COARSE_LPF_DELAY_LINE_LENGTH + LPF_MAX_BLOCK_LENGTH)];
 
 public:
-	CoarseLowPassFilter(bool oldMT32AnalogLPF);
-	SampleEx process(SampleEx sample);
+	CoarseLowPassFilter(bool oldMT32AnalogLPF, SIMDLevel simdLevel);
+	void process(Sample *outStream, const SampleEx *inStream, Bit32u outLength);
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 class AccurateLowPassFilter : public AbstractLowPassFilter {
 private:
-	const float * const LPF_TAPS;
 	const Bit32u (* const deltas)[ACCURATE_LPF_NUMBER_OF_PHASES];
 	const unsigned int phaseIncrement;
 	const unsigned int outputSampleRate;
+	const AccurateLPFKernel kernel;
 
-	SampleEx ringBuffer[ACCURATE_LPF_DELAY_LINE_LENGTH];
-	unsigned int ringBufferPosition;
+	// For each phase, the taps in the order of application, each one is duplicated for both channels
+	float phaseTaps[ACCURATE_LPF_NUMBER_OF_PHASES][2 * ACCURATE_LPF_PHASE_TAPS_LENGTH];
+	// Input frames, starts with the last ACCURATE_LPF_PHASE_TAPS_LENGTH frames of the previous block
+	float history[2 * (ACCURATE_LPF_PHASE_TAPS_LENGTH + LPF_MAX_BLOCK_LENGTH)];
 	unsigned int phase;
 
-public:
-	AccurateLowPassFilter(bool oldMT32AnalogLPF, bool oversample);
-	SampleEx process(SampleEx sample);
 	bool hasNextSample() const;
+
+public:
+	AccurateLowPassFilter(bool oldMT32AnalogLPF, bool oversample, SIMDLevel simdLevel);
+	void process(Sample *outStream, const SampleEx *inStream, Bit32u outLength);
 	unsigned int getOutputSampleRate() const;
 	unsigned int estimateInSampleCount(unsigned int outSamples) const;
 	void addPositionIncrement(unsigned int positionIncrement);
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
-Analog::Analog(const AnalogOutputMode mode, const bool oldMT32AnalogLPF) :
-	leftChannelLPF(AbstractLowPassFilter::createLowPassFilter(mode, oldMT32AnalogLPF)),
-	rightChannelLPF(AbstractLowPassFilter::createLowPassFilter(mode, oldMT32AnalogLPF)),
+static void processCoarseLPFGeneric(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount) {
+	for (Bit32u frameIx = 0; frameIx < frameCount; frameIx++) {
+		const Sample *frame = history + 2 * (COARSE_LPF_DELAY_LINE_LENGTH + frameIx);
+		for (unsigned int channel = 0; channel < 2; channel++) {
+			SampleEx sample = taps[COARSE_LPF_DELAY_LINE_LENGTH] * (SampleEx)(frame - 2 * COARSE_LPF_DELAY_LINE_LENGTH)[channel];
+			for (unsigned int i = 0; i < COARSE_LPF_DELAY_LINE_LENGTH; i++) {
+				sample += taps[i] * (SampleEx)(frame - 2 * i)[channel];
+			}
+
+#if !MT32EMU_USE_FLOAT_SAMPLES
+			sample >>= COARSE_LPF_FRACTION_BITS;
+#endif
+
+			*(outStream++) = Synth::clipSampleEx(sample);
+		}
+	}
+}
+
+static void processAccurateLPFGeneric(float *sums, const float *history, const float *phaseTaps, const Bit32u *framePositions, const Bit32u *framePhases, Bit32u frameCount) {
+	// Substitutes the sample that leaves the delay line for phases other than 0, so that the sum starts from +0.0f
+	static const float ZERO_FRAME[] = { 0.0f, 0.0f };
+
+	for (Bit32u frameIx = 0; frameIx < frameCount; frameIx++) {
+		const float *taps = phaseTaps + 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH * framePhases[frameIx];
+		const float *frame = history + 2 * framePositions[frameIx];
+		const float *leavingFrame = framePhases[frameIx] == 0 ? frame - 2 * ACCURATE_LPF_DELAY_LINE_LENGTH : ZERO_FRAME;
+		for (unsigned int channel = 0; channel < 2; channel++) {
+			float sample = taps[channel] * leavingFrame[channel];
+			for (unsigned int delaySampleIx = 0; delaySampleIx < ACCURATE_LPF_DELAY_LINE_LENGTH; delaySampleIx++) {
+				sample += taps[2 * (delaySampleIx + 1) + channel] * (frame - 2 * delaySampleIx)[channel];
+			}
+			*(sums++) = sample;
+		}
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+
+#if MT32EMU_USE_FLOAT_SAMPLES
+
+// Computes two adjacent stereo frames per iteration
+MT32EMU_X86_TARGET("sse2")
+static void processCoarseLPFSSE2(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount) {
+	Bit32u frameIx = 0;
+	for (; frameIx + 2 <= frameCount; frameIx += 2) {
+		const float *frames = history + 2 * (COARSE_LPF_DELAY_LINE_LENGTH + frameIx);
+		__m128 sample = _mm_mul_ps(_mm_set1_ps(taps[COARSE_LPF_DELAY_LINE_LENGTH]), _mm_loadu_ps(frames - 2 * COARSE_LPF_DELAY_LINE_LENGTH));
+		for (unsigned int i = 0; i < COARSE_LPF_DELAY_LINE_LENGTH; i++) {
+			sample = _mm_add_ps(sample, _mm_mul_ps(_mm_set1_ps(taps[i]), _mm_loadu_ps(frames - 2 * i)));
+		}
+		_mm_storeu_ps(outStream + 2 * frameIx, sample);
+	}
+	processCoarseLPFGeneric(outStream + 2 * frameIx, history + 2 * frameIx, taps, frameCount - frameIx);
+}
+
+// Same as the SSE2 version but computes four stereo frames per iteration
+MT32EMU_X86_TARGET("avx")
+static void processCoarseLPFAVX(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount) {
+	Bit32u frameIx = 0;
+	for (; frameIx + 4 <= frameCount; frameIx += 4) {
+		const float *frames = history + 2 * (COARSE_LPF_DELAY_LINE_LENGTH + frameIx);
+		__m256 sample = _mm256_mul_ps(_mm256_set1_ps(taps[COARSE_LPF_DELAY_LINE_LENGTH]), _mm256_loadu_ps(frames - 2 * COARSE_LPF_DELAY_LINE_LENGTH));
+		for (unsigned int i = 0; i < COARSE_LPF_DELAY_LINE_LENGTH; i++) {
+			sample = _mm256_add_ps(sample, _mm256_mul_ps(_mm256_set1_ps(taps[i]), _mm256_loadu_ps(frames - 2 * i)));
+		}
+		_mm256_storeu_ps(outStream + 2 * frameIx, sample);
+	}
+	processCoarseLPFSSE2(outStream + 2 * frameIx, history + 2 * frameIx, taps, frameCount - frameIx);
+}
+
+#else
+
+// Computes four adjacent stereo frames per iteration. The clipped input samples and the taps fit in 16 bits, so the products
+// are exact when composed of the halves. The integer sum doesn't depend on the order of additions, the saturating packing
+// is equivalent to Synth::clipSampleEx().
+MT32EMU_X86_TARGET("sse2")
+static void processCoarseLPFSSE2(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount) {
+	Bit32u frameIx = 0;
+	for (; frameIx + 4 <= frameCount; frameIx += 4) {
+		const Bit16s *frames = history + 2 * (COARSE_LPF_DELAY_LINE_LENGTH + frameIx);
+		__m128i sampleLow = _mm_setzero_si128();
+		__m128i sampleHigh = _mm_setzero_si128();
+		for (unsigned int i = 0; i <= COARSE_LPF_DELAY_LINE_LENGTH; i++) {
+			const __m128i tap = _mm_set1_epi16(Bit16s(taps[i]));
+			const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frames - 2 * i));
+			const __m128i productLow = _mm_mullo_epi16(in, tap);
+			const __m128i productHigh = _mm_mulhi_epi16(in, tap);
+			sampleLow = _mm_add_epi32(sampleLow, _mm_unpacklo_epi16(productLow, productHigh));
+			sampleHigh = _mm_add_epi32(sampleHigh, _mm_unpackhi_epi16(productLow, productHigh));
+		}
+		sampleLow = _mm_srai_epi32(sampleLow, COARSE_LPF_FRACTION_BITS);
+		sampleHigh = _mm_srai_epi32(sampleHigh, COARSE_LPF_FRACTION_BITS);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outStream + 2 * frameIx), _mm_packs_epi32(sampleLow, sampleHigh));
+	}
+	processCoarseLPFGeneric(outStream + 2 * frameIx, history + 2 * frameIx, taps, frameCount - frameIx);
+}
+
+// Same as the SSE2 version but computes eight stereo frames per iteration. Unpacking and packing operate within 128-bit lanes,
+// so the order of samples is preserved.
+MT32EMU_X86_TARGET("avx2")
+static void processCoarseLPFAVX2(Sample *outStream, const Sample *history, const SampleEx *taps, Bit32u frameCount) {
+	Bit32u frameIx = 0;
+	for (; frameIx + 8 <= frameCount; frameIx += 8) {
+		const Bit16s *frames = history + 2 * (COARSE_LPF_DELAY_LINE_LENGTH + frameIx);
+		__m256i sampleLow = _mm256_setzero_si256();
+		__m256i sampleHigh = _mm256_setzero_si256();
+		for (unsigned int i = 0; i <= COARSE_LPF_DELAY_LINE_LENGTH; i++) {
+			const __m256i tap = _mm256_set1_epi16(Bit16s(taps[i]));
+			const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(frames - 2 * i));
+			const __m256i productLow = _mm256_mullo_epi16(in, tap);
+			const __m256i productHigh = _mm256_mulhi_epi16(in, tap);
+			sampleLow = _mm256_add_epi32(sampleLow, _mm256_unpacklo_epi16(productLow, productHigh));
+			sampleHigh = _mm256_add_epi32(sampleHigh, _mm256_unpackhi_epi16(productLow, productHigh));
+		}
+		sampleLow = _mm256_srai_epi32(sampleLow, COARSE_LPF_FRACTION_BITS);
+		sampleHigh = _mm256_srai_epi32(sampleHigh, COARSE_LPF_FRACTION_BITS);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(outStream + 2 * frameIx), _mm256_packs_epi32(sampleLow, sampleHigh));
+	}
+	processCoarseLPFSSE2(outStream + 2 * frameIx, history + 2 * frameIx, taps, frameCount - frameIx);
+}
+
+#endif // #if MT32EMU_USE_FLOAT_SAMPLES
+
+// Output frames of the accurate LPF may share the input frames and use different phases, so the lanes are loaded by halves
+MT32EMU_X86_TARGET("sse2")
+static inline __m128 loadFramePair(const float *frame0, const float *frame1) {
+	return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(frame0)), reinterpret_cast<const __m64 *>(frame1));
+}
+
+MT32EMU_X86_TARGET("sse2")
+static void processAccurateLPFSSE2(float *sums, const float *history, const float *phaseTaps, const Bit32u *framePositions, const Bit32u *framePhases, Bit32u frameCount) {
+	static const float ZERO_FRAME[] = { 0.0f, 0.0f };
+
+	Bit32u frameIx = 0;
+	for (; frameIx + 2 <= frameCount; frameIx += 2) {
+		const float *taps0 = phaseTaps + 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH * framePhases[frameIx];
+		const float *taps1 = phaseTaps + 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH * framePhases[frameIx + 1];
+		const float *frame0 = history + 2 * framePositions[frameIx];
+		const float *frame1 = history + 2 * framePositions[frameIx + 1];
+		const float *leavingFrame0 = framePhases[frameIx] == 0 ? frame0 - 2 * ACCURATE_LPF_DELAY_LINE_LENGTH : ZERO_FRAME;
+		const float *leavingFrame1 = framePhases[frameIx + 1] == 0 ? frame1 - 2 * ACCURATE_LPF_DELAY_LINE_LENGTH : ZERO_FRAME;
+		__m128 sample = _mm_mul_ps(loadFramePair(taps0, taps1), loadFramePair(leavingFrame0, leavingFrame1));
+		for (unsigned int delaySampleIx = 0; delaySampleIx < ACCURATE_LPF_DELAY_LINE_LENGTH; delaySampleIx++) {
+			const unsigned int tapIx = 2 * (delaySampleIx + 1);
+			const unsigned int delayOffset = 2 * delaySampleIx;
+			sample = _mm_add_ps(sample, _mm_mul_ps(loadFramePair(taps0 + tapIx, taps1 + tapIx), loadFramePair(frame0 - delayOffset, frame1 - delayOffset)));
+		}
+		_mm_storeu_ps(sums + 2 * frameIx, sample);
+	}
+	processAccurateLPFGeneric(sums + 2 * frameIx, history, phaseTaps, framePositions + frameIx, framePhases + frameIx, frameCount - frameIx);
+}
+
+MT32EMU_X86_TARGET("avx")
+static inline __m256 loadFrameQuad(const float *frame0, const float *frame1, const float *frame2, const float *frame3) {
+	const __m128 low = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(frame0)), reinterpret_cast<const __m64 *>(frame1));
+	const __m128 high = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(frame2)), reinterpret_cast<const __m64 *>(frame3));
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+}
+
+// Same as the SSE2 version but computes four output frames per iteration
+MT32EMU_X86_TARGET("avx")
+static void processAccurateLPFAVX(float *sums, const float *history, const float *phaseTaps, const Bit32u *framePositions, const Bit32u *framePhases, Bit32u frameCount) {
+	static const float ZERO_FRAME[] = { 0.0f, 0.0f };
+
+	Bit32u frameIx = 0;
+	for (; frameIx + 4 <= frameCount; frameIx += 4) {
+		const float *taps[4];
+		const float *frames[4];
+		const float *leavingFrames[4];
+		for (unsigned int i = 0; i < 4; i++) {
+			taps[i] = phaseTaps + 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH * framePhases[frameIx + i];
+			frames[i] = history + 2 * framePositions[frameIx + i];
+			leavingFrames[i] = framePhases[frameIx + i] == 0 ? frames[i] - 2 * ACCURATE_LPF_DELAY_LINE_LENGTH : ZERO_FRAME;
+		}
+		__m256 sample = _mm256_mul_ps(loadFrameQuad(taps[0], taps[1], taps[2], taps[3]),
+			loadFrameQuad(leavingFrames[0], leavingFrames[1], leavingFrames[2], leavingFrames[3]));
+		for (unsigned int delaySampleIx = 0; delaySampleIx < ACCURATE_LPF_DELAY_LINE_LENGTH; delaySampleIx++) {
+			const unsigned int tapIx = 2 * (delaySampleIx + 1);
+			const unsigned int delayOffset = 2 * delaySampleIx;
+			const __m256 tap = loadFrameQuad(taps[0] + tapIx, taps[1] + tapIx, taps[2] + tapIx, taps[3] + tapIx);
+			const __m256 in = loadFrameQuad(frames[0] - delayOffset, frames[1] - delayOffset, frames[2] - delayOffset, frames[3] - delayOffset);
+			sample = _mm256_add_ps(sample, _mm256_mul_ps(tap, in));
+		}
+		_mm256_storeu_ps(sums + 2 * frameIx, sample);
+	}
+	processAccurateLPFSSE2(sums + 2 * frameIx, history, phaseTaps, framePositions + frameIx, framePhases + frameIx, frameCount - frameIx);
+}
+
+#endif // #if MT32EMU_USE_X86_SIMD
+
+static CoarseLPFKernel selectCoarseLPFKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
+#if MT32EMU_USE_FLOAT_SAMPLES
+	if (simdLevel >= SIMDLevel_AVX) return processCoarseLPFAVX;
+#else
+	if (simdLevel >= SIMDLevel_AVX2) return processCoarseLPFAVX2;
+#endif
+	if (simdLevel >= SIMDLevel_SSE2) return processCoarseLPFSSE2;
+#else
+	(void)simdLevel;
+#endif
+	return processCoarseLPFGeneric;
+}
+
+static AccurateLPFKernel selectAccurateLPFKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
+	if (simdLevel >= SIMDLevel_AVX) return processAccurateLPFAVX;
+	if (simdLevel >= SIMDLevel_SSE2) return processAccurateLPFSSE2;
+#else
+	(void)simdLevel;
+#endif
+	return processAccurateLPFGeneric;
+}
+
+Analog::Analog(const AnalogOutputMode mode, const bool oldMT32AnalogLPF, const SIMDLevel simdLevel) :
+	lowPassFilter(AbstractLowPassFilter::createLowPassFilter(mode, oldMT32AnalogLPF, simdLevel)),
 	synthGain(0),
 	reverbGain(0)
 {}
 
 Analog::~Analog() {
-	delete &leftChannelLPF;
-	delete &rightChannelLPF;
+	delete &lowPassFilter;
 }
 
 void Analog::process(Sample *outStream, const Sample *nonReverbLeft, const Sample *nonReverbRight, const Sample *reverbDryLeft, const Sample *reverbDryRight, const Sample *reverbWetLeft, const Sample *reverbWetRight, Bit32u outLength) {
 	if (outStream == NULL) {
-		leftChannelLPF.addPositionIncrement(outLength);
-		rightChannelLPF.addPositionIncrement(outLength);
+		lowPassFilter.addPositionIncrement(outLength);
 		return;
 	}
 
-	while (0 < (outLength--)) {
-		SampleEx outSampleL;
-		SampleEx outSampleR;
+	SampleEx inStream[2 * LPF_MAX_BLOCK_LENGTH];
 
-		if (leftChannelLPF.hasNextSample()) {
-			outSampleL = leftChannelLPF.process(0);
-			outSampleR = rightChannelLPF.process(0);
-		} else {
-			SampleEx inSampleL = ((SampleEx)*(nonReverbLeft++) + (SampleEx)*(reverbDryLeft++)) * synthGain + (SampleEx)*(reverbWetLeft++) * reverbGain;
-			SampleEx inSampleR = ((SampleEx)*(nonReverbRight++) + (SampleEx)*(reverbDryRight++)) * synthGain + (SampleEx)*(reverbWetRight++) * reverbGain;
+	while (outLength > 0) {
+		const Bit32u outBlockLength = outLength < LPF_MAX_BLOCK_LENGTH ? outLength : LPF_MAX_BLOCK_LENGTH;
+		const Bit32u inBlockLength = lowPassFilter.estimateInSampleCount(outBlockLength);
+
+		for (Bit32u i = 0; i < inBlockLength; i++) {
+			SampleEx inSampleL = ((SampleEx)nonReverbLeft[i] + (SampleEx)reverbDryLeft[i]) * synthGain + (SampleEx)reverbWetLeft[i] * reverbGain;
+			SampleEx inSampleR = ((SampleEx)nonReverbRight[i] + (SampleEx)reverbDryRight[i]) * synthGain + (SampleEx)reverbWetRight[i] * reverbGain;
 
 #if !MT32EMU_USE_FLOAT_SAMPLES
 			inSampleL >>= OUTPUT_GAIN_FRACTION_BITS;
 			inSampleR >>= OUTPUT_GAIN_FRACTION_BITS;
 #endif
 
-			outSampleL = leftChannelLPF.process(inSampleL);
-			outSampleR = rightChannelLPF.process(inSampleR);
+			inStream[2 * i] = inSampleL;
+			inStream[2 * i + 1] = inSampleR;
 		}
 
-		*(outStream++) = Synth::clipSampleEx(outSampleL);
-		*(outStream++) = Synth::clipSampleEx(outSampleR);
+		lowPassFilter.process(outStream, inStream, outBlockLength);
+
+		nonReverbLeft += inBlockLength;
+		nonReverbRight += inBlockLength;
+		reverbDryLeft += inBlockLength;
+		reverbDryRight += inBlockLength;
+		reverbWetLeft += inBlockLength;
+		reverbWetRight += inBlockLength;
+		outStream += 2 * outBlockLength;
+		outLength -= outBlockLength;
 	}
 }
 
 unsigned int Analog::getOutputSampleRate() const {
-	return leftChannelLPF.getOutputSampleRate();
+	return lowPassFilter.getOutputSampleRate();
 }
 
 Bit32u Analog::getDACStreamsLength(Bit32u outputLength) const {
-	return leftChannelLPF.estimateInSampleCount(outputLength);
+	return lowPassFilter.estimateInSampleCount(outputLength);
 }
 
 void Analog::setSynthOutputGain(float useSynthGain) {
@@ -226,23 +477,27 @@ void Analog::setReverbOutputGain(float useReverbGain, bool mt32ReverbCompatibili
 #endif
 }
 
-AbstractLowPassFilter &AbstractLowPassFilter::createLowPassFilter(AnalogOutputMode mode, bool oldMT32AnalogLPF) {
+void Analog::saveState(StateWriter &writer) const {
+	lowPassFilter.saveState(writer);
+}
+
+void Analog::loadState(StateReader &reader) {
+	lowPassFilter.loadState(reader);
+}
+
+AbstractLowPassFilter &AbstractLowPassFilter::createLowPassFilter(AnalogOutputMode mode, bool oldMT32AnalogLPF, SIMDLevel simdLevel) {
 	switch (mode) {
 		case AnalogOutputMode_COARSE:
-			return *new CoarseLowPassFilter(oldMT32AnalogLPF);
+			return *new CoarseLowPassFilter(oldMT32AnalogLPF, simdLevel);
 		case AnalogOutputMode_ACCURATE:
-			return *new AccurateLowPassFilter(oldMT32AnalogLPF, false);
+			return *new AccurateLowPassFilter(oldMT32AnalogLPF, false, simdLevel);
 		case AnalogOutputMode_OVERSAMPLED:
-			return *new AccurateLowPassFilter(oldMT32AnalogLPF, true);
+			return *new AccurateLowPassFilter(oldMT32AnalogLPF, true, simdLevel);
 		default:
 			return *new NullLowPassFilter;
 	}
 }
 
-bool AbstractLowPassFilter::hasNextSample() const {
-	return false;
-}
-
 unsigned int AbstractLowPassFilter::getOutputSampleRate() const {
 	return SAMPLE_RATE;
 }
@@ -251,66 +506,103 @@ unsigned int AbstractLowPassFilter::estimateInSampleCount(unsigned int outSample
 	return outSamples;
 }
 
-SampleEx NullLowPassFilter::process(const SampleEx inSample) {
-	return inSample;
+void AbstractLowPassFilter::saveState(StateWriter &writer) const {
+	writer.writeBit32u(0);
 }
 
-CoarseLowPassFilter::CoarseLowPassFilter(bool oldMT32AnalogLPF) :
-	LPF_TAPS(oldMT32AnalogLPF ? COARSE_LPF_TAPS_MT32 : COARSE_LPF_TAPS_CM32L),
-	ringBufferPosition(0)
-{
-	Synth::muteSampleBuffer(ringBuffer, COARSE_LPF_DELAY_LINE_LENGTH);
+void AbstractLowPassFilter::loadState(StateReader &reader) {
+	if (reader.readBit32u() != 0) reader.fail();
 }
 
-SampleEx CoarseLowPassFilter::process(const SampleEx inSample) {
-	static const unsigned int DELAY_LINE_MASK = COARSE_LPF_DELAY_LINE_LENGTH - 1;
+void NullLowPassFilter::process(Sample *outStream, const SampleEx *inStream, Bit32u outLength) {
+	for (Bit32u i = 0; i < 2 * outLength; i++) {
+		outStream[i] = Synth::clipSampleEx(inStream[i]);
+	}
+}
 
-	SampleEx sample = LPF_TAPS[COARSE_LPF_DELAY_LINE_LENGTH] * ringBuffer[ringBufferPosition];
-	ringBuffer[ringBufferPosition] = Synth::clipSampleEx(inSample);
+CoarseLowPassFilter::CoarseLowPassFilter(bool oldMT32AnalogLPF, SIMDLevel simdLevel) :
+	LPF_TAPS(oldMT32AnalogLPF ? COARSE_LPF_TAPS_MT32 : COARSE_LPF_TAPS_CM32L),
+	kernel(selectCoarseLPFKernel(simdLevel))
+{
+	Synth::muteSampleBuffer(history, 2 * COARSE_LPF_DELAY_LINE_LENGTH);
+}
 
-	for (unsigned int i = 0; i < COARSE_LPF_DELAY_LINE_LENGTH; i++) {
-		sample += LPF_TAPS[i] * ringBuffer[(i + ringBufferPosition) & DELAY_LINE_MASK];
+void CoarseLowPassFilter::process(Sample *outStream, const SampleEx *inStream, Bit32u outLength) {
+	Sample *newFrames = history + 2 * COARSE_LPF_DELAY_LINE_LENGTH;
+	for (Bit32u i = 0; i < 2 * outLength; i++) {
+		newFrames[i] = Synth::clipSampleEx(inStream[i]);
 	}
 
-	ringBufferPosition = (ringBufferPosition - 1) & DELAY_LINE_MASK;
+	kernel(outStream, history, LPF_TAPS, outLength);
 
-#if !MT32EMU_USE_FLOAT_SAMPLES
-	sample >>= COARSE_LPF_FRACTION_BITS;
-#endif
+	memmove(history, history + 2 * outLength, 2 * COARSE_LPF_DELAY_LINE_LENGTH * sizeof(Sample));
+}
 
-	return sample;
+void CoarseLowPassFilter::saveState(StateWriter &writer) const {
+	writer.writeBit32u(2 * COARSE_LPF_DELAY_LINE_LENGTH);
+	writer.writeSamples(history, 2 * COARSE_LPF_DELAY_LINE_LENGTH);
 }
 
-AccurateLowPassFilter::AccurateLowPassFilter(const bool oldMT32AnalogLPF, const bool oversample) :
-	LPF_TAPS(oldMT32AnalogLPF ? ACCURATE_LPF_TAPS_MT32 : ACCURATE_LPF_TAPS_CM32L),
+void CoarseLowPassFilter::loadState(StateReader &reader) {
+	if (reader.readBit32u() != 2 * COARSE_LPF_DELAY_LINE_LENGTH) reader.fail();
+	reader.readSamples(history, 2 * COARSE_LPF_DELAY_LINE_LENGTH);
+}
+
+AccurateLowPassFilter::AccurateLowPassFilter(const bool oldMT32AnalogLPF, const bool oversample, const SIMDLevel simdLevel) :
 	deltas(oversample ? ACCURATE_LPF_DELTAS_OVERSAMPLED : ACCURATE_LPF_DELTAS_REGULAR),
 	phaseIncrement(oversample ? ACCURATE_LPF_PHASE_INCREMENT_OVERSAMPLED : ACCURATE_LPF_PHASE_INCREMENT_REGULAR),
 	outputSampleRate(SAMPLE_RATE * ACCURATE_LPF_NUMBER_OF_PHASES / phaseIncrement),
-	ringBufferPosition(0),
+	kernel(selectAccurateLPFKernel(simdLevel)),
 	phase(0)
 {
-	Synth::muteSampleBuffer(ringBuffer, ACCURATE_LPF_DELAY_LINE_LENGTH);
+	const float * const lpfTaps = oldMT32AnalogLPF ? ACCURATE_LPF_TAPS_MT32 : ACCURATE_LPF_TAPS_CM32L;
+	for (unsigned int tapsPhase = 0; tapsPhase < ACCURATE_LPF_NUMBER_OF_PHASES; tapsPhase++) {
+		// Only phase 0 makes use of the last tap, which applies to the sample leaving the delay line
+		const float leavingSampleTap = (tapsPhase == 0) ? lpfTaps[ACCURATE_LPF_DELAY_LINE_LENGTH * ACCURATE_LPF_NUMBER_OF_PHASES] : 0.0f;
+		phaseTaps[tapsPhase][0] = phaseTaps[tapsPhase][1] = leavingSampleTap;
+		for (unsigned int tapIx = tapsPhase, delaySampleIx = 0; delaySampleIx < ACCURATE_LPF_DELAY_LINE_LENGTH; delaySampleIx++, tapIx += ACCURATE_LPF_NUMBER_OF_PHASES) {
+			phaseTaps[tapsPhase][2 * (delaySampleIx + 1)] = phaseTaps[tapsPhase][2 * (delaySampleIx + 1) + 1] = lpfTaps[tapIx];
+		}
+	}
+	Synth::muteSampleBuffer(history, 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH);
 }
 
-SampleEx AccurateLowPassFilter::process(const SampleEx inSample) {
-	static const unsigned int DELAY_LINE_MASK = ACCURATE_LPF_DELAY_LINE_LENGTH - 1;
-
-	float sample = (phase == 0) ? LPF_TAPS[ACCURATE_LPF_DELAY_LINE_LENGTH * ACCURATE_LPF_NUMBER_OF_PHASES] * ringBuffer[ringBufferPosition] : 0.0f;
-	if (!hasNextSample()) {
-		ringBuffer[ringBufferPosition] = inSample;
+void AccurateLowPassFilter::process(Sample *outStream, const SampleEx *inStream, Bit32u outLength) {
+	// The kernel only reads the first outLength entries, they are zeroed to keep the compiler from warning
+	Bit32u framePositions[LPF_MAX_BLOCK_LENGTH] = {0};
+	Bit32u framePhases[LPF_MAX_BLOCK_LENGTH] = {0};
+	float sums[2 * LPF_MAX_BLOCK_LENGTH];
+
+	// Each frame of the history corresponds to a single position in the delay line, the current position is the last one.
+	// An input frame is stored at the current position in phases less than the phase increment, the position advances
+	// when the phase wraps around. In case the position advances with no input stored (that may only happen after
+	// addPositionIncrement()), the delay line would still contain the sample stored ACCURATE_LPF_DELAY_LINE_LENGTH positions
+	// earlier, hence it is carried over.
+	Bit32u position = ACCURATE_LPF_DELAY_LINE_LENGTH;
+	for (Bit32u frameIx = 0; frameIx < outLength; frameIx++) {
+		if (!hasNextSample()) {
+			history[2 * position] = float(*(inStream++));
+			history[2 * position + 1] = float(*(inStream++));
+		}
+		framePositions[frameIx] = position;
+		framePhases[frameIx] = phase;
+
+		phase += phaseIncrement;
+		if (ACCURATE_LPF_NUMBER_OF_PHASES <= phase) {
+			phase -= ACCURATE_LPF_NUMBER_OF_PHASES;
+			position++;
+			history[2 * position] = history[2 * (position - ACCURATE_LPF_DELAY_LINE_LENGTH)];
+			history[2 * position + 1] = history[2 * (position - ACCURATE_LPF_DELAY_LINE_LENGTH) + 1];
+		}
 	}
 
-	for (unsigned int tapIx = phase, delaySampleIx = 0; delaySampleIx < ACCURATE_LPF_DELAY_LINE_LENGTH; delaySampleIx++, tapIx += ACCURATE_LPF_NUMBER_OF_PHASES) {
-		sample += LPF_TAPS[tapIx] * ringBuffer[(delaySampleIx + ringBufferPosition) & DELAY_LINE_MASK];
-	}
+	kernel(sums, history, phaseTaps[0], framePositions, framePhases, outLength);
 
-	phase += phaseIncrement;
-	if (ACCURATE_LPF_NUMBER_OF_PHASES <= phase) {
-		phase -= ACCURATE_LPF_NUMBER_OF_PHASES;
-		ringBufferPosition = (ringBufferPosition - 1) & DELAY_LINE_MASK;
+	for (Bit32u i = 0; i < 2 * outLength; i++) {
+		outStream[i] = Synth::clipSampleEx(SampleEx(ACCURATE_LPF_NUMBER_OF_PHASES * sums[i]));
 	}
 
-	return SampleEx(ACCURATE_LPF_NUMBER_OF_PHASES * sample);
+	memmove(history, history + 2 * (position - ACCURATE_LPF_DELAY_LINE_LENGTH), 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH * sizeof(float));
 }
 
 bool AccurateLowPassFilter::hasNextSample() const {
@@ -331,4 +623,16 @@ void AccurateLowPassFilter::addPositionIncrement(const unsigned int positionIncr
 	phase = (phase + positionIncrement * phaseIncrement) % ACCURATE_LPF_NUMBER_OF_PHASES;
 }
 
+void AccurateLowPassFilter::saveState(StateWriter &writer) const {
+	writer.writeBit32u(2 * ACCURATE_LPF_PHASE_TAPS_LENGTH);
+	writer.writeSamples(history, 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH);
+	writer.writeBit32u(phase);
+}
+
+void AccurateLowPassFilter::loadState(StateReader &reader) {
+	if (reader.readBit32u() != 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH) reader.fail();
+	reader.readSamples(history, 2 * ACCURATE_LPF_PHASE_TAPS_LENGTH);
+	phase = reader.readIndex(ACCURATE_LPF_NUMBER_OF_PHASES);
+}
+
 } // namespace MT32Emu
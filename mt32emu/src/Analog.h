@@ -26,6 +26,8 @@
 namespace MT32Emu {
 
 class AbstractLowPassFilter;
+class StateReader;
+class StateWriter;
 
 /* Analog class is dedicated to perform fair emulation of analogue circuitry of hardware units that is responsible
  * for processing output signal after the DAC. It appears that the analogue circuit labeled "LPF" on the schematic
@@ -38,17 +40,20 @@ class AbstractLowPassFilter;
  */
 class Analog {
 public:
-	Analog(const AnalogOutputMode mode, const bool oldMT32AnalogLPF);
+	Analog(const AnalogOutputMode mode, const bool oldMT32AnalogLPF, const SIMDLevel simdLevel);
 	~Analog();
 	void process(Sample *outStream, const Sample *nonReverbLeft, const Sample *nonReverbRight, const Sample *reverbDryLeft, const Sample *reverbDryRight, const Sample *reverbWetLeft, const Sample *reverbWetRight, Bit32u outLength);
 	unsigned int getOutputSampleRate() const;
 	Bit32u getDACStreamsLength(Bit32u outputLength) const;
 	void setSynthOutputGain(float synthGain);
 	void setReverbOutputGain(float reverbGain, bool mt32ReverbCompatibilityMode);
+	// Store and restore the state of the LPF, the output gains are settings and aren't stored
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 
 private:
-	AbstractLowPassFilter &leftChannelLPF;
-	AbstractLowPassFilter &rightChannelLPF;
+	// Filters both channels at once, the samples are interleaved
+	AbstractLowPassFilter &lowPassFilter;
 	SampleEx synthGain;
 	SampleEx reverbGain;
 
@@ -0,0 +1,89 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_ATOMICS_H
+#define MT32EMU_ATOMICS_H
+
+#include "Types.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace MT32Emu {
+
+/**
+ * Minimal set of atomic operations on 32-bit variables used to exchange data between threads without locking.
+ * As the library sticks to C++98, these rely on the compiler intrinsics. Where the acquire / release semantics
+ * cannot be expressed, a full memory barrier is used instead which is more than enough for the purpose.
+ */
+namespace Atomics {
+
+#if !defined(_MSC_VER) && defined(__ATOMIC_ACQUIRE)
+
+// Reads the variable, subsequent memory accesses aren't reordered before this.
+static inline Bit32u load(const volatile Bit32u &variable) {
+	return __atomic_load_n(&variable, __ATOMIC_ACQUIRE);
+}
+
+// Writes the variable, preceding memory accesses aren't reordered after this.
+static inline void store(volatile Bit32u &variable, Bit32u value) {
+	__atomic_store_n(&variable, value, __ATOMIC_RELEASE);
+}
+
+// Sets the variable to desiredValue if it's equal to expectedValue. Returns true on success.
+static inline bool compareAndSwap(volatile Bit32u &variable, Bit32u expectedValue, Bit32u desiredValue) {
+	return __atomic_compare_exchange_n(&variable, &expectedValue, desiredValue, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#else // !defined(_MSC_VER) && defined(__ATOMIC_ACQUIRE)
+
+static inline void memoryBarrier() {
+#ifdef _MSC_VER
+	long fence = 0;
+	_InterlockedExchange(&fence, 1);
+#else
+	__sync_synchronize();
+#endif
+}
+
+static inline Bit32u load(const volatile Bit32u &variable) {
+	Bit32u value = variable;
+	memoryBarrier();
+	return value;
+}
+
+static inline void store(volatile Bit32u &variable, Bit32u value) {
+	memoryBarrier();
+	variable = value;
+}
+
+static inline bool compareAndSwap(volatile Bit32u &variable, Bit32u expectedValue, Bit32u desiredValue) {
+#ifdef _MSC_VER
+	return Bit32u(_InterlockedCompareExchange(reinterpret_cast<volatile long *>(&variable), long(desiredValue), long(expectedValue))) == expectedValue;
+#else
+	return __sync_bool_compare_and_swap(&variable, expectedValue, desiredValue);
+#endif
+}
+
+#endif // !defined(_MSC_VER) && defined(__ATOMIC_ACQUIRE)
+
+} // namespace Atomics
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_ATOMICS_H
@@ -20,8 +20,13 @@
 #include "internals.h"
 
 #include "BReverbModel.h"
+#include "StateStream.h"
 #include "Synth.h"
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 // Analysing of state of reverb RAM address lines gives exact sizes of the buffers of filters used. This also indicates that
 // the reverb model implemented in the real devices consists of three series allpass filters preceded by a non-feedback comb (or a delay with a LPF)
 // and followed by three parallel comb filters
@@ -37,6 +42,13 @@ static const Bit32u PROCESS_DELAY = 1;
 static const Bit32u MODE_3_ADDITIONAL_DELAY = 1;
 static const Bit32u MODE_3_FEEDBACK_DELAY = 1;
 
+// Samples in range [-MAX_INACTIVE_SAMPLE, MAX_INACTIVE_SAMPLE] are considered too quiet to keep the reverb active
+#if MT32EMU_USE_FLOAT_SAMPLES
+static const Sample MAX_INACTIVE_SAMPLE = 0.001f;
+#else
+static const Sample MAX_INACTIVE_SAMPLE = 8;
+#endif
+
 // Default reverb settings for "new" reverb model implemented in CM-32L / LAPC-I.
 // Found by tracing reverb RAM data lines (thanks go to Lord_Nightmare & balrog).
 const BReverbSettings &BReverbModel::getCM32L_LAPCSettings(const ReverbMode mode) {
@@ -196,128 +208,411 @@ static Sample weirdMul(Sample a, Bit8u addMask, Bit8u carryMask) {
 #endif
 }
 
-RingBuffer::RingBuffer(Bit32u newsize) : size(newsize), index(0) {
-	buffer = new Sample[size];
+static void mixDryInputGeneric(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples) {
+	for (Bit32u i = 0; i < numSamples; i++) {
+#if MT32EMU_USE_FLOAT_SAMPLES
+		Sample dry = (inLeft[i] * 0.25f) + (inRight[i] * 0.25f);
+#elif MT32EMU_BOSS_REVERB_PRECISE_MODE
+		Sample dry = (inLeft[i] >> 1) / 2 + (inRight[i] >> 1) / 2;
+#else
+		Sample dry = (inLeft[i] >> 2) + (inRight[i] >> 2);
+#endif
+
+		// Looks like dryAmp doesn't change in MT-32 but it does in CM-32L / LAPC-I
+		out[i] = weirdMul(dry, dryAmp, 0xFF);
+	}
 }
 
-RingBuffer::~RingBuffer() {
-	delete[] buffer;
-	buffer = NULL;
+static void mixCombOutputsGeneric(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples) {
+	for (Bit32u i = 0; i < numSamples; i++) {
+		const Sample out1 = comb1[i];
+		const Sample out2 = comb2[i];
+		const Sample out3 = comb3[i];
+#if MT32EMU_USE_FLOAT_SAMPLES
+		Sample outSample = 1.5f * (out1 + out2) + out3;
+#elif MT32EMU_BOSS_REVERB_PRECISE_MODE
+		/* NOTE:
+		 *   Thanks to Mok for discovering, the adder in BOSS reverb chip is found to perform addition with saturation to avoid integer overflow.
+		 *   Analysing of the algorithm suggests that the overflow is most probable when the combs output is added below.
+		 *   So, despite this isn't actually accurate, we only add the check here for performance reasons.
+		 */
+		Sample outSample = Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx((SampleEx)out1 + SampleEx(out1 >> 1)) + (SampleEx)out2) + SampleEx(out2 >> 1)) + (SampleEx)out3);
+#else
+		Sample outSample = Synth::clipSampleEx((SampleEx)out1 + SampleEx(out1 >> 1) + (SampleEx)out2 + SampleEx(out2 >> 1) + (SampleEx)out3);
+#endif
+		out[i] = weirdMul(outSample, wetLevel, 0xFF);
+	}
 }
 
-Sample RingBuffer::next() {
-	if (++index >= size) {
-		index = 0;
+// The precise mode relies on the bitwise multiplication, so it only uses the generic routines
+#if MT32EMU_USE_X86_SIMD && (MT32EMU_USE_FLOAT_SAMPLES || !MT32EMU_BOSS_REVERB_PRECISE_MODE)
+#define MT32EMU_REVERB_USE_X86_SIMD 1
+
+#if MT32EMU_USE_FLOAT_SAMPLES
+
+// Each lane performs the same operations as weirdMul() and the generic routines, so the results are identical
+MT32EMU_X86_TARGET("sse2")
+static void mixDryInputSSE2(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples) {
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	const __m128 amp = _mm_set1_ps(float(Bit8u(dryAmp)));
+	const __m128 divisor = _mm_set1_ps(256.0f);
+	Bit32u i = 0;
+	for (; i + 4 <= numSamples; i += 4) {
+		__m128 dry = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(inLeft + i), quarter), _mm_mul_ps(_mm_loadu_ps(inRight + i), quarter));
+		_mm_storeu_ps(out + i, _mm_div_ps(_mm_mul_ps(dry, amp), divisor));
 	}
-	return buffer[index];
+	mixDryInputGeneric(out + i, inLeft + i, inRight + i, dryAmp, numSamples - i);
 }
 
-bool RingBuffer::isEmpty() const {
-	if (buffer == NULL) return true;
+MT32EMU_X86_TARGET("sse2")
+static void mixCombOutputsSSE2(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples) {
+	const __m128 oneAndHalf = _mm_set1_ps(1.5f);
+	const __m128 level = _mm_set1_ps(float(Bit8u(wetLevel)));
+	const __m128 divisor = _mm_set1_ps(256.0f);
+	Bit32u i = 0;
+	for (; i + 4 <= numSamples; i += 4) {
+		__m128 sum = _mm_add_ps(_mm_mul_ps(oneAndHalf, _mm_add_ps(_mm_loadu_ps(comb1 + i), _mm_loadu_ps(comb2 + i))), _mm_loadu_ps(comb3 + i));
+		_mm_storeu_ps(out + i, _mm_div_ps(_mm_mul_ps(sum, level), divisor));
+	}
+	mixCombOutputsGeneric(out + i, comb1 + i, comb2 + i, comb3 + i, wetLevel, numSamples - i);
+}
+
+MT32EMU_X86_TARGET("avx")
+static void mixDryInputAVX(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples) {
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 amp = _mm256_set1_ps(float(Bit8u(dryAmp)));
+	const __m256 divisor = _mm256_set1_ps(256.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= numSamples; i += 8) {
+		__m256 dry = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(inLeft + i), quarter), _mm256_mul_ps(_mm256_loadu_ps(inRight + i), quarter));
+		_mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_mul_ps(dry, amp), divisor));
+	}
+	mixDryInputSSE2(out + i, inLeft + i, inRight + i, dryAmp, numSamples - i);
+}
+
+MT32EMU_X86_TARGET("avx")
+static void mixCombOutputsAVX(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples) {
+	const __m256 oneAndHalf = _mm256_set1_ps(1.5f);
+	const __m256 level = _mm256_set1_ps(float(Bit8u(wetLevel)));
+	const __m256 divisor = _mm256_set1_ps(256.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= numSamples; i += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_mul_ps(oneAndHalf, _mm256_add_ps(_mm256_loadu_ps(comb1 + i), _mm256_loadu_ps(comb2 + i))), _mm256_loadu_ps(comb3 + i));
+		_mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_mul_ps(sum, level), divisor));
+	}
+	mixCombOutputsSSE2(out + i, comb1 + i, comb2 + i, comb3 + i, wetLevel, numSamples - i);
+}
+
+#else
+
+// As in Partial.cpp, the middle 16 bits of the products are composed of the halves computed separately, that gives the same
+// result as weirdMul(). The comb outputs are summed up in 32 bits, the saturating packing is equivalent to Synth::clipSampleEx().
+MT32EMU_X86_TARGET("sse2")
+static inline __m128i weirdMulSSE2(const __m128i a, const __m128i factor) {
+	return _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epi16(a, factor), 8), _mm_srli_epi16(_mm_mullo_epi16(a, factor), 8));
+}
+
+MT32EMU_X86_TARGET("sse2")
+static void mixDryInputSSE2(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples) {
+	const __m128i amp = _mm_set1_epi16(Bit8u(dryAmp));
+	Bit32u i = 0;
+	for (; i + 8 <= numSamples; i += 8) {
+		__m128i left = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inLeft + i)), 2);
+		__m128i right = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inRight + i)), 2);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), weirdMulSSE2(_mm_add_epi16(left, right), amp));
+	}
+	mixDryInputGeneric(out + i, inLeft + i, inRight + i, dryAmp, numSamples - i);
+}
+
+// Returns x + (x >> 1) for the lower or the higher four samples, extended to 32 bits
+MT32EMU_X86_TARGET("sse2")
+static inline __m128i sumCombOutputHalvesSSE2(const __m128i x, const __m128i y, const __m128i z, const bool high) {
+	const __m128i x32 = _mm_srai_epi32(high ? _mm_unpackhi_epi16(x, x) : _mm_unpacklo_epi16(x, x), 16);
+	const __m128i y32 = _mm_srai_epi32(high ? _mm_unpackhi_epi16(y, y) : _mm_unpacklo_epi16(y, y), 16);
+	const __m128i z32 = _mm_srai_epi32(high ? _mm_unpackhi_epi16(z, z) : _mm_unpacklo_epi16(z, z), 16);
+	return _mm_add_epi32(_mm_add_epi32(_mm_add_epi32(x32, _mm_srai_epi32(x32, 1)), _mm_add_epi32(y32, _mm_srai_epi32(y32, 1))), z32);
+}
+
+MT32EMU_X86_TARGET("sse2")
+static void mixCombOutputsSSE2(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples) {
+	const __m128i level = _mm_set1_epi16(Bit8u(wetLevel));
+	Bit32u i = 0;
+	for (; i + 8 <= numSamples; i += 8) {
+		const __m128i out1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(comb1 + i));
+		const __m128i out2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(comb2 + i));
+		const __m128i out3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(comb3 + i));
+		const __m128i sum = _mm_packs_epi32(sumCombOutputHalvesSSE2(out1, out2, out3, false), sumCombOutputHalvesSSE2(out1, out2, out3, true));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), weirdMulSSE2(sum, level));
+	}
+	mixCombOutputsGeneric(out + i, comb1 + i, comb2 + i, comb3 + i, wetLevel, numSamples - i);
+}
+
+// Same as the SSE2 versions above extended to 256-bit vectors. Unpacking and packing operate within 128-bit lanes,
+// so the order of samples is preserved.
+MT32EMU_X86_TARGET("avx2")
+static inline __m256i weirdMulAVX2(const __m256i a, const __m256i factor) {
+	return _mm256_or_si256(_mm256_slli_epi16(_mm256_mulhi_epi16(a, factor), 8), _mm256_srli_epi16(_mm256_mullo_epi16(a, factor), 8));
+}
 
+MT32EMU_X86_TARGET("avx2")
+static void mixDryInputAVX2(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples) {
+	const __m256i amp = _mm256_set1_epi16(Bit8u(dryAmp));
+	Bit32u i = 0;
+	for (; i + 16 <= numSamples; i += 16) {
+		__m256i left = _mm256_srai_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(inLeft + i)), 2);
+		__m256i right = _mm256_srai_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(inRight + i)), 2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), weirdMulAVX2(_mm256_add_epi16(left, right), amp));
+	}
+	mixDryInputSSE2(out + i, inLeft + i, inRight + i, dryAmp, numSamples - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static inline __m256i sumCombOutputHalvesAVX2(const __m256i x, const __m256i y, const __m256i z, const bool high) {
+	const __m256i x32 = _mm256_srai_epi32(high ? _mm256_unpackhi_epi16(x, x) : _mm256_unpacklo_epi16(x, x), 16);
+	const __m256i y32 = _mm256_srai_epi32(high ? _mm256_unpackhi_epi16(y, y) : _mm256_unpacklo_epi16(y, y), 16);
+	const __m256i z32 = _mm256_srai_epi32(high ? _mm256_unpackhi_epi16(z, z) : _mm256_unpacklo_epi16(z, z), 16);
+	return _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(x32, _mm256_srai_epi32(x32, 1)), _mm256_add_epi32(y32, _mm256_srai_epi32(y32, 1))), z32);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void mixCombOutputsAVX2(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples) {
+	const __m256i level = _mm256_set1_epi16(Bit8u(wetLevel));
+	Bit32u i = 0;
+	for (; i + 16 <= numSamples; i += 16) {
+		const __m256i out1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(comb1 + i));
+		const __m256i out2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(comb2 + i));
+		const __m256i out3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(comb3 + i));
+		const __m256i sum = _mm256_packs_epi32(sumCombOutputHalvesAVX2(out1, out2, out3, false), sumCombOutputHalvesAVX2(out1, out2, out3, true));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), weirdMulAVX2(sum, level));
+	}
+	mixCombOutputsSSE2(out + i, comb1 + i, comb2 + i, comb3 + i, wetLevel, numSamples - i);
+}
+
+#endif // #if MT32EMU_USE_FLOAT_SAMPLES
+
+#endif // #if MT32EMU_USE_X86_SIMD && (MT32EMU_USE_FLOAT_SAMPLES || !MT32EMU_BOSS_REVERB_PRECISE_MODE)
+
+static DryInputKernel selectDryInputKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_REVERB_USE_X86_SIMD
 #if MT32EMU_USE_FLOAT_SAMPLES
-	Sample max = 0.001f;
+	if (simdLevel >= SIMDLevel_AVX) return mixDryInputAVX;
+#else
+	if (simdLevel >= SIMDLevel_AVX2) return mixDryInputAVX2;
+#endif
+	if (simdLevel >= SIMDLevel_SSE2) return mixDryInputSSE2;
 #else
-	Sample max = 8;
+	(void)simdLevel;
 #endif
-	Sample *buf = buffer;
-	for (Bit32u i = 0; i < size; i++) {
-		if (*buf < -max || *buf > max) return false;
-		buf++;
+	return mixDryInputGeneric;
+}
+
+static CombOutputKernel selectCombOutputKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_REVERB_USE_X86_SIMD
+#if MT32EMU_USE_FLOAT_SAMPLES
+	if (simdLevel >= SIMDLevel_AVX) return mixCombOutputsAVX;
+#else
+	if (simdLevel >= SIMDLevel_AVX2) return mixCombOutputsAVX2;
+#endif
+	if (simdLevel >= SIMDLevel_SSE2) return mixCombOutputsSSE2;
+#else
+	(void)simdLevel;
+#endif
+	return mixCombOutputsGeneric;
+}
+
+RingBuffer::RingBuffer() : buffer(NULL), size(0), index(0), pendingWriteCountUntilEmpty(0) {}
+
+void RingBuffer::init(Sample *useBuffer, const Bit32u useSize) {
+	buffer = useBuffer;
+	size = useSize;
+	index = 0;
+	pendingWriteCountUntilEmpty = useSize;
+}
+
+void RingBuffer::advance() {
+	if (++index >= size) {
+		index = 0;
+	}
+}
+
+// Returns the sample stored delay writes ago, delay must be in range [1, size].
+// Intended to be called after advance() but before the sample at the current index is overwritten,
+// so delay == size yields the oldest sample in the buffer.
+Sample RingBuffer::getDelayedSample(const Bit32u delay) const {
+	return buffer[index >= delay ? index - delay : index + size - delay];
+}
+
+// Stores the sample at the current index. As the index only advances by one between writes, a loud sample
+// remains in the buffer until exactly size more samples are stored, so there is no need to scan the buffer.
+void RingBuffer::storeSample(const Sample sample) {
+	buffer[index] = sample;
+	if (sample < -MAX_INACTIVE_SAMPLE || sample > MAX_INACTIVE_SAMPLE) {
+		pendingWriteCountUntilEmpty = size;
+	} else if (pendingWriteCountUntilEmpty > 0) {
+		pendingWriteCountUntilEmpty--;
+	}
+}
+
+// Same as calling storeSample() for each of count samples already written to the buffer, count must not exceed size.
+void RingBuffer::updateActivity(const Sample *storedSamples, const Bit32u count) {
+	for (Bit32u quietCount = 0; quietCount < count; quietCount++) {
+		const Sample sample = storedSamples[count - 1 - quietCount];
+		if (sample < -MAX_INACTIVE_SAMPLE || sample > MAX_INACTIVE_SAMPLE) {
+			pendingWriteCountUntilEmpty = size - quietCount;
+			return;
+		}
 	}
-	return true;
+	pendingWriteCountUntilEmpty = pendingWriteCountUntilEmpty > count ? pendingWriteCountUntilEmpty - count : 0;
+}
+
+bool RingBuffer::isEmpty() const {
+	return buffer == NULL || pendingWriteCountUntilEmpty == 0;
 }
 
 void RingBuffer::mute() {
 	Synth::muteSampleBuffer(buffer, size);
+	pendingWriteCountUntilEmpty = 0;
 }
 
-AllpassFilter::AllpassFilter(const Bit32u useSize) : RingBuffer(useSize) {}
+void RingBuffer::saveState(StateWriter &writer) const {
+	writer.writeBit32u(index);
+	writer.writeBit32u(pendingWriteCountUntilEmpty);
+	writer.writeSamples(buffer, size);
+}
 
-Sample AllpassFilter::process(const Sample in) {
+void RingBuffer::loadState(StateReader &reader) {
+	index = reader.readIndex(size);
+	pendingWriteCountUntilEmpty = reader.readIndex(size + 1);
+	reader.readSamples(buffer, size);
+}
+
+void AllpassFilter::process(Sample *samples, const Bit32u numSamples) {
 	// This model corresponds to the allpass filter implementation of the real CM-32L device
 	// found from sample analysis
 
-	const Sample bufferOut = next();
-
+	// Each sample only depends on the one stored size samples before, so the buffer is processed
+	// in contiguous segments up to the wrap point, which the compiler is free to vectorise.
+	Bit32u processed = 0;
+	while (processed < numSamples) {
+		const Bit32u start = index + 1 < size ? index + 1 : 0;
+		const Bit32u segmentLength = size - start < numSamples - processed ? size - start : numSamples - processed;
+		Sample *segment = buffer + start;
+		Sample *segmentSamples = samples + processed;
+		for (Bit32u i = 0; i < segmentLength; i++) {
+			const Sample bufferOut = segment[i];
 #if MT32EMU_USE_FLOAT_SAMPLES
-	// store input - feedback / 2
-	buffer[index] = in - 0.5f * bufferOut;
+			// store input - feedback / 2
+			const Sample stored = segmentSamples[i] - 0.5f * bufferOut;
+			segment[i] = stored;
 
-	// return buffer output + feedforward / 2
-	return bufferOut + 0.5f * buffer[index];
+			// return buffer output + feedforward / 2
+			segmentSamples[i] = bufferOut + 0.5f * stored;
 #else
-	// store input - feedback / 2
-	buffer[index] = in - (bufferOut >> 1);
+			// store input - feedback / 2
+			const Sample stored = segmentSamples[i] - (bufferOut >> 1);
+			segment[i] = stored;
 
-	// return buffer output + feedforward / 2
-	return bufferOut + (buffer[index] >> 1);
+			// return buffer output + feedforward / 2
+			segmentSamples[i] = bufferOut + (stored >> 1);
 #endif
+		}
+		updateActivity(segment, segmentLength);
+		index = start + segmentLength - 1;
+		processed += segmentLength;
+	}
 }
 
-CombFilter::CombFilter(const Bit32u useSize, const Bit32u useFilterFactor) : RingBuffer(useSize), filterFactor(useFilterFactor) {}
+CombFilter::CombFilter() : filterFactor(0), feedbackFactor(0) {}
+
+void CombFilter::init(Sample *useBuffer, const Bit32u useSize, const Bit32u useFilterFactor) {
+	RingBuffer::init(useBuffer, useSize);
+	filterFactor = useFilterFactor;
+}
 
-void CombFilter::process(const Sample in) {
+void CombFilter::process(const Sample *in, Sample *outL, const Bit32u outLDelay, Sample *outR, const Bit32u outRDelay, const Bit32u numSamples) {
 	// This model corresponds to the comb filter implementation of the real CM-32L device
 
-	// the previously stored value
-	const Sample last = buffer[index];
+	// The low-pass filter makes each stored sample depend on the previous one, so this runs sample by sample
+	for (Bit32u i = 0; i < numSamples; i++) {
+		// the previously stored value
+		const Sample last = buffer[index];
+
+		advance();
+
+		// output taps are read before the sample at the current index gets overwritten
+		outL[i] = getDelayedSample(outLDelay);
+		outR[i] = getDelayedSample(outRDelay);
 
-	// prepare input + feedback
-	const Sample filterIn = in + weirdMul(next(), feedbackFactor, 0xF0);
+		// prepare input + feedback
+		const Sample filterIn = in[i] + weirdMul(buffer[index], feedbackFactor, 0xF0);
+
+		// store input + feedback processed by a low-pass filter
+		storeSample(weirdMul(last, filterFactor, 0xC0) - filterIn);
+	}
+}
 
-	// store input + feedback processed by a low-pass filter
-	buffer[index] = weirdMul(last, filterFactor, 0xC0) - filterIn;
+void CombFilter::saveState(StateWriter &writer) const {
+	RingBuffer::saveState(writer);
+	writer.writeBit32u(feedbackFactor);
 }
 
-Sample CombFilter::getOutputAt(const Bit32u outIndex) const {
-	return buffer[(size + index - outIndex) % size];
+void CombFilter::loadState(StateReader &reader) {
+	RingBuffer::loadState(reader);
+	feedbackFactor = reader.readBit32u();
 }
 
 void CombFilter::setFeedbackFactor(const Bit32u useFeedbackFactor) {
 	feedbackFactor = useFeedbackFactor;
 }
 
-DelayWithLowPassFilter::DelayWithLowPassFilter(const Bit32u useSize, const Bit32u useFilterFactor, const Bit32u useAmp)
-	: CombFilter(useSize, useFilterFactor), amp(useAmp) {}
+DelayWithLowPassFilter::DelayWithLowPassFilter() : filterFactor(0), amp(0) {}
 
-void DelayWithLowPassFilter::process(const Sample in) {
-	// the previously stored value
-	const Sample last = buffer[index];
+void DelayWithLowPassFilter::init(Sample *useBuffer, const Bit32u useSize, const Bit32u useFilterFactor, const Bit32u useAmp) {
+	RingBuffer::init(useBuffer, useSize);
+	filterFactor = useFilterFactor;
+	amp = useAmp;
+}
 
-	// move to the next index
-	next();
+void DelayWithLowPassFilter::process(Sample *samples, const Bit32u numSamples) {
+	for (Bit32u i = 0; i < numSamples; i++) {
+		// the previously stored value
+		const Sample last = buffer[index];
 
-	// low-pass filter process
-	Sample lpfOut = weirdMul(last, filterFactor, 0xFF) + in;
+		// move to the next index
+		advance();
 
-	// store lpfOut multiplied by LPF amp factor
-	buffer[index] = weirdMul(lpfOut, amp, 0xFF);
-}
+		// the output is the oldest sample which is about to be replaced
+		const Sample in = samples[i];
+		samples[i] = buffer[index];
 
-TapDelayCombFilter::TapDelayCombFilter(const Bit32u useSize, const Bit32u useFilterFactor) : CombFilter(useSize, useFilterFactor) {}
+		// low-pass filter process
+		Sample lpfOut = weirdMul(last, filterFactor, 0xFF) + in;
 
-void TapDelayCombFilter::process(const Sample in) {
-	// the previously stored value
-	const Sample last = buffer[index];
+		// store lpfOut multiplied by LPF amp factor
+		storeSample(weirdMul(lpfOut, amp, 0xFF));
+	}
+}
 
-	// move to the next index
-	next();
+TapDelayCombFilter::TapDelayCombFilter() : outL(0), outR(0) {}
 
-	// prepare input + feedback
-	// Actually, the size of the filter varies with the TIME parameter, the feedback sample is taken from the position just below the right output
-	const Sample filterIn = in + weirdMul(getOutputAt(outR + MODE_3_FEEDBACK_DELAY), feedbackFactor, 0xF0);
+void TapDelayCombFilter::process(const Sample *in, Sample *outLeft, Sample *outRight, const Bit32u numSamples) {
+	for (Bit32u i = 0; i < numSamples; i++) {
+		// the previously stored value
+		const Sample last = buffer[index];
 
-	// store input + feedback processed by a low-pass filter
-	buffer[index] = weirdMul(last, filterFactor, 0xF0) - filterIn;
-}
+		// move to the next index
+		advance();
 
-Sample TapDelayCombFilter::getLeftOutput() const {
-	return getOutputAt(outL + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY);
-}
+		// prepare input + feedback
+		// Actually, the size of the filter varies with the TIME parameter, the feedback sample is taken from the position just below the right output
+		const Sample filterIn = in[i] + weirdMul(getDelayedSample(outR + MODE_3_FEEDBACK_DELAY), feedbackFactor, 0xF0);
 
-Sample TapDelayCombFilter::getRightOutput() const {
-	return getOutputAt(outR + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY);
+		outLeft[i] = getDelayedSample(outL + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY);
+		outRight[i] = getDelayedSample(outR + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY);
+
+		// store input + feedback processed by a low-pass filter
+		storeSample(weirdMul(last, filterFactor, 0xF0) - filterIn);
+	}
 }
 
 void TapDelayCombFilter::setOutputPositions(const Bit32u useOutL, const Bit32u useOutR) {
@@ -325,81 +620,98 @@ void TapDelayCombFilter::setOutputPositions(const Bit32u useOutL, const Bit32u u
 	outR = useOutR;
 }
 
-BReverbModel::BReverbModel(const ReverbMode mode, const bool mt32CompatibleModel) :
-	allpasses(NULL), combs(NULL),
+void TapDelayCombFilter::saveState(StateWriter &writer) const {
+	CombFilter::saveState(writer);
+	writer.writeBit32u(outL);
+	writer.writeBit32u(outR);
+}
+
+void TapDelayCombFilter::loadState(StateReader &reader) {
+	CombFilter::loadState(reader);
+	// Delays with the extra margins must not exceed the buffer size, see process()
+	outL = reader.readBit32u();
+	outR = reader.readBit32u();
+	if (size < outL + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY || size < outR + PROCESS_DELAY + MODE_3_ADDITIONAL_DELAY) {
+		reader.fail();
+		outL = outR = 0;
+	}
+}
+
+BReverbModel::BReverbModel(const ReverbMode mode, const bool mt32CompatibleModel, const SIMDLevel simdLevel) :
+	delayLines(NULL),
 	currentSettings(mt32CompatibleModel ? getMT32Settings(mode) : getCM32L_LAPCSettings(mode)),
-	tapDelayMode(mode == REVERB_MODE_TAP_DELAY) {}
+	tapDelayMode(mode == REVERB_MODE_TAP_DELAY),
+	dryInputKernel(selectDryInputKernel(simdLevel)),
+	combOutputKernel(selectCombOutputKernel(simdLevel)) {}
 
 BReverbModel::~BReverbModel() {
 	close();
 }
 
 void BReverbModel::open() {
-	if (currentSettings.numberOfAllpasses > 0) {
-		allpasses = new AllpassFilter*[currentSettings.numberOfAllpasses];
-		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
-			allpasses[i] = new AllpassFilter(currentSettings.allpassSizes[i]);
-		}
+	Bit32u delayLinesSize = 0;
+	for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
+		delayLinesSize += currentSettings.allpassSizes[i];
+	}
+	for (Bit32u i = 0; i < currentSettings.numberOfCombs; i++) {
+		delayLinesSize += currentSettings.combSizes[i];
 	}
-	combs = new CombFilter*[currentSettings.numberOfCombs];
+	delayLines = new Sample[delayLinesSize];
+
+	// Delay lines are laid out in the order of processing
+	Sample *nextBuffer = delayLines;
 	if (tapDelayMode) {
-		*combs = new TapDelayCombFilter(*currentSettings.combSizes, *currentSettings.filterFactors);
+		tapDelayComb.init(nextBuffer, *currentSettings.combSizes, *currentSettings.filterFactors);
 	} else {
-		combs[0] = new DelayWithLowPassFilter(currentSettings.combSizes[0], currentSettings.filterFactors[0], currentSettings.lpfAmp);
+		// Well, actually there are 3 comb filters, the first "comb" in the settings is the entrance LPF + delay
+		entranceDelay.init(nextBuffer, currentSettings.combSizes[0], currentSettings.filterFactors[0], currentSettings.lpfAmp);
+		nextBuffer += currentSettings.combSizes[0];
+		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
+			allpasses[i].init(nextBuffer, currentSettings.allpassSizes[i]);
+			nextBuffer += currentSettings.allpassSizes[i];
+		}
 		for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
-			combs[i] = new CombFilter(currentSettings.combSizes[i], currentSettings.filterFactors[i]);
+			combs[i - 1].init(nextBuffer, currentSettings.combSizes[i], currentSettings.filterFactors[i]);
+			nextBuffer += currentSettings.combSizes[i];
 		}
 	}
 	mute();
 }
 
 void BReverbModel::close() {
-	if (allpasses != NULL) {
-		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
-			if (allpasses[i] != NULL) {
-				delete allpasses[i];
-				allpasses[i] = NULL;
-			}
-		}
-		delete[] allpasses;
-		allpasses = NULL;
-	}
-	if (combs != NULL) {
-		for (Bit32u i = 0; i < currentSettings.numberOfCombs; i++) {
-			if (combs[i] != NULL) {
-				delete combs[i];
-				combs[i] = NULL;
-			}
-		}
-		delete[] combs;
-		combs = NULL;
+	if (delayLines != NULL) {
+		delete[] delayLines;
+		delayLines = NULL;
 	}
 }
 
 void BReverbModel::mute() {
-	if (allpasses != NULL) {
+	if (delayLines == NULL) return;
+	if (tapDelayMode) {
+		tapDelayComb.mute();
+	} else {
+		entranceDelay.mute();
 		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
-			allpasses[i]->mute();
+			allpasses[i].mute();
 		}
-	}
-	if (combs != NULL) {
-		for (Bit32u i = 0; i < currentSettings.numberOfCombs; i++) {
-			combs[i]->mute();
+		for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+			combs[i - 1].mute();
 		}
 	}
+	blockPosition = 0;
+	idle = false;
 }
 
 void BReverbModel::setParameters(Bit8u time, Bit8u level) {
-	if (combs == NULL) return;
+	if (delayLines == NULL) return;
 	level &= 7;
 	time &= 7;
 	if (tapDelayMode) {
-		TapDelayCombFilter *comb = static_cast<TapDelayCombFilter *> (*combs);
-		comb->setOutputPositions(currentSettings.outLPositions[time], currentSettings.outRPositions[time & 7]);
-		comb->setFeedbackFactor(currentSettings.feedbackFactors[((level < 3) || (time < 6)) ? 0 : 1]);
+		tapDelayComb.setOutputPositions(currentSettings.outLPositions[time], currentSettings.outRPositions[time & 7]);
+		tapDelayComb.setFeedbackFactor(currentSettings.feedbackFactors[((level < 3) || (time < 6)) ? 0 : 1]);
 	} else {
-		for (Bit32u i = 0; i < currentSettings.numberOfCombs; i++) {
-			combs[i]->setFeedbackFactor(currentSettings.feedbackFactors[(i << 3) + time]);
+		for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+			combs[i - 1].setFeedbackFactor(currentSettings.feedbackFactors[(i << 3) + time]);
 		}
 	}
 	if (time == 0 && level == 0) {
@@ -417,14 +729,18 @@ void BReverbModel::setParameters(Bit8u time, Bit8u level) {
 }
 
 bool BReverbModel::isActive() const {
-	if (combs == NULL) {
+	if (delayLines == NULL) {
 		return false;
 	}
+	if (tapDelayMode) {
+		return !tapDelayComb.isEmpty();
+	}
+	if (!entranceDelay.isEmpty()) return true;
 	for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
-		if (!allpasses[i]->isEmpty()) return true;
+		if (!allpasses[i].isEmpty()) return true;
 	}
-	for (Bit32u i = 0; i < currentSettings.numberOfCombs; i++) {
-		if (!combs[i]->isEmpty()) return true;
+	for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+		if (!combs[i - 1].isEmpty()) return true;
 	}
 	return false;
 }
@@ -433,97 +749,148 @@ bool BReverbModel::isMT32Compatible(const ReverbMode mode) const {
 	return &currentSettings == &getMT32Settings(mode);
 }
 
+bool BReverbModel::isOpen() const {
+	return delayLines != NULL;
+}
+
+void BReverbModel::saveState(StateWriter &writer) const {
+	if (tapDelayMode) {
+		tapDelayComb.saveState(writer);
+	} else {
+		entranceDelay.saveState(writer);
+		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
+			allpasses[i].saveState(writer);
+		}
+		for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+			combs[i - 1].saveState(writer);
+		}
+	}
+	writer.writeBit32u(dryAmp);
+	writer.writeBit32u(wetLevel);
+	writer.writeBit32u(blockPosition);
+	writer.writeBool(idle);
+}
+
+void BReverbModel::loadState(StateReader &reader) {
+	if (tapDelayMode) {
+		tapDelayComb.loadState(reader);
+	} else {
+		entranceDelay.loadState(reader);
+		for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
+			allpasses[i].loadState(reader);
+		}
+		for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+			combs[i - 1].loadState(reader);
+		}
+	}
+	dryAmp = reader.readBit32u();
+	wetLevel = reader.readBit32u();
+	blockPosition = reader.readBit32u();
+	idle = reader.readBool();
+	if (blockPosition >= MAX_BLOCK_LENGTH) reader.fail();
+}
+
 void BReverbModel::process(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, unsigned long numSamples) {
-	if (combs == NULL) {
+	if (delayLines == NULL) {
 		Synth::muteSampleBuffer(outLeft, numSamples);
 		Synth::muteSampleBuffer(outRight, numSamples);
 		return;
 	}
 
-	Sample dry;
-
-	while ((numSamples--) > 0) {
+	while (numSamples > 0) {
+		// Once the tail has decayed, the model would only circulate the noise below the activity threshold.
+		// Unless there is new input, just leave it as it is and produce silence. The activity is checked at the block
+		// boundaries counted from the last mute, so the output doesn't depend on how the input is split in calls.
+		if (!idle && blockPosition == 0 && !isActive()) idle = true;
+		if (idle) {
+			Bit32u silentLength = 0;
+			while (silentLength < numSamples && inLeft[silentLength] == 0 && inRight[silentLength] == 0) silentLength++;
+			Synth::muteSampleBuffer(outLeft, silentLength);
+			Synth::muteSampleBuffer(outRight, silentLength);
+			inLeft += silentLength;
+			inRight += silentLength;
+			if (outLeft != NULL) outLeft += silentLength;
+			if (outRight != NULL) outRight += silentLength;
+			numSamples -= silentLength;
+			blockPosition = (blockPosition + silentLength) % MAX_BLOCK_LENGTH;
+			if (numSamples == 0) break;
+			idle = false;
+		}
+		const Bit32u blockLength = numSamples < MAX_BLOCK_LENGTH - blockPosition ? Bit32u(numSamples) : MAX_BLOCK_LENGTH - blockPosition;
 		if (tapDelayMode) {
-#if MT32EMU_USE_FLOAT_SAMPLES
-			dry = (*(inLeft++) * 0.5f) + (*(inRight++) * 0.5f);
-#else
-			dry = (*(inLeft++) >> 1) + (*(inRight++) >> 1);
-#endif
+			processTapDelayBlock(inLeft, inRight, outLeft, outRight, blockLength);
 		} else {
-#if MT32EMU_USE_FLOAT_SAMPLES
-			dry = (*(inLeft++) * 0.25f) + (*(inRight++) * 0.25f);
-#elif MT32EMU_BOSS_REVERB_PRECISE_MODE
-			dry = (*(inLeft++) >> 1) / 2 + (*(inRight++) >> 1) / 2;
-#else
-			dry = (*(inLeft++) >> 2) + (*(inRight++) >> 2);
-#endif
+			processBlock(inLeft, inRight, outLeft, outRight, blockLength);
 		}
+		inLeft += blockLength;
+		inRight += blockLength;
+		if (outLeft != NULL) outLeft += blockLength;
+		if (outRight != NULL) outRight += blockLength;
+		numSamples -= blockLength;
+		blockPosition = (blockPosition + blockLength) % MAX_BLOCK_LENGTH;
+	}
+}
 
-		// Looks like dryAmp doesn't change in MT-32 but it does in CM-32L / LAPC-I
-		dry = weirdMul(dry, dryAmp, 0xFF);
+// The model has no feedback between the stages, so instead of passing each sample through the whole chain,
+// every stage processes the entire block before the next one starts. This produces exactly the same output.
+void BReverbModel::processBlock(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, const Bit32u numSamples) {
+	Sample link[MAX_BLOCK_LENGTH];
+	Sample combOutL[MAX_NUMBER_OF_COMBS][MAX_BLOCK_LENGTH];
+	Sample combOutR[MAX_NUMBER_OF_COMBS][MAX_BLOCK_LENGTH];
 
-		if (tapDelayMode) {
-			TapDelayCombFilter *comb = static_cast<TapDelayCombFilter *> (*combs);
-			comb->process(dry);
-			if (outLeft != NULL) {
-				*(outLeft++) = weirdMul(comb->getLeftOutput(), wetLevel, 0xFF);
-			}
-			if (outRight != NULL) {
-				*(outRight++) = weirdMul(comb->getRightOutput(), wetLevel, 0xFF);
-			}
-		} else {
-			// If the output position is equal to the comb size, get it now in order not to loose it
-			Sample link = combs[0]->getOutputAt(currentSettings.combSizes[0] - 1);
+	dryInputKernel(link, inLeft, inRight, dryAmp, numSamples);
 
-			// Entrance LPF. Note, comb.process() differs a bit here.
-			combs[0]->process(dry);
+	// Entrance LPF
+	entranceDelay.process(link, numSamples);
 
 #if !MT32EMU_USE_FLOAT_SAMPLES
-			// This introduces reverb noise which actually makes output from the real Boss chip nondeterministic
-			link = link - 1;
+	// This introduces reverb noise which actually makes output from the real Boss chip nondeterministic
+	for (Bit32u i = 0; i < numSamples; i++) {
+		link[i] = link[i] - 1;
+	}
 #endif
-			link = allpasses[0]->process(link);
-			link = allpasses[1]->process(link);
-			link = allpasses[2]->process(link);
 
-			// If the output position is equal to the comb size, get it now in order not to loose it
-			Sample outL1 = combs[1]->getOutputAt(currentSettings.outLPositions[0] - 1);
+	for (Bit32u i = 0; i < currentSettings.numberOfAllpasses; i++) {
+		allpasses[i].process(link, numSamples);
+	}
 
-			combs[1]->process(link);
-			combs[2]->process(link);
-			combs[3]->process(link);
+	for (Bit32u i = 1; i < currentSettings.numberOfCombs; i++) {
+		combs[i - 1].process(link, combOutL[i - 1], currentSettings.outLPositions[i - 1], combOutR[i - 1], currentSettings.outRPositions[i - 1], numSamples);
+	}
 
-			if (outLeft != NULL) {
-				Sample outL2 = combs[2]->getOutputAt(currentSettings.outLPositions[1]);
-				Sample outL3 = combs[3]->getOutputAt(currentSettings.outLPositions[2]);
-#if MT32EMU_USE_FLOAT_SAMPLES
-				Sample outSample = 1.5f * (outL1 + outL2) + outL3;
-#elif MT32EMU_BOSS_REVERB_PRECISE_MODE
-				/* NOTE:
-				 *   Thanks to Mok for discovering, the adder in BOSS reverb chip is found to perform addition with saturation to avoid integer overflow.
-				 *   Analysing of the algorithm suggests that the overflow is most probable when the combs output is added below.
-				 *   So, despite this isn't actually accurate, we only add the check here for performance reasons.
-				 */
-				Sample outSample = Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx((SampleEx)outL1 + SampleEx(outL1 >> 1)) + (SampleEx)outL2) + SampleEx(outL2 >> 1)) + (SampleEx)outL3);
-#else
-				Sample outSample = Synth::clipSampleEx((SampleEx)outL1 + SampleEx(outL1 >> 1) + (SampleEx)outL2 + SampleEx(outL2 >> 1) + (SampleEx)outL3);
-#endif
-				*(outLeft++) = weirdMul(outSample, wetLevel, 0xFF);
-			}
-			if (outRight != NULL) {
-				Sample outR1 = combs[1]->getOutputAt(currentSettings.outRPositions[0]);
-				Sample outR2 = combs[2]->getOutputAt(currentSettings.outRPositions[1]);
-				Sample outR3 = combs[3]->getOutputAt(currentSettings.outRPositions[2]);
+	if (outLeft != NULL) {
+		combOutputKernel(outLeft, combOutL[0], combOutL[1], combOutL[2], wetLevel, numSamples);
+	}
+	if (outRight != NULL) {
+		combOutputKernel(outRight, combOutR[0], combOutR[1], combOutR[2], wetLevel, numSamples);
+	}
+}
+
+void BReverbModel::processTapDelayBlock(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, const Bit32u numSamples) {
+	// Only the first numSamples entries are used, the array is zeroed to keep the compiler from warning
+	Sample dry[MAX_BLOCK_LENGTH] = {0};
+	Sample tapOutL[MAX_BLOCK_LENGTH];
+	Sample tapOutR[MAX_BLOCK_LENGTH];
+
+	for (Bit32u i = 0; i < numSamples; i++) {
 #if MT32EMU_USE_FLOAT_SAMPLES
-				Sample outSample = 1.5f * (outR1 + outR2) + outR3;
-#elif MT32EMU_BOSS_REVERB_PRECISE_MODE
-				// See the note above for the left channel output.
-				Sample outSample = Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx(Synth::clipSampleEx((SampleEx)outR1 + SampleEx(outR1 >> 1)) + (SampleEx)outR2) + SampleEx(outR2 >> 1)) + (SampleEx)outR3);
+		Sample drySample = (inLeft[i] * 0.5f) + (inRight[i] * 0.5f);
 #else
-				Sample outSample = Synth::clipSampleEx((SampleEx)outR1 + SampleEx(outR1 >> 1) + (SampleEx)outR2 + SampleEx(outR2 >> 1) + (SampleEx)outR3);
+		Sample drySample = (inLeft[i] >> 1) + (inRight[i] >> 1);
 #endif
-				*(outRight++) = weirdMul(outSample, wetLevel, 0xFF);
-			}
+		dry[i] = weirdMul(drySample, dryAmp, 0xFF);
+	}
+
+	tapDelayComb.process(dry, tapOutL, tapOutR, numSamples);
+
+	if (outLeft != NULL) {
+		for (Bit32u i = 0; i < numSamples; i++) {
+			outLeft[i] = weirdMul(tapOutL[i], wetLevel, 0xFF);
+		}
+	}
+	if (outRight != NULL) {
+		for (Bit32u i = 0; i < numSamples; i++) {
+			outRight[i] = weirdMul(tapOutR[i], wetLevel, 0xFF);
 		}
 	}
 }
@@ -21,9 +21,13 @@
 #include "globals.h"
 #include "internals.h"
 #include "Types.h"
+#include "Enumerations.h"
 
 namespace MT32Emu {
 
+class StateReader;
+class StateWriter;
+
 struct BReverbSettings {
 	const Bit32u numberOfAllpasses;
 	const Bit32u * const allpassSizes;
@@ -38,45 +42,57 @@ struct BReverbSettings {
 	const Bit32u lpfAmp;
 };
 
+// Delay line which stores samples in a memory region provided by the owner.
+// The filters below are plain classes with no virtual functions, they process blocks of samples at once.
 class RingBuffer {
 protected:
 	Sample *buffer;
-	const Bit32u size;
+	Bit32u size;
 	Bit32u index;
+	// Number of writes left until all the samples stored in the buffer are below the activity threshold
+	Bit32u pendingWriteCountUntilEmpty;
+
+	void advance();
+	Sample getDelayedSample(const Bit32u delay) const;
+	void storeSample(const Sample sample);
+	void updateActivity(const Sample *storedSamples, const Bit32u count);
 
 public:
-	RingBuffer(const Bit32u size);
-	virtual ~RingBuffer();
-	Sample next();
+	RingBuffer();
+	void init(Sample *useBuffer, const Bit32u useSize);
 	bool isEmpty() const;
 	void mute();
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 class AllpassFilter : public RingBuffer {
 public:
-	AllpassFilter(const Bit32u size);
-	Sample process(const Sample in);
+	void process(Sample *samples, const Bit32u numSamples);
 };
 
 class CombFilter : public RingBuffer {
 protected:
-	const Bit32u filterFactor;
+	Bit32u filterFactor;
 	Bit32u feedbackFactor;
 
 public:
-	CombFilter(const Bit32u size, const Bit32u useFilterFactor);
-	virtual void process(const Sample in);
-	Sample getOutputAt(const Bit32u outIndex) const;
+	CombFilter();
+	void init(Sample *useBuffer, const Bit32u useSize, const Bit32u useFilterFactor);
+	void process(const Sample *in, Sample *outL, const Bit32u outLDelay, Sample *outR, const Bit32u outRDelay, const Bit32u numSamples);
 	void setFeedbackFactor(const Bit32u useFeedbackFactor);
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
-class DelayWithLowPassFilter : public CombFilter {
+class DelayWithLowPassFilter : public RingBuffer {
+	Bit32u filterFactor;
 	Bit32u amp;
 
 public:
-	DelayWithLowPassFilter(const Bit32u useSize, const Bit32u useFilterFactor, const Bit32u useAmp);
-	void process(const Sample in);
-	void setFeedbackFactor(const Bit32u) {}
+	DelayWithLowPassFilter();
+	void init(Sample *useBuffer, const Bit32u useSize, const Bit32u useFilterFactor, const Bit32u useAmp);
+	void process(Sample *samples, const Bit32u numSamples);
 };
 
 class TapDelayCombFilter : public CombFilter {
@@ -84,27 +100,50 @@ class TapDelayCombFilter : public CombFilter {
 	Bit32u outR;
 
 public:
-	TapDelayCombFilter(const Bit32u useSize, const Bit32u useFilterFactor);
-	void process(const Sample in);
-	Sample getLeftOutput() const;
-	Sample getRightOutput() const;
+	TapDelayCombFilter();
+	void process(const Sample *in, Sample *outLeft, Sample *outRight, const Bit32u numSamples);
 	void setOutputPositions(const Bit32u useOutL, const Bit32u useOutR);
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
+// Produces the reverb input, i.e. the dry signal attenuated by dryAmp, from the left and right input channels
+typedef void (*DryInputKernel)(Sample *out, const Sample *inLeft, const Sample *inRight, const Bit32u dryAmp, const Bit32u numSamples);
+// Sums up the outputs of three combs and attenuates the result by wetLevel producing a channel of the wet signal
+typedef void (*CombOutputKernel)(Sample *out, const Sample *comb1, const Sample *comb2, const Sample *comb3, const Bit32u wetLevel, const Bit32u numSamples);
+
 class BReverbModel {
-	AllpassFilter **allpasses;
-	CombFilter **combs;
+	static const Bit32u MAX_NUMBER_OF_ALLPASSES = 3;
+	static const Bit32u MAX_NUMBER_OF_COMBS = 3;
+	// Input is processed in blocks of at most this many samples, each stage of the model runs over the whole block at once
+	static const Bit32u MAX_BLOCK_LENGTH = 256;
+
+	// All the delay lines are allocated in a single chunk, NULL when closed
+	Sample *delayLines;
+	AllpassFilter allpasses[MAX_NUMBER_OF_ALLPASSES];
+	DelayWithLowPassFilter entranceDelay;
+	CombFilter combs[MAX_NUMBER_OF_COMBS];
+	TapDelayCombFilter tapDelayComb;
 
 	const BReverbSettings &currentSettings;
 	const bool tapDelayMode;
+	const DryInputKernel dryInputKernel;
+	const CombOutputKernel combOutputKernel;
 	Bit32u dryAmp;
 	Bit32u wetLevel;
+	// Samples processed since the start of the current block, counted from the last mute
+	Bit32u blockPosition;
+	// Set once the activity has decayed at a block boundary, the model stays unchanged until there is new input
+	bool idle;
 
 	static const BReverbSettings &getCM32L_LAPCSettings(const ReverbMode mode);
 	static const BReverbSettings &getMT32Settings(const ReverbMode mode);
 
+	void processBlock(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, const Bit32u numSamples);
+	void processTapDelayBlock(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, const Bit32u numSamples);
+
 public:
-	BReverbModel(const ReverbMode mode, const bool mt32CompatibleModel = false);
+	BReverbModel(const ReverbMode mode, const bool mt32CompatibleModel = false, const SIMDLevel simdLevel = SIMDLevel_GENERIC);
 	~BReverbModel();
 	// After construction or a close(), open() must be called at least once before any other call (with the exception of close()).
 	void open();
@@ -115,6 +154,10 @@ public:
 	void process(const Sample *inLeft, const Sample *inRight, Sample *outLeft, Sample *outRight, unsigned long numSamples);
 	bool isActive() const;
 	bool isMT32Compatible(const ReverbMode mode) const;
+	bool isOpen() const;
+	// Store and restore the contents of the delay lines and the parameters. The model must be open.
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 } // namespace MT32Emu
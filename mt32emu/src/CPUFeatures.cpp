@@ -0,0 +1,93 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+
+#include "internals.h"
+
+#include "CPUFeatures.h"
+
+#if MT32EMU_USE_X86_SIMD && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace MT32Emu {
+
+static const char * const SIMD_LEVEL_NAMES[] = {"auto", "generic", "sse2", "avx", "avx2"};
+
+#if MT32EMU_USE_X86_SIMD
+
+#ifdef _MSC_VER
+
+static SIMDLevel detectSIMDLevel() {
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	if (maxLeaf < 1) return SIMDLevel_GENERIC;
+	__cpuid(info, 1);
+	if ((info[3] & (1 << 26)) == 0) return SIMDLevel_GENERIC;
+	// Besides the CPU support, the OS must preserve the upper halves of the YMM registers on context switches
+	const bool osxsaveSupported = (info[2] & (1 << 27)) != 0;
+	if ((info[2] & (1 << 28)) == 0 || !osxsaveSupported || (_xgetbv(0) & 6) != 6) return SIMDLevel_SSE2;
+	if (maxLeaf < 7) return SIMDLevel_AVX;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0 ? SIMDLevel_AVX2 : SIMDLevel_AVX;
+}
+
+#else
+
+// The builtin takes the OS support of the AVX state into account
+static SIMDLevel detectSIMDLevel() {
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse2")) return SIMDLevel_GENERIC;
+	if (!__builtin_cpu_supports("avx")) return SIMDLevel_SSE2;
+	return __builtin_cpu_supports("avx2") ? SIMDLevel_AVX2 : SIMDLevel_AVX;
+}
+
+#endif // #ifdef _MSC_VER
+
+#else
+
+static SIMDLevel detectSIMDLevel() {
+	return SIMDLevel_GENERIC;
+}
+
+#endif // #if MT32EMU_USE_X86_SIMD
+
+SIMDLevel CPUFeatures::getSupportedSIMDLevel() {
+	static const SIMDLevel supportedLevel = detectSIMDLevel();
+	return supportedLevel;
+}
+
+bool CPUFeatures::parseSIMDLevel(const char *name, SIMDLevel &level) {
+	for (int levelIx = SIMDLevel_AUTO; levelIx <= SIMDLevel_AVX2; levelIx++) {
+		const char *levelName = SIMD_LEVEL_NAMES[levelIx];
+		Bit32u i = 0;
+		while (name[i] != 0 && tolower((unsigned char)name[i]) == levelName[i]) i++;
+		if (name[i] == 0 && levelName[i] == 0) {
+			level = SIMDLevel(levelIx);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *CPUFeatures::getSIMDLevelName(SIMDLevel level) {
+	return level <= SIMDLevel_AVX2 ? SIMD_LEVEL_NAMES[level] : "unknown";
+}
+
+} // namespace MT32Emu
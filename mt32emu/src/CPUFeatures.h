@@ -0,0 +1,42 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_CPU_FEATURES_H
+#define MT32EMU_CPU_FEATURES_H
+
+#include "globals.h"
+#include "Enumerations.h"
+
+namespace MT32Emu {
+
+// Detects the SIMD instruction set extensions available for the optimised DSP routines, see SIMDLevel.
+class CPUFeatures {
+public:
+	// Returns the highest level the library is compiled for which the CPU and the OS support. Detected once per process.
+	static SIMDLevel getSupportedSIMDLevel();
+
+	// Parses a level name as accepted in the environment variable MT32EMU_SIMD_LEVEL, the case is ignored.
+	// Returns false if the name isn't recognised, leaving the level unchanged.
+	static bool parseSIMDLevel(const char *name, SIMDLevel &level);
+
+	// Returns the lowercase name of the level.
+	static const char *getSIMDLevelName(SIMDLevel level);
+}; // class CPUFeatures
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_CPU_FEATURES_H
@@ -0,0 +1,52 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "internals.h"
+
+#include "Clock.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+namespace MT32Emu {
+
+double Clock::getSeconds() {
+#ifdef _WIN32
+	static double period = 0.0;
+	LARGE_INTEGER counter;
+	if (period == 0.0) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		period = 1.0 / double(frequency.QuadPart);
+	}
+	QueryPerformanceCounter(&counter);
+	return double(counter.QuadPart) * period;
+#elif defined(CLOCK_MONOTONIC)
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return double(time.tv_sec) + double(time.tv_nsec) * 1e-9;
+#else
+	timeval time;
+	gettimeofday(&time, NULL);
+	return double(time.tv_sec) + double(time.tv_usec) * 1e-6;
+#endif
+}
+
+} // namespace MT32Emu
@@ -35,6 +35,12 @@
 #define MT32EMU_PARTIAL_STATE_NAME mt32emu_partial_state
 #define MT32EMU_PARTIAL_STATE(ident) MT32EMU_PS_##ident
 
+#define MT32EMU_POLY_ABORT_REASON_NAME mt32emu_poly_abort_reason
+#define MT32EMU_POLY_ABORT_REASON(ident) MT32EMU_PAR_##ident
+
+#define MT32EMU_SIMD_LEVEL_NAME mt32emu_simd_level
+#define MT32EMU_SIMD_LEVEL(ident) MT32EMU_SL_##ident
+
 #else /* #ifdef MT32EMU_C_ENUMERATIONS */
 
 #define MT32EMU_CPP_ENUMERATIONS_H
@@ -51,6 +57,12 @@
 #define MT32EMU_PARTIAL_STATE_NAME PartialState
 #define MT32EMU_PARTIAL_STATE(ident) PartialState_##ident
 
+#define MT32EMU_POLY_ABORT_REASON_NAME PolyAbortReason
+#define MT32EMU_POLY_ABORT_REASON(ident) PolyAbortReason_##ident
+
+#define MT32EMU_SIMD_LEVEL_NAME SIMDLevel
+#define MT32EMU_SIMD_LEVEL(ident) SIMDLevel_##ident
+
 namespace MT32Emu {
 
 #endif /* #ifdef MT32EMU_C_ENUMERATIONS */
@@ -134,6 +146,38 @@ enum MT32EMU_PARTIAL_STATE_NAME {
 	MT32EMU_PARTIAL_STATE(RELEASE)
 };
 
+/** Reasons for aborting a playing poly to free up partials for a new one, as counted in the polyphony statistics. */
+enum MT32EMU_POLY_ABORT_REASON_NAME {
+	/** The same key is played again by a part in single-assign mode. */
+	MT32EMU_POLY_ABORT_REASON(SAME_KEY),
+	/** The poly is releasing and its part uses more partials than reserved. */
+	MT32EMU_POLY_ABORT_REASON(RELEASING_OVER_RESERVE),
+	/** The poly is held or playing and its part uses more partials than reserved. */
+	MT32EMU_POLY_ABORT_REASON(OVER_RESERVE),
+	/** The poly belongs to the part that plays the new poly and there are no other polys to abort. */
+	MT32EMU_POLY_ABORT_REASON(SAME_PART)
+};
+
+/**
+ * Sets of SIMD instruction set extensions the optimised DSP routines are compiled for. The routines selected produce
+ * bit-identical output, so the level only affects the rendering speed. Apart from AUTO, each level includes the lower ones.
+ */
+enum MT32EMU_SIMD_LEVEL_NAME {
+	/**
+	 * Selects the highest level supported by the CPU, unless the environment variable MT32EMU_SIMD_LEVEL names another one
+	 * (generic, sse2, avx or avx2).
+	 */
+	MT32EMU_SIMD_LEVEL(AUTO),
+	/** Only portable C++ code is used. */
+	MT32EMU_SIMD_LEVEL(GENERIC),
+	/** The routines using SSE2 instructions, available in all x86-64 CPUs. */
+	MT32EMU_SIMD_LEVEL(SSE2),
+	/** Floating-point routines are extended to 256-bit vectors with AVX instructions. */
+	MT32EMU_SIMD_LEVEL(AVX),
+	/** Integer routines are extended to 256-bit vectors with AVX2 instructions, gathered loads are used as well. */
+	MT32EMU_SIMD_LEVEL(AVX2)
+};
+
 #ifndef MT32EMU_C_ENUMERATIONS
 
 } // namespace MT32Emu
@@ -152,4 +196,10 @@ enum MT32EMU_PARTIAL_STATE_NAME {
 #undef MT32EMU_PARTIAL_STATE_NAME
 #undef MT32EMU_PARTIAL_STATE
 
+#undef MT32EMU_POLY_ABORT_REASON_NAME
+#undef MT32EMU_POLY_ABORT_REASON
+
+#undef MT32EMU_SIMD_LEVEL_NAME
+#undef MT32EMU_SIMD_LEVEL
+
 #endif /* #if (!defined MT32EMU_CPP_ENUMERATIONS_H && !defined MT32EMU_C_ENUMERATIONS) || (!defined MT32EMU_C_ENUMERATIONS_H && defined MT32EMU_C_ENUMERATIONS) */
@@ -19,24 +19,219 @@
 #error This file should be included from LA32WaveGenerator.cpp only.
 #endif
 
+#include <cstring>
+
 #include "mmath.h"
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace MT32Emu {
 
 static const float MIDDLE_CUTOFF_VALUE = 128.0f;
 static const float RESONANCE_DECAY_THRESHOLD_CUTOFF_VALUE = 144.0f;
 static const float MAX_CUTOFF_VALUE = 240.0f;
 
-float LA32WaveGenerator::getPCMSample(unsigned int position) {
+// The block-based generation computes the exponents and the sines by means of polynomial approximations rather than libm functions.
+// The generic and the SIMD code evaluate them in exactly the same way, so the output doesn't depend on the SIMD level selected.
+// Compared to the libm functions, the relative error of exp2 and the absolute error of the sine are below 2e-7 within the range
+// of arguments, that is in the order of the float precision. With dense material, the output deviates from the one of the former
+// per-sample model based on libm functions by less than 6e-7 (-124 dBFS).
+
+// Adding and then subtracting 1.5 * 2^23 rounds a float to the nearest integer for arguments below 2^22 in magnitude
+static const float ROUNDING_BIAS = 12582912.0f;
+
+static const float EXP2_MIN_ARGUMENT = -126.0f;
+static const float EXP2_MAX_ARGUMENT = 127.0f;
+
+// Taylor series of 2^x, used within [-0.5, 0.5]
+static const float EXP2_COEFFICIENTS[] = {
+	1.0f, 6.931471806e-01f, 2.402265070e-01f, 5.550410866e-02f, 9.618129108e-03f, 1.333355815e-03f, 1.540353039e-04f, 1.525273380e-05f
+};
+
+// Odd Taylor series of sin(pi * x), used within [-0.5, 0.5]
+static const float SINPI_COEFFICIENTS[] = {
+	3.141592654e+00f, -5.167712780e+00f, 2.550164040e+00f, -5.992645293e-01f, 8.214588661e-02f, -7.370430946e-03f
+};
+
+static inline float exp2Approx(float x) {
+	x = x < EXP2_MIN_ARGUMENT ? EXP2_MIN_ARGUMENT : x;
+	x = x > EXP2_MAX_ARGUMENT ? EXP2_MAX_ARGUMENT : x;
+	float n = (x + ROUNDING_BIAS) - ROUNDING_BIAS;
+	float f = x - n;
+	float p = EXP2_COEFFICIENTS[7];
+	for (int k = 6; k >= 0; k--) {
+		p = p * f + EXP2_COEFFICIENTS[k];
+	}
+	// 2^n is composed directly in the exponent bits
+	Bit32u scaleBits = Bit32u(Bit32s(n) + 127) << 23;
+	float scale;
+	memcpy(&scale, &scaleBits, sizeof(scale));
+	return p * scale;
+}
+
+// Computes sin(pi * x)
+static inline float sinPiApprox(float x) {
+	float n = (x + ROUNDING_BIAS) - ROUNDING_BIAS;
+	float r = x - n;
+	float r2 = r * r;
+	float p = SINPI_COEFFICIENTS[5];
+	for (int k = 4; k >= 0; k--) {
+		p = p * r2 + SINPI_COEFFICIENTS[k];
+	}
+	p *= r;
+	// sin(pi * (n + r)) = (-1)^n * sin(pi * r), so the sign bit is flipped for odd n
+	Bit32u bits;
+	memcpy(&bits, &p, sizeof(bits));
+	bits ^= Bit32u(Bit32s(n)) << 31;
+	memcpy(&p, &bits, sizeof(p));
+	return p;
+}
+
+#if MT32EMU_USE_X86_SIMD
+MT32EMU_X86_TARGET("sse2")
+static inline __m128 exp2Approx(__m128 x) {
+	const __m128 bias = _mm_set1_ps(ROUNDING_BIAS);
+	x = _mm_max_ps(x, _mm_set1_ps(EXP2_MIN_ARGUMENT));
+	x = _mm_min_ps(x, _mm_set1_ps(EXP2_MAX_ARGUMENT));
+	__m128 n = _mm_sub_ps(_mm_add_ps(x, bias), bias);
+	__m128 f = _mm_sub_ps(x, n);
+	__m128 p = _mm_set1_ps(EXP2_COEFFICIENTS[7]);
+	for (int k = 6; k >= 0; k--) {
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_COEFFICIENTS[k]));
+	}
+	__m128i scaleBits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(scaleBits));
+}
+
+MT32EMU_X86_TARGET("sse2")
+static inline __m128 sinPiApprox(__m128 x) {
+	const __m128 bias = _mm_set1_ps(ROUNDING_BIAS);
+	__m128 n = _mm_sub_ps(_mm_add_ps(x, bias), bias);
+	__m128 r = _mm_sub_ps(x, n);
+	__m128 r2 = _mm_mul_ps(r, r);
+	__m128 p = _mm_set1_ps(SINPI_COEFFICIENTS[5]);
+	for (int k = 4; k >= 0; k--) {
+		p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINPI_COEFFICIENTS[k]));
+	}
+	p = _mm_mul_ps(p, r);
+	__m128i signBits = _mm_slli_epi32(_mm_cvttps_epi32(n), 31);
+	return _mm_xor_ps(p, _mm_castsi128_ps(signBits));
+}
+
+// The 256-bit versions need AVX2 for the integer operations on the exponent and sign bits
+MT32EMU_X86_TARGET("avx2")
+static inline __m256 exp2Approx(__m256 x) {
+	const __m256 bias = _mm256_set1_ps(ROUNDING_BIAS);
+	x = _mm256_max_ps(x, _mm256_set1_ps(EXP2_MIN_ARGUMENT));
+	x = _mm256_min_ps(x, _mm256_set1_ps(EXP2_MAX_ARGUMENT));
+	__m256 n = _mm256_sub_ps(_mm256_add_ps(x, bias), bias);
+	__m256 f = _mm256_sub_ps(x, n);
+	__m256 p = _mm256_set1_ps(EXP2_COEFFICIENTS[7]);
+	for (int k = 6; k >= 0; k--) {
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_COEFFICIENTS[k]));
+	}
+	__m256i scaleBits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(scaleBits));
+}
+
+MT32EMU_X86_TARGET("avx2")
+static inline __m256 sinPiApprox(__m256 x) {
+	const __m256 bias = _mm256_set1_ps(ROUNDING_BIAS);
+	__m256 n = _mm256_sub_ps(_mm256_add_ps(x, bias), bias);
+	__m256 r = _mm256_sub_ps(x, n);
+	__m256 r2 = _mm256_mul_ps(r, r);
+	__m256 p = _mm256_set1_ps(SINPI_COEFFICIENTS[5]);
+	for (int k = 4; k >= 0; k--) {
+		p = _mm256_add_ps(_mm256_mul_ps(p, r2), _mm256_set1_ps(SINPI_COEFFICIENTS[k]));
+	}
+	p = _mm256_mul_ps(p, r);
+	__m256i signBits = _mm256_slli_epi32(_mm256_cvttps_epi32(n), 31);
+	return _mm256_xor_ps(p, _mm256_castsi256_ps(signBits));
+}
+#endif
+
+// Replaces each value in the array with 2 raised to the power of the value
+static void exp2SamplesGeneric(float *values, const Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		values[i] = exp2Approx(values[i]);
+	}
+}
+
+// Replaces each value x in the array with sin(pi * x)
+static void sinPiSamplesGeneric(float *values, const Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		values[i] = sinPiApprox(values[i]);
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+MT32EMU_X86_TARGET("sse2")
+static void exp2SamplesSSE2(float *values, const Bit32u length) {
+	Bit32u i = 0;
+	for (; i + 4 <= length; i += 4) {
+		_mm_storeu_ps(values + i, exp2Approx(_mm_loadu_ps(values + i)));
+	}
+	exp2SamplesGeneric(values + i, length - i);
+}
+
+MT32EMU_X86_TARGET("sse2")
+static void sinPiSamplesSSE2(float *values, const Bit32u length) {
+	Bit32u i = 0;
+	for (; i + 4 <= length; i += 4) {
+		_mm_storeu_ps(values + i, sinPiApprox(_mm_loadu_ps(values + i)));
+	}
+	sinPiSamplesGeneric(values + i, length - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void exp2SamplesAVX2(float *values, const Bit32u length) {
+	Bit32u i = 0;
+	for (; i + 8 <= length; i += 8) {
+		_mm256_storeu_ps(values + i, exp2Approx(_mm256_loadu_ps(values + i)));
+	}
+	exp2SamplesSSE2(values + i, length - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void sinPiSamplesAVX2(float *values, const Bit32u length) {
+	Bit32u i = 0;
+	for (; i + 8 <= length; i += 8) {
+		_mm256_storeu_ps(values + i, sinPiApprox(_mm256_loadu_ps(values + i)));
+	}
+	sinPiSamplesSSE2(values + i, length - i);
+}
+#endif
+
+void LA32WaveGenerator::selectKernels(const SIMDLevel simdLevel) {
+	exp2SamplesKernel = exp2SamplesGeneric;
+	sinPiSamplesKernel = sinPiSamplesGeneric;
+#if MT32EMU_USE_X86_SIMD
+	if (simdLevel >= SIMDLevel_AVX2) {
+		exp2SamplesKernel = exp2SamplesAVX2;
+		sinPiSamplesKernel = sinPiSamplesAVX2;
+	} else if (simdLevel >= SIMDLevel_SSE2) {
+		exp2SamplesKernel = exp2SamplesSSE2;
+		sinPiSamplesKernel = sinPiSamplesSSE2;
+	}
+#else
+	(void)simdLevel;
+#endif
+}
+
+void LA32WaveGenerator::getPCMLogSample(unsigned int position, float &log2Value, float &sign) const {
 	if (position >= pcmWaveLength) {
 		if (!pcmWaveLooped) {
-			return 0;
+			log2Value = 0.0f;
+			sign = 0.0f;
+			return;
 		}
 		position = position % pcmWaveLength;
 	}
 	Bit16s pcmSample = pcmWaveAddress[position];
-	float sampleValue = EXP2F(((pcmSample & 32767) - 32787.0f) / 2048.0f);
-	return ((pcmSample & 32768) == 0) ? sampleValue : -sampleValue;
+	log2Value = ((pcmSample & 32767) - 32787.0f) / 2048.0f;
+	sign = ((pcmSample & 32768) == 0) ? 1.0f : -1.0f;
 }
 
 void LA32WaveGenerator::initSynth(const bool useSawtoothWaveform, const Bit8u usePulseWidth, const Bit8u useResonance) {
@@ -61,49 +256,33 @@ void LA32WaveGenerator::initPCM(const Bit16s * const usePCMWaveAddress, const Bi
 	active = true;
 }
 
-// ampVal - Logarithmic amp of the wave generator
-// pitch - Logarithmic frequency of the resulting wave
-// cutoffRampVal - Composed of the base cutoff in range [78..178] left-shifted by 18 bits and the TVF modifier
-float LA32WaveGenerator::generateNextSample(const Bit32u ampVal, const Bit16u pitch, const Bit32u cutoffRampVal) {
-	if (!active) {
-		return 0.0f;
-	}
-
-	float sample = 0.0f;
-
-	// SEMI-CONFIRMED: From sample analysis:
-	// (1) Tested with a single partial playing PCM wave 77 with pitchCoarse 36 and no keyfollow, velocity follow, etc.
-	// This gives results within +/- 2 at the output (before any DAC bitshifting)
-	// when sustaining at levels 156 - 255 with no modifiers.
-	// (2) Tested with a special square wave partial (internal capture ID tva5) at TVA envelope levels 155-255.
-	// This gives deltas between -1 and 0 compared to the real output. Note that this special partial only produces
-	// positive amps, so negative still needs to be explored, as well as lower levels.
-	//
-	// Also still partially unconfirmed is the behaviour when ramping between levels, as well as the timing.
-
-	float amp = EXP2F(ampVal / -1024.0f / 4096.0f);
-	float freq = EXP2F(pitch / 4096.0f - 16.0f) * SAMPLE_RATE;
-
-	if (isPCMWave()) {
-		// Render PCM waveform
+Bit32u LA32WaveGenerator::generateNextPCMWaveSamples(float *samples, const float *amps, const float *freqs, const Bit32u length) {
+	float firstSamples[LA32_MAX_BLOCK_LENGTH];
+	float firstSigns[LA32_MAX_BLOCK_LENGTH];
+	float secondSamples[LA32_MAX_BLOCK_LENGTH];
+	float secondSigns[LA32_MAX_BLOCK_LENGTH];
+	float interpolationFactors[LA32_MAX_BLOCK_LENGTH];
+
+	// Advance the position and fetch the neighbour samples in the log-space
+	const bool interpolated = pcmWaveInterpolated;
+	Bit32u sampleCount = 0;
+	while (sampleCount < length) {
 		int len = pcmWaveLength;
 		int intPCMPosition = (int)pcmPosition;
 		if (intPCMPosition >= len && !pcmWaveLooped) {
 			// We're now past the end of a non-looping PCM waveform so it's time to die.
 			deactivate();
-			return 0.0f;
+			break;
 		}
-		float positionDelta = freq * 2048.0f / SAMPLE_RATE;
+		float positionDelta = freqs[sampleCount] * 2048.0f / SAMPLE_RATE;
 
-		// Linear interpolation
-		float firstSample = getPCMSample(intPCMPosition);
+		getPCMLogSample(intPCMPosition, firstSamples[sampleCount], firstSigns[sampleCount]);
 		// We observe that for partial structures with ring modulation the interpolation is not applied to the slave PCM partial.
 		// It's assumed that the multiplication circuitry intended to perform the interpolation on the slave PCM partial
 		// is borrowed by the ring modulation circuit (or the LA32 chip has a similar lack of resources assigned to each partial pair).
-		if (pcmWaveInterpolated) {
-			sample = firstSample + (getPCMSample(intPCMPosition + 1) - firstSample) * (pcmPosition - intPCMPosition);
-		} else {
-			sample = firstSample;
+		if (interpolated) {
+			getPCMLogSample(intPCMPosition + 1, secondSamples[sampleCount], secondSigns[sampleCount]);
+			interpolationFactors[sampleCount] = pcmPosition - intPCMPosition;
 		}
 
 		float newPCMPosition = pcmPosition + positionDelta;
@@ -111,50 +290,117 @@ float LA32WaveGenerator::generateNextSample(const Bit32u ampVal, const Bit16u pi
 			newPCMPosition = fmod(newPCMPosition, (float)pcmWaveLength);
 		}
 		pcmPosition = newPCMPosition;
-	} else {
-		// Render synthesised waveform
-		wavePos *= lastFreq / freq;
-		lastFreq = freq;
+		sampleCount++;
+	}
 
-		float resAmp = EXP2F(1.0f - (32 - resonance) / 4.0f);
-		{
-			//static const float resAmpFactor = EXP2F(-7);
-			//resAmp = EXP2I(resonance << 10) * resAmpFactor;
+	// Convert to the linear space and apply linear interpolation
+	exp2SamplesKernel(firstSamples, sampleCount);
+	if (interpolated) {
+		exp2SamplesKernel(secondSamples, sampleCount);
+		for (Bit32u i = 0; i < sampleCount; i++) {
+			float firstSample = firstSigns[i] * firstSamples[i];
+			float secondSample = secondSigns[i] * secondSamples[i];
+			samples[i] = (firstSample + (secondSample - firstSample) * interpolationFactors[i]) * amps[i];
 		}
+	} else {
+		for (Bit32u i = 0; i < sampleCount; i++) {
+			samples[i] = (firstSigns[i] * firstSamples[i]) * amps[i];
+		}
+	}
+
+	if (sampleCount < length) {
+		// The WG engine has just deactivated, the last sample is silent
+		samples[sampleCount++] = 0.0f;
+	}
+	return sampleCount;
+}
 
+template <bool SAWTOOTH_WAVEFORM>
+Bit32u LA32WaveGenerator::generateNextSynthWaveSamples(float *samples, const float *amps, const float *freqs, const Bit32u *cutoffRampVals, const Bit32u length) {
+	float resAmp = EXP2F(1.0f - (32 - resonance) / 4.0f);
+	{
+		//static const float resAmpFactor = EXP2F(-7);
+		//resAmp = EXP2I(resonance << 10) * resAmpFactor;
+	}
+
+	// Ratio of positive segment to wave length
+	float pulseLenFactor = 0.5f;
+	if (pulseWidth > 128) {
+		pulseLenFactor = EXP2F((64 - pulseWidth) / 64.0f);
+		//static const float pulseLenFactor = EXP2F(-192 / 64);
+		//pulseLen = EXP2I((256 - pulseWidthVal) << 6) * pulseLenFactor;
+	}
+
+	// Resonance decay speed factor
+	const float baseResAmpDecayFactor = Tables::getInstance().resAmpDecayFactor[resonance >> 2];
+
+	float cutoffVals[LA32_MAX_BLOCK_LENGTH];
+	float cosineLenFactors[LA32_MAX_BLOCK_LENGTH];
+	float waveLens[LA32_MAX_BLOCK_LENGTH];
+	float wavePositions[LA32_MAX_BLOCK_LENGTH];
+
+	for (Bit32u i = 0; i < length; i++) {
 		// The cutoffModifier may not be supposed to be directly added to the cutoff -
 		// it may for example need to be multiplied in some way.
 		// The 240 cutoffVal limit was determined via sample analysis (internal Munt capture IDs: glop3, glop4).
 		// More research is needed to be sure that this is correct, however.
-		float cutoffVal = cutoffRampVal / 262144.0f;
+		float cutoffVal = cutoffRampVals[i] / 262144.0f;
 		if (cutoffVal > MAX_CUTOFF_VALUE) {
 			cutoffVal = MAX_CUTOFF_VALUE;
 		}
+		cutoffVals[i] = cutoffVal;
+		// found from sample analysis
+		cosineLenFactors[i] = (cutoffVal > MIDDLE_CUTOFF_VALUE) ? (cutoffVal - MIDDLE_CUTOFF_VALUE) / -16.0f : 0.0f;
+	}
+	exp2SamplesKernel(cosineLenFactors, length);
+
+	// The wave position is the only state carried from sample to sample
+	for (Bit32u i = 0; i < length; i++) {
+		float freq = freqs[i];
+		wavePos *= lastFreq / freq;
+		lastFreq = freq;
 
 		// Wave length in samples
 		float waveLen = SAMPLE_RATE / freq;
+		waveLens[i] = waveLen;
+		wavePositions[i] = wavePos;
 
-		// Init cosineLen
-		float cosineLen = 0.5f * waveLen;
-		if (cutoffVal > MIDDLE_CUTOFF_VALUE) {
-			cosineLen *= EXP2F((cutoffVal - MIDDLE_CUTOFF_VALUE) / -16.0f); // found from sample analysis
+		wavePos++;
+
+		// wavePos isn't supposed to be > waveLen
+		if (wavePos > waveLen) {
+			wavePos -= waveLen;
 		}
+	}
+
+	// The arguments of the sines and exponents are collected first, then replaced with the results in place
+	float squareCosines[LA32_MAX_BLOCK_LENGTH];
+	float squareCosineFactors[LA32_MAX_BLOCK_LENGTH];
+	float squareLevels[LA32_MAX_BLOCK_LENGTH];
+	float resSines[LA32_MAX_BLOCK_LENGTH];
+	float resSigns[LA32_MAX_BLOCK_LENGTH];
+	float windowSines[LA32_MAX_BLOCK_LENGTH];
+	Bit8u windowTypes[LA32_MAX_BLOCK_LENGTH];
+	float resAmpCorrections[LA32_MAX_BLOCK_LENGTH];
+	float fades[LA32_MAX_BLOCK_LENGTH];
+	float sawtoothCosines[LA32_MAX_BLOCK_LENGTH];
+
+	for (Bit32u i = 0; i < length; i++) {
+		float cutoffVal = cutoffVals[i];
+		float waveLen = waveLens[i];
+		float position = wavePositions[i];
+
+		// Init cosineLen
+		float cosineLen = 0.5f * waveLen * cosineLenFactors[i];
 
 		// Start playing in center of first cosine segment
 		// relWavePos is shifted by a half of cosineLen
-		float relWavePos = wavePos + 0.5f * cosineLen;
+		float relWavePos = position + 0.5f * cosineLen;
 		if (relWavePos > waveLen) {
 			relWavePos -= waveLen;
 		}
 
-		// Ratio of positive segment to wave length
-		float pulseLen = 0.5f;
-		if (pulseWidth > 128) {
-			pulseLen = EXP2F((64 - pulseWidth) / 64.0f);
-			//static const float pulseLenFactor = EXP2F(-192 / 64);
-			//pulseLen = EXP2I((256 - pulseWidthVal) << 6) * pulseLenFactor;
-		}
-		pulseLen *= waveLen;
+		float pulseLen = pulseLenFactor * waveLen;
 
 		float hLen = pulseLen - cosineLen;
 
@@ -163,57 +409,56 @@ float LA32WaveGenerator::generateNextSample(const Bit32u ampVal, const Bit16u pi
 			hLen = 0.0f;
 		}
 
-		// Ignore pulsewidths too high for given freq and cutoff
-		float lLen = waveLen - hLen - 2 * cosineLen;
-		if (lLen < 0.0f) {
-			lLen = 0.0f;
-		}
-
-		// Correct resAmp for cutoff in range 50..66
-		if ((cutoffVal >= 128.0f) && (cutoffVal < 144.0f)) {
-			resAmp *= sin(FLOAT_PI * (cutoffVal - 128.0f) / 32.0f);
-		}
-
-		// Produce filtered square wave with 2 cosine waves on slopes
+		// Produce filtered square wave with 2 cosine waves on slopes, cos(pi * x) = sin(pi * (x + 0.5))
+		squareCosines[i] = 0.0f;
+		squareCosineFactors[i] = 0.0f;
+		squareLevels[i] = 0.0f;
 
 		// 1st cosine segment
 		if (relWavePos < cosineLen) {
-			sample = -cos(FLOAT_PI * relWavePos / cosineLen);
+			squareCosines[i] = relWavePos / cosineLen + 0.5f;
+			squareCosineFactors[i] = -1.0f;
 		} else
 
 		// high linear segment
 		if (relWavePos < (cosineLen + hLen)) {
-			sample = 1.f;
+			squareLevels[i] = 1.0f;
 		} else
 
 		// 2nd cosine segment
 		if (relWavePos < (2 * cosineLen + hLen)) {
-			sample = cos(FLOAT_PI * (relWavePos - (cosineLen + hLen)) / cosineLen);
+			squareCosines[i] = (relWavePos - (cosineLen + hLen)) / cosineLen + 0.5f;
+			squareCosineFactors[i] = 1.0f;
 		} else {
 
 		// low linear segment
-			sample = -1.f;
+			squareLevels[i] = -1.0f;
 		}
 
+		resSines[i] = 0.0f;
+		resSigns[i] = 0.0f;
+		windowSines[i] = 0.0f;
+		windowTypes[i] = 0;
+		resAmpCorrections[i] = 0.0f;
+
 		if (cutoffVal < 128.0f) {
 
 			// Attenuate samples below cutoff 50
 			// Found by sample analysis
-			sample *= EXP2F(-0.125f * (128.0f - cutoffVal));
+			fades[i] = -0.125f * (128.0f - cutoffVal);
 		} else {
 
 			// Add resonance sine. Effective for cutoff > 50 only
-			float resSample = 1.0f;
+			resSigns[i] = 1.0f;
 
-			// Resonance decay speed factor
-			float resAmpDecayFactor = Tables::getInstance().resAmpDecayFactor[resonance >> 2];
+			float resAmpDecayFactor = baseResAmpDecayFactor;
 
 			// Now relWavePos counts from the middle of first cosine
-			relWavePos = wavePos;
+			relWavePos = position;
 
 			// negative segments
 			if (!(relWavePos < (cosineLen + hLen))) {
-				resSample = -resSample;
+				resSigns[i] = -1.0f;
 				relWavePos -= cosineLen + hLen;
 
 				// From the digital captures, the decaying speed of the resonance sine is found a bit different for the positive and the negative segments
@@ -221,58 +466,132 @@ float LA32WaveGenerator::generateNextSample(const Bit32u ampVal, const Bit16u pi
 			}
 
 			// Resonance sine WG
-			resSample *= sin(FLOAT_PI * relWavePos / cosineLen);
+			resSines[i] = relWavePos / cosineLen;
 
 			// Resonance sine amp
-			float resAmpFadeLog2 = -0.125f * resAmpDecayFactor * (relWavePos / cosineLen); // seems to be exact
-			float resAmpFade = EXP2F(resAmpFadeLog2);
+			fades[i] = -0.125f * resAmpDecayFactor * (relWavePos / cosineLen); // seems to be exact
 
 			// Now relWavePos set negative to the left from center of any cosine
-			relWavePos = wavePos;
+			relWavePos = position;
 
 			// negative segment
-			if (!(wavePos < (waveLen - 0.5f * cosineLen))) {
+			if (!(position < (waveLen - 0.5f * cosineLen))) {
 				relWavePos -= waveLen;
 			} else
 
 			// positive segment
-			if (!(wavePos < (hLen + 0.5f * cosineLen))) {
+			if (!(position < (hLen + 0.5f * cosineLen))) {
 				relWavePos -= cosineLen + hLen;
 			}
 
 			// To ensure the output wave has no breaks, two different windows are appied to the beginning and the ending of the resonance sine segment
 			if (relWavePos < 0.5f * cosineLen) {
-				float syncSine = sin(FLOAT_PI * relWavePos / cosineLen);
-				if (relWavePos < 0.0f) {
-					// The window is synchronous square sine here
-					resAmpFade *= syncSine * syncSine;
-				} else {
-					// The window is synchronous sine here
-					resAmpFade *= syncSine;
-				}
+				windowSines[i] = relWavePos / cosineLen;
+				// The window is synchronous square sine for negative positions and synchronous sine otherwise
+				windowTypes[i] = (relWavePos < 0.0f) ? 2 : 1;
 			}
 
-			sample += resSample * resAmp * resAmpFade;
+			// Correct resAmp for cutoff in range 50..66
+			if (cutoffVal < RESONANCE_DECAY_THRESHOLD_CUTOFF_VALUE) {
+				resAmpCorrections[i] = (cutoffVal - 128.0f) / 32.0f;
+			}
 		}
 
 		// sawtooth waves
-		if (sawtoothWaveform) {
-			sample *= cos(FLOAT_2PI * wavePos / waveLen);
+		if (SAWTOOTH_WAVEFORM) {
+			sawtoothCosines[i] = 2.0f * position / waveLen + 0.5f;
 		}
+	}
 
-		wavePos++;
+	sinPiSamplesKernel(squareCosines, length);
+	sinPiSamplesKernel(resSines, length);
+	sinPiSamplesKernel(windowSines, length);
+	sinPiSamplesKernel(resAmpCorrections, length);
+	exp2SamplesKernel(fades, length);
+	if (SAWTOOTH_WAVEFORM) {
+		sinPiSamplesKernel(sawtoothCosines, length);
+	}
 
-		// wavePos isn't supposed to be > waveLen
-		if (wavePos > waveLen) {
-			wavePos -= waveLen;
+	for (Bit32u i = 0; i < length; i++) {
+		float sample = squareCosineFactors[i] * squareCosines[i] + squareLevels[i];
+		if (cutoffVals[i] < 128.0f) {
+			sample *= fades[i];
+		} else {
+			float resAmpFade = fades[i];
+			if (windowTypes[i] == 2) {
+				resAmpFade *= windowSines[i] * windowSines[i];
+			} else if (windowTypes[i] == 1) {
+				resAmpFade *= windowSines[i];
+			}
+			float sampleResAmp = resAmp;
+			if (cutoffVals[i] < RESONANCE_DECAY_THRESHOLD_CUTOFF_VALUE) {
+				sampleResAmp *= resAmpCorrections[i];
+			}
+			sample += resSigns[i] * resSines[i] * sampleResAmp * resAmpFade;
+		}
+		if (SAWTOOTH_WAVEFORM) {
+			sample *= sawtoothCosines[i];
 		}
+
+		// Multiply sample with current TVA value
+		samples[i] = sample * amps[i];
 	}
+	return length;
+}
 
-	// Multiply sample with current TVA value
-	sample *= amp;
+// ampVal - Logarithmic amp of the wave generator
+// pitch - Logarithmic frequency of the resulting wave
+// cutoffRampVal - Composed of the base cutoff in range [78..178] left-shifted by 18 bits and the TVF modifier
+float LA32WaveGenerator::generateNextSample(const Bit32u ampVal, const Bit16u pitch, const Bit32u cutoffRampVal) {
+	float sample = 0.0f;
+	generateNextSamples(&sample, &ampVal, &pitch, &cutoffRampVal, 1);
 	return sample;
 }
 
+Bit32u LA32WaveGenerator::generateNextSamples(float *samples, const Bit32u *ampVals, const Bit16u *pitches, const Bit32u *cutoffRampVals, const Bit32u length) {
+	if (!active) {
+		return 0;
+	}
+
+	// SEMI-CONFIRMED: From sample analysis:
+	// (1) Tested with a single partial playing PCM wave 77 with pitchCoarse 36 and no keyfollow, velocity follow, etc.
+	// This gives results within +/- 2 at the output (before any DAC bitshifting)
+	// when sustaining at levels 156 - 255 with no modifiers.
+	// (2) Tested with a special square wave partial (internal capture ID tva5) at TVA envelope levels 155-255.
+	// This gives deltas between -1 and 0 compared to the real output. Note that this special partial only produces
+	// positive amps, so negative still needs to be explored, as well as lower levels.
+	//
+	// Also still partially unconfirmed is the behaviour when ramping between levels, as well as the timing.
+
+	float amps[LA32_MAX_BLOCK_LENGTH];
+	for (Bit32u i = 0; i < length; i++) {
+		amps[i] = ampVals[i] / -1024.0f / 4096.0f;
+	}
+	exp2SamplesKernel(amps, length);
+
+	// Rounding errors in the frequency would accumulate in the wave position, so it is computed precisely.
+	// The pitch only changes when TVP is processed, hence the exponent is only recomputed for a new pitch.
+	float freqs[LA32_MAX_BLOCK_LENGTH];
+	Bit16u lastPitch = pitches[0];
+	float lastPitchFreq = EXP2F(lastPitch / 4096.0f - 16.0f) * SAMPLE_RATE;
+	for (Bit32u i = 0; i < length; i++) {
+		if (pitches[i] != lastPitch) {
+			lastPitch = pitches[i];
+			lastPitchFreq = EXP2F(lastPitch / 4096.0f - 16.0f) * SAMPLE_RATE;
+		}
+		freqs[i] = lastPitchFreq;
+	}
+
+	// The kind of wave is invariant while the WG engine is active, so it is enough to dispatch once per block.
+	if (isPCMWave()) {
+		return generateNextPCMWaveSamples(samples, amps, freqs, length);
+	}
+	if (sawtoothWaveform) {
+		return generateNextSynthWaveSamples<true>(samples, amps, freqs, cutoffRampVals, length);
+	}
+	return generateNextSynthWaveSamples<false>(samples, amps, freqs, cutoffRampVals, length);
+}
+
 void LA32WaveGenerator::deactivate() {
 	active = false;
 }
@@ -292,6 +611,11 @@ void LA32PartialPair::init(const bool useRingModulated, const bool useMixed) {
 	slaveOutputSample = 0.0f;
 }
 
+void LA32PartialPair::selectKernels(const SIMDLevel simdLevel) {
+	master.selectKernels(simdLevel);
+	slave.selectKernels(simdLevel);
+}
+
 void LA32PartialPair::initSynth(const PairType useMaster, const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance) {
 	if (useMaster == MASTER) {
 		master.initSynth(sawtoothWaveform, pulseWidth, resonance);
@@ -341,6 +665,46 @@ float LA32PartialPair::nextOutSample() {
 	return mixed ? masterOutputSample + ringModulatedSample : ringModulatedSample;
 }
 
+Bit32u LA32PartialPair::generateNextSamples(const PairType useMaster, float *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length) {
+	if (useMaster == MASTER) {
+		Bit32u generatedLength = master.generateNextSamples(buffer, amps, pitches, cutoffs, length);
+		if (generatedLength > 0) {
+			masterOutputSample = buffer[generatedLength - 1];
+		}
+		return generatedLength;
+	}
+	Bit32u generatedLength = slave.generateNextSamples(buffer, amps, pitches, cutoffs, length);
+	if (generatedLength > 0) {
+		slaveOutputSample = buffer[generatedLength - 1];
+	}
+	return generatedLength;
+}
+
+void LA32PartialPair::produceOutputSamples(float *buffer, const float *masterSamples, const float *slaveSamples, const Bit32u length) {
+	if (!ringModulated) {
+		for (Bit32u i = 0; i < length; i++) {
+			buffer[i] = masterSamples[i] + slaveSamples[i];
+		}
+		return;
+	}
+	// See the notes on ring modulation in nextOutSample()
+	for (Bit32u i = 0; i < length; i++) {
+		float ringModulatedSample = produceDistortedSample(masterSamples[i]) * produceDistortedSample(slaveSamples[i]);
+		buffer[i] = mixed ? masterSamples[i] + ringModulatedSample : ringModulatedSample;
+	}
+}
+
+Bit32u LA32PartialPair::generateNextMasterSamples(float *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length) {
+	Bit32u generatedLength = generateNextSamples(MASTER, buffer, amps, pitches, cutoffs, length);
+	if (ringModulated && !mixed) {
+		// The ring modulator output is silent as long as the slave is inactive
+		for (Bit32u i = 0; i < generatedLength; i++) {
+			buffer[i] = 0.0f;
+		}
+	}
+	return generatedLength;
+}
+
 void LA32PartialPair::deactivate(const PairType useMaster) {
 	if (useMaster == MASTER) {
 		master.deactivate();
@@ -355,4 +719,62 @@ bool LA32PartialPair::isActive(const PairType useMaster) const {
 	return useMaster == MASTER ? master.isActive() : slave.isActive();
 }
 
+void LA32WaveGenerator::saveState(StateWriter &writer, const Bit16s *pcmROMData, const Bit32u pcmROMSize) const {
+	// Inactive WG engine gets initialised anew before use
+	writer.writeBool(active);
+	if (!active) return;
+	writer.writeBool(isPCMWave());
+	if (isPCMWave()) {
+		writer.writeBit32u(pcmWaveLength);
+		writer.writePointer(pcmWaveAddress, pcmROMData, pcmROMSize * sizeof(Bit16s));
+		writer.writeBool(pcmWaveLooped);
+		writer.writeBool(pcmWaveInterpolated);
+		writer.writeFloat(pcmPosition);
+		return;
+	}
+	writer.writeBool(sawtoothWaveform);
+	writer.writeBit8u(resonance);
+	writer.writeBit8u(pulseWidth);
+	writer.writeFloat(wavePos);
+	writer.writeFloat(lastFreq);
+}
+
+void LA32WaveGenerator::loadState(StateReader &reader, const Bit16s *pcmROMData, const Bit32u pcmROMSize) {
+	active = reader.readBool();
+	if (!active) return;
+	if (reader.readBool()) {
+		pcmWaveLength = reader.readBit32u();
+		pcmWaveAddress = static_cast<const Bit16s *>(reader.readPointer(pcmROMData, pcmROMSize * sizeof(Bit16s), pcmWaveLength * sizeof(Bit16s)));
+		if (pcmWaveAddress == NULL) reader.fail();
+		pcmWaveLooped = reader.readBool();
+		pcmWaveInterpolated = reader.readBool();
+		pcmPosition = reader.readFloat();
+		return;
+	}
+	pcmWaveAddress = NULL;
+	sawtoothWaveform = reader.readBool();
+	resonance = reader.readBit8u();
+	pulseWidth = reader.readBit8u();
+	wavePos = reader.readFloat();
+	lastFreq = reader.readFloat();
+}
+
+void LA32PartialPair::saveState(StateWriter &writer, const Bit16s *pcmROMData, const Bit32u pcmROMSize) const {
+	master.saveState(writer, pcmROMData, pcmROMSize);
+	slave.saveState(writer, pcmROMData, pcmROMSize);
+	writer.writeBool(ringModulated);
+	writer.writeBool(mixed);
+	writer.writeFloat(masterOutputSample);
+	writer.writeFloat(slaveOutputSample);
+}
+
+void LA32PartialPair::loadState(StateReader &reader, const Bit16s *pcmROMData, const Bit32u pcmROMSize) {
+	master.loadState(reader, pcmROMData, pcmROMSize);
+	slave.loadState(reader, pcmROMData, pcmROMSize);
+	ringModulated = reader.readBool();
+	mixed = reader.readBool();
+	masterOutputSample = reader.readFloat();
+	slaveOutputSample = reader.readFloat();
+}
+
 } // namespace MT32Emu
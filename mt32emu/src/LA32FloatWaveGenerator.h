@@ -21,6 +21,15 @@
 
 namespace MT32Emu {
 
+class StateReader;
+class StateWriter;
+
+// Maximum number of samples processed at once by the block-based methods of the WG engine
+const unsigned int LA32_MAX_BLOCK_LENGTH = 128;
+
+// Replaces each value in the array with the result of a function approximated for the block-based generation
+typedef void (*ApproximationKernel)(float *values, const Bit32u length);
+
 /**
  * LA32WaveGenerator is aimed to represent the exact model of LA32 wave generator.
  * The output square wave is created by adding high / low linear segments in-between
@@ -68,9 +77,23 @@ class LA32WaveGenerator {
 	float lastFreq;
 	float pcmPosition;
 
-	float getPCMSample(unsigned int position);
+	ApproximationKernel exp2SamplesKernel;
+	ApproximationKernel sinPiSamplesKernel;
+
+	// Fetches the PCM sample at the position as the base 2 logarithm of its magnitude and the sign, which is zero beyond the end of the wave
+	void getPCMLogSample(unsigned int position, float &log2Value, float &sign) const;
+
+	// Parts of generateNextSamples() for the kind of wave, taking the amps and the frequencies already converted to the linear space.
+	// Each is split into a short sequential pass which advances the wave position and a number of passes over whole arrays
+	// that are free of dependencies between the samples, so that the transcendental functions can be computed several samples at once.
+	Bit32u generateNextPCMWaveSamples(float *samples, const float *amps, const float *freqs, const Bit32u length);
+	template <bool SAWTOOTH_WAVEFORM>
+	Bit32u generateNextSynthWaveSamples(float *samples, const float *amps, const float *freqs, const Bit32u *cutoffs, const Bit32u length);
 
 public:
+	// Select the routines of the block-based methods optimised for the level of SIMD instruction set extensions given
+	void selectKernels(const SIMDLevel simdLevel);
+
 	// Initialise the WG engine for generation of synth partial samples and set up the invariant parameters
 	void initSynth(const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance);
 
@@ -80,6 +103,11 @@ public:
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	float generateNextSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
+	// Generate up to length (at most LA32_MAX_BLOCK_LENGTH) samples taking parameters of TVP, TVA and TVF for each sample from the arrays.
+	// Returns the number of samples generated which is less than length if the WG engine deactivates. In the latter case,
+	// the last generated sample is silent as well as generateNextSample() would have returned.
+	Bit32u generateNextSamples(float *samples, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
 	// Deactivate the WG engine
 	void deactivate();
 
@@ -88,6 +116,10 @@ public:
 
 	// Return true if the WG engine generates PCM wave samples
 	bool isPCMWave() const;
+
+	// Store and restore the state of the WG engine, the PCM wave address is stored relative to the PCM ROM
+	void saveState(StateWriter &writer, const Bit16s *pcmROMData, const Bit32u pcmROMSize) const;
+	void loadState(StateReader &reader, const Bit16s *pcmROMData, const Bit32u pcmROMSize);
 }; // class LA32WaveGenerator
 
 // LA32PartialPair contains a structure of two partials being mixed / ring modulated
@@ -110,6 +142,9 @@ public:
 	// mixed is used for the structures with ring modulation and indicates whether the master partial output is mixed to the ring modulator output
 	void init(const bool ringModulated, const bool mixed);
 
+	// Select the routines of the block-based methods optimised for the level of SIMD instruction set extensions given
+	void selectKernels(const SIMDLevel simdLevel);
+
 	// Initialise the WG engine for generation of synth partial samples and set up the invariant parameters
 	void initSynth(const PairType master, const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance);
 
@@ -122,11 +157,27 @@ public:
 	// Perform mixing / ring modulation and return the result
 	float nextOutSample();
 
+	// Block-based equivalent of generateNextSample(), stores the output of the WG engine in the buffer.
+	// Returns the number of samples generated which is less than length if the WG engine deactivates.
+	Bit32u generateNextSamples(const PairType master, float *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
+	// Block-based equivalent of nextOutSample() taking the outputs of the WG engines from the arrays, the buffer may be either of them
+	void produceOutputSamples(float *buffer, const float *masterSamples, const float *slaveSamples, const Bit32u length);
+
+	// Block-based equivalent of generateNextSample(MASTER, ...) followed by nextOutSample(), usable while the slave WG engine is inactive.
+	// Generates up to length (at most LA32_MAX_BLOCK_LENGTH) output samples in the buffer and returns the number of samples generated.
+	// Fewer samples are generated when the master WG engine deactivates.
+	Bit32u generateNextMasterSamples(float *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
 	// Deactivate the WG engine
 	void deactivate(const PairType master);
 
 	// Return active state of the WG engine
 	bool isActive(const PairType master) const;
+
+	// Store and restore the state of both WG engines
+	void saveState(StateWriter &writer, const Bit16s *pcmROMData, const Bit32u pcmROMSize) const;
+	void loadState(StateReader &reader, const Bit16s *pcmROMData, const Bit32u pcmROMSize);
 }; // class LA32PartialPair
 
 } // namespace MT32Emu
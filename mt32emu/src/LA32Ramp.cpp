@@ -51,6 +51,7 @@ We haven't fully explored:
 #include "internals.h"
 
 #include "LA32Ramp.h"
+#include "StateStream.h"
 #include "Tables.h"
 
 namespace MT32Emu {
@@ -137,6 +138,65 @@ Bit32u LA32Ramp::nextValue() {
 	return current;
 }
 
+// Returns the number of steps of an active ramp until the target is reached and the interrupt countdown starts.
+// Clamping of the current value on overflow (see nextValue()) always coincides with reaching the target.
+Bit32u LA32Ramp::getStepsToTarget() const {
+	Bit32u distance;
+	if (descending) {
+		distance = current > largeTarget ? current - largeTarget : 0;
+	} else {
+		distance = current < largeTarget ? largeTarget - current : 0;
+	}
+	return distance == 0 ? 1 : (distance + largeIncrement - 1) / largeIncrement;
+}
+
+Bit32u LA32Ramp::getSamplesBeforeInterrupt() const {
+	if (interruptRaised) {
+		return 0;
+	}
+	if (interruptCountdown > 0) {
+		return Bit32u(interruptCountdown - 1);
+	}
+	if (largeIncrement == 0) {
+		return NO_INTERRUPT;
+	}
+	return getStepsToTarget() - 1 + INTERRUPT_TIME;
+}
+
+void LA32Ramp::nextValues(Bit32u *values, Bit32u length) {
+	Bit32u i = 0;
+	if (interruptCountdown == 0 && largeIncrement != 0) {
+		Bit32u linearLength = getStepsToTarget() - 1;
+		if (linearLength > length) {
+			linearLength = length;
+		}
+		if (descending) {
+			for (; i < linearLength; i++) {
+				current -= largeIncrement;
+				values[i] = current;
+			}
+		} else {
+			for (; i < linearLength; i++) {
+				current += largeIncrement;
+				values[i] = current;
+			}
+		}
+		if (i == length) {
+			return;
+		}
+		current = largeTarget;
+		interruptCountdown = INTERRUPT_TIME;
+		values[i++] = current;
+	}
+	// The value holds from here on. The countdown cannot expire as long as the caller respects getSamplesBeforeInterrupt().
+	if (interruptCountdown > 0) {
+		interruptCountdown -= int(length - i);
+	}
+	for (; i < length; i++) {
+		values[i] = current;
+	}
+}
+
 bool LA32Ramp::checkInterrupt() {
 	bool wasRaised = interruptRaised;
 	interruptRaised = false;
@@ -152,4 +212,22 @@ void LA32Ramp::reset() {
 	interruptRaised = false;
 }
 
+void LA32Ramp::saveState(StateWriter &writer) const {
+	writer.writeBit32u(current);
+	writer.writeBit32u(largeTarget);
+	writer.writeBit32u(largeIncrement);
+	writer.writeBool(descending);
+	writer.writeBit32s(interruptCountdown);
+	writer.writeBool(interruptRaised);
+}
+
+void LA32Ramp::loadState(StateReader &reader) {
+	current = reader.readBit32u();
+	largeTarget = reader.readBit32u();
+	largeIncrement = reader.readBit32u();
+	descending = reader.readBool();
+	interruptCountdown = reader.readBit32s();
+	interruptRaised = reader.readBool();
+}
+
 } // namespace MT32Emu
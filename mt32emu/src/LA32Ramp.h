@@ -23,6 +23,9 @@
 
 namespace MT32Emu {
 
+class StateReader;
+class StateWriter;
+
 class LA32Ramp {
 private:
 	Bit32u current;
@@ -33,12 +36,23 @@ private:
 	int interruptCountdown;
 	bool interruptRaised;
 
+	Bit32u getStepsToTarget() const;
+
 public:
+	// Returned by getSamplesBeforeInterrupt() when the ramp is stopped and never raises the interrupt
+	static const Bit32u NO_INTERRUPT = 0xFFFFFFFF;
+
 	LA32Ramp();
 	void startRamp(Bit8u target, Bit8u increment);
 	Bit32u nextValue();
+	// Returns the number of subsequent calls to nextValue() before the one which raises the interrupt
+	Bit32u getSamplesBeforeInterrupt() const;
+	// Equivalent to length calls to nextValue() storing the results. The interrupt must not be raised meanwhile, see above.
+	void nextValues(Bit32u *values, Bit32u length);
 	bool checkInterrupt();
 	void reset();
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 } // namespace MT32Emu
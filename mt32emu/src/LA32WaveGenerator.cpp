@@ -20,6 +20,7 @@
 #include "internals.h"
 
 #include "LA32WaveGenerator.h"
+#include "StateStream.h"
 #include "Tables.h"
 
 #if MT32EMU_USE_FLOAT_SAMPLES
@@ -28,6 +29,10 @@
 #undef MT32EMU_LA32_WAVE_GENERATOR_CPP
 #else
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace MT32Emu {
 
 static const Bit32u SINE_SEGMENT_RELATIVE_LENGTH = 1 << 18;
@@ -37,11 +42,8 @@ static const Bit32u MAX_CUTOFF_VALUE = 240 << 18;
 static const LogSample SILENCE = {65535, LogSample::POSITIVE};
 
 Bit16u LA32Utilites::interpolateExp(const Bit16u fract) {
-	Bit16u expTabIndex = fract >> 3;
-	Bit16u extraBits = ~fract & 7;
-	Bit16u expTabEntry2 = 8191 - Tables::getInstance().exp9[expTabIndex];
-	Bit16u expTabEntry1 = expTabIndex == 0 ? 8191 : (8191 - Tables::getInstance().exp9[expTabIndex - 1]);
-	return expTabEntry2 + (((expTabEntry1 - expTabEntry2) * extraBits) >> 3);
+	// The interpolation of exp9 is precomputed for all the 12-bit arguments in Tables
+	return Tables::getInstance().interpolatedExp[fract & 4095];
 }
 
 Bit16s LA32Utilites::unlog(const LogSample &logSample) {
@@ -52,6 +54,54 @@ Bit16s LA32Utilites::unlog(const LogSample &logSample) {
 	return logSample.sign == LogSample::POSITIVE ? sample : -sample;
 }
 
+static void unlogSamplesGeneric(Bit16s *samples, const Bit16u *logValues, const Bit16u *signMasks, const Bit32u length) {
+	const Bit16u *interpolatedExp = Tables::getInstance().interpolatedExp;
+	for (Bit32u i = 0; i < length; i++) {
+		Bit16s sample = interpolatedExp[logValues[i] & 4095] >> (logValues[i] >> 12);
+		samples[i] = signMasks[i] == 0 ? sample : Bit16s(-sample);
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+// Processes 8 samples at once making use of gathered loads and per-element shifts that have no SSE2 equivalent
+MT32EMU_X86_TARGET("avx2")
+static void unlogSamplesAVX2(Bit16s *samples, const Bit16u *logValues, const Bit16u *signMasks, const Bit32u length) {
+	// Each gathered 32-bit element contains the needed 16-bit table entry in the low half, hence the padding entry in the table
+	const int *interpolatedExp = reinterpret_cast<const int *>(Tables::getInstance().interpolatedExp);
+	const __m256i fracMask = _mm256_set1_epi32(4095);
+	const __m256i lowHalfMask = _mm256_set1_epi32(0xFFFF);
+	Bit32u i = 0;
+	for (; i + 8 <= length; i += 8) {
+		__m256i logValue = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(logValues + i)));
+		__m256i signMask = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(signMasks + i)));
+		__m256i exp = _mm256_and_si256(_mm256_i32gather_epi32(interpolatedExp, _mm256_and_si256(logValue, fracMask), 2), lowHalfMask);
+		__m256i sample = _mm256_srlv_epi32(exp, _mm256_srli_epi32(logValue, 12));
+		sample = _mm256_sub_epi32(_mm256_xor_si256(sample, signMask), signMask);
+		// Packing works within 128-bit lanes, so the low 64 bits of both lanes are to be joined afterwards
+		__m256i packedSamples = _mm256_permute4x64_epi64(_mm256_packs_epi32(sample, sample), 0x08);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(samples + i), _mm256_castsi256_si128(packedSamples));
+	}
+	unlogSamplesGeneric(samples + i, logValues + i, signMasks + i, length - i);
+}
+#endif
+
+static UnlogSamplesKernel selectUnlogSamplesKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
+	if (simdLevel >= SIMDLevel_AVX2) return unlogSamplesAVX2;
+#else
+	(void)simdLevel;
+#endif
+	return unlogSamplesGeneric;
+}
+
+void LA32Utilites::makePCMLogSamples(Bit32u *logSamples, const Bit16s *pcmSamples, const Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		// Values above 65535 saturate to silence whatever the amp, so they can be saturated in advance
+		Bit32u logValue = (32787 - (pcmSamples[i] & 32767)) << 1;
+		logSamples[i] = (logValue < 65536 ? logValue : 65535) | (pcmSamples[i] < 0 ? 0xFFFF0000U : 0);
+	}
+}
+
 void LA32Utilites::addLogSamples(LogSample &logSample1, const LogSample &logSample2) {
 	Bit32u logSampleValue = logSample1.logValue + logSample2.logValue;
 	logSample1.logValue = logSampleValue < 65536 ? (Bit16u)logSampleValue : 65535;
@@ -217,11 +267,10 @@ void LA32WaveGenerator::generateNextSawtoothCosineLogSample(LogSample &logSample
 	logSample.sign = ((sawtoothCosinePosition & (1 << 19)) == 0) ? LogSample::POSITIVE : LogSample::NEGATIVE;
 }
 
-void LA32WaveGenerator::pcmSampleToLogSample(LogSample &logSample, const Bit16s pcmSample) const {
-	Bit32u logSampleValue = (32787 - (pcmSample & 32767)) << 1;
-	logSampleValue += amp >> 10;
+void LA32WaveGenerator::pcmSampleToLogSample(LogSample &logSample, const Bit32u pcmLogSample) const {
+	Bit32u logSampleValue = (pcmLogSample & 0xFFFF) + (amp >> 10);
 	logSample.logValue = logSampleValue < 65536 ? (Bit16u)logSampleValue : 65535;
-	logSample.sign = pcmSample < 0 ? LogSample::NEGATIVE : LogSample::POSITIVE;
+	logSample.sign = (pcmLogSample >> 16) == 0 ? LogSample::POSITIVE : LogSample::NEGATIVE;
 }
 
 void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
@@ -230,15 +279,15 @@ void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
 	// accurate than the sample position counter
 	pcmInterpolationFactor = (wavePosition & 255) >> 1;
 	Bit32u pcmWaveTableIx = wavePosition >> 8;
-	pcmSampleToLogSample(firstPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
+	pcmSampleToLogSample(firstPCMLogSample, pcmWaveLogAddress[pcmWaveTableIx]);
 	if (pcmWaveInterpolated) {
 		pcmWaveTableIx++;
 		if (pcmWaveTableIx < pcmWaveLength) {
-			pcmSampleToLogSample(secondPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
+			pcmSampleToLogSample(secondPCMLogSample, pcmWaveLogAddress[pcmWaveTableIx]);
 		} else {
 			if (pcmWaveLooped) {
 				pcmWaveTableIx -= pcmWaveLength;
-				pcmSampleToLogSample(secondPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
+				pcmSampleToLogSample(secondPCMLogSample, pcmWaveLogAddress[pcmWaveTableIx]);
 			} else {
 				secondPCMLogSample = SILENCE;
 			}
@@ -277,12 +326,12 @@ void LA32WaveGenerator::initSynth(const bool useSawtoothWaveform, const Bit8u us
 	resonanceAmpSubtraction = (32 - resonance) << 10;
 	resAmpDecayFactor = Tables::getInstance().resAmpDecayFactor[resonance >> 2] << 2;
 
-	pcmWaveAddress = NULL;
+	pcmWaveLogAddress = NULL;
 	active = true;
 }
 
-void LA32WaveGenerator::initPCM(const Bit16s * const usePCMWaveAddress, const Bit32u usePCMWaveLength, const bool usePCMWaveLooped, const bool usePCMWaveInterpolated) {
-	pcmWaveAddress = usePCMWaveAddress;
+void LA32WaveGenerator::initPCM(const Bit32u * const usePCMWaveLogAddress, const Bit32u usePCMWaveLength, const bool usePCMWaveLooped, const bool usePCMWaveInterpolated) {
+	pcmWaveLogAddress = usePCMWaveLogAddress;
 	pcmWaveLength = usePCMWaveLength;
 	pcmWaveLooped = usePCMWaveLooped;
 	pcmWaveInterpolated = usePCMWaveInterpolated;
@@ -319,6 +368,55 @@ void LA32WaveGenerator::generateNextSample(const Bit32u useAmp, const Bit16u use
 	advancePosition();
 }
 
+template <bool PCM_WAVE, bool SAWTOOTH_WAVEFORM>
+Bit32u LA32WaveGenerator::generateNextWaveSamples(LogSampleBlock &block, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length) {
+	Bit32u sampleIndex = 0;
+	while (active && sampleIndex < length) {
+		amp = amps[sampleIndex];
+		pitch = pitches[sampleIndex];
+		const LogSample *firstLogSample;
+		const LogSample *secondLogSample;
+		if (PCM_WAVE) {
+			generateNextPCMWaveLogSamples();
+			// Only PCM waves deactivate by themselves, in which case the output is silent as getOutputLogSample() returns
+			firstLogSample = active ? &firstPCMLogSample : &SILENCE;
+			secondLogSample = active ? &secondPCMLogSample : &SILENCE;
+			block.pcmInterpolationFactors[sampleIndex] = Bit16u(pcmInterpolationFactor);
+		} else {
+			// See the note in generateNextSample() about the cutoffVal limit.
+			cutoffVal = (cutoffs[sampleIndex] > MAX_CUTOFF_VALUE) ? MAX_CUTOFF_VALUE : cutoffs[sampleIndex];
+			generateNextSquareWaveLogSample();
+			generateNextResonanceWaveLogSample();
+			if (SAWTOOTH_WAVEFORM) {
+				LogSample cosineLogSample;
+				generateNextSawtoothCosineLogSample(cosineLogSample);
+				LA32Utilites::addLogSamples(squareLogSample, cosineLogSample);
+				LA32Utilites::addLogSamples(resonanceLogSample, cosineLogSample);
+			}
+			advancePosition();
+			firstLogSample = &squareLogSample;
+			secondLogSample = &resonanceLogSample;
+		}
+		block.firstLogValues[sampleIndex] = firstLogSample->logValue;
+		block.firstSignMasks[sampleIndex] = firstLogSample->sign == LogSample::POSITIVE ? 0 : 0xFFFF;
+		block.secondLogValues[sampleIndex] = secondLogSample->logValue;
+		block.secondSignMasks[sampleIndex] = secondLogSample->sign == LogSample::POSITIVE ? 0 : 0xFFFF;
+		sampleIndex++;
+	}
+	return sampleIndex;
+}
+
+Bit32u LA32WaveGenerator::generateNextSamples(LogSampleBlock &block, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length) {
+	// The kind of wave is invariant while the WG engine is active, so it is enough to dispatch once per block.
+	if (isPCMWave()) {
+		return generateNextWaveSamples<true, false>(block, amps, pitches, cutoffs, length);
+	}
+	if (sawtoothWaveform) {
+		return generateNextWaveSamples<false, true>(block, amps, pitches, cutoffs, length);
+	}
+	return generateNextWaveSamples<false, false>(block, amps, pitches, cutoffs, length);
+}
+
 LogSample LA32WaveGenerator::getOutputLogSample(const bool first) const {
 	if (!isActive()) {
 		return SILENCE;
@@ -338,7 +436,7 @@ bool LA32WaveGenerator::isActive() const {
 }
 
 bool LA32WaveGenerator::isPCMWave() const {
-	return pcmWaveAddress != NULL;
+	return pcmWaveLogAddress != NULL;
 }
 
 Bit32u LA32WaveGenerator::getPCMInterpolationFactor() const {
@@ -350,6 +448,10 @@ void LA32PartialPair::init(const bool useRingModulated, const bool useMixed) {
 	mixed = useMixed;
 }
 
+void LA32PartialPair::selectKernels(const SIMDLevel simdLevel) {
+	unlogSamplesKernel = selectUnlogSamplesKernel(simdLevel);
+}
+
 void LA32PartialPair::initSynth(const PairType useMaster, const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance) {
 	if (useMaster == MASTER) {
 		master.initSynth(sawtoothWaveform, pulseWidth, resonance);
@@ -358,11 +460,11 @@ void LA32PartialPair::initSynth(const PairType useMaster, const bool sawtoothWav
 	}
 }
 
-void LA32PartialPair::initPCM(const PairType useMaster, const Bit16s *pcmWaveAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped) {
+void LA32PartialPair::initPCM(const PairType useMaster, const Bit32u *pcmWaveLogAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped) {
 	if (useMaster == MASTER) {
-		master.initPCM(pcmWaveAddress, pcmWaveLength, pcmWaveLooped, true);
+		master.initPCM(pcmWaveLogAddress, pcmWaveLength, pcmWaveLooped, true);
 	} else {
-		slave.initPCM(pcmWaveAddress, pcmWaveLength, pcmWaveLooped, !ringModulated);
+		slave.initPCM(pcmWaveLogAddress, pcmWaveLength, pcmWaveLooped, !ringModulated);
 	}
 }
 
@@ -415,6 +517,31 @@ Bit16s LA32PartialPair::nextOutSample() {
 	return mixed ? nonOverdrivenMasterSample + ringModulatedSample : ringModulatedSample;
 }
 
+Bit32u LA32PartialPair::generateNextMasterSamples(Bit16s *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length) {
+	LogSampleBlock block;
+	Bit16s secondSamples[LA32_MAX_BLOCK_LENGTH];
+	Bit32u generatedLength = master.generateNextSamples(block, amps, pitches, cutoffs, length);
+	if (ringModulated && !mixed) {
+		// The ring modulator output is silent as long as the slave is inactive
+		for (Bit32u i = 0; i < generatedLength; i++) {
+			buffer[i] = 0;
+		}
+		return generatedLength;
+	}
+	unlogSamplesKernel(buffer, block.firstLogValues, block.firstSignMasks, generatedLength);
+	unlogSamplesKernel(secondSamples, block.secondLogValues, block.secondSignMasks, generatedLength);
+	if (master.isPCMWave()) {
+		for (Bit32u i = 0; i < generatedLength; i++) {
+			buffer[i] = Bit16s(buffer[i] + ((Bit32s(secondSamples[i] - buffer[i]) * block.pcmInterpolationFactors[i]) >> 7));
+		}
+	} else {
+		for (Bit32u i = 0; i < generatedLength; i++) {
+			buffer[i] = Bit16s(buffer[i] + secondSamples[i]);
+		}
+	}
+	return generatedLength;
+}
+
 void LA32PartialPair::deactivate(const PairType useMaster) {
 	if (useMaster == MASTER) {
 		master.deactivate();
@@ -427,6 +554,74 @@ bool LA32PartialPair::isActive(const PairType useMaster) const {
 	return useMaster == MASTER ? master.isActive() : slave.isActive();
 }
 
+void LA32WaveGenerator::saveState(StateWriter &writer, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) const {
+	// Inactive WG engine gets initialised anew before use.
+	// The amp, pitch, cutoff and the log samples are recomputed for each sample and need not be stored.
+	writer.writeBool(active);
+	if (!active) return;
+	writer.writeBool(isPCMWave());
+	writer.writeBit32u(wavePosition);
+	if (isPCMWave()) {
+		writer.writeBit32u(pcmWaveLength);
+		writer.writePointer(pcmWaveLogAddress, pcmROMLogData, pcmROMSize * sizeof(Bit32u));
+		writer.writeBool(pcmWaveLooped);
+		writer.writeBool(pcmWaveInterpolated);
+		return;
+	}
+	writer.writeBool(sawtoothWaveform);
+	writer.writeBit8u(resonance);
+	writer.writeBit8u(pulseWidth);
+	writer.writeBit32u(squareWavePosition);
+	writer.writeBit32u(resonanceSinePosition);
+	writer.writeBit32u(resonanceAmpSubtraction);
+	writer.writeBit32u(resAmpDecayFactor);
+	writer.writeBit8u(Bit8u(phase));
+	writer.writeBit8u(Bit8u(resonancePhase));
+}
+
+void LA32WaveGenerator::loadState(StateReader &reader, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) {
+	active = reader.readBool();
+	if (!active) return;
+	bool pcmWave = reader.readBool();
+	wavePosition = reader.readBit32u();
+	if (pcmWave) {
+		pcmWaveLength = reader.readBit32u();
+		pcmWaveLogAddress = static_cast<const Bit32u *>(reader.readPointer(pcmROMLogData, pcmROMSize * sizeof(Bit32u), pcmWaveLength * sizeof(Bit32u)));
+		if (pcmWaveLogAddress == NULL) reader.fail();
+		pcmWaveLooped = reader.readBool();
+		pcmWaveInterpolated = reader.readBool();
+		return;
+	}
+	pcmWaveLogAddress = NULL;
+	sawtoothWaveform = reader.readBool();
+	resonance = reader.readBit8u();
+	pulseWidth = reader.readBit8u();
+	squareWavePosition = reader.readBit32u();
+	resonanceSinePosition = reader.readBit32u();
+	resonanceAmpSubtraction = reader.readBit32u();
+	resAmpDecayFactor = reader.readBit32u();
+	Bit8u phaseValue = reader.readBit8u();
+	if (phaseValue > NEGATIVE_RISING_SINE_SEGMENT) reader.fail();
+	phase = SquareWavePhase(phaseValue);
+	Bit8u resonancePhaseValue = reader.readBit8u();
+	if (resonancePhaseValue > NEGATIVE_RISING_RESONANCE_SINE_SEGMENT) reader.fail();
+	resonancePhase = ResonanceWavePhase(resonancePhaseValue);
+}
+
+void LA32PartialPair::saveState(StateWriter &writer, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) const {
+	master.saveState(writer, pcmROMLogData, pcmROMSize);
+	slave.saveState(writer, pcmROMLogData, pcmROMSize);
+	writer.writeBool(ringModulated);
+	writer.writeBool(mixed);
+}
+
+void LA32PartialPair::loadState(StateReader &reader, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) {
+	master.loadState(reader, pcmROMLogData, pcmROMSize);
+	slave.loadState(reader, pcmROMLogData, pcmROMSize);
+	ringModulated = reader.readBool();
+	mixed = reader.readBool();
+}
+
 } // namespace MT32Emu
 
 #endif // #if MT32EMU_USE_FLOAT_SAMPLES
@@ -21,6 +21,7 @@
 #include "globals.h"
 #include "internals.h"
 #include "Types.h"
+#include "Enumerations.h"
 
 #if MT32EMU_USE_FLOAT_SAMPLES
 #include "LA32FloatWaveGenerator.h"
@@ -28,6 +29,9 @@
 
 namespace MT32Emu {
 
+class StateReader;
+class StateWriter;
+
 /**
  * LA32 performs wave generation in the log-space that allows replacing multiplications by cheap additions
  * It's assumed that only low-bit multiplications occur in a few places which are unavoidable like these:
@@ -49,11 +53,32 @@ struct LogSample {
 	} sign;
 };
 
+// Maximum number of samples processed at once by the block-based methods of the WG engine
+const unsigned int LA32_MAX_BLOCK_LENGTH = 128;
+
+// Log-space output of the WG engine for a block of samples.
+// The components are stored in separate arrays to allow for vectorised conversion to the linear space.
+// The signs are represented as masks: 0 for positive and 0xFFFF for negative samples.
+struct LogSampleBlock {
+	Bit16u firstLogValues[LA32_MAX_BLOCK_LENGTH];
+	Bit16u firstSignMasks[LA32_MAX_BLOCK_LENGTH];
+	Bit16u secondLogValues[LA32_MAX_BLOCK_LENGTH];
+	Bit16u secondSignMasks[LA32_MAX_BLOCK_LENGTH];
+	Bit16u pcmInterpolationFactors[LA32_MAX_BLOCK_LENGTH];
+};
+
+// Converts a block of log-space samples to the linear space, the result is identical to calling LA32Utilites::unlog() for each sample.
+typedef void (*UnlogSamplesKernel)(Bit16s *samples, const Bit16u *logValues, const Bit16u *signMasks, const Bit32u length);
+
 class LA32Utilites {
 public:
 	static Bit16u interpolateExp(const Bit16u fract);
 	static Bit16s unlog(const LogSample &logSample);
 	static void addLogSamples(LogSample &logSample1, const LogSample &logSample2);
+
+	// Converts PCM ROM samples to the log-space once for all, so that producing a PCM wave sample only takes adding the amp.
+	// Each resulting value holds the log value (saturated to 16 bits) in the low half and the sign mask in the high half.
+	static void makePCMLogSamples(Bit32u *logSamples, const Bit16s *pcmSamples, const Bit32u length);
 };
 
 /**
@@ -92,8 +117,8 @@ class LA32WaveGenerator {
 	// Composed of the base cutoff in range [78..178] left-shifted by 18 bits and the TVF modifier
 	Bit32u cutoffVal;
 
-	// Logarithmic PCM sample start address
-	const Bit16s *pcmWaveAddress;
+	// Logarithmic PCM sample start address, the samples are converted by LA32Utilites::makePCMLogSamples()
+	const Bit32u *pcmWaveLogAddress;
 
 	// Logarithmic PCM sample length
 	Bit32u pcmWaveLength;
@@ -137,7 +162,7 @@ class LA32WaveGenerator {
 	Bit32u pcmInterpolationFactor;
 
 	// Current phase of the square wave
-	enum {
+	enum SquareWavePhase {
 		POSITIVE_RISING_SINE_SEGMENT,
 		POSITIVE_LINEAR_SEGMENT,
 		POSITIVE_FALLING_SINE_SEGMENT,
@@ -147,7 +172,7 @@ class LA32WaveGenerator {
 	} phase;
 
 	// Current phase of the resonance wave
-	enum {
+	enum ResonanceWavePhase {
 		POSITIVE_RISING_RESONANCE_SINE_SEGMENT,
 		POSITIVE_FALLING_RESONANCE_SINE_SEGMENT,
 		NEGATIVE_FALLING_RESONANCE_SINE_SEGMENT,
@@ -177,19 +202,28 @@ class LA32WaveGenerator {
 	void generateNextResonanceWaveLogSample();
 	void generateNextSawtoothCosineLogSample(LogSample &logSample) const;
 
-	void pcmSampleToLogSample(LogSample &logSample, const Bit16s pcmSample) const;
+	void pcmSampleToLogSample(LogSample &logSample, const Bit32u pcmLogSample) const;
 	void generateNextPCMWaveLogSamples();
 
+	// Specialisations of generateNextSamples() for the kind of wave, so that the per-sample loop doesn't branch on it.
+	template <bool PCM_WAVE, bool SAWTOOTH_WAVEFORM>
+	Bit32u generateNextWaveSamples(LogSampleBlock &block, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
 public:
 	// Initialise the WG engine for generation of synth partial samples and set up the invariant parameters
 	void initSynth(const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance);
 
 	// Initialise the WG engine for generation of PCM partial samples and set up the invariant parameters
-	void initPCM(const Bit16s * const pcmWaveAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped, const bool pcmWaveInterpolated);
+	void initPCM(const Bit32u * const pcmWaveLogAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped, const bool pcmWaveInterpolated);
 
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	void generateNextSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
+	// Generate up to length (at most LA32_MAX_BLOCK_LENGTH) samples taking parameters of TVP, TVA and TVF for each sample from the arrays
+	// and store the output in the block. Returns the number of samples generated which is less than length if the WG engine deactivates.
+	// In the latter case, the last generated sample is silent as well as getOutputLogSample() would have returned.
+	Bit32u generateNextSamples(LogSampleBlock &block, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
 	// WG output in the log-space consists of two components which are to be added (or ring modulated) in the linear-space afterwards
 	LogSample getOutputLogSample(const bool first) const;
 
@@ -204,6 +238,10 @@ public:
 
 	// Return current PCM interpolation factor
 	Bit32u getPCMInterpolationFactor() const;
+
+	// Store and restore the state of the WG engine, the PCM wave address is stored relative to the PCM ROM log samples
+	void saveState(StateWriter &writer, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) const;
+	void loadState(StateReader &reader, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize);
 }; // class LA32WaveGenerator
 
 // LA32PartialPair contains a structure of two partials being mixed / ring modulated
@@ -212,6 +250,7 @@ class LA32PartialPair {
 	LA32WaveGenerator slave;
 	bool ringModulated;
 	bool mixed;
+	UnlogSamplesKernel unlogSamplesKernel;
 
 	static Bit16s unlogAndMixWGOutput(const LA32WaveGenerator &wg);
 
@@ -226,11 +265,14 @@ public:
 	// mixed is used for the structures with ring modulation and indicates whether the master partial output is mixed to the ring modulator output
 	void init(const bool ringModulated, const bool mixed);
 
+	// Select the routines of the block-based methods optimised for the level of SIMD instruction set extensions given
+	void selectKernels(const SIMDLevel simdLevel);
+
 	// Initialise the WG engine for generation of synth partial samples and set up the invariant parameters
 	void initSynth(const PairType master, const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance);
 
 	// Initialise the WG engine for generation of PCM partial samples and set up the invariant parameters
-	void initPCM(const PairType master, const Bit16s * const pcmWaveAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped);
+	void initPCM(const PairType master, const Bit32u * const pcmWaveLogAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped);
 
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	void generateNextSample(const PairType master, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
@@ -238,11 +280,20 @@ public:
 	// Perform mixing / ring modulation and return the result
 	Bit16s nextOutSample();
 
+	// Block-based equivalent of generateNextSample(MASTER, ...) followed by nextOutSample(), usable while the slave WG engine is inactive.
+	// Generates up to length (at most LA32_MAX_BLOCK_LENGTH) output samples in the buffer and returns the number of samples generated.
+	// Fewer samples are generated when the master WG engine deactivates.
+	Bit32u generateNextMasterSamples(Bit16s *buffer, const Bit32u *amps, const Bit16u *pitches, const Bit32u *cutoffs, const Bit32u length);
+
 	// Deactivate the WG engine
 	void deactivate(const PairType master);
 
 	// Return active state of the WG engine
 	bool isActive(const PairType master) const;
+
+	// Store and restore the state of both WG engines
+	void saveState(StateWriter &writer, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize) const;
+	void loadState(StateReader &reader, const Bit32u *pcmROMLogData, const Bit32u pcmROMSize);
 }; // class LA32PartialPair
 
 } // namespace MT32Emu
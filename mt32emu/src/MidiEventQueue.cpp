@@ -0,0 +1,277 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <cstring>
+
+#include "internals.h"
+
+#include "MidiEventQueue.h"
+#include "Atomics.h"
+#include "StateStream.h"
+
+namespace MT32Emu {
+
+/* The queue follows the well-known design of a bounded lock-free queue based on a ring of slots with sequence numbers.
+ * A pushing thread claims a position by incrementing the end position atomically, provided the slot at that position
+ * has been freed by the reader. Once the event is stored, the thread sets the sequence number of the slot to mark
+ * the event ready. As there is only one reader, the start position needs no atomic updates. The reader owns the slots
+ * with events ready, so it sorts them in place by the timestamp, inserting each event into the sorted run at the start.
+ * Events pushed in order of their timestamps take a single comparison.
+ *
+ * SysEx storage is a ring of bytes split in chunks, each starts with a header of two 32-bit words: the chunk length and
+ * the release flag. Chunks are allocated by incrementing the end position atomically, though they may be released in
+ * a different order. Hence, the reader only reclaims the space of consecutive released chunks at the start of the storage.
+ * Reclaimed space is zeroed, so that the release flags of chunks allocated there later are initially clear.
+ */
+
+static const Bit32u SYSEX_CHUNK_HEADER_LENGTH = 8;
+// Chunks are 8-byte aligned, so that the headers never wrap
+static const Bit32u SYSEX_CHUNK_ALIGNMENT_MASK = 7;
+// By default, SysEx storage size is proportional to the queue size, the bounds are powers of 2.
+// A chunk no longer than a half of the storage always fits in if the storage is empty. Hence, the default minimum
+// is sufficient to hold the longest SysEx the MidiStreamParser passes through.
+static const Bit32u SYSEX_STORAGE_BYTES_PER_EVENT = 32;
+static const Bit32u MIN_SYSEX_STORAGE_SIZE = 1 << 17;
+static const Bit32u MAX_SYSEX_STORAGE_SIZE = 1 << 24;
+// Bounds of the storage size when configured explicitly
+static const Bit32u MIN_CONFIGURED_SYSEX_STORAGE_SIZE = 1 << 10;
+static const Bit32u MAX_CONFIGURED_SYSEX_STORAGE_SIZE = 1 << 30;
+
+static Bit32u calcSysexStorageSize(Bit32u ringBufferSize, Bit32u requestedSize) {
+	if (requestedSize == 0) {
+		if (ringBufferSize < MIN_SYSEX_STORAGE_SIZE / SYSEX_STORAGE_BYTES_PER_EVENT) return MIN_SYSEX_STORAGE_SIZE;
+		if (ringBufferSize > MAX_SYSEX_STORAGE_SIZE / SYSEX_STORAGE_BYTES_PER_EVENT) return MAX_SYSEX_STORAGE_SIZE;
+		return ringBufferSize * SYSEX_STORAGE_BYTES_PER_EVENT;
+	}
+	if (requestedSize > MAX_CONFIGURED_SYSEX_STORAGE_SIZE) return MAX_CONFIGURED_SYSEX_STORAGE_SIZE;
+	Bit32u binarySize = MIN_CONFIGURED_SYSEX_STORAGE_SIZE;
+	while (binarySize < requestedSize) binarySize <<= 1;
+	return binarySize;
+}
+
+MidiEventQueue::MidiEventQueue(Bit32u useRingBufferSize, Bit32u useSysexStorageSize) :
+	ringBuffer(new Slot[useRingBufferSize]), ringBufferMask(useRingBufferSize - 1),
+	sysexStorage(new Bit32u[calcSysexStorageSize(useRingBufferSize, useSysexStorageSize) >> 2]),
+	sysexStorageSize(calcSysexStorageSize(useRingBufferSize, useSysexStorageSize))
+{
+	reset();
+}
+
+MidiEventQueue::~MidiEventQueue() {
+	delete[] ringBuffer;
+	delete[] sysexStorage;
+}
+
+void MidiEventQueue::reset() {
+	for (Bit32u i = 0; i <= ringBufferMask; i++) {
+		ringBuffer[i].sequenceNumber = i;
+		ringBuffer[i].sysexChunkPosition = 0;
+		memset(&ringBuffer[i].event, 0, sizeof(MidiEvent));
+	}
+	startPosition = 0;
+	endPosition = 0;
+	sortedEndPosition = 0;
+	memset(sysexStorage, 0, sysexStorageSize);
+	sysexStartPosition = 0;
+	Atomics::store(sysexEndPosition, 0);
+}
+
+bool MidiEventQueue::pushShortMessage(Bit32u shortMessageData, Bit32u timestamp) {
+	return push(shortMessageData, NULL, 0, timestamp);
+}
+
+bool MidiEventQueue::pushSysex(const Bit8u *sysexData, Bit32u sysexLength, Bit32u timestamp) {
+	return push(0, sysexData, sysexLength, timestamp);
+}
+
+bool MidiEventQueue::push(Bit32u shortMessageData, const Bit8u *sysexData, Bit32u sysexLength, Bit32u timestamp) {
+	Bit32u sysexChunkPosition = 0;
+	Bit8u *sysexChunkData = NULL;
+	if (sysexData != NULL) {
+		sysexChunkData = allocateSysexChunk(sysexLength, sysexChunkPosition);
+		if (sysexChunkData == NULL) return false;
+		memcpy(sysexChunkData, sysexData, sysexLength);
+	}
+
+	Bit32u position = Atomics::load(endPosition);
+	for (;;) {
+		Bit32s sequenceDelta = Bit32s(Atomics::load(ringBuffer[position & ringBufferMask].sequenceNumber) - position);
+		if (sequenceDelta == 0) {
+			if (Atomics::compareAndSwap(endPosition, position, position + 1)) break;
+		} else if (sequenceDelta < 0) {
+			// The slot still contains the event pushed a full turn ago, the ring buffer is full
+			if (sysexChunkData != NULL) {
+				releaseSysexChunk(sysexChunkPosition);
+			}
+			return false;
+		}
+		// Another thread has claimed the position meanwhile
+		position = Atomics::load(endPosition);
+	}
+
+	Slot &slot = ringBuffer[position & ringBufferMask];
+	slot.event.shortMessageData = shortMessageData;
+	slot.event.sysexData = sysexChunkData;
+	slot.event.sysexLength = sysexLength;
+	slot.event.timestamp = timestamp;
+	slot.sysexChunkPosition = sysexChunkPosition;
+	Atomics::store(slot.sequenceNumber, position + 1);
+	return true;
+}
+
+const MidiEvent *MidiEventQueue::peekMidiEvent() {
+	sortStoredEvents();
+	return (sortedEndPosition != startPosition) ? &ringBuffer[startPosition & ringBufferMask].event : NULL;
+}
+
+void MidiEventQueue::dropMidiEvent() {
+	Slot &slot = ringBuffer[startPosition & ringBufferMask];
+	// Is ring buffer empty?
+	if (Atomics::load(slot.sequenceNumber) != startPosition + 1) return;
+	if (slot.event.sysexData != NULL) {
+		releaseSysexChunk(slot.sysexChunkPosition);
+	}
+	// Makes the slot available for the position a full turn ahead
+	Atomics::store(slot.sequenceNumber, startPosition + ringBufferMask + 1);
+	if (sortedEndPosition == startPosition) sortedEndPosition++;
+	startPosition++;
+	reclaimSysexStorage();
+}
+
+// Sorting stops at the first position claimed but not stored yet, the events past it are sorted once it is stored.
+void MidiEventQueue::sortStoredEvents() {
+	while (Atomics::load(ringBuffer[sortedEndPosition & ringBufferMask].sequenceNumber) == sortedEndPosition + 1) {
+		const Slot &newSlot = ringBuffer[sortedEndPosition & ringBufferMask];
+		Bit32u position = sortedEndPosition;
+		while (position != startPosition && Bit32s(ringBuffer[(position - 1) & ringBufferMask].event.timestamp - newSlot.event.timestamp) > 0) {
+			position--;
+		}
+		if (position != sortedEndPosition) {
+			const MidiEvent event = newSlot.event;
+			const Bit32u sysexChunkPosition = newSlot.sysexChunkPosition;
+			for (Bit32u i = sortedEndPosition; i != position; i--) {
+				Slot &slot = ringBuffer[i & ringBufferMask];
+				const Slot &precedingSlot = ringBuffer[(i - 1) & ringBufferMask];
+				slot.event = precedingSlot.event;
+				slot.sysexChunkPosition = precedingSlot.sysexChunkPosition;
+			}
+			Slot &slot = ringBuffer[position & ringBufferMask];
+			slot.event = event;
+			slot.sysexChunkPosition = sysexChunkPosition;
+		}
+		sortedEndPosition++;
+	}
+}
+
+Bit32u MidiEventQueue::getSize() const {
+	return ringBufferMask + 1;
+}
+
+Bit32u MidiEventQueue::getSysexStorageSize() const {
+	return sysexStorageSize;
+}
+
+bool MidiEventQueue::isFull() const {
+	const Bit32u position = Atomics::load(endPosition);
+	return Bit32s(Atomics::load(ringBuffer[position & ringBufferMask].sequenceNumber) - position) < 0;
+}
+
+void MidiEventQueue::saveState(StateWriter &writer) const {
+	// Events pushed meanwhile are left out, so the count is taken first
+	Bit32u eventCount = 0;
+	while (Atomics::load(ringBuffer[(startPosition + eventCount) & ringBufferMask].sequenceNumber) == startPosition + eventCount + 1) {
+		eventCount++;
+	}
+	writer.writeBit32u(eventCount);
+	for (Bit32u i = 0; i < eventCount; i++) {
+		const MidiEvent &event = ringBuffer[(startPosition + i) & ringBufferMask].event;
+		writer.writeBit32u(event.timestamp);
+		if (event.sysexData != NULL) {
+			writer.writeBool(true);
+			writer.writeBit32u(event.sysexLength);
+			writer.writeBytes(event.sysexData, event.sysexLength);
+		} else {
+			writer.writeBool(false);
+			writer.writeBit32u(event.shortMessageData);
+		}
+	}
+}
+
+void MidiEventQueue::loadState(StateReader &reader) {
+	reset();
+	Bit32u eventCount = reader.readBit32u();
+	while (!reader.isFailed() && eventCount-- > 0) {
+		Bit32u timestamp = reader.readBit32u();
+		bool pushed;
+		if (reader.readBool()) {
+			Bit32u sysexLength = reader.readBit32u();
+			const Bit8u *sysexData = reader.read(sysexLength);
+			pushed = sysexData != NULL && pushSysex(sysexData, sysexLength, timestamp);
+		} else {
+			pushed = pushShortMessage(reader.readBit32u(), timestamp);
+		}
+		if (!pushed) reader.fail();
+	}
+}
+
+Bit8u *MidiEventQueue::allocateSysexChunk(Bit32u sysexLength, Bit32u &chunkPosition) {
+	if (sysexLength > sysexStorageSize - SYSEX_CHUNK_HEADER_LENGTH) return NULL;
+	const Bit32u chunkLength = (SYSEX_CHUNK_HEADER_LENGTH + sysexLength + SYSEX_CHUNK_ALIGNMENT_MASK) & ~SYSEX_CHUNK_ALIGNMENT_MASK;
+	const Bit32u storageMask = sysexStorageSize - 1;
+	for (;;) {
+		// The start position is read first as it never overtakes the end position
+		const Bit32u readPosition = Atomics::load(sysexStartPosition);
+		const Bit32u writePosition = Atomics::load(sysexEndPosition);
+		const Bit32u writeOffset = writePosition & storageMask;
+		// A chunk must be contiguous, so the rest of the storage is skipped if the chunk doesn't fit there
+		const Bit32u paddingLength = (sysexStorageSize - writeOffset < chunkLength) ? sysexStorageSize - writeOffset : 0;
+		// Is the storage full?
+		if (writePosition - readPosition + paddingLength + chunkLength > sysexStorageSize) return NULL;
+		if (!Atomics::compareAndSwap(sysexEndPosition, writePosition, writePosition + paddingLength + chunkLength)) continue;
+		if (paddingLength > 0) {
+			// The padding is a chunk that is released right away
+			sysexStorage[writeOffset >> 2] = paddingLength;
+			releaseSysexChunk(writePosition);
+		}
+		chunkPosition = writePosition + paddingLength;
+		Bit32u *header = sysexStorage + ((chunkPosition & storageMask) >> 2);
+		header[0] = chunkLength;
+		return reinterpret_cast<Bit8u *>(header) + SYSEX_CHUNK_HEADER_LENGTH;
+	}
+}
+
+void MidiEventQueue::releaseSysexChunk(Bit32u chunkPosition) {
+	Atomics::store(sysexStorage[((chunkPosition & (sysexStorageSize - 1)) >> 2) + 1], 1);
+}
+
+void MidiEventQueue::reclaimSysexStorage() {
+	// Only the reader modifies the start position
+	Bit32u readPosition = sysexStartPosition;
+	const Bit32u writePosition = Atomics::load(sysexEndPosition);
+	if (readPosition == writePosition) return;
+	while (readPosition != writePosition) {
+		Bit32u *header = sysexStorage + ((readPosition & (sysexStorageSize - 1)) >> 2);
+		if (Atomics::load(header[1]) == 0) break;
+		const Bit32u chunkLength = header[0];
+		memset(header, 0, chunkLength);
+		readPosition += chunkLength;
+	}
+	Atomics::store(sysexStartPosition, readPosition);
+}
+
+} // namespace MT32Emu
@@ -23,18 +23,18 @@
 
 namespace MT32Emu {
 
+class StateReader;
+class StateWriter;
+
 /**
  * Used to safely store timestamped MIDI events in a local queue.
+ * The SysEx data (if any) resides in the storage owned by the queue, it remains valid until the event is dropped.
  */
 struct MidiEvent {
 	Bit32u shortMessageData;
 	const Bit8u *sysexData;
 	Bit32u sysexLength;
 	Bit32u timestamp;
-
-	~MidiEvent();
-	void setShortMessage(Bit32u shortMessageData, Bit32u timestamp);
-	void setSysex(const Bit8u *sysexData, Bit32u sysexLength, Bit32u timestamp);
 };
 
 /**
@@ -43,19 +43,46 @@ struct MidiEvent {
  * - get rid of prerenderer while retaining graceful partial abortion
  * - add fair emulation of the MIDI interface delays
  * - extend the synth interface with the default implementation of a typical rendering loop.
+ * SysEx data is copied to a preallocated ring of bytes, so neither pushing nor dropping events involves memory allocation.
  * THREAD SAFETY:
- * It is safe to use either in a single thread environment or when there are only two threads - one performs only reading
- * and one performs only writing. More complicated usage requires external synchronisation.
+ * Any number of threads may push events simultaneously with no external synchronisation, the queue is lock-free.
+ * Only one thread may peek and drop events at a time, though it needn't be synchronised with the pushing threads.
+ * Events are read in the order of their timestamps, events with equal timestamps in the order they were pushed.
+ * Pushing threads may store their events in a different order than they claimed positions in the queue, so the reader
+ * sorts the events once they are stored. An event stored after a later one has been read is read next.
+ * Construction, destruction and reset() must not run concurrently with any other method.
  */
 class MidiEventQueue {
 private:
-	MidiEvent * const ringBuffer;
+	struct Slot {
+		// Equals to the position in the queue + 1 once the event is ready to be read
+		volatile Bit32u sequenceNumber;
+		Bit32u sysexChunkPosition;
+		MidiEvent event;
+	};
+
+	Slot * const ringBuffer;
 	const Bit32u ringBufferMask;
-	volatile Bit32u startPosition;
 	volatile Bit32u endPosition;
+	Bit32u startPosition;
+	// The events between the start position and this one are stored and sorted by the timestamp
+	Bit32u sortedEndPosition;
+
+	Bit32u * const sysexStorage;
+	const Bit32u sysexStorageSize;
+	volatile Bit32u sysexEndPosition;
+	volatile Bit32u sysexStartPosition;
+
+	bool push(Bit32u shortMessageData, const Bit8u *sysexData, Bit32u sysexLength, Bit32u timestamp);
+	Bit8u *allocateSysexChunk(Bit32u sysexLength, Bit32u &chunkPosition);
+	void releaseSysexChunk(Bit32u chunkPosition);
+	void reclaimSysexStorage();
+	void sortStoredEvents();
 
 public:
-	MidiEventQueue(Bit32u ringBufferSize = DEFAULT_MIDI_EVENT_QUEUE_SIZE); // Must be a power of 2
+	// The ring buffer size must be a power of 2. The SysEx storage size is rounded up to a power of 2,
+	// 0 makes it proportional to the ring buffer size.
+	MidiEventQueue(Bit32u ringBufferSize = DEFAULT_MIDI_EVENT_QUEUE_SIZE, Bit32u sysexStorageSize = 0);
 	~MidiEventQueue();
 	void reset();
 	bool pushShortMessage(Bit32u shortMessageData, Bit32u timestamp);
@@ -63,6 +90,12 @@ public:
 	const MidiEvent *peekMidiEvent();
 	void dropMidiEvent();
 	bool isFull() const;
+	Bit32u getSize() const;
+	Bit32u getSysexStorageSize() const;
+	// Store the pending events and replace the contents of the queue with the events restored.
+	// Neither may run concurrently with the reading thread, loadState() may not run concurrently with any other method.
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 } // namespace MT32Emu
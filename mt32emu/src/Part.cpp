@@ -23,7 +23,9 @@
 #include "Part.h"
 #include "Partial.h"
 #include "PartialManager.h"
+#include "PatchCacheStore.h"
 #include "Poly.h"
+#include "StateStream.h"
 #include "Synth.h"
 
 namespace MT32Emu {
@@ -41,6 +43,7 @@ static const Bit8u PartialMixStruct[13] = {
 RhythmPart::RhythmPart(Synth *useSynth, unsigned int usePartNum): Part(useSynth, usePartNum) {
 	strcpy(name, "Rhythm");
 	rhythmTemp = &synth->mt32ram.rhythmTemp[0];
+	memset(drumCache, 0, sizeof(drumCache));
 	refresh();
 }
 
@@ -62,6 +65,7 @@ Part::Part(Synth *useSynth, unsigned int usePartNum) {
 	modulation = 0;
 	expression = 100;
 	pitchBend = 0;
+	nrpn = false;
 	activePartialCount = 0;
 	memset(patchCache, 0, sizeof(patchCache));
 }
@@ -242,6 +246,27 @@ void Part::backupCacheToPartials(PatchCache cache[4]) {
 
 void Part::cacheTimbre(PatchCache cache[4], const TimbreParam *timbre) {
 	backupCacheToPartials(cache);
+	const PatchCache *storedCache = synth->patchCacheStore->find(*timbre);
+	if (storedCache != NULL) {
+		// The reverb flags come from the patch or rhythm settings rather than the timbre, so they are kept
+		for (int t = 0; t < 4; t++) {
+			if (storedCache[t].playPartial) {
+				bool reverb = cache[t].reverb;
+				cache[t] = storedCache[t];
+				cache[t].reverb = reverb;
+				cache[t].partialParam = &timbre->partial[t];
+			} else {
+				cache[t].playPartial = false;
+			}
+			cache[t].dirty = false;
+			cache[t].partialCount = storedCache[t].partialCount;
+			cache[t].sustain = storedCache[t].sustain;
+		}
+#if MT32EMU_MONITOR_INSTRUMENTS > 0
+		synth->printDebug("%s (%s): Reused cached timbre", name, currentInstr);
+#endif
+		return;
+	}
 	int partialCount = 0;
 	for (int t = 0; t < 4; t++) {
 		if (((timbre->common.partialMute >> t) & 0x1) == 1) {
@@ -297,6 +322,7 @@ void Part::cacheTimbre(PatchCache cache[4], const TimbreParam *timbre) {
 		cache[t].sustain = (timbre->common.noSustain == 0);
 	}
 	//synth->printDebug("Res 1: %d 2: %d 3: %d 4: %d", cache[0].waveform, cache[1].waveform, cache[2].waveform, cache[3].waveform);
+	synth->patchCacheStore->store(*timbre, cache);
 
 #if MT32EMU_MONITOR_INSTRUMENTS > 0
 	synth->printDebug("%s (%s): Recached timbre", name, currentInstr);
@@ -310,6 +336,10 @@ const char *Part::getName() const {
 	return name;
 }
 
+unsigned int Part::getPartNum() const {
+	return partNum;
+}
+
 void Part::setVolume(unsigned int midiVolume) {
 	// CONFIRMED: This calculation matches the table used in the control ROM
 	patchTemp->outputLevel = (Bit8u)(midiVolume * 100 / 127);
@@ -464,11 +494,14 @@ void Part::playPoly(const PatchCache cache[4], const MemParams::RhythmTemp *rhyt
 
 	if ((patchTemp->patch.assignMode & 2) == 0) {
 		// Single-assign mode
-		abortFirstPoly(key);
+		if (abortFirstPoly(key)) {
+			synth->countPolyAbort(PolyAbortReason_SAME_KEY, partNum);
+		}
 		if (synth->isAbortingPoly()) return;
 	}
 
 	if (!synth->partialManager->freePartials(needPartials, partNum)) {
+		synth->polyphonyStatistics.partialAllocationFailures[partNum]++;
 #if MT32EMU_MONITOR_PARTIALS > 0
 		synth->printDebug("%s (%s): Insufficient free partials to play key %d (velocity %d); needed=%d, free=%d, assignMode=%d", name, currentInstr, midiKey, velocity, needPartials, synth->partialManager->getFreePartialCount(), patchTemp->patch.assignMode);
 		synth->printPartialUsage();
@@ -479,6 +512,7 @@ void Part::playPoly(const PatchCache cache[4], const MemParams::RhythmTemp *rhyt
 
 	Poly *poly = synth->partialManager->assignPolyToPart(this);
 	if (poly == NULL) {
+		synth->polyphonyStatistics.polyAllocationFailures[partNum]++;
 		synth->printDebug("%s (%s): No free poly to play key %d (velocity %d)", name, currentInstr, midiKey, velocity);
 		return;
 	}
@@ -601,6 +635,123 @@ void Part::partialDeactivated(Poly *poly) {
 	}
 }
 
+int Part::getActivePolyIndex(const Poly *poly) const {
+	int polyIndex = 0;
+	for (const Poly *activePoly = activePolys.getFirst(); activePoly != NULL; activePoly = activePoly->getNext()) {
+		if (activePoly == poly) return polyIndex;
+		polyIndex++;
+	}
+	return -1;
+}
+
+Poly *Part::getActivePoly(unsigned int index) const {
+	Poly *poly = activePolys.getFirst();
+	while (poly != NULL && index-- > 0) {
+		poly = poly->getNext();
+	}
+	return poly;
+}
+
+int Part::getPatchCacheIndex(const PatchCache *cache) const {
+	for (int t = 0; t < 4; t++) {
+		if (cache == &patchCache[t]) return t;
+	}
+	return -1;
+}
+
+const PatchCache *Part::getPatchCache(unsigned int index) const {
+	return index < 4 ? &patchCache[index] : NULL;
+}
+
+int RhythmPart::getPatchCacheIndex(const PatchCache *cache) const {
+	for (int drumNum = 0; drumNum < 85; drumNum++) {
+		for (int t = 0; t < 4; t++) {
+			if (cache == &drumCache[drumNum][t]) return (drumNum << 2) | t;
+		}
+	}
+	return -1;
+}
+
+const PatchCache *RhythmPart::getPatchCache(unsigned int index) const {
+	return index < 85 * 4 ? &drumCache[index >> 2][index & 3] : NULL;
+}
+
+void Part::saveState(StateWriter &writer) const {
+	writer.writeBool(holdpedal);
+	writer.writeBit32u(activePartialCount);
+	for (int t = 0; t < 4; t++) {
+		synth->savePatchCache(writer, patchCache[t]);
+	}
+	writer.writeBytes(currentInstr, sizeof(currentInstr));
+	writer.writeBit8u(modulation);
+	writer.writeBit8u(expression);
+	writer.writeBit32s(pitchBend);
+	writer.writeBool(nrpn);
+	writer.writeBit16u(rpn);
+	writer.writeBit16u(pitchBenderRange);
+	Bit32u polyCount = 0;
+	for (const Poly *poly = activePolys.getFirst(); poly != NULL; poly = poly->getNext()) {
+		polyCount++;
+	}
+	writer.writeBit32u(polyCount);
+	for (const Poly *poly = activePolys.getFirst(); poly != NULL; poly = poly->getNext()) {
+		poly->saveState(writer);
+	}
+}
+
+void Part::loadState(StateReader &reader) {
+	holdpedal = reader.readBool();
+	activePartialCount = reader.readBit32u();
+	for (int t = 0; t < 4; t++) {
+		synth->loadPatchCache(reader, patchCache[t]);
+	}
+	reader.readBytes(currentInstr, sizeof(currentInstr));
+	currentInstr[10] = 0;
+	modulation = reader.readBit8u();
+	expression = reader.readBit8u();
+	pitchBend = reader.readBit32s();
+	nrpn = reader.readBool();
+	rpn = reader.readBit16u();
+	pitchBenderRange = reader.readBit16u();
+	Bit32u polyCount = reader.readIndex(synth->getPartialCount() + 1);
+	while (polyCount-- > 0) {
+		Poly *poly = synth->partialManager->assignPolyToPart(this);
+		if (poly == NULL) {
+			reader.fail();
+			return;
+		}
+		poly->loadState(reader);
+		activePolys.append(poly);
+	}
+}
+
+void Part::discardActivePolys() {
+	while (!activePolys.isEmpty()) {
+		Poly *poly = activePolys.takeFirst();
+		poly->discard();
+		synth->partialManager->polyFreed(poly);
+	}
+	activePartialCount = 0;
+}
+
+void RhythmPart::saveState(StateWriter &writer) const {
+	Part::saveState(writer);
+	for (int drumNum = 0; drumNum < 85; drumNum++) {
+		for (int t = 0; t < 4; t++) {
+			synth->savePatchCache(writer, drumCache[drumNum][t]);
+		}
+	}
+}
+
+void RhythmPart::loadState(StateReader &reader) {
+	Part::loadState(reader);
+	for (int drumNum = 0; drumNum < 85; drumNum++) {
+		for (int t = 0; t < 4; t++) {
+			synth->loadPatchCache(reader, drumCache[drumNum][t]);
+		}
+	}
+}
+
 PolyList::PolyList() : firstPoly(NULL), lastPoly(NULL) {}
 
 bool PolyList::isEmpty() const {
@@ -26,6 +26,8 @@
 namespace MT32Emu {
 
 class Poly;
+class StateReader;
+class StateWriter;
 class Synth;
 
 class PolyList {
@@ -83,6 +85,8 @@ protected:
 	const char *getName() const;
 
 public:
+	// 0=Part 1, .. 7=Part 8, 8=Rhythm
+	unsigned int getPartNum() const;
 	Part(Synth *synth, unsigned int usePartNum);
 	virtual ~Part();
 	void reset();
@@ -128,6 +132,20 @@ public:
 	// Abort the first poly in PolyState_HELD, or if none exists, the first active poly in any state.
 	bool abortFirstPolyPreferHeld();
 	bool abortFirstPoly();
+
+	// Used to refer to the polys and the timbre caches of the part in the saved state.
+	// Returns -1 if the poly is not active within this part or the cache is not owned by this part.
+	int getActivePolyIndex(const Poly *poly) const;
+	Poly *getActivePoly(unsigned int index) const;
+	virtual int getPatchCacheIndex(const PatchCache *cache) const;
+	virtual const PatchCache *getPatchCache(unsigned int index) const;
+
+	// Store and restore the state of the part along with the active polys.
+	// The polys must all be freed before loading, the partials are restored separately.
+	virtual void saveState(StateWriter &writer) const;
+	virtual void loadState(StateReader &reader);
+	// Frees the polys disregarding the partials, used when the restored state appears inconsistent
+	void discardActivePolys();
 }; // class Part
 
 class RhythmPart: public Part {
@@ -146,6 +164,10 @@ public:
 	unsigned int getAbsTimbreNum() const;
 	void setPan(unsigned int midiPan);
 	void setProgram(unsigned int patchNum);
+	int getPatchCacheIndex(const PatchCache *cache) const;
+	const PatchCache *getPatchCache(unsigned int index) const;
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 };
 
 } // namespace MT32Emu
@@ -21,13 +21,19 @@
 
 #include "Partial.h"
 #include "Part.h"
+#include "PartialManager.h"
 #include "Poly.h"
+#include "StateStream.h"
 #include "Synth.h"
 #include "Tables.h"
 #include "TVA.h"
 #include "TVF.h"
 #include "TVP.h"
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace MT32Emu {
 
 static const Bit8u PAN_NUMERATOR_MASTER[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7};
@@ -35,8 +41,100 @@ static const Bit8u PAN_NUMERATOR_SLAVE[]  = {0, 1, 2, 3, 4, 5, 6, 7, 7, 7, 7, 7,
 
 static const Bit32s PAN_FACTORS[] = {0, 18, 37, 55, 73, 91, 110, 128, 146, 165, 183, 201, 219, 238, 256};
 
+#if !MT32EMU_USE_FLOAT_SAMPLES
+// Applies the pan value to the samples and mixes the result into the buffer, see the notes in Partial::produceOutput()
+static void mixPannedSamplesGeneric(Sample *buffer, const Bit16s *samples, const Bit32s panValue, const Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		Sample out = Sample((samples[i] * panValue) >> 8);
+		buffer[i] = Synth::clipSampleEx((SampleEx)buffer[i] + (SampleEx)out);
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+// The pan value never exceeds 256 in magnitude. The middle 16 bits of the 32-bit products are composed of the halves
+// computed separately, so the result is exactly the same as the one of the 32-bit multiplication and the arithmetic shift.
+// The saturating addition is equivalent to Synth::clipSampleEx() of the sum.
+MT32EMU_X86_TARGET("sse2")
+static void mixPannedSamplesSSE2(Sample *buffer, const Bit16s *samples, const Bit32s panValue, const Bit32u length) {
+	const __m128i pan = _mm_set1_epi16(Bit16s(panValue));
+	Bit32u i = 0;
+	for (; i + 8 <= length; i += 8) {
+		__m128i sample = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+		__m128i productHigh = _mm_mulhi_epi16(sample, pan);
+		__m128i productLow = _mm_mullo_epi16(sample, pan);
+		__m128i out = _mm_or_si128(_mm_slli_epi16(productHigh, 8), _mm_srli_epi16(productLow, 8));
+		__m128i *mixBuffer = reinterpret_cast<__m128i *>(buffer + i);
+		_mm_storeu_si128(mixBuffer, _mm_adds_epi16(_mm_loadu_si128(mixBuffer), out));
+	}
+	mixPannedSamplesGeneric(buffer + i, samples + i, panValue, length - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void mixPannedSamplesAVX2(Sample *buffer, const Bit16s *samples, const Bit32s panValue, const Bit32u length) {
+	const __m256i pan = _mm256_set1_epi16(Bit16s(panValue));
+	Bit32u i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m256i sample = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + i));
+		__m256i productHigh = _mm256_mulhi_epi16(sample, pan);
+		__m256i productLow = _mm256_mullo_epi16(sample, pan);
+		__m256i out = _mm256_or_si256(_mm256_slli_epi16(productHigh, 8), _mm256_srli_epi16(productLow, 8));
+		__m256i *mixBuffer = reinterpret_cast<__m256i *>(buffer + i);
+		_mm256_storeu_si256(mixBuffer, _mm256_adds_epi16(_mm256_loadu_si256(mixBuffer), out));
+	}
+	mixPannedSamplesSSE2(buffer + i, samples + i, panValue, length - i);
+}
+#endif
+#else
+// Applies the pan value to the samples and mixes the result into the buffer, see the notes in Partial::produceOutput()
+static void mixPannedSamplesGeneric(Sample *buffer, const float *samples, const Bit32s panValue, const Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		buffer[i] += (samples[i] * (float)panValue) / 14.0f;
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+MT32EMU_X86_TARGET("sse2")
+static void mixPannedSamplesSSE2(Sample *buffer, const float *samples, const Bit32s panValue, const Bit32u length) {
+	const __m128 pan = _mm_set1_ps((float)panValue);
+	const __m128 divisor = _mm_set1_ps(14.0f);
+	Bit32u i = 0;
+	for (; i + 4 <= length; i += 4) {
+		__m128 out = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(samples + i), pan), divisor);
+		_mm_storeu_ps(buffer + i, _mm_add_ps(_mm_loadu_ps(buffer + i), out));
+	}
+	mixPannedSamplesGeneric(buffer + i, samples + i, panValue, length - i);
+}
+
+MT32EMU_X86_TARGET("avx")
+static void mixPannedSamplesAVX(Sample *buffer, const float *samples, const Bit32s panValue, const Bit32u length) {
+	const __m256 pan = _mm256_set1_ps((float)panValue);
+	const __m256 divisor = _mm256_set1_ps(14.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= length; i += 8) {
+		__m256 out = _mm256_div_ps(_mm256_mul_ps(_mm256_loadu_ps(samples + i), pan), divisor);
+		_mm256_storeu_ps(buffer + i, _mm256_add_ps(_mm256_loadu_ps(buffer + i), out));
+	}
+	mixPannedSamplesSSE2(buffer + i, samples + i, panValue, length - i);
+}
+#endif
+#endif
+
+static MixPannedSamplesKernel selectMixPannedSamplesKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
+#if MT32EMU_USE_FLOAT_SAMPLES
+	if (simdLevel >= SIMDLevel_AVX) return mixPannedSamplesAVX;
+#else
+	if (simdLevel >= SIMDLevel_AVX2) return mixPannedSamplesAVX2;
+#endif
+	if (simdLevel >= SIMDLevel_SSE2) return mixPannedSamplesSSE2;
+#else
+	(void)simdLevel;
+#endif
+	return mixPannedSamplesGeneric;
+}
+
 Partial::Partial(Synth *useSynth, int useDebugPartialNum) :
-	synth(useSynth), debugPartialNum(useDebugPartialNum), sampleNum(0) {
+	synth(useSynth), debugPartialNum(useDebugPartialNum), sampleNum(0), mixPannedSamplesKernel(selectMixPannedSamplesKernel(useSynth->simdLevel)) {
 	// Initialisation of tva, tvp and tvf uses 'this' pointer
 	// and thus should not be in the initializer list to avoid a compiler warning
 	tva = new TVA(this, &ampRamp);
@@ -45,6 +143,13 @@ Partial::Partial(Synth *useSynth, int useDebugPartialNum) :
 	ownerPart = -1;
 	poly = NULL;
 	pair = NULL;
+	deactivationDeferred = false;
+	deactivationPending = false;
+	// The own LA32 pair remains unused by slave partials, yet it is stored in the state snapshots
+	la32Pair.selectKernels(synth->simdLevel);
+	la32Pair.init(false, false);
+	la32Pair.deactivate(LA32PartialPair::MASTER);
+	la32Pair.deactivate(LA32PartialPair::SLAVE);
 }
 
 Partial::~Partial() {
@@ -85,14 +190,20 @@ void Partial::deactivate() {
 		return;
 	}
 	ownerPart = -1;
-	if (poly != NULL) {
-		poly->partialDeactivated(this);
+	if (deactivationDeferred) {
+		deactivationPending = true;
+	} else {
+		synth->partialManager->partialDeactivated(debugPartialNum);
+		if (poly != NULL) {
+			poly->partialDeactivated(this);
+		}
 	}
 #if MT32EMU_MONITOR_PARTIALS > 2
 	synth->printDebug("[+%lu] [Partial %d] Deactivated", sampleNum, debugPartialNum);
 	synth->printPartialUsage(sampleNum);
 #endif
-	if (isRingModulatingSlave()) {
+	bool ringModulatingSlave = isRingModulatingSlave();
+	if (ringModulatingSlave) {
 		pair->la32Pair.deactivate(LA32PartialPair::SLAVE);
 	} else {
 		la32Pair.deactivate(LA32PartialPair::MASTER);
@@ -101,11 +212,30 @@ void Partial::deactivate() {
 			pair = NULL;
 		}
 	}
-	if (pair != NULL) {
+	// Unless ring modulated, the pair partial may be rendered by another thread meanwhile, so it's unlinked afterwards
+	if (pair != NULL && (ringModulatingSlave || !deactivationDeferred)) {
 		pair->pair = NULL;
 	}
 }
 
+void Partial::deferDeactivation() {
+	deactivationDeferred = true;
+}
+
+void Partial::completeDeferredDeactivation() {
+	deactivationDeferred = false;
+	if (deactivationPending) {
+		deactivationPending = false;
+		if (pair != NULL) {
+			pair->pair = NULL;
+		}
+		synth->partialManager->partialDeactivated(debugPartialNum);
+		if (poly != NULL) {
+			poly->partialDeactivated(this);
+		}
+	}
+}
+
 void Partial::startPartial(const Part *part, Poly *usePoly, const PatchCache *usePatchCache, const MemParams::RhythmTemp *rhythmTemp, Partial *pairPartial) {
 	if (usePoly == NULL || usePatchCache == NULL) {
 		synth->printDebug("[Partial %d] *** Error: Starting partial for owner %d, usePoly=%s, usePatchCache=%s", debugPartialNum, ownerPart, usePoly == NULL ? "*** NULL ***" : "OK", usePatchCache == NULL ? "*** NULL ***" : "OK");
@@ -199,7 +329,11 @@ void Partial::startPartial(const Part *part, Poly *usePoly, const PatchCache *us
 		useLA32Pair = &la32Pair;
 	}
 	if (isPCM()) {
+#if MT32EMU_USE_FLOAT_SAMPLES
 		useLA32Pair->initPCM(pairType, &synth->pcmROMData[pcmWave->addr], pcmWave->len, pcmWave->loop);
+#else
+		useLA32Pair->initPCM(pairType, &synth->getPCMROMLogData()[pcmWave->addr], pcmWave->len, pcmWave->loop);
+#endif
 	} else {
 		useLA32Pair->initSynth(pairType, (patchCache->waveform & 1) != 0, pulseWidthVal, patchCache->srcPartial.tvf.resonance + 1);
 	}
@@ -237,6 +371,69 @@ Bit32u Partial::getCutoffValue() {
 	return (tvf->getBaseCutoff() << 18) + cutoffModifierRampVal;
 }
 
+// Returns the number of samples before the next envelope event, that is a ramp interrupt or TVP processing.
+// Until then, TVA, TVF and TVP state stays intact, so the envelopes can be stepped in bulk by generateEnvelopeSamples().
+Bit32u Partial::getEnvelopeSamplesBeforeEvent() const {
+	Bit32u length = tvp->getSamplesBeforeProcessing();
+	Bit32u ampLength = ampRamp.getSamplesBeforeInterrupt();
+	if (ampLength < length) {
+		length = ampLength;
+	}
+	if (!isPCM()) {
+		Bit32u cutoffLength = cutoffModifierRamp.getSamplesBeforeInterrupt();
+		if (cutoffLength < length) {
+			length = cutoffLength;
+		}
+	}
+	return length;
+}
+
+// Equivalent to length iterations of getCutoffValue(), tvp->nextPitch() and getAmpValue() when no envelope event occurs meanwhile.
+void Partial::generateEnvelopeSamples(Bit32u *amps, Bit16u *pitches, Bit32u *cutoffs, Bit32u length) {
+	if (isPCM()) {
+		for (Bit32u i = 0; i < length; i++) {
+			cutoffs[i] = 0;
+		}
+	} else {
+		cutoffModifierRamp.nextValues(cutoffs, length);
+		Bit32u baseCutoff = tvf->getBaseCutoff() << 18;
+		for (Bit32u i = 0; i < length; i++) {
+			cutoffs[i] += baseCutoff;
+		}
+	}
+	tvp->nextPitches(pitches, length);
+	ampRamp.nextValues(amps, length);
+	for (Bit32u i = 0; i < length; i++) {
+		amps[i] = 67117056 - amps[i];
+	}
+}
+
+// Steps the envelopes for up to maxLength samples and stores the parameters for the WG engine, advancing sampleNum.
+// The envelopes are stepped in the same order and until the TVA stops playing, exactly as the per-sample loop does.
+// Between envelope events, the envelopes are stepped in bulk. Each event is then handled by stepping a single sample.
+// Returns the number of samples stepped.
+Bit32u Partial::generateEnvelopeBlock(Bit32u *amps, Bit16u *pitches, Bit32u *cutoffs, Bit32u maxLength) {
+	Bit32u length = 0;
+	do {
+		Bit32u bulkLength = getEnvelopeSamplesBeforeEvent();
+		if (bulkLength > maxLength - length) {
+			bulkLength = maxLength - length;
+		}
+		if (bulkLength > 0) {
+			generateEnvelopeSamples(amps + length, pitches + length, cutoffs + length, bulkLength);
+			length += bulkLength;
+			sampleNum += bulkLength;
+			continue;
+		}
+		cutoffs[length] = getCutoffValue();
+		pitches[length] = tvp->nextPitch();
+		amps[length] = getAmpValue();
+		length++;
+		sampleNum++;
+	} while (length < maxLength && tva->isPlaying());
+	return length;
+}
+
 bool Partial::hasRingModulatingSlave() const {
 	return pair != NULL && structurePosition == 0 && (mixType == 1 || mixType == 2);
 }
@@ -245,6 +442,10 @@ bool Partial::isRingModulatingSlave() const {
 	return pair != NULL && structurePosition == 1 && (mixType == 1 || mixType == 2);
 }
 
+Partial *Partial::getRingModulatingSlave() const {
+	return hasRingModulatingSlave() ? pair : NULL;
+}
+
 bool Partial::isPCM() const {
 	return pcmWave != NULL;
 }
@@ -271,30 +472,35 @@ void Partial::backupCache(const PatchCache &cache) {
 	}
 }
 
-bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long length) {
-	if (!isActive() || alreadyOutputed || isRingModulatingSlave()) {
-		return false;
-	}
-	if (poly == NULL) {
-		synth->printDebug("[Partial %d] *** ERROR: poly is NULL at Partial::produceOutput()!", debugPartialNum);
-		return false;
-	}
-	alreadyOutputed = true;
-
-	for (sampleNum = 0; sampleNum < length; sampleNum++) {
+#if !MT32EMU_USE_FLOAT_SAMPLES
+// Per-sample rendering loop specialised for the structure of the pair, so that the loop body doesn't branch on it.
+// RING_MODULATED is set while the partial has a ring modulating slave, MIXED tells whether the output of the master
+// is mixed with the output of the ring modulator. Returns early with sampleNum < length if the partial is deactivated
+// or, in the mixed case, once the slave finishes. From then on, the pair output comes from the master WG engine alone.
+template <bool RING_MODULATED, bool MIXED>
+void Partial::producePairOutput(Sample *&leftBuf, Sample *&rightBuf, unsigned long length) {
+	while (sampleNum < length) {
 		if (!tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::MASTER)) {
 			deactivate();
-			break;
+			return;
 		}
-		la32Pair.generateNextSample(LA32PartialPair::MASTER, getAmpValue(), tvp->nextPitch(), getCutoffValue());
-		if (hasRingModulatingSlave()) {
-			la32Pair.generateNextSample(LA32PartialPair::SLAVE, pair->getAmpValue(), pair->tvp->nextPitch(), pair->getCutoffValue());
+		// NOTE: TVP affects the TVA sustain level, so the envelopes are stepped in a fixed order (the one GCC and MSVC
+		// happened to use when these calls were arguments of generateNextSample()). produceMasterOutput() relies on it as well.
+		Bit32u cutoff = getCutoffValue();
+		Bit16u pitch = tvp->nextPitch();
+		la32Pair.generateNextSample(LA32PartialPair::MASTER, getAmpValue(), pitch, cutoff);
+		bool slaveFinished = false;
+		if (RING_MODULATED) {
+			cutoff = pair->getCutoffValue();
+			pitch = pair->tvp->nextPitch();
+			la32Pair.generateNextSample(LA32PartialPair::SLAVE, pair->getAmpValue(), pitch, cutoff);
 			if (!pair->tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::SLAVE)) {
 				pair->deactivate();
-				if (mixType == 2) {
+				if (!MIXED) {
 					deactivate();
-					break;
+					return;
 				}
+				slaveFinished = true;
 			}
 		}
 
@@ -303,12 +509,6 @@ bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long len
 		Sample sample = la32Pair.nextOutSample();
 
 		// FIXME: Sample analysis suggests that the use of panVal is linear, but there are some quirks that still need to be resolved.
-#if MT32EMU_USE_FLOAT_SAMPLES
-		Sample leftOut = (sample * (float)leftPanValue) / 14.0f;
-		Sample rightOut = (sample * (float)rightPanValue) / 14.0f;
-		*(leftBuf++) += leftOut;
-		*(rightBuf++) += rightOut;
-#else
 		// FIXME: Dividing by 7 (or by 14 in a Mok-friendly way) looks of course pointless. Need clarification.
 		// FIXME2: LA32 may produce distorted sound in case if the absolute value of maximal amplitude of the input exceeds 8191
 		// when the panning value is non-zero. Most probably the distortion occurs in the same way it does with ring modulation,
@@ -322,12 +522,141 @@ bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long len
 		*rightBuf = Synth::clipSampleEx((SampleEx)*rightBuf + (SampleEx)rightOut);
 		leftBuf++;
 		rightBuf++;
+		sampleNum++;
+		if (slaveFinished) {
+			return;
+		}
+	}
+}
+#else
+// Block-based equivalent of the per-sample loop for partials with a ring modulating slave. MIXED tells whether the output
+// of the master is mixed with the output of the ring modulator. The envelopes of the master and the slave don't affect each other,
+// so the slave is stepped through the block first, and the block of the master is cut short at the sample where the slave finishes.
+// Returns early with sampleNum < length if the partial is deactivated or, in the mixed case, once the slave finishes.
+template <bool MIXED>
+void Partial::produceRingModulatedOutput(Sample *&leftBuf, Sample *&rightBuf, unsigned long length) {
+	Bit32u amps[LA32_MAX_BLOCK_LENGTH];
+	Bit16u pitches[LA32_MAX_BLOCK_LENGTH];
+	Bit32u cutoffs[LA32_MAX_BLOCK_LENGTH];
+	float masterSamples[LA32_MAX_BLOCK_LENGTH];
+	float slaveSamples[LA32_MAX_BLOCK_LENGTH];
+
+	while (sampleNum < length) {
+		if (!tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::MASTER)) {
+			deactivate();
+			return;
+		}
+		Bit32u maxBlockLength = (length - sampleNum) < LA32_MAX_BLOCK_LENGTH ? Bit32u(length - sampleNum) : LA32_MAX_BLOCK_LENGTH;
+
+		pair->sampleNum = sampleNum;
+		Bit32u slaveLength = pair->generateEnvelopeBlock(amps, pitches, cutoffs, maxBlockLength);
+		pair->sampleNum = 0;
+		Bit32u slaveGeneratedLength = la32Pair.generateNextSamples(LA32PartialPair::SLAVE, slaveSamples, amps, pitches, cutoffs, slaveLength);
+		if (slaveGeneratedLength == 0) {
+			// The slave WG engine was inactive already, that is noticed after the first sample
+			slaveSamples[0] = 0.0f;
+			slaveGeneratedLength = 1;
+		}
+		// Unless the slave finishes, it is stepped through the whole block. Otherwise, it finishes at the last generated sample.
+		bool slaveFinished = !pair->tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::SLAVE);
+		Bit32u blockLength = slaveFinished ? slaveGeneratedLength : maxBlockLength;
+
+		unsigned long blockStart = sampleNum;
+		Bit32u masterLength = generateEnvelopeBlock(amps, pitches, cutoffs, blockLength);
+		Bit32u outputLength = la32Pair.generateNextSamples(LA32PartialPair::MASTER, masterSamples, amps, pitches, cutoffs, masterLength);
+		sampleNum = blockStart;
+
+		// The slave finishing only counts if the master lasts until then
+		slaveFinished = slaveFinished && outputLength == blockLength;
+		if (slaveFinished) {
+			pair->deactivate();
+			if (MIXED) {
+				slaveSamples[outputLength - 1] = 0.0f;
+			} else {
+				// The last sample isn't output, the master is deactivated along with the slave
+				outputLength--;
+			}
+		}
+
+		la32Pair.produceOutputSamples(masterSamples, masterSamples, slaveSamples, outputLength);
+		mixPannedSamplesKernel(leftBuf, masterSamples, leftPanValue, outputLength);
+		mixPannedSamplesKernel(rightBuf, masterSamples, rightPanValue, outputLength);
+		leftBuf += outputLength;
+		rightBuf += outputLength;
+		sampleNum += outputLength;
+
+		if (slaveFinished) {
+			if (!MIXED) {
+				deactivate();
+			}
+			return;
+		}
+	}
+}
+#endif
+
+bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long length) {
+	if (!isActive() || alreadyOutputed || isRingModulatingSlave()) {
+		return false;
+	}
+	if (poly == NULL) {
+		synth->printDebug("[Partial %d] *** ERROR: poly is NULL at Partial::produceOutput()!", debugPartialNum);
+		return false;
+	}
+	alreadyOutputed = true;
+
+	// The structure of the pair can only change when the slave finishes, so the rendering loop is chosen once per run.
+	sampleNum = 0;
+	if (hasRingModulatingSlave()) {
+#if MT32EMU_USE_FLOAT_SAMPLES
+		if (mixType == 1) {
+			produceRingModulatedOutput<true>(leftBuf, rightBuf, length);
+		} else {
+			produceRingModulatedOutput<false>(leftBuf, rightBuf, length);
+		}
+#else
+		if (mixType == 1) {
+			producePairOutput<true, true>(leftBuf, rightBuf, length);
+		} else {
+			producePairOutput<true, false>(leftBuf, rightBuf, length);
+		}
 #endif
 	}
+	if (sampleNum < length && isActive()) {
+		produceMasterOutput(leftBuf, rightBuf, length);
+	}
 	sampleNum = 0;
 	return true;
 }
 
+// Block-based equivalent of the per-sample loop in produceOutput() for partials without a ring modulating slave.
+// In this case, the slave WG engine is inactive and the pair output is the output of the master WG engine alone.
+// Rendering continues from sampleNum, the buffers point to the corresponding sample.
+void Partial::produceMasterOutput(Sample *leftBuf, Sample *rightBuf, unsigned long length) {
+	Bit32u amps[LA32_MAX_BLOCK_LENGTH];
+	Bit16u pitches[LA32_MAX_BLOCK_LENGTH];
+	Bit32u cutoffs[LA32_MAX_BLOCK_LENGTH];
+	Sample samples[LA32_MAX_BLOCK_LENGTH];
+
+	while (sampleNum < length) {
+		if (!tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::MASTER)) {
+			deactivate();
+			break;
+		}
+		unsigned long blockStart = sampleNum;
+		Bit32u maxBlockLength = (length - sampleNum) < LA32_MAX_BLOCK_LENGTH ? Bit32u(length - sampleNum) : LA32_MAX_BLOCK_LENGTH;
+		// If the WG engine deactivates in the middle of the block, the envelopes end up stepped further than needed.
+		// That is of no consequence since the partial is deactivated right after.
+		Bit32u blockLength = generateEnvelopeBlock(amps, pitches, cutoffs, maxBlockLength);
+		Bit32u generatedLength = la32Pair.generateNextMasterSamples(samples, amps, pitches, cutoffs, blockLength);
+		mixPannedSamplesKernel(leftBuf, samples, leftPanValue, generatedLength);
+		mixPannedSamplesKernel(rightBuf, samples, rightPanValue, generatedLength);
+		leftBuf += generatedLength;
+		rightBuf += generatedLength;
+		sampleNum = blockStart + generatedLength;
+	}
+}
+
 bool Partial::shouldReverb() {
 	if (!isActive()) {
 		return false;
@@ -346,4 +675,96 @@ void Partial::startDecayAll() {
 	tvf->startDecay();
 }
 
+void Partial::saveState(StateWriter &writer) const {
+	writer.writeBit8u(Bit8u(ownerPart));
+	if (!isActive()) return;
+	writer.writeBit32s(leftPanValue);
+	writer.writeBit32s(rightPanValue);
+	writer.writeBit32s(mixType);
+	writer.writeBit32s(structurePosition);
+	writer.writeBool(isPCM());
+	if (isPCM()) writer.writeBit32s(pcmNum);
+	writer.writeBit32s(pulseWidthVal);
+	synth->savePolyPointer(writer, poly);
+	writer.writeBit32s(pair == NULL ? -1 : pair->debugPartialNum);
+	writer.writeBool(alreadyOutputed);
+	tva->saveState(writer);
+	tvp->saveState(writer);
+	tvf->saveState(writer);
+	ampRamp.saveState(writer);
+	cutoffModifierRamp.saveState(writer);
+#if MT32EMU_USE_FLOAT_SAMPLES
+	la32Pair.saveState(writer, synth->pcmROMData, Bit32u(synth->pcmROMSize));
+#else
+	la32Pair.saveState(writer, synth->getPCMROMLogData(), Bit32u(synth->pcmROMSize));
+#endif
+	// The cache is mostly owned by the part, otherwise it's a backup copy
+	int patchCacheIndex = synth->parts[ownerPart]->getPatchCacheIndex(patchCache);
+	writer.writeBit32s(patchCacheIndex);
+	if (patchCacheIndex < 0) synth->savePatchCache(writer, *patchCache);
+}
+
+void Partial::loadState(StateReader &reader) {
+	deactivationDeferred = false;
+	deactivationPending = false;
+	poly = NULL;
+	pair = NULL;
+	ownerPart = reader.readBit8u();
+	if (ownerPart == 0xFF) {
+		ownerPart = -1;
+		return;
+	}
+	if (ownerPart > 8) {
+		reader.fail();
+		ownerPart = -1;
+		return;
+	}
+	leftPanValue = reader.readBit32s();
+	rightPanValue = reader.readBit32s();
+	mixType = reader.readBit32s();
+	structurePosition = reader.readBit32s();
+	if (reader.readBool()) {
+		pcmNum = reader.readIndex(synth->controlROMMap->pcmCount);
+		pcmWave = &synth->pcmWaves[pcmNum];
+	} else {
+		pcmWave = NULL;
+	}
+	pulseWidthVal = reader.readBit32s();
+	poly = synth->loadPolyPointer(reader);
+	if (poly == NULL) reader.fail();
+	Bit32s pairNum = reader.readBit32s();
+	pair = pairNum < 0 ? NULL : synth->partialManager->getPartial(pairNum);
+	if (pairNum >= 0 && pair == NULL) reader.fail();
+	alreadyOutputed = reader.readBool();
+	tva->loadState(reader);
+	tvp->loadState(reader);
+	tvf->loadState(reader);
+	ampRamp.loadState(reader);
+	cutoffModifierRamp.loadState(reader);
+#if MT32EMU_USE_FLOAT_SAMPLES
+	la32Pair.loadState(reader, synth->pcmROMData, Bit32u(synth->pcmROMSize));
+#else
+	la32Pair.loadState(reader, synth->getPCMROMLogData(), Bit32u(synth->pcmROMSize));
+#endif
+	Bit32s patchCacheIndex = reader.readBit32s();
+	if (patchCacheIndex < 0) {
+		synth->loadPatchCache(reader, cachebackup);
+		patchCache = &cachebackup;
+	} else {
+		patchCache = synth->parts[ownerPart]->getPatchCache(patchCacheIndex);
+		if (patchCache == NULL) {
+			reader.fail();
+			patchCache = &cachebackup;
+		}
+	}
+}
+
+void Partial::discard() {
+	ownerPart = -1;
+	poly = NULL;
+	pair = NULL;
+	la32Pair.deactivate(LA32PartialPair::MASTER);
+	la32Pair.deactivate(LA32PartialPair::SLAVE);
+}
+
 } // namespace MT32Emu
@@ -29,12 +29,17 @@ namespace MT32Emu {
 
 class Part;
 class Poly;
+class StateReader;
+class StateWriter;
 class Synth;
 class TVA;
 class TVF;
 class TVP;
 struct ControlROMPCMStruct;
 
+// Applies the pan value to the samples produced by the LA32 pair and mixes the result into the buffer
+typedef void (*MixPannedSamplesKernel)(Sample *buffer, const Sample *samples, const Bit32s panValue, const Bit32u length);
+
 // A partial represents one of up to four waveform generators currently playing within a poly.
 class Partial {
 private:
@@ -64,6 +69,10 @@ private:
 	Poly *poly;
 	Partial *pair;
 
+	// When set, the poly is only notified about deactivation in completeDeferredDeactivation()
+	bool deactivationDeferred;
+	bool deactivationPending;
+
 	TVA *tva;
 	TVP *tvp;
 	TVF *tvf;
@@ -73,12 +82,24 @@ private:
 
 	// TODO: This should be owned by PartialPair
 	LA32PartialPair la32Pair;
+	const MixPannedSamplesKernel mixPannedSamplesKernel;
 
 	const PatchCache *patchCache;
 	PatchCache cachebackup;
 
 	Bit32u getAmpValue();
 	Bit32u getCutoffValue();
+	Bit32u getEnvelopeSamplesBeforeEvent() const;
+	void generateEnvelopeSamples(Bit32u *amps, Bit16u *pitches, Bit32u *cutoffs, Bit32u length);
+	Bit32u generateEnvelopeBlock(Bit32u *amps, Bit16u *pitches, Bit32u *cutoffs, Bit32u maxLength);
+#if MT32EMU_USE_FLOAT_SAMPLES
+	template <bool MIXED>
+	void produceRingModulatedOutput(Sample *&leftBuf, Sample *&rightBuf, unsigned long length);
+#else
+	template <bool RING_MODULATED, bool MIXED>
+	void producePairOutput(Sample *&leftBuf, Sample *&rightBuf, unsigned long length);
+#endif
+	void produceMasterOutput(Sample *leftBuf, Sample *rightBuf, unsigned long length);
 
 public:
 	bool alreadyOutputed;
@@ -94,12 +115,17 @@ public:
 	bool isActive() const;
 	void activate(int part);
 	void deactivate(void);
+	// Used when rendering in worker threads. Delays notification of the poly when the partial deactivates
+	// (as that touches the shared state of the owner part) until completeDeferredDeactivation() is invoked.
+	void deferDeactivation();
+	void completeDeferredDeactivation();
 	void startPartial(const Part *part, Poly *usePoly, const PatchCache *useCache, const MemParams::RhythmTemp *rhythmTemp, Partial *pairPartial);
 	void startAbort();
 	void startDecayAll();
 	bool shouldReverb();
 	bool hasRingModulatingSlave() const;
 	bool isRingModulatingSlave() const;
+	Partial *getRingModulatingSlave() const;
 	bool isPCM() const;
 	const ControlROMPCMStruct *getControlROMPCMStruct() const;
 	Synth *getSynth() const;
@@ -111,6 +137,12 @@ public:
 	// This function (unlike the one below it) returns processed stereo samples
 	// made from combining this single partial with its pair, if it has one.
 	bool produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long length);
+
+	// Store and restore the state of the partial. When loading, the polys must be restored beforehand.
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
+	// Makes the partial inactive disregarding the poly, used when the restored state appears inconsistent
+	void discard();
 }; // class Partial
 
 } // namespace MT32Emu
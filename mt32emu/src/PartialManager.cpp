@@ -24,10 +24,24 @@
 #include "Part.h"
 #include "Partial.h"
 #include "Poly.h"
+#include "StateStream.h"
 #include "Synth.h"
 
 namespace MT32Emu {
 
+// Returns the index of the lowest bit set, the argument must be non-zero
+static inline unsigned int getLowestSetBitIndex(Bit32u bits) {
+	// Multiplication of the isolated lowest bit by a de Bruijn sequence yields a unique 5-bit value in the top bits
+	static const Bit8u DE_BRUIJN_BIT_INDICES[] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+	return DE_BRUIJN_BIT_INDICES[((bits & (~bits + 1)) * 0x077CB531U) >> 27];
+}
+
+static inline Bit32u getActivePartialFlagsLength(unsigned int partialCount) {
+	return (partialCount + 31) >> 5;
+}
+
 PartialManager::PartialManager(Synth *useSynth, Part **useParts) {
 	synth = useSynth;
 	parts = useParts;
@@ -38,6 +52,10 @@ PartialManager::PartialManager(Synth *useSynth, Part **useParts) {
 		partialTable[i] = new Partial(synth, i);
 		freePolys[i] = new Poly();
 	}
+	Bit32u activePartialFlagsLength = getActivePartialFlagsLength(synth->getPartialCount());
+	activePartialFlags = new Bit32u[activePartialFlagsLength];
+	memset(activePartialFlags, 0, activePartialFlagsLength * sizeof(Bit32u));
+	activePartialCount = 0;
 }
 
 PartialManager::~PartialManager(void) {
@@ -47,10 +65,12 @@ PartialManager::~PartialManager(void) {
 	}
 	delete[] partialTable;
 	delete[] freePolys;
+	delete[] activePartialFlags;
 }
 
 void PartialManager::clearAlreadyOutputed() {
-	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
+	// Inactive partials are skipped as the flag is reset anyway when a partial starts
+	for (unsigned int i = getNextActivePartialNum(0); i < synth->getPartialCount(); i = getNextActivePartialNum(i + 1)) {
 		partialTable[i]->alreadyOutputed = false;
 	}
 }
@@ -64,7 +84,7 @@ bool PartialManager::produceOutput(int i, Sample *leftBuf, Sample *rightBuf, Bit
 }
 
 void PartialManager::deactivateAll() {
-	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
+	for (unsigned int i = getNextActivePartialNum(0); i < synth->getPartialCount(); i = getNextActivePartialNum(i + 1)) {
 		partialTable[i]->deactivate();
 	}
 }
@@ -79,38 +99,38 @@ unsigned int PartialManager::setReserve(Bit8u *rset) {
 }
 
 Partial *PartialManager::allocPartial(int partNum) {
-	Partial *outPartial = NULL;
-
 	// Get the first inactive partial
-	for (unsigned int partialNum = 0; partialNum < synth->getPartialCount(); partialNum++) {
-		if (!partialTable[partialNum]->isActive()) {
-			outPartial = partialTable[partialNum];
-			break;
+	Bit32u activePartialFlagsLength = getActivePartialFlagsLength(synth->getPartialCount());
+	for (Bit32u flagsIndex = 0; flagsIndex < activePartialFlagsLength; flagsIndex++) {
+		Bit32u inactivePartialFlags = ~activePartialFlags[flagsIndex];
+		if (inactivePartialFlags == 0) continue;
+		unsigned int partialNum = (flagsIndex << 5) + getLowestSetBitIndex(inactivePartialFlags);
+		if (partialNum >= synth->getPartialCount()) break;
+		activePartialFlags[flagsIndex] |= 1U << (partialNum & 31);
+		activePartialCount++;
+		if (activePartialCount > synth->polyphonyStatistics.peakActivePartials) {
+			synth->polyphonyStatistics.peakActivePartials = activePartialCount;
 		}
-	}
-	if (outPartial != NULL) {
+		Partial *outPartial = partialTable[partialNum];
 		outPartial->activate(partNum);
+		return outPartial;
 	}
-	return outPartial;
+	return NULL;
 }
 
 unsigned int PartialManager::getFreePartialCount(void) {
-	int count = 0;
-	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
-		if (!partialTable[i]->isActive()) {
-			count++;
-		}
-	}
-	return count;
+	return synth->getPartialCount() - activePartialCount;
+}
+
+unsigned int PartialManager::getActivePartialCount() const {
+	return activePartialCount;
 }
 
 // This function is solely used to gather data for debug output at the moment.
 void PartialManager::getPerPartPartialUsage(unsigned int perPartPartialUsage[9]) {
 	memset(perPartPartialUsage, 0, 9 * sizeof(unsigned int));
-	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
-		if (partialTable[i]->isActive()) {
-			perPartPartialUsage[partialTable[i]->getOwnerPart()]++;
-		}
+	for (unsigned int i = getNextActivePartialNum(0); i < synth->getPartialCount(); i = getNextActivePartialNum(i + 1)) {
+		perPartPartialUsage[partialTable[i]->getOwnerPart()]++;
 	}
 }
 
@@ -129,6 +149,7 @@ bool PartialManager::abortFirstReleasingPolyWhereReserveExceeded(int minPart) {
 			// This part has exceeded its reserved partial count.
 			// If it has any releasing polys, kill its first one and we're done.
 			if (parts[usePartNum]->abortFirstPoly(POLY_Releasing)) {
+				synth->countPolyAbort(PolyAbortReason_RELEASING_OVER_RESERVE, usePartNum);
 				return true;
 			}
 		}
@@ -151,6 +172,7 @@ bool PartialManager::abortFirstPolyPreferHeldWhereReserveExceeded(int minPart) {
 			// This part has exceeded its reserved partial count.
 			// If it has any polys, kill its first (preferably held) one and we're done.
 			if (parts[usePartNum]->abortFirstPolyPreferHeld()) {
+				synth->countPolyAbort(PolyAbortReason_OVER_RESERVE, usePartNum);
 				return true;
 			}
 		}
@@ -246,6 +268,7 @@ bool PartialManager::freePartials(unsigned int needed, int partNum) {
 		if (!parts[partNum]->abortFirstPolyPreferHeld()) {
 			break;
 		}
+		synth->countPolyAbort(PolyAbortReason_SAME_PART, partNum);
 		if (synth->isAbortingPoly() || getFreePartialCount() >= needed) {
 			return true;
 		}
@@ -262,6 +285,63 @@ const Partial *PartialManager::getPartial(unsigned int partialNum) const {
 	return partialTable[partialNum];
 }
 
+Partial *PartialManager::getPartial(unsigned int partialNum) {
+	if (partialNum > synth->getPartialCount() - 1) {
+		return NULL;
+	}
+	return partialTable[partialNum];
+}
+
+unsigned int PartialManager::getNextActivePartialNum(unsigned int partialNum) const {
+	unsigned int partialCount = synth->getPartialCount();
+	while (partialNum < partialCount) {
+		Bit32u flags = activePartialFlags[partialNum >> 5] >> (partialNum & 31);
+		if (flags != 0) {
+			return partialNum + getLowestSetBitIndex(flags);
+		}
+		partialNum = (partialNum | 31) + 1;
+	}
+	return partialCount;
+}
+
+bool PartialManager::hasActivePartials() const {
+	return activePartialCount > 0;
+}
+
+// Invoked by the partial when deactivated, unless the deactivation is deferred until a threaded rendering run completes.
+void PartialManager::partialDeactivated(unsigned int partialNum) {
+	activePartialFlags[partialNum >> 5] &= ~(1U << (partialNum & 31));
+	activePartialCount--;
+}
+
+void PartialManager::saveState(StateWriter &writer) const {
+	writer.writeBytes(numReservedPartialsForPart, sizeof(numReservedPartialsForPart));
+	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
+		partialTable[i]->saveState(writer);
+	}
+}
+
+void PartialManager::loadState(StateReader &reader) {
+	reader.readBytes(numReservedPartialsForPart, sizeof(numReservedPartialsForPart));
+	memset(activePartialFlags, 0, getActivePartialFlagsLength(synth->getPartialCount()) * sizeof(Bit32u));
+	activePartialCount = 0;
+	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
+		partialTable[i]->loadState(reader);
+		if (partialTable[i]->isActive()) {
+			activePartialFlags[i >> 5] |= 1U << (i & 31);
+			activePartialCount++;
+		}
+	}
+}
+
+void PartialManager::discardPartials() {
+	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
+		partialTable[i]->discard();
+	}
+	memset(activePartialFlags, 0, getActivePartialFlagsLength(synth->getPartialCount()) * sizeof(Bit32u));
+	activePartialCount = 0;
+}
+
 Poly *PartialManager::assignPolyToPart(Part *part) {
 	if (firstFreePolyIndex < synth->getPartialCount()) {
 		Poly *poly = freePolys[firstFreePolyIndex];
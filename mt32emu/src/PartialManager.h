@@ -27,6 +27,8 @@ namespace MT32Emu {
 class Part;
 class Partial;
 class Poly;
+class StateReader;
+class StateWriter;
 class Synth;
 
 class PartialManager {
@@ -37,6 +39,9 @@ private:
 	Partial **partialTable;
 	Bit8u numReservedPartialsForPart[9];
 	Bit32u firstFreePolyIndex;
+	// Bit set of the active partials, bit (partialNum & 31) of item (partialNum >> 5) is set when the partial is active
+	Bit32u *activePartialFlags;
+	Bit32u activePartialCount;
 
 	bool abortFirstReleasingPolyWhereReserveExceeded(int minPart);
 	bool abortFirstPolyPreferHeldWhereReserveExceeded(int minPart);
@@ -46,6 +51,7 @@ public:
 	~PartialManager();
 	Partial *allocPartial(int partNum);
 	unsigned int getFreePartialCount(void);
+	unsigned int getActivePartialCount() const;
 	void getPerPartPartialUsage(unsigned int perPartPartialUsage[9]);
 	bool freePartials(unsigned int needed, int partNum);
 	unsigned int setReserve(Bit8u *rset);
@@ -54,8 +60,19 @@ public:
 	bool shouldReverb(int i);
 	void clearAlreadyOutputed();
 	const Partial *getPartial(unsigned int partialNum) const;
+	Partial *getPartial(unsigned int partialNum);
 	Poly *assignPolyToPart(Part *part);
 	void polyFreed(Poly *poly);
+	// Returns the number of the first active partial starting from partialNum, or the partial count if there are no more
+	unsigned int getNextActivePartialNum(unsigned int partialNum) const;
+	// Returns true if any partial is active
+	bool hasActivePartials() const;
+	void partialDeactivated(unsigned int partialNum);
+	// Store and restore the state of all the partials, the polys must be restored beforehand
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
+	// Makes all the partials inactive disregarding the polys, used when the restored state appears inconsistent
+	void discardPartials();
 }; // class PartialManager
 
 } // namespace MT32Emu
@@ -0,0 +1,86 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "internals.h"
+
+#include "PatchCacheStore.h"
+
+namespace MT32Emu {
+
+PatchCacheStore::PatchCacheStore(unsigned int useCapacity) :
+	entries(new Entry[useCapacity > 0 ? useCapacity : 1]),
+	capacity(useCapacity > 0 ? useCapacity : 1),
+	useCounter(0)
+{
+	for (unsigned int i = 0; i < capacity; i++) {
+		entries[i].lastUsed = 0;
+	}
+}
+
+PatchCacheStore::~PatchCacheStore() {
+	delete[] entries;
+}
+
+// FNV-1a
+Bit32u PatchCacheStore::calcHash(const TimbreParam &timbre) {
+	const Bit8u *data = reinterpret_cast<const Bit8u *>(&timbre);
+	Bit32u hash = 2166136261U;
+	for (size_t i = 0; i < sizeof(TimbreParam); i++) {
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+	return hash;
+}
+
+Bit32u PatchCacheStore::nextUse() {
+	if (++useCounter == 0) {
+		// The counter wrapped around, so restart the ordering rather than let the fresh entry look the oldest
+		for (unsigned int i = 0; i < capacity; i++) {
+			if (entries[i].lastUsed != 0) entries[i].lastUsed = 1;
+		}
+		useCounter = 2;
+	}
+	return useCounter;
+}
+
+const PatchCache *PatchCacheStore::find(const TimbreParam &timbre) {
+	Bit32u hash = calcHash(timbre);
+	for (unsigned int i = 0; i < capacity; i++) {
+		Entry &entry = entries[i];
+		if (entry.lastUsed != 0 && entry.hash == hash && memcmp(&entry.timbre, &timbre, sizeof(TimbreParam)) == 0) {
+			entry.lastUsed = nextUse();
+			return entry.cache;
+		}
+	}
+	return NULL;
+}
+
+void PatchCacheStore::store(const TimbreParam &timbre, const PatchCache cache[4]) {
+	Entry *victim = &entries[0];
+	for (unsigned int i = 1; i < capacity && victim->lastUsed != 0; i++) {
+		if (entries[i].lastUsed < victim->lastUsed) victim = &entries[i];
+	}
+	victim->hash = calcHash(timbre);
+	victim->lastUsed = nextUse();
+	victim->timbre = timbre;
+	for (int t = 0; t < 4; t++) {
+		victim->cache[t] = cache[t];
+	}
+}
+
+} // namespace MT32Emu
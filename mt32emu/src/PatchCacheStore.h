@@ -0,0 +1,63 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_PATCH_CACHE_STORE_H
+#define MT32EMU_PATCH_CACHE_STORE_H
+
+#include "globals.h"
+#include "Types.h"
+#include "Structures.h"
+
+namespace MT32Emu {
+
+/* Keeps the sets of PatchCache entries computed by Part::cacheTimbre() keyed by the content of the timbre,
+ * so that switching back to a timbre used recently doesn't need the cache to be rebuilt. The derived fields
+ * only depend on the timbre parameters, hence the entries never go stale and are shared by all the parts.
+ * The number of entries is bounded, the least recently used one is replaced when the store is full.
+ */
+class PatchCacheStore {
+public:
+	static const unsigned int DEFAULT_CAPACITY = 64;
+
+	PatchCacheStore(unsigned int useCapacity = DEFAULT_CAPACITY);
+	~PatchCacheStore();
+
+	// Returns the set stored for a timbre with the same parameters or NULL if there is none.
+	// The pointers to the partial params and the reverb flags in the set returned aren't meaningful.
+	const PatchCache *find(const TimbreParam &timbre);
+	// Stores the set computed for the timbre, replacing the least recently used set if the store is full.
+	void store(const TimbreParam &timbre, const PatchCache cache[4]);
+
+private:
+	struct Entry {
+		Bit32u hash;
+		Bit32u lastUsed; // Zero for unused entries
+		TimbreParam timbre;
+		PatchCache cache[4];
+	};
+
+	Entry * const entries;
+	const unsigned int capacity;
+	Bit32u useCounter;
+
+	static Bit32u calcHash(const TimbreParam &timbre);
+	Bit32u nextUse();
+}; // class PatchCacheStore
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_PATCH_CACHE_STORE_H
@@ -22,6 +22,8 @@
 #include "Poly.h"
 #include "Part.h"
 #include "Partial.h"
+#include "PartialManager.h"
+#include "StateStream.h"
 #include "Synth.h"
 
 namespace MT32Emu {
@@ -120,6 +122,9 @@ bool Poly::startAbort() {
 			part->getSynth()->abortingPoly = this;
 		}
 	}
+	if (part->getSynth()->abortingPoly == this) {
+		part->getSynth()->traceInstant("abortPoly", "part", part->getPartNum());
+	}
 	return true;
 }
 
@@ -174,6 +179,7 @@ void Poly::partialDeactivated(Partial *partial) {
 		state = POLY_Inactive;
 		if (part->getSynth()->abortingPoly == this) {
 			part->getSynth()->abortingPoly = NULL;
+			part->getSynth()->traceInstant("polyAborted", "part", part->getPartNum());
 		}
 	}
 	part->partialDeactivated(this);
@@ -187,4 +193,37 @@ void Poly::setNext(Poly *poly) {
 	next = poly;
 }
 
+void Poly::discard() {
+	activePartialCount = 0;
+	for (int i = 0; i < 4; i++) {
+		partials[i] = NULL;
+	}
+	state = POLY_Inactive;
+}
+
+void Poly::saveState(StateWriter &writer) const {
+	writer.writeBit32u(key);
+	writer.writeBit32u(velocity);
+	writer.writeBit32u(activePartialCount);
+	writer.writeBool(sustain);
+	writer.writeBit32u(state);
+	for (int i = 0; i < 4; i++) {
+		writer.writeBit32s(partials[i] == NULL ? -1 : partials[i]->debugGetPartialNum());
+	}
+}
+
+void Poly::loadState(StateReader &reader) {
+	PartialManager *partialManager = part->getSynth()->partialManager;
+	key = reader.readBit32u();
+	velocity = reader.readBit32u();
+	activePartialCount = reader.readIndex(5);
+	sustain = reader.readBool();
+	state = PolyState(reader.readIndex(POLY_Inactive));
+	for (int i = 0; i < 4; i++) {
+		Bit32s partialNum = reader.readBit32s();
+		partials[i] = partialNum < 0 ? NULL : partialManager->getPartial(partialNum);
+		if (partialNum >= 0 && partials[i] == NULL) reader.fail();
+	}
+}
+
 } // namespace MT32Emu
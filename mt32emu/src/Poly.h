@@ -25,6 +25,8 @@ namespace MT32Emu {
 
 class Part;
 class Partial;
+class StateReader;
+class StateWriter;
 struct PatchCache;
 
 class Poly {
@@ -63,6 +65,12 @@ public:
 
 	Poly *getNext() const;
 	void setNext(Poly *poly);
+
+	// Store and restore the state of the poly assigned to a part, the partials are referred to by their numbers
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
+	// Makes the poly inactive disregarding the partials, used when the restored state appears inconsistent
+	void discard();
 }; // class Poly
 
 } // namespace MT32Emu
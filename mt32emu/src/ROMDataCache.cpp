@@ -0,0 +1,404 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "internals.h"
+
+#include "ROMDataCache.h"
+#include "Atomics.h"
+#include "File.h"
+#include "LA32WaveGenerator.h"
+#include "ROMInfo.h"
+#include "StateStream.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define MT32EMU_MAPPED_FILES 1
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MT32EMU_MAPPED_FILES 1
+#else
+#define MT32EMU_MAPPED_FILES 0
+#endif
+
+namespace MT32Emu {
+
+struct CacheEntry {
+	File::SHA1Digest sha1Digest;
+	ROMInfo::Type type;
+	const void *data;
+	Bit32u refCount;
+	CacheEntry *next;
+	// PCM ROM samples converted to the log-space on the first request, NULL until then, for control ROMs
+	// and when rendering float samples
+	const Bit32u *logData;
+	// Number of 16-bit samples in the PCM ROM data, 0 for control ROMs
+	size_t sampleCount;
+	// Non-NULL when the data resides in a mapped cache file
+	const void *mappedView;
+	size_t mappedSize;
+};
+
+// Layout of the PCM ROM cache file. The header is followed by the unscrambled samples in native byte order.
+// The checksum of the samples guards against a file that got truncated or damaged after it was written.
+struct PCMROMCacheFileHeader {
+	char magic[8];
+	Bit32u formatVersion;
+	Bit32u byteOrderMark;
+	Bit32u sampleCount;
+	Bit32u sampleChecksum;
+	char sha1Digest[40];
+};
+
+typedef const void *(*ROMDecoder)(const Bit8u *fileData, size_t fileSize);
+
+static const char PCM_ROM_CACHE_FILE_MAGIC[] = "MT32PCMC";
+static const Bit32u PCM_ROM_CACHE_FILE_FORMAT_VERSION = 2;
+static const Bit32u PCM_ROM_CACHE_FILE_BYTE_ORDER_MARK = 0x01020304;
+static const char PCM_ROM_CACHE_FILE_EXTENSION[] = ".mt32pcm";
+
+// Singly-linked list of the cached ROMs, there are only few known ones
+static CacheEntry *cacheEntries = NULL;
+
+// Directory to keep the PCM ROM cache files in, NULL if disabled
+static char *pcmROMCacheDirectory = NULL;
+
+// The lock is only held while looking up the list, so spinning is cheap enough
+static volatile Bit32u cacheLock = 0;
+
+static void lockCache() {
+	while (!Atomics::compareAndSwap(cacheLock, 0, 1)) {}
+}
+
+static void unlockCache() {
+	Atomics::store(cacheLock, 0);
+}
+
+static CacheEntry *findEntry(const File::SHA1Digest &sha1Digest) {
+	for (CacheEntry *entry = cacheEntries; entry != NULL; entry = entry->next) {
+		if (strcmp(entry->sha1Digest, sha1Digest) == 0) return entry;
+	}
+	return NULL;
+}
+
+#if MT32EMU_MAPPED_FILES
+
+#ifdef _WIN32
+
+static const void *mapFile(const char *path, size_t &size) {
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return NULL;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || fileSize.QuadPart > LONGLONG(~DWORD(0))) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) return NULL;
+	// The view keeps the mapping alive
+	const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	size = size_t(fileSize.QuadPart);
+	return view;
+}
+
+static void unmapFile(const void *view, size_t) {
+	UnmapViewOfFile(view);
+}
+
+static unsigned long getProcessID() {
+	return GetCurrentProcessId();
+}
+
+#else // #ifdef _WIN32
+
+static const void *mapFile(const char *path, size_t &size) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return NULL;
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+	size = size_t(fileStat.st_size);
+	void *view = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return view == MAP_FAILED ? NULL : view;
+}
+
+static void unmapFile(const void *view, size_t size) {
+	munmap(const_cast<void *>(view), size);
+}
+
+static unsigned long getProcessID() {
+	return (unsigned long)getpid();
+}
+
+#endif // #ifdef _WIN32
+
+// Returns the name of the cache file for the ROM given or NULL if the cache is disabled. The caller must free the name.
+static char *makePCMROMCacheFilePath(const File::SHA1Digest &sha1Digest) {
+	lockCache();
+	char *path = NULL;
+	if (pcmROMCacheDirectory != NULL) {
+		size_t directoryLength = strlen(pcmROMCacheDirectory);
+		path = new char[directoryLength + 1 + strlen(sha1Digest) + sizeof(PCM_ROM_CACHE_FILE_EXTENSION)];
+		strcpy(path, pcmROMCacheDirectory);
+		if (directoryLength > 0 && path[directoryLength - 1] != '/' && path[directoryLength - 1] != '\\') {
+			path[directoryLength++] = '/';
+		}
+		strcpy(path + directoryLength, sha1Digest);
+		strcat(path, PCM_ROM_CACHE_FILE_EXTENSION);
+	}
+	unlockCache();
+	return path;
+}
+
+static void makePCMROMCacheFileHeader(PCMROMCacheFileHeader &header, const File::SHA1Digest &sha1Digest, const Bit16s *samples, size_t sampleCount) {
+	memset(&header, 0, sizeof(PCMROMCacheFileHeader));
+	memcpy(header.magic, PCM_ROM_CACHE_FILE_MAGIC, sizeof(header.magic));
+	header.formatVersion = PCM_ROM_CACHE_FILE_FORMAT_VERSION;
+	header.byteOrderMark = PCM_ROM_CACHE_FILE_BYTE_ORDER_MARK;
+	header.sampleCount = Bit32u(sampleCount);
+	header.sampleChecksum = StateReader::calcChecksum(reinterpret_cast<const Bit8u *>(samples), sampleCount * sizeof(Bit16s), 1);
+	memcpy(header.sha1Digest, sha1Digest, sizeof(header.sha1Digest));
+}
+
+// Maps the cache file and returns the samples, or NULL if the file is missing, damaged or doesn't match the ROM
+static const Bit16s *mapPCMROMCacheFile(const char *path, const File::SHA1Digest &sha1Digest, size_t sampleCount, const void *&mappedView, size_t &mappedSize) {
+	mappedView = mapFile(path, mappedSize);
+	if (mappedView == NULL) return NULL;
+	const Bit16s *samples = reinterpret_cast<const Bit16s *>(static_cast<const Bit8u *>(mappedView) + sizeof(PCMROMCacheFileHeader));
+	if (mappedSize == sizeof(PCMROMCacheFileHeader) + sampleCount * sizeof(Bit16s)) {
+		PCMROMCacheFileHeader expectedHeader;
+		makePCMROMCacheFileHeader(expectedHeader, sha1Digest, samples, sampleCount);
+		if (memcmp(mappedView, &expectedHeader, sizeof(PCMROMCacheFileHeader)) == 0) return samples;
+	}
+	unmapFile(mappedView, mappedSize);
+	mappedView = NULL;
+	return NULL;
+}
+
+// Writes the samples to a temporary file which then replaces the cache file, so that the cache file is always complete.
+// Errors are ignored, the synths just keep decoding the ROM.
+static void writePCMROMCacheFile(const char *path, const File::SHA1Digest &sha1Digest, const Bit16s *samples, size_t sampleCount) {
+	char *tempPath = new char[strlen(path) + 40];
+	sprintf(tempPath, "%s.%lx.%lx.tmp", path, getProcessID(), (unsigned long)(size_t)samples);
+	FILE *file = fopen(tempPath, "wb");
+	if (file == NULL) {
+		delete[] tempPath;
+		return;
+	}
+	PCMROMCacheFileHeader header;
+	makePCMROMCacheFileHeader(header, sha1Digest, samples, sampleCount);
+	bool written = fwrite(&header, sizeof(PCMROMCacheFileHeader), 1, file) == 1
+		&& fwrite(samples, sizeof(Bit16s), sampleCount, file) == sampleCount;
+	written = fclose(file) == 0 && written;
+	if (written && rename(tempPath, path) != 0) {
+		// A stale cache file may prevent renaming on some platforms
+		remove(path);
+		written = rename(tempPath, path) == 0;
+	}
+	if (!written) remove(tempPath);
+	delete[] tempPath;
+}
+
+#endif // #if MT32EMU_MAPPED_FILES
+
+static const Bit32u *makePCMROMLogData(const Bit16s *pcmROMData, size_t sampleCount) {
+#if MT32EMU_USE_FLOAT_SAMPLES
+	(void)pcmROMData;
+	(void)sampleCount;
+	return NULL;
+#else
+	Bit32u *logData = new Bit32u[sampleCount];
+	LA32Utilites::makePCMLogSamples(logData, pcmROMData, Bit32u(sampleCount));
+	return logData;
+#endif
+}
+
+static void freeData(const CacheEntry &entry) {
+	delete[] entry.logData;
+#if MT32EMU_MAPPED_FILES
+	if (entry.mappedView != NULL) {
+		unmapFile(entry.mappedView, entry.mappedSize);
+		return;
+	}
+#endif
+	if (entry.type == ROMInfo::PCM) {
+		delete[] static_cast<const Bit16s *>(entry.data);
+	} else {
+		delete[] static_cast<const Bit8u *>(entry.data);
+	}
+}
+
+static const void *copyControlROM(const Bit8u *fileData, size_t fileSize) {
+	Bit8u *data = new Bit8u[fileSize];
+	memcpy(data, fileData, fileSize);
+	return data;
+}
+
+static const void *unscramblePCMROM(const Bit8u *fileData, size_t fileSize) {
+	static const int order[16] = {0, 9, 1, 2, 3, 4, 5, 6, 7, 10, 11, 12, 13, 14, 15, 8};
+
+	size_t pcmROMSize = fileSize >> 1;
+	Bit16s *data = new Bit16s[pcmROMSize];
+	for (size_t i = 0; i < pcmROMSize; i++) {
+		Bit8u s = *(fileData++);
+		Bit8u c = *(fileData++);
+
+		signed short log = 0;
+		for (int u = 0; u < 15; u++) {
+			int bit;
+			if (order[u] < 8) {
+				bit = (s >> (7 - order[u])) & 0x1;
+			} else {
+				bit = (c >> (7 - (order[u] - 8))) & 0x1;
+			}
+			log = log | (short)(bit << (15 - u));
+		}
+		data[i] = log;
+	}
+	return data;
+}
+
+static const void *acquire(const ROMImage &romImage, ROMDecoder decoder) {
+	const ROMInfo *romInfo = romImage.getROMInfo();
+	lockCache();
+	CacheEntry *entry = findEntry(romInfo->sha1Digest);
+	if (entry != NULL) {
+		entry->refCount++;
+		unlockCache();
+		return entry->data;
+	}
+	unlockCache();
+
+	// Loading takes a while, so it is done without holding the lock.
+	// Should another thread get ahead meanwhile, its copy is used and ours is dropped.
+	CacheEntry newEntry;
+	strcpy(newEntry.sha1Digest, romInfo->sha1Digest);
+	newEntry.type = romInfo->type;
+	newEntry.data = NULL;
+	newEntry.logData = NULL;
+	newEntry.mappedView = NULL;
+	newEntry.mappedSize = 0;
+	File *file = romImage.getFile();
+	newEntry.sampleCount = romInfo->type == ROMInfo::PCM ? file->getSize() >> 1 : 0;
+#if MT32EMU_MAPPED_FILES
+	char *cacheFilePath = romInfo->type == ROMInfo::PCM ? makePCMROMCacheFilePath(romInfo->sha1Digest) : NULL;
+	if (cacheFilePath != NULL) {
+		size_t sampleCount = file->getSize() >> 1;
+		newEntry.data = mapPCMROMCacheFile(cacheFilePath, romInfo->sha1Digest, sampleCount, newEntry.mappedView, newEntry.mappedSize);
+		if (newEntry.data == NULL) {
+			newEntry.data = decoder(file->getData(), file->getSize());
+			writePCMROMCacheFile(cacheFilePath, romInfo->sha1Digest, static_cast<const Bit16s *>(newEntry.data), sampleCount);
+		}
+		delete[] cacheFilePath;
+	}
+#endif
+	if (newEntry.data == NULL) {
+		newEntry.data = decoder(file->getData(), file->getSize());
+	}
+
+	lockCache();
+	entry = findEntry(romInfo->sha1Digest);
+	bool raceLost = entry != NULL;
+	if (!raceLost) {
+		entry = new CacheEntry(newEntry);
+		entry->refCount = 0;
+		entry->next = cacheEntries;
+		cacheEntries = entry;
+	}
+	entry->refCount++;
+	const void *sharedData = entry->data;
+	unlockCache();
+
+	if (raceLost) freeData(newEntry);
+	return sharedData;
+}
+
+const Bit8u *ROMDataCache::acquireControlROM(const ROMImage &controlROMImage) {
+	return static_cast<const Bit8u *>(acquire(controlROMImage, copyControlROM));
+}
+
+const Bit16s *ROMDataCache::acquirePCMROM(const ROMImage &pcmROMImage) {
+	return static_cast<const Bit16s *>(acquire(pcmROMImage, unscramblePCMROM));
+}
+
+const Bit32u *ROMDataCache::getPCMROMLogSamples(const Bit16s *pcmROMData) {
+	lockCache();
+	CacheEntry *entry = cacheEntries;
+	while (entry != NULL && entry->data != pcmROMData) {
+		entry = entry->next;
+	}
+	const Bit32u *logData = entry == NULL ? NULL : entry->logData;
+	unlockCache();
+	if (logData != NULL || entry == NULL || entry->type != ROMInfo::PCM) return logData;
+
+	// The entry stays in the list as the caller holds a reference. The conversion is done without holding the lock,
+	// should another thread get ahead meanwhile, its copy is used and ours is dropped.
+	const Bit32u *newLogData = makePCMROMLogData(pcmROMData, entry->sampleCount);
+	if (newLogData == NULL) return NULL;
+	lockCache();
+	if (entry->logData == NULL) {
+		entry->logData = newLogData;
+		newLogData = NULL;
+	}
+	logData = entry->logData;
+	unlockCache();
+	delete[] newLogData;
+	return logData;
+}
+
+void ROMDataCache::release(const void *romData) {
+	if (romData == NULL) return;
+	lockCache();
+	CacheEntry **link = &cacheEntries;
+	while (*link != NULL && (*link)->data != romData) {
+		link = &(*link)->next;
+	}
+	CacheEntry *entry = *link;
+	if (entry == NULL || --entry->refCount > 0) {
+		unlockCache();
+		return;
+	}
+	*link = entry->next;
+	unlockCache();
+	freeData(*entry);
+	delete entry;
+}
+
+void ROMDataCache::setPCMROMCacheDirectory(const char *directory) {
+	char *newDirectory = NULL;
+	if (directory != NULL) {
+		newDirectory = new char[strlen(directory) + 1];
+		strcpy(newDirectory, directory);
+	}
+	lockCache();
+	char *oldDirectory = pcmROMCacheDirectory;
+	pcmROMCacheDirectory = newDirectory;
+	unlockCache();
+	delete[] oldDirectory;
+}
+
+} // namespace MT32Emu
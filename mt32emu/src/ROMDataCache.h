@@ -0,0 +1,61 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_ROM_DATA_CACHE_H
+#define MT32EMU_ROM_DATA_CACHE_H
+
+#include "globals.h"
+#include "Types.h"
+
+namespace MT32Emu {
+
+class ROMImage;
+
+/**
+ * Process-wide cache of the ROM data in the form used by the emulation, keyed by the SHA1 digest of the ROM image.
+ * Synths opened with ROM images of the same content share a single read-only copy of the data, which is decoded
+ * on the first request and freed as soon as the last reference is released. The ROM image is only accessed
+ * while acquiring the data, so it may be freed afterwards. Optionally, the unscrambled PCM ROM data is also kept
+ * in files which are memory-mapped by subsequent processes instead of decoding the ROM again.
+ * THREAD SAFETY:
+ * All the methods may be called from any thread. The data is never modified once acquired.
+ */
+class ROMDataCache {
+public:
+	// Returns the shared copy of the control ROM. The image must be a known full control ROM.
+	static const Bit8u *acquireControlROM(const ROMImage &controlROMImage);
+
+	// Returns the shared PCM ROM data unscrambled to 16-bit samples. The image must be a known full PCM ROM.
+	static const Bit16s *acquirePCMROM(const ROMImage &pcmROMImage);
+
+	// Returns the samples of the PCM ROM data returned by acquirePCMROM() converted to the log-space for the integer
+	// LA32 wave generator, see LA32Utilites::makePCMLogSamples(). The conversion is made on the first call, so that
+	// acquiring the PCM ROM data mapped from the cache file stays cheap. It is shared along with the PCM ROM data
+	// and valid as long as it is. Returns NULL if the library renders float samples, as the conversion isn't used then.
+	static const Bit32u *getPCMROMLogSamples(const Bit16s *pcmROMData);
+
+	// Drops a reference to the data returned by either of the acquire methods. NULL is ignored.
+	static void release(const void *romData);
+
+	// Sets the directory to keep the unscrambled PCM ROM data in or disables the file cache if NULL.
+	// The data is mapped from the cache file if present and valid, otherwise the file is created after decoding.
+	static void setPCMROMCacheDirectory(const char *directory);
+};
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_ROM_DATA_CACHE_H
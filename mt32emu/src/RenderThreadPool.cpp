@@ -0,0 +1,286 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+
+#include "internals.h"
+
+#include "RenderThreadPool.h"
+
+#if MT32EMU_USE_RENDER_THREADS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+namespace MT32Emu {
+
+#if MT32EMU_USE_RENDER_THREADS
+
+struct RenderWorker {
+	RenderThreadPoolData *data;
+	Bit32u index;
+#ifdef _WIN32
+	HANDLE thread;
+	HANDLE batchStartedEvent;
+#else
+	pthread_t thread;
+#endif
+};
+
+struct RenderThreadPoolData {
+	Bit32u threadCount;
+	RenderWorker *workers; // threadCount - 1 entries, the calling thread isn't included
+
+	RenderJobBatch *batch;
+	Bit32u jobCount;
+	bool quit;
+
+#ifdef _WIN32
+	volatile LONG pendingWorkerCount;
+	HANDLE batchFinishedEvent;
+
+	static DWORD WINAPI workerMain(LPVOID context) {
+		RenderWorker &worker = *static_cast<RenderWorker *>(context);
+		RenderThreadPoolData &data = *worker.data;
+		for (;;) {
+			WaitForSingleObject(worker.batchStartedEvent, INFINITE);
+			if (data.quit) break;
+			RenderThreadPool::runJobs(*data.batch, data.jobCount, worker.index, data.threadCount);
+			if (InterlockedDecrement(&data.pendingWorkerCount) == 0) {
+				SetEvent(data.batchFinishedEvent);
+			}
+		}
+		return 0;
+	}
+#else
+	Bit32u batchNumber;
+	Bit32u pendingWorkerCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t batchStarted;
+	pthread_cond_t batchFinished;
+
+	static void *workerMain(void *context) {
+		RenderWorker &worker = *static_cast<RenderWorker *>(context);
+		RenderThreadPoolData &data = *worker.data;
+		// The first batch may be started before this thread gets a chance to run
+		Bit32u lastBatchNumber = 0;
+		pthread_mutex_lock(&data.mutex);
+		for (;;) {
+			while (!data.quit && lastBatchNumber == data.batchNumber) {
+				pthread_cond_wait(&data.batchStarted, &data.mutex);
+			}
+			if (data.quit) break;
+			lastBatchNumber = data.batchNumber;
+			pthread_mutex_unlock(&data.mutex);
+			RenderThreadPool::runJobs(*data.batch, data.jobCount, worker.index, data.threadCount);
+			pthread_mutex_lock(&data.mutex);
+			if (--data.pendingWorkerCount == 0) {
+				pthread_cond_signal(&data.batchFinished);
+			}
+		}
+		pthread_mutex_unlock(&data.mutex);
+		return NULL;
+	}
+#endif
+
+	// Stops and joins the first startedWorkerCount workers.
+	void stopWorkers(Bit32u startedWorkerCount) {
+#ifdef _WIN32
+		quit = true;
+		for (Bit32u i = 0; i < startedWorkerCount; i++) {
+			SetEvent(workers[i].batchStartedEvent);
+		}
+		for (Bit32u i = 0; i < startedWorkerCount; i++) {
+			WaitForSingleObject(workers[i].thread, INFINITE);
+			CloseHandle(workers[i].thread);
+		}
+#else
+		pthread_mutex_lock(&mutex);
+		quit = true;
+		pthread_cond_broadcast(&batchStarted);
+		pthread_mutex_unlock(&mutex);
+		for (Bit32u i = 0; i < startedWorkerCount; i++) {
+			pthread_join(workers[i].thread, NULL);
+		}
+#endif
+	}
+
+	bool startWorkers() {
+		Bit32u workerCount = threadCount - 1;
+		for (Bit32u i = 0; i < workerCount; i++) {
+			workers[i].data = this;
+			workers[i].index = i + 1;
+#ifdef _WIN32
+			workers[i].thread = CreateThread(NULL, 0, workerMain, &workers[i], 0, NULL);
+			if (workers[i].thread == NULL) {
+#else
+			if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) {
+#endif
+				stopWorkers(i);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool init(Bit32u useThreadCount) {
+		threadCount = useThreadCount;
+		batch = NULL;
+		jobCount = 0;
+		quit = false;
+		pendingWorkerCount = 0;
+		workers = new RenderWorker[threadCount - 1];
+#ifdef _WIN32
+		batchFinishedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		Bit32u eventCount = 0;
+		while (eventCount < threadCount - 1) {
+			workers[eventCount].batchStartedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+			if (workers[eventCount].batchStartedEvent == NULL) break;
+			eventCount++;
+		}
+		if (batchFinishedEvent != NULL && eventCount == threadCount - 1 && startWorkers()) return true;
+		closeEvents(eventCount);
+#else
+		batchNumber = 0;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&batchStarted, NULL);
+		pthread_cond_init(&batchFinished, NULL);
+		if (startWorkers()) return true;
+		destroySyncObjects();
+#endif
+		delete[] workers;
+		workers = NULL;
+		return false;
+	}
+
+	void deinit() {
+		stopWorkers(threadCount - 1);
+#ifdef _WIN32
+		closeEvents(threadCount - 1);
+#else
+		destroySyncObjects();
+#endif
+		delete[] workers;
+		workers = NULL;
+	}
+
+#ifdef _WIN32
+	void closeEvents(Bit32u eventCount) {
+		for (Bit32u i = 0; i < eventCount; i++) {
+			CloseHandle(workers[i].batchStartedEvent);
+		}
+		if (batchFinishedEvent != NULL) CloseHandle(batchFinishedEvent);
+	}
+#else
+	void destroySyncObjects() {
+		pthread_cond_destroy(&batchFinished);
+		pthread_cond_destroy(&batchStarted);
+		pthread_mutex_destroy(&mutex);
+	}
+#endif
+
+	void run(RenderJobBatch &useBatch, Bit32u useJobCount) {
+		if (useJobCount < 2) {
+			// Not worth waking up the workers
+			RenderThreadPool::runJobs(useBatch, useJobCount, 0, 1);
+			return;
+		}
+		batch = &useBatch;
+		jobCount = useJobCount;
+#ifdef _WIN32
+		pendingWorkerCount = LONG(threadCount - 1);
+		for (Bit32u i = 0; i < threadCount - 1; i++) {
+			SetEvent(workers[i].batchStartedEvent);
+		}
+		RenderThreadPool::runJobs(useBatch, useJobCount, 0, threadCount);
+		WaitForSingleObject(batchFinishedEvent, INFINITE);
+#else
+		pthread_mutex_lock(&mutex);
+		pendingWorkerCount = threadCount - 1;
+		batchNumber++;
+		pthread_cond_broadcast(&batchStarted);
+		pthread_mutex_unlock(&mutex);
+		RenderThreadPool::runJobs(useBatch, useJobCount, 0, threadCount);
+		pthread_mutex_lock(&mutex);
+		while (pendingWorkerCount > 0) {
+			pthread_cond_wait(&batchFinished, &mutex);
+		}
+		pthread_mutex_unlock(&mutex);
+#endif
+		batch = NULL;
+	}
+};
+
+RenderThreadPool *RenderThreadPool::createRenderThreadPool(Bit32u threadCount) {
+	if (threadCount < 2) return NULL;
+	RenderThreadPoolData *data = new RenderThreadPoolData;
+	if (!data->init(threadCount)) {
+		delete data;
+		return NULL;
+	}
+	return new RenderThreadPool(*data);
+}
+
+RenderThreadPool::~RenderThreadPool() {
+	data.deinit();
+	delete &data;
+}
+
+Bit32u RenderThreadPool::getThreadCount() const {
+	return data.threadCount;
+}
+
+void RenderThreadPool::run(RenderJobBatch &batch, Bit32u jobCount) {
+	if (jobCount == 0) return;
+	data.run(batch, jobCount);
+}
+
+#else // #if MT32EMU_USE_RENDER_THREADS
+
+struct RenderThreadPoolData {};
+
+RenderThreadPool *RenderThreadPool::createRenderThreadPool(Bit32u threadCount) {
+	(void)threadCount;
+	return NULL;
+}
+
+RenderThreadPool::~RenderThreadPool() {
+	delete &data;
+}
+
+Bit32u RenderThreadPool::getThreadCount() const {
+	return 1;
+}
+
+void RenderThreadPool::run(RenderJobBatch &batch, Bit32u jobCount) {
+	runJobs(batch, jobCount, 0, 1);
+}
+
+#endif // #if MT32EMU_USE_RENDER_THREADS
+
+RenderThreadPool::RenderThreadPool(RenderThreadPoolData &useData) : data(useData) {}
+
+void RenderThreadPool::runJobs(RenderJobBatch &batch, Bit32u jobCount, Bit32u firstJobIndex, Bit32u jobIndexIncrement) {
+	for (Bit32u jobIndex = firstJobIndex; jobIndex < jobCount; jobIndex += jobIndexIncrement) {
+		batch.runJob(jobIndex);
+	}
+}
+
+} // namespace MT32Emu
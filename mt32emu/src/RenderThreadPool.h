@@ -0,0 +1,66 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_RENDER_THREAD_POOL_H
+#define MT32EMU_RENDER_THREAD_POOL_H
+
+#include "globals.h"
+#include "Types.h"
+
+namespace MT32Emu {
+
+struct RenderThreadPoolData;
+
+// A batch of mutually independent jobs to be executed by RenderThreadPool.
+class RenderJobBatch {
+public:
+	virtual ~RenderJobBatch() {}
+
+	// Executes a single job. Invoked exactly once per job index, possibly from a worker thread.
+	virtual void runJob(Bit32u jobIndex) = 0;
+};
+
+// Simple pool of worker threads that splits a batch of jobs between the workers and the calling thread.
+// Job indices are assigned to threads statically, so the only synchronisation happens when a batch starts and ends.
+// The pool is intended for use by a single rendering thread.
+class RenderThreadPool {
+public:
+	// Creates a pool that runs batches in threadCount threads, including the calling thread.
+	// Returns NULL when threadCount is less than 2, the library is built without MT32EMU_USE_RENDER_THREADS
+	// or the worker threads can't be started.
+	static RenderThreadPool *createRenderThreadPool(Bit32u threadCount);
+	~RenderThreadPool();
+
+	// Returns the number of threads that execute jobs, including the calling thread.
+	Bit32u getThreadCount() const;
+
+	// Executes jobs with indices in range [0, jobCount) and returns when all of them are complete.
+	void run(RenderJobBatch &batch, Bit32u jobCount);
+
+private:
+	RenderThreadPoolData &data;
+
+	RenderThreadPool(RenderThreadPoolData &useData);
+
+	static void runJobs(RenderJobBatch &batch, Bit32u jobCount, Bit32u firstJobIndex, Bit32u jobIndexIncrement);
+
+	friend struct RenderThreadPoolData;
+};
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_RENDER_THREAD_POOL_H
@@ -0,0 +1,229 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "internals.h"
+
+#include "StateStream.h"
+
+namespace MT32Emu {
+
+// Adler-32 is simple enough yet it reliably detects a blob truncated or damaged accidentally
+static const Bit32u ADLER_MODULUS = 65521;
+
+Bit32u StateReader::calcChecksum(const Bit8u *data, size_t dataLength, Bit32u initChecksum) {
+	Bit32u sumA = initChecksum & 0xFFFF;
+	Bit32u sumB = initChecksum >> 16;
+	while (dataLength > 0) {
+		// Ensures that the sums don't overflow before the modulo is applied
+		size_t chunkLength = dataLength < 5552 ? dataLength : 5552;
+		dataLength -= chunkLength;
+		while (chunkLength-- > 0) {
+			sumA += *(data++);
+			sumB += sumA;
+		}
+		sumA %= ADLER_MODULUS;
+		sumB %= ADLER_MODULUS;
+	}
+	return (sumB << 16) | sumA;
+}
+
+static inline Bit32u floatToBits(float value) {
+	Bit32u bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline float bitsToFloat(Bit32u bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+StateWriter::StateWriter(Bit8u *useBuffer, size_t useBufferSize) :
+	buffer(useBuffer), bufferSize(useBufferSize), length(0), checksum(1)
+{}
+
+void StateWriter::writeBytes(const void *data, size_t dataLength) {
+	if (buffer != NULL && length + dataLength <= bufferSize) {
+		memcpy(buffer + length, data, dataLength);
+		checksum = StateReader::calcChecksum(buffer + length, dataLength, checksum);
+	}
+	length += dataLength;
+}
+
+void StateWriter::writeBit8u(Bit8u value) {
+	writeBytes(&value, 1);
+}
+
+void StateWriter::writeBit16u(Bit16u value) {
+	Bit8u bytes[] = { Bit8u(value), Bit8u(value >> 8) };
+	writeBytes(bytes, sizeof(bytes));
+}
+
+void StateWriter::writeBit16s(Bit16s value) {
+	writeBit16u(Bit16u(value));
+}
+
+void StateWriter::writeBit32u(Bit32u value) {
+	Bit8u bytes[] = { Bit8u(value), Bit8u(value >> 8), Bit8u(value >> 16), Bit8u(value >> 24) };
+	writeBytes(bytes, sizeof(bytes));
+}
+
+void StateWriter::writeBit32s(Bit32s value) {
+	writeBit32u(Bit32u(value));
+}
+
+void StateWriter::writeBool(bool value) {
+	writeBit8u(value ? 1 : 0);
+}
+
+void StateWriter::writeFloat(float value) {
+	writeBit32u(floatToBits(value));
+}
+
+void StateWriter::writeSamples(const Bit16s *samples, Bit32u count) {
+	while (count-- > 0) {
+		writeBit16s(*(samples++));
+	}
+}
+
+void StateWriter::writeSamples(const float *samples, Bit32u count) {
+	while (count-- > 0) {
+		writeFloat(*(samples++));
+	}
+}
+
+void StateWriter::writePointer(const void *pointer, const void *regionStart, size_t regionSize) {
+	const Bit8u *bytePointer = static_cast<const Bit8u *>(pointer);
+	const Bit8u *byteRegionStart = static_cast<const Bit8u *>(regionStart);
+	if (bytePointer < byteRegionStart || byteRegionStart + regionSize <= bytePointer) {
+		writeBit32u(0);
+		return;
+	}
+	writeBit32u(Bit32u(bytePointer - byteRegionStart) + 1);
+}
+
+size_t StateWriter::getLength() const {
+	return length;
+}
+
+bool StateWriter::isOverflowed() const {
+	return bufferSize < length;
+}
+
+Bit32u StateWriter::getChecksum() const {
+	return checksum;
+}
+
+StateReader::StateReader(const Bit8u *useBuffer, size_t useBufferSize) :
+	buffer(useBuffer), bufferSize(useBufferSize), position(0), failed(false)
+{}
+
+const Bit8u *StateReader::read(size_t dataLength) {
+	if (failed || bufferSize - position < dataLength) {
+		failed = true;
+		return NULL;
+	}
+	const Bit8u *data = buffer + position;
+	position += dataLength;
+	return data;
+}
+
+void StateReader::readBytes(void *data, size_t dataLength) {
+	const Bit8u *source = read(dataLength);
+	if (source == NULL) {
+		memset(data, 0, dataLength);
+	} else {
+		memcpy(data, source, dataLength);
+	}
+}
+
+Bit8u StateReader::readBit8u() {
+	const Bit8u *bytes = read(1);
+	return bytes == NULL ? 0 : bytes[0];
+}
+
+Bit16u StateReader::readBit16u() {
+	const Bit8u *bytes = read(2);
+	return bytes == NULL ? 0 : Bit16u(bytes[0] | (bytes[1] << 8));
+}
+
+Bit16s StateReader::readBit16s() {
+	return Bit16s(readBit16u());
+}
+
+Bit32u StateReader::readBit32u() {
+	const Bit8u *bytes = read(4);
+	return bytes == NULL ? 0 : (Bit32u(bytes[0]) | (Bit32u(bytes[1]) << 8) | (Bit32u(bytes[2]) << 16) | (Bit32u(bytes[3]) << 24));
+}
+
+Bit32s StateReader::readBit32s() {
+	return Bit32s(readBit32u());
+}
+
+bool StateReader::readBool() {
+	return readBit8u() != 0;
+}
+
+float StateReader::readFloat() {
+	return bitsToFloat(readBit32u());
+}
+
+void StateReader::readSamples(Bit16s *samples, Bit32u count) {
+	while (count-- > 0) {
+		*(samples++) = readBit16s();
+	}
+}
+
+void StateReader::readSamples(float *samples, Bit32u count) {
+	while (count-- > 0) {
+		*(samples++) = readFloat();
+	}
+}
+
+Bit32u StateReader::readIndex(Bit32u limit) {
+	Bit32u index = readBit32u();
+	if (index < limit) return index;
+	failed = true;
+	return 0;
+}
+
+const void *StateReader::readPointer(const void *regionStart, size_t regionSize, size_t objectSize) {
+	Bit32u offset = readBit32u();
+	if (offset == 0) return NULL;
+	if (regionSize < objectSize || regionSize - objectSize < offset - 1) {
+		failed = true;
+		return NULL;
+	}
+	return static_cast<const Bit8u *>(regionStart) + offset - 1;
+}
+
+void StateReader::fail() {
+	failed = true;
+}
+
+bool StateReader::isFailed() const {
+	return failed;
+}
+
+size_t StateReader::getPosition() const {
+	return position;
+}
+
+} // namespace MT32Emu
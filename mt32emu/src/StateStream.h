@@ -0,0 +1,103 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_STATE_STREAM_H
+#define MT32EMU_STATE_STREAM_H
+
+#include <cstddef>
+
+#include "globals.h"
+#include "Types.h"
+
+namespace MT32Emu {
+
+/* StateWriter and StateReader are used to save and load the emulation state as a binary blob.
+ * Multi-byte values are stored in the little-endian byte order and floats are stored as their IEEE 754 bit patterns,
+ * so the layout doesn't depend on the host. Pointers into long-living memory regions are stored as offsets.
+ */
+
+class StateWriter {
+private:
+	Bit8u * const buffer;
+	const size_t bufferSize;
+	size_t length;
+	Bit32u checksum;
+
+public:
+	// When the buffer is NULL, the writer merely counts the bytes written.
+	StateWriter(Bit8u *buffer = NULL, size_t bufferSize = 0);
+
+	void writeBit8u(Bit8u value);
+	void writeBit16u(Bit16u value);
+	void writeBit16s(Bit16s value);
+	void writeBit32u(Bit32u value);
+	void writeBit32s(Bit32s value);
+	void writeBool(bool value);
+	void writeFloat(float value);
+	void writeBytes(const void *data, size_t dataLength);
+	void writeSamples(const Bit16s *samples, Bit32u count);
+	void writeSamples(const float *samples, Bit32u count);
+	// Stores a pointer into the memory region as an offset. A pointer outside the region is stored as NULL,
+	// this is intended for dangling pointers which are never dereferenced before set anew.
+	void writePointer(const void *pointer, const void *regionStart, size_t regionSize);
+
+	size_t getLength() const;
+	// True if the buffer appears too small to hold everything written
+	bool isOverflowed() const;
+	// Checksum of the bytes written so far
+	Bit32u getChecksum() const;
+};
+
+class StateReader {
+private:
+	const Bit8u * const buffer;
+	const size_t bufferSize;
+	size_t position;
+	bool failed;
+
+public:
+	StateReader(const Bit8u *buffer, size_t bufferSize);
+
+	// Once the data is exhausted or found invalid, all the subsequent reads return zeroes.
+	Bit8u readBit8u();
+	Bit16u readBit16u();
+	Bit16s readBit16s();
+	Bit32u readBit32u();
+	Bit32s readBit32s();
+	bool readBool();
+	float readFloat();
+	void readBytes(void *data, size_t dataLength);
+	// Returns a pointer to the data within the buffer or NULL if there is not enough data left
+	const Bit8u *read(size_t dataLength);
+	void readSamples(Bit16s *samples, Bit32u count);
+	void readSamples(float *samples, Bit32u count);
+	// Returns a value read if it's less than the limit, otherwise marks the data invalid.
+	Bit32u readIndex(Bit32u limit);
+	// Counterpart of StateWriter::writePointer(), an object of the specified size is checked to fit the region.
+	const void *readPointer(const void *regionStart, size_t regionSize, size_t objectSize);
+
+	// Marks the data invalid. Used when the state read is inconsistent with the emulator configuration.
+	void fail();
+	bool isFailed() const;
+	size_t getPosition() const;
+
+	static Bit32u calcChecksum(const Bit8u *data, size_t dataLength, Bit32u initChecksum = 0);
+};
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_STATE_STREAM_H
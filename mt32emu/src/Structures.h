@@ -227,7 +227,7 @@ struct PCMWaveEntry {
 	Bit32u addr;
 	Bit32u len;
 	bool loop;
-	ControlROMPCMStruct *controlROMPCMStruct;
+	const ControlROMPCMStruct *controlROMPCMStruct;
 };
 
 // This is basically a per-partial, pre-processed combination of timbre and patch/rhythm settings
@@ -16,27 +16,49 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
 
 #include "internals.h"
 
 #include "Synth.h"
 #include "Analog.h"
 #include "BReverbModel.h"
+#include "Clock.h"
+#include "CPUFeatures.h"
+#include "TraceRecorder.h"
 #include "File.h"
 #include "MemoryRegion.h"
 #include "MidiEventQueue.h"
+#include "Atomics.h"
 #include "Part.h"
 #include "Partial.h"
 #include "PartialManager.h"
+#include "PatchCacheStore.h"
 #include "Poly.h"
+#include "RenderThreadPool.h"
+#include "ROMDataCache.h"
 #include "ROMInfo.h"
+#include "StateStream.h"
 #include "TVA.h"
 
+#if MT32EMU_USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace MT32Emu {
 
 // MIDI interface data transfer rate in samples. Used to simulate the transfer delay.
 static const double MIDI_DATA_TRANSFER_RATE = (double)SAMPLE_RATE / 31250.0 * 8.0;
 
+// The saved state starts with a header followed by the payload: magic, format version, payload length and payload checksum
+static const Bit8u STATE_MAGIC[] = {'M', 'T', '3', '2', 'S', 'T', 'A', 'T'};
+static const Bit32u STATE_VERSION = 4;
+static const size_t STATE_HEADER_LENGTH = sizeof(STATE_MAGIC) + 12;
+// Unchanged bytes shorter than this are stored as a part of the surrounding changed run of the synth memory
+static const Bit32u STATE_MEMORY_MIN_UNCHANGED_RUN_LENGTH = 8;
+// Denotes NULL in place of a part or poly
+static const Bit8u STATE_NULL_PART = 0xFF;
+
 // FIXME: there should be more specific feature sets for various MT-32 control ROM versions
 static const ControlROMFeatureSet OLD_MT32_COMPATIBLE = { true, true, true };
 static const ControlROMFeatureSet CM32L_COMPATIBLE = { false, false, false };
@@ -71,13 +93,164 @@ static inline float convertSample(Bit16s sample) {
 	return float(sample) / 16384.0f; // This multiplier takes into account the DAC bit shift
 }
 
-class SampleFormatConverter {
-protected:
+// The sample format the rendered samples are converted to on request
+#if MT32EMU_USE_FLOAT_SAMPLES
+typedef Bit16s ConvertedSample;
+#else
+typedef float ConvertedSample;
+#endif
+
+typedef void (*ConvertSamplesKernel)(ConvertedSample *outBuffer, const Sample *inBuffer, Bit32u len);
+// Mixes the output of a partial rendered into a private buffer, see Renderer::renderPartialsThreaded()
+typedef void (*MixPartialOutputKernel)(Sample *buffer, const Sample *partialBuffer, Bit32u len);
+
+static void convertSamplesGeneric(ConvertedSample *outBuffer, const Sample *inBuffer, Bit32u len) {
+	while (len--) {
+		*(outBuffer++) = convertSample(*(inBuffer++));
+	}
+}
+
+static void mixPartialOutputGeneric(Sample *buffer, const Sample *partialBuffer, Bit32u len) {
+	while (len--) {
+#if MT32EMU_USE_FLOAT_SAMPLES
+		*buffer += *partialBuffer;
+#else
+		*buffer = Synth::clipSampleEx(SampleEx(*buffer) + SampleEx(*partialBuffer));
+#endif
+		++buffer;
+		++partialBuffer;
+	}
+}
+
+#if MT32EMU_USE_X86_SIMD
+
+#if MT32EMU_USE_FLOAT_SAMPLES
+
+// The truncating conversion yields 0x80000000 for out-of-range values the same way as the scalar one does on x86,
+// the saturating packing is equivalent to Synth::clipSampleEx().
+MT32EMU_X86_TARGET("sse2")
+static void convertSamplesSSE2(Bit16s *outBuffer, const float *inBuffer, Bit32u len) {
+	const __m128 multiplier = _mm_set1_ps(16384.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= len; i += 8) {
+		const __m128i low = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(inBuffer + i), multiplier));
+		const __m128i high = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(inBuffer + i + 4), multiplier));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuffer + i), _mm_packs_epi32(low, high));
+	}
+	convertSamplesGeneric(outBuffer + i, inBuffer + i, len - i);
+}
+
+// Packing works within 128-bit lanes, so the 64-bit quarters are to be reordered afterwards
+MT32EMU_X86_TARGET("avx2")
+static void convertSamplesAVX2(Bit16s *outBuffer, const float *inBuffer, Bit32u len) {
+	const __m256 multiplier = _mm256_set1_ps(16384.0f);
+	Bit32u i = 0;
+	for (; i + 16 <= len; i += 16) {
+		const __m256i low = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(inBuffer + i), multiplier));
+		const __m256i high = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(inBuffer + i + 8), multiplier));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(outBuffer + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8));
+	}
+	convertSamplesSSE2(outBuffer + i, inBuffer + i, len - i);
+}
+
+MT32EMU_X86_TARGET("sse2")
+static void mixPartialOutputSSE2(Sample *buffer, const Sample *partialBuffer, Bit32u len) {
+	Bit32u i = 0;
+	for (; i + 4 <= len; i += 4) {
+		_mm_storeu_ps(buffer + i, _mm_add_ps(_mm_loadu_ps(buffer + i), _mm_loadu_ps(partialBuffer + i)));
+	}
+	mixPartialOutputGeneric(buffer + i, partialBuffer + i, len - i);
+}
+
+MT32EMU_X86_TARGET("avx")
+static void mixPartialOutputAVX(Sample *buffer, const Sample *partialBuffer, Bit32u len) {
+	Bit32u i = 0;
+	for (; i + 8 <= len; i += 8) {
+		_mm256_storeu_ps(buffer + i, _mm256_add_ps(_mm256_loadu_ps(buffer + i), _mm256_loadu_ps(partialBuffer + i)));
+	}
+	mixPartialOutputSSE2(buffer + i, partialBuffer + i, len - i);
+}
+
+#else
+
+// Multiplying by the reciprocal of the power of two is exact, so it gives the same result as the division
+MT32EMU_X86_TARGET("sse2")
+static void convertSamplesSSE2(float *outBuffer, const Bit16s *inBuffer, Bit32u len) {
+	const __m128 multiplier = _mm_set1_ps(1.0f / 16384.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= len; i += 8) {
+		const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuffer + i));
+		const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+		_mm_storeu_ps(outBuffer + i, _mm_mul_ps(_mm_cvtepi32_ps(low), multiplier));
+		_mm_storeu_ps(outBuffer + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), multiplier));
+	}
+	convertSamplesGeneric(outBuffer + i, inBuffer + i, len - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void convertSamplesAVX2(float *outBuffer, const Bit16s *inBuffer, Bit32u len) {
+	const __m256 multiplier = _mm256_set1_ps(1.0f / 16384.0f);
+	Bit32u i = 0;
+	for (; i + 8 <= len; i += 8) {
+		const __m256i in = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuffer + i)));
+		_mm256_storeu_ps(outBuffer + i, _mm256_mul_ps(_mm256_cvtepi32_ps(in), multiplier));
+	}
+	convertSamplesSSE2(outBuffer + i, inBuffer + i, len - i);
+}
+
+// The saturating addition is equivalent to Synth::clipSampleEx() of the sum
+MT32EMU_X86_TARGET("sse2")
+static void mixPartialOutputSSE2(Sample *buffer, const Sample *partialBuffer, Bit32u len) {
+	Bit32u i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i *mixBuffer = reinterpret_cast<__m128i *>(buffer + i);
+		_mm_storeu_si128(mixBuffer, _mm_adds_epi16(_mm_loadu_si128(mixBuffer), _mm_loadu_si128(reinterpret_cast<const __m128i *>(partialBuffer + i))));
+	}
+	mixPartialOutputGeneric(buffer + i, partialBuffer + i, len - i);
+}
+
+MT32EMU_X86_TARGET("avx2")
+static void mixPartialOutputAVX2(Sample *buffer, const Sample *partialBuffer, Bit32u len) {
+	Bit32u i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m256i *mixBuffer = reinterpret_cast<__m256i *>(buffer + i);
+		_mm256_storeu_si256(mixBuffer, _mm256_adds_epi16(_mm256_loadu_si256(mixBuffer), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(partialBuffer + i))));
+	}
+	mixPartialOutputSSE2(buffer + i, partialBuffer + i, len - i);
+}
+
+#endif // #if MT32EMU_USE_FLOAT_SAMPLES
+
+#endif // #if MT32EMU_USE_X86_SIMD
+
+static ConvertSamplesKernel selectConvertSamplesKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
+	if (simdLevel >= SIMDLevel_AVX2) return convertSamplesAVX2;
+	if (simdLevel >= SIMDLevel_SSE2) return convertSamplesSSE2;
+#else
+	(void)simdLevel;
+#endif
+	return convertSamplesGeneric;
+}
+
+static MixPartialOutputKernel selectMixPartialOutputKernel(const SIMDLevel simdLevel) {
+#if MT32EMU_USE_X86_SIMD
 #if MT32EMU_USE_FLOAT_SAMPLES
-	Bit16s *outBuffer;
+	if (simdLevel >= SIMDLevel_AVX) return mixPartialOutputAVX;
+#else
+	if (simdLevel >= SIMDLevel_AVX2) return mixPartialOutputAVX2;
+#endif
+	if (simdLevel >= SIMDLevel_SSE2) return mixPartialOutputSSE2;
 #else
-	float *outBuffer;
+	(void)simdLevel;
 #endif
+	return mixPartialOutputGeneric;
+}
+
+class SampleFormatConverter {
+protected:
+	ConvertedSample *outBuffer;
 
 public:
 	Sample *sampleBuffer;
@@ -88,16 +261,14 @@ public:
 		return outBuffer != NULL;
 	}
 
-	inline void convert(Bit32u len) {
+	inline void convert(Bit32u len, ConvertSamplesKernel kernel) {
 		if (sampleBuffer == NULL) return;
 		if (outBuffer == NULL) {
 			sampleBuffer += len;
 			return;
 		}
-		Sample *inBuffer = sampleBuffer;
-		while (len--) {
-			*(outBuffer++) = convertSample(*(inBuffer++));
-		}
+		kernel(outBuffer, sampleBuffer, len);
+		outBuffer += len;
 	}
 
 	inline void addSilence(Bit32u len) {
@@ -116,11 +287,7 @@ class BufferedSampleFormatConverter : public SampleFormatConverter {
 	Sample renderingBuffer[BUFFER_SIZE_MULTIPLIER * MAX_SAMPLES_PER_RUN];
 
 public:
-#if MT32EMU_USE_FLOAT_SAMPLES
-	BufferedSampleFormatConverter(Bit16s *buffer)
-#else
-	BufferedSampleFormatConverter(float *buffer)
-#endif
+	BufferedSampleFormatConverter(ConvertedSample *buffer)
 		: SampleFormatConverter(renderingBuffer)
 	{
 		outBuffer = buffer;
@@ -128,17 +295,97 @@ public:
 	}
 };
 
-class Renderer {
+// Runs shorter than this are always rendered in the calling thread as the synchronisation overhead isn't worth it.
+static const Bit32u MIN_SAMPLES_PER_THREADED_RUN = 32;
+
+// Describes a partial (along with its ring modulating slave, if any) rendered into a private buffer,
+// possibly in a worker thread. The private buffers are mixed into the output afterwards in the order of partials,
+// so that the result is bit-identical to rendering all the partials sequentially.
+struct PartialRenderJob {
+	Partial *partial;
+	Partial *slave;
+	bool reverb;
+	bool rendered;
+	Sample *leftBuffer;
+	Sample *rightBuffer;
+};
+
+class Renderer : public RenderJobBatch {
 	Synth &synth;
 
+	Bit32u requestedThreadCount;
+	RenderThreadPool *threadPool;
+	PartialRenderJob *partialRenderJobs; // Array, one item per partial
+	Sample *partialBuffers;
+	Bit32u threadedRunLength;
+	Bit32u passLength;
+
+	ConvertSamplesKernel convertSamplesKernel;
+	MixPartialOutputKernel mixPartialOutputKernel;
+
+	bool statisticsEnabled;
+	RenderStatistics statistics;
+
+	void renderStreamsWithEvents(SampleFormatConverter &nonReverbLeft, SampleFormatConverter &nonReverbRight, SampleFormatConverter &reverbDryLeft, SampleFormatConverter &reverbDryRight, SampleFormatConverter &reverbWetLeft, SampleFormatConverter &reverbWetRight, Bit32u len);
+	void renderPartials(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Bit32u len);
+	void renderPartialsThreaded(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Bit32u len);
+
 public:
-	Renderer(Synth &useSynth) : synth(useSynth) {}
+	Renderer(Synth &useSynth) : synth(useSynth), requestedThreadCount(1), threadPool(NULL), partialRenderJobs(NULL), partialBuffers(NULL), threadedRunLength(0), passLength(DEFAULT_RENDER_PASS_LENGTH), convertSamplesKernel(convertSamplesGeneric), mixPartialOutputKernel(mixPartialOutputGeneric), statisticsEnabled(false) {
+		resetStatistics();
+	}
+	~Renderer();
+
+	void setStatisticsEnabled(bool enabled);
+	bool isStatisticsEnabled() const;
+	const RenderStatistics &getStatistics() const;
+	void resetStatistics();
+
+	// Returns the start time of a stage to be passed to endStage(), if the statistics are enabled.
+	inline double startStage() const {
+#if MT32EMU_RENDER_STATISTICS
+		return statisticsEnabled ? Clock::getSeconds() : 0.0;
+#else
+		return 0.0;
+#endif
+	}
+
+	inline void endStage(RenderStageStatistics &stage, double startTime) {
+#if MT32EMU_RENDER_STATISTICS
+		if (!statisticsEnabled) return;
+		stage.seconds += Clock::getSeconds() - startTime;
+		stage.runCount++;
+#else
+		(void)stage;
+		(void)startTime;
+#endif
+	}
+
+	// Returns the start time of a span to be passed to endTrace(), if a trace recorder is attached.
+	inline double startTrace() const {
+		return synth.traceRecorder != NULL ? TraceRecorder::getTime() : 0.0;
+	}
+
+	inline void endTrace(const char *name, double startTime, const char *argName, Bit32u argValue) {
+		if (synth.traceRecorder == NULL) return;
+		synth.traceRecorder->recordSpan(synth.traceTrack, name, startTime, TraceRecorder::getTime(), argName, argValue);
+	}
+
+	void selectKernels(SIMDLevel simdLevel);
+	void setThreadCount(Bit32u threadCount);
+	Bit32u getThreadCount() const;
+	void setPassLength(Bit32u length);
+	Bit32u getPassLength() const;
+	void openThreadPool();
+	void closeThreadPool();
+	void runJob(Bit32u jobIndex);
 
 	void render(SampleFormatConverter &converter, Bit32u len);
 	void renderStreams(SampleFormatConverter &nonReverbLeft, SampleFormatConverter &nonReverbRight, SampleFormatConverter &reverbDryLeft, SampleFormatConverter &reverbDryRight, SampleFormatConverter &reverbWetLeft, SampleFormatConverter &reverbWetRight, Bit32u len);
 	void produceLA32Output(Sample *buffer, Bit32u len);
 	void convertSamplesToOutput(Sample *buffer, Bit32u len);
-	void doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len);
+	void renderPass(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len);
+	void processReverb(Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u start, Bit32u end, bool enabled);
 };
 
 Bit32u Synth::getLibraryVersionInt() {
@@ -169,6 +416,7 @@ Synth::Synth(ReportHandler *useReportHandler) : mt32ram(*new MemParams), mt32def
 	partialCount = DEFAULT_MAX_PARTIALS;
 	controlROMMap = NULL;
 	controlROMFeatures = NULL;
+	controlROMData = NULL;
 
 	if (useReportHandler == NULL) {
 		reportHandler = new ReportHandler;
@@ -183,11 +431,16 @@ Synth::Synth(ReportHandler *useReportHandler) : mt32ram(*new MemParams), mt32def
 	}
 	reverbModel = NULL;
 	analog = NULL;
+	traceRecorder = NULL;
+	traceTrack = 0;
+	resetPolyphonyStatistics();
 	setDACInputMode(DACInputMode_NICE);
 	setMIDIDelayMode(MIDIDelayMode_DELAY_SHORT_MESSAGES_ONLY);
 	setOutputGain(1.0f);
 	setReverbOutputGain(1.0f);
 	setReversedStereoEnabled(false);
+	requestedSIMDLevel = SIMDLevel_AUTO;
+	simdLevel = SIMDLevel_GENERIC;
 
 	patchTempMemoryRegion = NULL;
 	rhythmTempMemoryRegion = NULL;
@@ -197,13 +450,19 @@ Synth::Synth(ReportHandler *useReportHandler) : mt32ram(*new MemParams), mt32def
 	systemMemoryRegion = NULL;
 	displayMemoryRegion = NULL;
 	resetMemoryRegion = NULL;
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+		memoryRegionIndexByPage[page] = MEMORY_REGION_COUNT;
+	}
 	paddedTimbreMaxTable = NULL;
 
 	partialManager = NULL;
+	patchCacheStore = NULL;
 	pcmWaves = NULL;
 	pcmROMData = NULL;
+	pcmROMLogData = NULL;
 	soundGroupNames = NULL;
 	midiQueue = NULL;
+	midiQueueSysexStorageSize = 0;
 	lastReceivedMIDIEventTimestamp = 0;
 	memset(parts, 0, sizeof(parts));
 	renderedSampleCount = 0;
@@ -299,10 +558,10 @@ void Synth::setReverbCompatibilityMode(bool mt32CompatibleMode) {
 			delete reverbModels[i];
 		}
 	}
-	reverbModels[REVERB_MODE_ROOM] = new BReverbModel(REVERB_MODE_ROOM, mt32CompatibleMode);
-	reverbModels[REVERB_MODE_HALL] = new BReverbModel(REVERB_MODE_HALL, mt32CompatibleMode);
-	reverbModels[REVERB_MODE_PLATE] = new BReverbModel(REVERB_MODE_PLATE, mt32CompatibleMode);
-	reverbModels[REVERB_MODE_TAP_DELAY] = new BReverbModel(REVERB_MODE_TAP_DELAY, mt32CompatibleMode);
+	reverbModels[REVERB_MODE_ROOM] = new BReverbModel(REVERB_MODE_ROOM, mt32CompatibleMode, simdLevel);
+	reverbModels[REVERB_MODE_HALL] = new BReverbModel(REVERB_MODE_HALL, mt32CompatibleMode, simdLevel);
+	reverbModels[REVERB_MODE_PLATE] = new BReverbModel(REVERB_MODE_PLATE, mt32CompatibleMode, simdLevel);
+	reverbModels[REVERB_MODE_TAP_DELAY] = new BReverbModel(REVERB_MODE_TAP_DELAY, mt32CompatibleMode, simdLevel);
 #if !MT32EMU_REDUCE_REVERB_MEMORY
 	for (int i = REVERB_MODE_ROOM; i <= REVERB_MODE_TAP_DELAY; i++) {
 		reverbModels[i]->open();
@@ -372,8 +631,109 @@ bool Synth::isReversedStereoEnabled() const {
 	return reversedStereoEnabled;
 }
 
+void Synth::setRenderThreadCount(Bit32u threadCount) {
+	renderer.setThreadCount(threadCount);
+}
+
+Bit32u Synth::getRenderThreadCount() const {
+	return renderer.getThreadCount();
+}
+
+void Synth::setRenderPassLength(Bit32u length) {
+	renderer.setPassLength(length);
+}
+
+Bit32u Synth::getRenderPassLength() const {
+	return renderer.getPassLength();
+}
+
+void Synth::setRenderStatisticsEnabled(bool enabled) {
+	renderer.setStatisticsEnabled(enabled);
+}
+
+bool Synth::isRenderStatisticsEnabled() const {
+	return renderer.isStatisticsEnabled();
+}
+
+void Synth::getRenderStatistics(RenderStatistics &statistics) const {
+	statistics = renderer.getStatistics();
+}
+
+void Synth::resetRenderStatistics() {
+	renderer.resetStatistics();
+}
+
+void Synth::getPolyphonyStatistics(PolyphonyStatistics &statistics) const {
+	statistics = polyphonyStatistics;
+	if (polyphonyStatistics.renderedSamples > 0) {
+		statistics.averageActivePartials = activePartialSampleSum / polyphonyStatistics.renderedSamples;
+	}
+}
+
+void Synth::resetPolyphonyStatistics() {
+	memset(&polyphonyStatistics, 0, sizeof(polyphonyStatistics));
+	activePartialSampleSum = 0.0;
+}
+
+void Synth::countPolyAbort(PolyAbortReason reason, unsigned int partNum) {
+	polyphonyStatistics.abortedPolys[reason][partNum]++;
+}
+
+void Synth::setTraceRecorder(TraceRecorder *recorder, const char *trackName) {
+	traceRecorder = recorder;
+	if (recorder != NULL) {
+		traceTrack = recorder->addTrack(trackName);
+	}
+}
+
+TraceRecorder *Synth::getTraceRecorder() const {
+	return traceRecorder;
+}
+
+void Synth::traceInstant(const char *name, const char *argName, Bit32u argValue) {
+	if (traceRecorder == NULL) return;
+	traceRecorder->recordInstant(traceTrack, name, TraceRecorder::getTime(), argName, argValue);
+}
+
+void Synth::setPCMROMCacheDirectory(const char *directory) {
+	ROMDataCache::setPCMROMCacheDirectory(directory);
+}
+
+SIMDLevel Synth::getSupportedSIMDLevel() {
+	return CPUFeatures::getSupportedSIMDLevel();
+}
+
+void Synth::setSIMDLevel(SIMDLevel level) {
+	requestedSIMDLevel = level;
+}
+
+SIMDLevel Synth::getSIMDLevel() const {
+	return opened ? simdLevel : requestedSIMDLevel;
+}
+
+// The environment variable allows forcing a level for testing without the client's involvement
+void Synth::selectSIMDLevel() {
+	SIMDLevel level = requestedSIMDLevel;
+	if (level == SIMDLevel_AUTO) {
+		const char *levelName = getenv("MT32EMU_SIMD_LEVEL");
+		if (levelName != NULL && *levelName != 0 && !CPUFeatures::parseSIMDLevel(levelName, level)) {
+			printDebug("Ignoring unknown SIMD level '%s' in MT32EMU_SIMD_LEVEL", levelName);
+		}
+	}
+	const SIMDLevel supportedLevel = CPUFeatures::getSupportedSIMDLevel();
+	if (level == SIMDLevel_AUTO) {
+		level = supportedLevel;
+	} else if (level > supportedLevel) {
+		printDebug("SIMD level %s isn't supported by the CPU, using %s instead", CPUFeatures::getSIMDLevelName(level), CPUFeatures::getSIMDLevelName(supportedLevel));
+		level = supportedLevel;
+	}
+	simdLevel = level;
+#if MT32EMU_MONITOR_INIT
+	printDebug("Using SIMD level %s", CPUFeatures::getSIMDLevelName(simdLevel));
+#endif
+}
+
 bool Synth::loadControlROM(const ROMImage &controlROMImage) {
-	File *file = controlROMImage.getFile();
 	const ROMInfo *controlROMInfo = controlROMImage.getROMInfo();
 	if ((controlROMInfo == NULL)
 			|| (controlROMInfo->type != ROMInfo::Control)
@@ -387,8 +747,8 @@ bool Synth::loadControlROM(const ROMImage &controlROMImage) {
 #if MT32EMU_MONITOR_INIT
 	printDebug("Found Control ROM: %s, %s", controlROMInfo->shortName, controlROMInfo->description);
 #endif
-	const Bit8u *fileData = file->getData();
-	memcpy(controlROMData, fileData, CONTROL_ROM_SIZE);
+	ROMDataCache::release(controlROMData);
+	controlROMData = ROMDataCache::acquireControlROM(controlROMImage);
 
 	// Control ROM successfully loaded, now check whether it's a known type
 	controlROMMap = NULL;
@@ -424,30 +784,21 @@ bool Synth::loadPCMROM(const ROMImage &pcmROMImage) {
 #endif
 		return false;
 	}
-	const Bit8u *fileData = file->getData();
-	for (size_t i = 0; i < pcmROMSize; i++) {
-		Bit8u s = *(fileData++);
-		Bit8u c = *(fileData++);
-
-		int order[16] = {0, 9, 1, 2, 3, 4, 5, 6, 7, 10, 11, 12, 13, 14, 15, 8};
-
-		signed short log = 0;
-		for (int u = 0; u < 15; u++) {
-			int bit;
-			if (order[u] < 8) {
-				bit = (s >> (7 - order[u])) & 0x1;
-			} else {
-				bit = (c >> (7 - (order[u] - 8))) & 0x1;
-			}
-			log = log | (short)(bit << (15 - u));
-		}
-		pcmROMData[i] = log;
-	}
+	ROMDataCache::release(pcmROMData);
+	pcmROMData = ROMDataCache::acquirePCMROM(pcmROMImage);
+	pcmROMLogData = NULL;
 	return true;
 }
 
+// The conversion to the log-space is deferred until a PCM partial needs it, so that opening a synth with the PCM ROM data
+// mapped from the cache file doesn't touch all the samples.
+const Bit32u *Synth::getPCMROMLogData() {
+	if (pcmROMLogData == NULL) pcmROMLogData = ROMDataCache::getPCMROMLogSamples(pcmROMData);
+	return pcmROMLogData;
+}
+
 bool Synth::initPCMList(Bit16u mapAddress, Bit16u count) {
-	ControlROMPCMStruct *tps = (ControlROMPCMStruct *)&controlROMData[mapAddress];
+	const ControlROMPCMStruct *tps = (const ControlROMPCMStruct *)&controlROMData[mapAddress];
 	for (int i = 0; i < count; i++) {
 		Bit32u rAddr = tps[i].pos * 0x800;
 		Bit32u rLenExp = (tps[i].len & 0x70) >> 4;
@@ -531,6 +882,9 @@ bool Synth::open(const ROMImage &controlROMImage, const ROMImage &pcmROMImage, u
 	}
 	partialCount = usePartialCount;
 	abortingPoly = NULL;
+	resetPolyphonyStatistics();
+	selectSIMDLevel();
+	renderer.selectKernels(simdLevel);
 
 	// This is to help detect bugs
 	memset(&mt32ram, '?', sizeof(mt32ram));
@@ -550,7 +904,6 @@ bool Synth::open(const ROMImage &controlROMImage, const ROMImage &pcmROMImage, u
 	// 1MB PCM ROM for CM-32L, LAPC-I, CM-64, CM-500
 	// Note that the size below is given in samples (16-bit), not bytes
 	pcmROMSize = controlROMMap->pcmCount == 256 ? 512 * 1024 : 256 * 1024;
-	pcmROMData = new Bit16s[pcmROMSize];
 
 #if MT32EMU_MONITOR_INIT
 	printDebug("Loading PCM ROM");
@@ -598,6 +951,7 @@ bool Synth::open(const ROMImage &controlROMImage, const ROMImage &pcmROMImage, u
 	memset(&mt32ram.timbres[128], 0, sizeof(mt32ram.timbres[128]) * 64);
 
 	partialManager = new PartialManager(this, parts);
+	patchCacheStore = new PatchCacheStore;
 
 	pcmWaves = new PCMWaveEntry[controlROMMap->pcmCount];
 
@@ -682,12 +1036,14 @@ bool Synth::open(const ROMImage &controlROMImage, const ROMImage &pcmROMImage, u
 	// For resetting mt32 mid-execution
 	mt32default = mt32ram;
 
-	midiQueue = new MidiEventQueue();
+	midiQueue = new MidiEventQueue(DEFAULT_MIDI_EVENT_QUEUE_SIZE, midiQueueSysexStorageSize);
 
-	analog = new Analog(analogOutputMode, controlROMFeatures->oldMT32AnalogLPF);
+	analog = new Analog(analogOutputMode, controlROMFeatures->oldMT32AnalogLPF, simdLevel);
 	setOutputGain(outputGain);
 	setReverbOutputGain(reverbOutputGain);
 
+	renderer.openThreadPool();
+
 	opened = true;
 	isEnabled = false;
 
@@ -704,6 +1060,8 @@ void Synth::close(bool forced) {
 
 	opened = false;
 
+	renderer.closeThreadPool();
+
 	delete midiQueue;
 	midiQueue = NULL;
 
@@ -713,6 +1071,9 @@ void Synth::close(bool forced) {
 	delete partialManager;
 	partialManager = NULL;
 
+	delete patchCacheStore;
+	patchCacheStore = NULL;
+
 	for (int i = 0; i < 9; i++) {
 		delete parts[i];
 		parts[i] = NULL;
@@ -724,8 +1085,12 @@ void Synth::close(bool forced) {
 	delete[] pcmWaves;
 	pcmWaves = NULL;
 
-	delete[] pcmROMData;
+	ROMDataCache::release(pcmROMData);
 	pcmROMData = NULL;
+	pcmROMLogData = NULL;
+
+	ROMDataCache::release(controlROMData);
+	controlROMData = NULL;
 
 	deleteMemoryRegions();
 
@@ -773,10 +1138,22 @@ Bit32u Synth::setMIDIEventQueueSize(Bit32u useSize) {
 		binarySize = MAX_QUEUE_SIZE;
 	}
 	delete midiQueue;
-	midiQueue = new MidiEventQueue(binarySize);
+	midiQueue = new MidiEventQueue(binarySize, midiQueueSysexStorageSize);
 	return binarySize;
 }
 
+Bit32u Synth::configureMIDIEventQueueSysexStorage(Bit32u storageBufferSize) {
+	midiQueueSysexStorageSize = storageBufferSize;
+
+	if (midiQueue == NULL) return 0;
+	flushMIDIQueue();
+
+	Bit32u queueSize = midiQueue->getSize();
+	delete midiQueue;
+	midiQueue = new MidiEventQueue(queueSize, midiQueueSysexStorageSize);
+	return midiQueue->getSysexStorageSize();
+}
+
 Bit32u Synth::getShortMessageLength(Bit32u msg) {
 	if ((msg & 0xF0) == 0xF0) {
 		switch (msg & 0xFF) {
@@ -796,13 +1173,17 @@ Bit32u Synth::getShortMessageLength(Bit32u msg) {
 
 Bit32u Synth::addMIDIInterfaceDelay(Bit32u len, Bit32u timestamp) {
 	Bit32u transferTime =  Bit32u((double)len * MIDI_DATA_TRANSFER_RATE);
-	// Dealing with wrapping
-	if (Bit32s(timestamp - lastReceivedMIDIEventTimestamp) < 0) {
-		timestamp = lastReceivedMIDIEventTimestamp;
+	// Events may come from several threads at once, so the timestamp of the last one is updated atomically
+	for (;;) {
+		Bit32u lastTimestamp = Atomics::load(lastReceivedMIDIEventTimestamp);
+		Bit32u newTimestamp = timestamp;
+		// Dealing with wrapping
+		if (Bit32s(newTimestamp - lastTimestamp) < 0) {
+			newTimestamp = lastTimestamp;
+		}
+		newTimestamp += transferTime;
+		if (Atomics::compareAndSwap(lastReceivedMIDIEventTimestamp, lastTimestamp, newTimestamp)) return newTimestamp;
 	}
-	timestamp += transferTime;
-	lastReceivedMIDIEventTimestamp = timestamp;
-	return timestamp;
 }
 
 bool Synth::playMsg(Bit32u msg) {
@@ -840,6 +1221,7 @@ void Synth::playMsgNow(Bit32u msg) {
 	unsigned char note     = (unsigned char)((msg & 0x007F00) >> 8);
 	unsigned char velocity = (unsigned char)((msg & 0x7F0000) >> 16);
 	if (!isEnabled) isEnabled = true;
+	refreshDirtyMemoryRegions();
 
 	//printDebug("Playing chan %d, code 0x%01x note: 0x%02x", chan, code, note);
 
@@ -1152,6 +1534,307 @@ void Synth::readMemory(Bit32u addr, Bit32u len, Bit8u *data) {
 	}
 }
 
+size_t Synth::getStateSize() const {
+	if (!opened) return 0;
+	StateWriter writer;
+	saveStatePayload(writer);
+	return STATE_HEADER_LENGTH + writer.getLength();
+}
+
+bool Synth::saveState(Bit8u *buffer, size_t bufferSize) const {
+	if (!opened || buffer == NULL || bufferSize < STATE_HEADER_LENGTH) return false;
+	StateWriter writer(buffer + STATE_HEADER_LENGTH, bufferSize - STATE_HEADER_LENGTH);
+	saveStatePayload(writer);
+	if (writer.isOverflowed()) return false;
+	StateWriter headerWriter(buffer, STATE_HEADER_LENGTH);
+	headerWriter.writeBytes(STATE_MAGIC, sizeof(STATE_MAGIC));
+	headerWriter.writeBit32u(STATE_VERSION);
+	headerWriter.writeBit32u(Bit32u(writer.getLength()));
+	headerWriter.writeBit32u(writer.getChecksum());
+	return true;
+}
+
+bool Synth::loadState(const Bit8u *buffer, size_t bufferSize) {
+	if (!opened || buffer == NULL || bufferSize < STATE_HEADER_LENGTH) return false;
+	if (memcmp(buffer, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0) {
+		printDebug("loadState: Unrecognised data");
+		return false;
+	}
+	StateReader headerReader(buffer + sizeof(STATE_MAGIC), STATE_HEADER_LENGTH - sizeof(STATE_MAGIC));
+	Bit32u version = headerReader.readBit32u();
+	Bit32u payloadLength = headerReader.readBit32u();
+	Bit32u checksum = headerReader.readBit32u();
+	if (version != STATE_VERSION) {
+		printDebug("loadState: Unsupported state version %d", version);
+		return false;
+	}
+	if (bufferSize - STATE_HEADER_LENGTH < payloadLength || StateReader::calcChecksum(buffer + STATE_HEADER_LENGTH, payloadLength, 1) != checksum) {
+		printDebug("loadState: Damaged data");
+		return false;
+	}
+	StateReader reader(buffer + STATE_HEADER_LENGTH, payloadLength);
+	if (!loadStatePayload(reader)) return false;
+	if (reader.isFailed()) {
+		printDebug("loadState: Inconsistent state, resetting");
+		// The references in between the objects can't be trusted, so they are dropped outright
+		for (int i = 0; i < 9; i++) {
+			parts[i]->discardActivePolys();
+		}
+		partialManager->discardPartials();
+		abortingPoly = NULL;
+		midiQueue->reset();
+		reset();
+		return false;
+	}
+	for (int i = 0; i < 9; i++) {
+		polyStateChanged(i);
+	}
+	return true;
+}
+
+// Stores the data as a sequence of runs, each one consists of the length of the unchanged bytes, the length of the changed bytes
+// and the changed bytes themselves.
+static void saveMemoryDelta(StateWriter &writer, const Bit8u *data, const Bit8u *defaultData, Bit32u dataLength) {
+	Bit32u position = 0;
+	while (position < dataLength) {
+		Bit32u unchangedStart = position;
+		while (position < dataLength && data[position] == defaultData[position]) position++;
+		Bit32u changedStart = position;
+		Bit32u changedEnd = position;
+		while (position < dataLength) {
+			if (data[position] != defaultData[position]) {
+				changedEnd = ++position;
+			} else if (position - changedEnd < STATE_MEMORY_MIN_UNCHANGED_RUN_LENGTH) {
+				position++;
+			} else {
+				break;
+			}
+		}
+		position = changedEnd;
+		writer.writeBit32u(changedStart - unchangedStart);
+		writer.writeBit32u(changedEnd - changedStart);
+		writer.writeBytes(data + changedStart, changedEnd - changedStart);
+		if (changedStart == changedEnd) break;
+	}
+}
+
+static void loadMemoryDelta(StateReader &reader, Bit8u *data, const Bit8u *defaultData, Bit32u dataLength) {
+	memcpy(data, defaultData, dataLength);
+	Bit32u position = 0;
+	while (position < dataLength && !reader.isFailed()) {
+		Bit32u unchangedLength = reader.readBit32u();
+		Bit32u changedLength = reader.readBit32u();
+		if (dataLength - position < unchangedLength || dataLength - position - unchangedLength < changedLength) {
+			reader.fail();
+			return;
+		}
+		position += unchangedLength;
+		reader.readBytes(data + position, changedLength);
+		position += changedLength;
+		if (changedLength == 0) break;
+	}
+}
+
+void Synth::saveStatePayload(StateWriter &writer) const {
+	// Configuration the state depends upon
+	writer.writeBool(MT32EMU_USE_FLOAT_SAMPLES != 0);
+	writer.writeBool(MT32EMU_BOSS_REVERB_PRECISE_MODE != 0);
+	size_t controlROMNameLength = strlen(controlROMMap->shortName);
+	writer.writeBit8u(Bit8u(controlROMNameLength));
+	writer.writeBytes(controlROMMap->shortName, controlROMNameLength);
+	writer.writeBit32u(Bit32u(pcmROMSize));
+	writer.writeBit32u(partialCount);
+	writer.writeBit32u(getStereoOutputSampleRate());
+	writer.writeBool(isMT32ReverbCompatibilityMode());
+
+	writer.writeBit32u(renderedSampleCount);
+	writer.writeBit32u(lastReceivedMIDIEventTimestamp);
+	writer.writeBool(isEnabled);
+	writer.writeBytes(chantable, sizeof(chantable));
+	saveMemoryDelta(writer, reinterpret_cast<const Bit8u *>(&mt32ram), reinterpret_cast<const Bit8u *>(&mt32default), sizeof(MemParams));
+	for (unsigned int i = 0; i < MEMORY_REGION_COUNT; i++) {
+		saveMemoryRegionDirtyRange(writer, memoryRegions[i]);
+	}
+	for (int i = 0; i < 9; i++) {
+		parts[i]->saveState(writer);
+	}
+	partialManager->saveState(writer);
+	savePolyPointer(writer, abortingPoly);
+
+	Bit8u reverbModelIndex = STATE_NULL_PART;
+	for (Bit8u i = REVERB_MODE_ROOM; i <= REVERB_MODE_TAP_DELAY; i++) {
+		if (reverbModel == reverbModels[i]) reverbModelIndex = i;
+	}
+	writer.writeBit8u(reverbModelIndex);
+	if (reverbModel != NULL) reverbModel->saveState(writer);
+	analog->saveState(writer);
+	midiQueue->saveState(writer);
+}
+
+bool Synth::loadStatePayload(StateReader &reader) {
+	bool floatSamples = reader.readBool();
+	bool preciseReverb = reader.readBool();
+	char controlROMName[256];
+	Bit8u controlROMNameLength = reader.readBit8u();
+	reader.readBytes(controlROMName, controlROMNameLength);
+	controlROMName[controlROMNameLength] = 0;
+	Bit32u statePCMROMSize = reader.readBit32u();
+	Bit32u statePartialCount = reader.readBit32u();
+	Bit32u stateOutputSampleRate = reader.readBit32u();
+	bool stateMT32ReverbCompatibilityMode = reader.readBool();
+	if (reader.isFailed() || floatSamples != (MT32EMU_USE_FLOAT_SAMPLES != 0) || preciseReverb != (MT32EMU_BOSS_REVERB_PRECISE_MODE != 0)
+		|| strcmp(controlROMName, controlROMMap->shortName) != 0 || statePCMROMSize != pcmROMSize || statePartialCount != partialCount
+		|| stateOutputSampleRate != getStereoOutputSampleRate() || stateMT32ReverbCompatibilityMode != isMT32ReverbCompatibilityMode()) {
+		printDebug("loadState: State is incompatible with the synth configuration");
+		return false;
+	}
+
+	// From now on, the synth is modified
+	partialManager->deactivateAll();
+	abortingPoly = NULL;
+
+	renderedSampleCount = reader.readBit32u();
+	lastReceivedMIDIEventTimestamp = reader.readBit32u();
+	isEnabled = reader.readBool();
+	reader.readBytes(chantable, sizeof(chantable));
+	for (int i = 0; i < 32; i++) {
+		if (chantable[i] > 8) reader.fail();
+	}
+	loadMemoryDelta(reader, reinterpret_cast<Bit8u *>(&mt32ram), reinterpret_cast<const Bit8u *>(&mt32default), sizeof(MemParams));
+	if (mt32ram.system.reverbMode > REVERB_MODE_TAP_DELAY) reader.fail();
+	for (unsigned int i = 0; i < MEMORY_REGION_COUNT; i++) {
+		loadMemoryRegionDirtyRange(reader, memoryRegions[i]);
+	}
+	for (int i = 0; i < 9 && !reader.isFailed(); i++) {
+		parts[i]->loadState(reader);
+	}
+	if (reader.isFailed()) return true;
+	partialManager->loadState(reader);
+	abortingPoly = loadPolyPointer(reader);
+
+	BReverbModel *oldReverbModel = reverbModel;
+	Bit8u reverbModelIndex = reader.readBit8u();
+	if (reverbModelIndex <= REVERB_MODE_TAP_DELAY) {
+		reverbModel = reverbModels[reverbModelIndex];
+	} else {
+		if (reverbModelIndex != STATE_NULL_PART) reader.fail();
+		reverbModel = NULL;
+	}
+#if MT32EMU_REDUCE_REVERB_MEMORY
+	if (oldReverbModel != NULL && oldReverbModel != reverbModel) {
+		oldReverbModel->close();
+	}
+	if (reverbModel != NULL && !reverbModel->isOpen()) {
+		reverbModel->open();
+	}
+#else
+	(void)oldReverbModel;
+#endif
+	if (reverbModel != NULL) reverbModel->loadState(reader);
+	analog->loadState(reader);
+	midiQueue->loadState(reader);
+	return true;
+}
+
+void Synth::saveMemoryRegionDirtyRange(StateWriter &writer, const MemoryRegion *region) const {
+	writer.writeBool(region->dirty);
+	if (region->dirty) {
+		writer.writeBit32u(region->dirtyFirst);
+		writer.writeBit32u(region->dirtyLast);
+	}
+}
+
+void Synth::loadMemoryRegionDirtyRange(StateReader &reader, MemoryRegion *region) {
+	region->clearDirty();
+	if (reader.readBool()) {
+		unsigned int first = reader.readIndex(region->entries);
+		unsigned int last = reader.readIndex(region->entries);
+		if (first > last) reader.fail();
+		region->markDirty(first, last);
+	}
+}
+
+void Synth::savePartPointer(StateWriter &writer, const Part *part) const {
+	Bit8u partNum = STATE_NULL_PART;
+	for (Bit8u i = 0; i < 9; i++) {
+		if (parts[i] == part) partNum = i;
+	}
+	writer.writeBit8u(partNum);
+}
+
+Part *Synth::loadPartPointer(StateReader &reader) const {
+	Bit8u partNum = reader.readBit8u();
+	if (partNum == STATE_NULL_PART) return NULL;
+	if (partNum > 8) {
+		reader.fail();
+		return NULL;
+	}
+	return parts[partNum];
+}
+
+void Synth::saveMemParamsPointer(StateWriter &writer, const void *pointer) const {
+	writer.writePointer(pointer, &mt32ram, sizeof(MemParams));
+}
+
+const void *Synth::loadMemParamsPointer(StateReader &reader, size_t objectSize) const {
+	return reader.readPointer(&mt32ram, sizeof(MemParams), objectSize);
+}
+
+void Synth::savePolyPointer(StateWriter &writer, const Poly *poly) const {
+	if (poly != NULL) {
+		for (Bit8u i = 0; i < 9; i++) {
+			int polyIndex = parts[i]->getActivePolyIndex(poly);
+			if (polyIndex >= 0) {
+				writer.writeBit8u(i);
+				writer.writeBit32u(polyIndex);
+				return;
+			}
+		}
+	}
+	writer.writeBit8u(STATE_NULL_PART);
+}
+
+Poly *Synth::loadPolyPointer(StateReader &reader) const {
+	Part *part = loadPartPointer(reader);
+	if (part == NULL) return NULL;
+	Poly *poly = part->getActivePoly(reader.readBit32u());
+	if (poly == NULL) reader.fail();
+	return poly;
+}
+
+void Synth::savePatchCache(StateWriter &writer, const PatchCache &cache) const {
+	writer.writeBool(cache.playPartial);
+	writer.writeBool(cache.PCMPartial);
+	writer.writeBit32s(cache.pcm);
+	writer.writeBit8u(Bit8u(cache.waveform));
+	writer.writeBit32u(cache.structureMix);
+	writer.writeBit32s(cache.structurePosition);
+	writer.writeBit32s(cache.structurePair);
+	writer.writeBool(cache.dirty);
+	writer.writeBit32u(cache.partialCount);
+	writer.writeBool(cache.sustain);
+	writer.writeBool(cache.reverb);
+	writer.writeBytes(&cache.srcPartial, sizeof(TimbreParam::PartialParam));
+	saveMemParamsPointer(writer, cache.partialParam);
+}
+
+void Synth::loadPatchCache(StateReader &reader, PatchCache &cache) const {
+	cache.playPartial = reader.readBool();
+	cache.PCMPartial = reader.readBool();
+	cache.pcm = reader.readBit32s();
+	cache.waveform = char(reader.readBit8u());
+	cache.structureMix = reader.readBit32u();
+	cache.structurePosition = reader.readBit32s();
+	// Used to index the partials of a poly
+	cache.structurePair = reader.readIndex(4);
+	cache.dirty = reader.readBool();
+	cache.partialCount = reader.readBit32u();
+	cache.sustain = reader.readBool();
+	cache.reverb = reader.readBool();
+	reader.readBytes(&cache.srcPartial, sizeof(TimbreParam::PartialParam));
+	cache.partialParam = static_cast<const TimbreParam::PartialParam *>(loadMemParamsPointer(reader, sizeof(TimbreParam::PartialParam)));
+}
+
 void Synth::initMemoryRegions() {
 	// Timbre max tables are slightly more complicated than the others, which are used directly from the ROM.
 	// The ROM (sensibly) just has maximums for TimbreParam.commonParam followed by just one TimbreParam.partialParam,
@@ -1172,6 +1855,22 @@ void Synth::initMemoryRegions() {
 	systemMemoryRegion = new SystemMemoryRegion(this, (Bit8u *)&mt32ram.system, &controlROMData[controlROMMap->systemMaxTable]);
 	displayMemoryRegion = new DisplayMemoryRegion(this);
 	resetMemoryRegion = new ResetMemoryRegion(this);
+
+	memoryRegions[0] = patchTempMemoryRegion;
+	memoryRegions[1] = rhythmTempMemoryRegion;
+	memoryRegions[2] = timbreTempMemoryRegion;
+	memoryRegions[3] = patchesMemoryRegion;
+	memoryRegions[4] = timbresMemoryRegion;
+	memoryRegions[5] = systemMemoryRegion;
+	memoryRegions[6] = displayMemoryRegion;
+	memoryRegions[7] = resetMemoryRegion;
+	unsigned int regionIndex = 0;
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+		while (regionIndex < MEMORY_REGION_COUNT && memoryRegions[regionIndex]->regionEnd() <= (page << 14)) {
+			regionIndex++;
+		}
+		memoryRegionIndexByPage[page] = Bit8u(regionIndex);
+	}
 }
 
 void Synth::deleteMemoryRegions() {
@@ -1191,26 +1890,21 @@ void Synth::deleteMemoryRegions() {
 	displayMemoryRegion = NULL;
 	delete resetMemoryRegion;
 	resetMemoryRegion = NULL;
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+		memoryRegionIndexByPage[page] = MEMORY_REGION_COUNT;
+	}
 
 	delete[] paddedTimbreMaxTable;
 	paddedTimbreMaxTable = NULL;
 }
 
 MemoryRegion *Synth::findMemoryRegion(Bit32u addr) {
-	MemoryRegion *regions[] = {
-		patchTempMemoryRegion,
-		rhythmTempMemoryRegion,
-		timbreTempMemoryRegion,
-		patchesMemoryRegion,
-		timbresMemoryRegion,
-		systemMemoryRegion,
-		displayMemoryRegion,
-		resetMemoryRegion,
-		NULL
-	};
-	for (int pos = 0; regions[pos] != NULL; pos++) {
-		if (regions[pos]->contains(addr)) {
-			return regions[pos];
+	Bit32u page = addr >> 14;
+	if (page >= MEMORY_PAGE_COUNT) return NULL;
+	// No page intersects more than two regions, so this takes at most two iterations
+	for (unsigned int pos = memoryRegionIndexByPage[page]; pos < MEMORY_REGION_COUNT && memoryRegions[pos]->startAddr <= addr; pos++) {
+		if (memoryRegions[pos]->contains(addr)) {
+			return memoryRegions[pos];
 		}
 	}
 	return NULL;
@@ -1266,9 +1960,9 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 						parts[i]->setTimbre(&mt32ram.timbres[parts[i]->getAbsTimbreNum()].timbre);
 					}
 				}
-				parts[i]->refresh();
 			}
 		}
+		patchTempMemoryRegion->markDirty(first, last);
 		break;
 	case MR_RhythmTemp:
 		region->write(first, off, data, len);
@@ -1285,9 +1979,7 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 			printDebug("WRITE-RHYTHM (%d-%d@%d..%d): %d; level=%02x, panpot=%02x, reverb=%02x, timbre=%d (%s)", first, last, off, off + len, i, mt32ram.rhythmTemp[i].outputLevel, mt32ram.rhythmTemp[i].panpot, mt32ram.rhythmTemp[i].reverbSwitch, mt32ram.rhythmTemp[i].timbre, timbreName);
 #endif
 		}
-		if (parts[8] != NULL) {
-			parts[8]->refresh();
-		}
+		rhythmTempMemoryRegion->markDirty(first, last);
 		break;
 	case MR_TimbreTemp:
 		region->write(first, off, data, len);
@@ -1298,10 +1990,8 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 #if MT32EMU_MONITOR_SYSEX > 0
 			printDebug("WRITE-PARTTIMBRE (%d-%d@%d..%d): timbre=%d (%s)", first, last, off, off + len, i, instrumentName);
 #endif
-			if (parts[i] != NULL) {
-				parts[i]->refresh();
-			}
 		}
+		timbreTempMemoryRegion->markDirty(first, last);
 		break;
 	case MR_Patches:
 		region->write(first, off, data, len);
@@ -1319,6 +2009,7 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 		break;
 	case MR_Timbres:
 		// Timbres
+		timbresMemoryRegion->markDirty(first, last);
 		first += 128;
 		last += 128;
 		region->write(first, off, data, len);
@@ -1404,13 +2095,6 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 #undef DT
 #endif
 #endif
-			// FIXME:KG: Not sure if the stuff below should be done (for rhythm and/or parts)...
-			// Does the real MT-32 automatically do this?
-			for (unsigned int part = 0; part < 9; part++) {
-				if (parts[part] != NULL) {
-					parts[part]->refreshTimbre(i);
-				}
-			}
 		}
 		break;
 	case MR_System:
@@ -1462,6 +2146,31 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 	}
 }
 
+void Synth::refreshDirtyMemoryRegions() {
+	if (!opened) return;
+	if (timbresMemoryRegion->dirty) {
+		// FIXME:KG: Not sure if the stuff below should be done (for rhythm and/or parts)...
+		// Does the real MT-32 automatically do this?
+		for (unsigned int i = timbresMemoryRegion->dirtyFirst; i <= timbresMemoryRegion->dirtyLast; i++) {
+			for (unsigned int part = 0; part < 9; part++) {
+				parts[part]->refreshTimbre(i + 128);
+			}
+		}
+		timbresMemoryRegion->clearDirty();
+	}
+	if (!patchTempMemoryRegion->dirty && !rhythmTempMemoryRegion->dirty && !timbreTempMemoryRegion->dirty) return;
+	// Each part is refreshed once, no matter how many writes have touched it
+	for (unsigned int i = 0; i < 9; i++) {
+		bool partDirty = i < 8 ? timbreTempMemoryRegion->isDirty(i) : rhythmTempMemoryRegion->dirty;
+		if (partDirty || patchTempMemoryRegion->isDirty(i)) {
+			parts[i]->refresh();
+		}
+	}
+	patchTempMemoryRegion->clearDirty();
+	rhythmTempMemoryRegion->clearDirty();
+	timbreTempMemoryRegion->clearDirty();
+}
+
 void Synth::refreshSystemMasterTune() {
 #if MT32EMU_MONITOR_SYSEX > 0
 	//FIXME:KG: This is just an educated guess.
@@ -1564,6 +2273,9 @@ void Synth::reset() {
 	reportHandler->onDeviceReset();
 	partialManager->deactivateAll();
 	mt32ram = mt32default;
+	for (unsigned int i = 0; i < MEMORY_REGION_COUNT; i++) {
+		memoryRegions[i]->clearDirty();
+	}
 	for (int i = 0; i < 9; i++) {
 		parts[i]->reset();
 		if (i != 8) {
@@ -1576,105 +2288,56 @@ void Synth::reset() {
 	isEnabled = false;
 }
 
-MidiEvent::~MidiEvent() {
-	if (sysexData != NULL) {
-		delete[] sysexData;
-	}
-}
-
-void MidiEvent::setShortMessage(Bit32u useShortMessageData, Bit32u useTimestamp) {
-	if (sysexData != NULL) {
-		delete[] sysexData;
-	}
-	shortMessageData = useShortMessageData;
-	timestamp = useTimestamp;
-	sysexData = NULL;
-	sysexLength = 0;
-}
-
-void MidiEvent::setSysex(const Bit8u *useSysexData, Bit32u useSysexLength, Bit32u useTimestamp) {
-	if (sysexData != NULL) {
-		delete[] sysexData;
-	}
-	shortMessageData = 0;
-	timestamp = useTimestamp;
-	sysexLength = useSysexLength;
-	Bit8u *dstSysexData = new Bit8u[sysexLength];
-	sysexData = dstSysexData;
-	memcpy(dstSysexData, useSysexData, sysexLength);
-}
-
-MidiEventQueue::MidiEventQueue(Bit32u useRingBufferSize) : ringBuffer(new MidiEvent[useRingBufferSize]), ringBufferMask(useRingBufferSize - 1) {
-	memset(ringBuffer, 0, useRingBufferSize * sizeof(MidiEvent));
-	reset();
-}
-
-MidiEventQueue::~MidiEventQueue() {
-	delete[] ringBuffer;
-}
-
-void MidiEventQueue::reset() {
-	startPosition = 0;
-	endPosition = 0;
-}
-
-bool MidiEventQueue::pushShortMessage(Bit32u shortMessageData, Bit32u timestamp) {
-	Bit32u newEndPosition = (endPosition + 1) & ringBufferMask;
-	// Is ring buffer full?
-	if (startPosition == newEndPosition) return false;
-	ringBuffer[endPosition].setShortMessage(shortMessageData, timestamp);
-	endPosition = newEndPosition;
-	return true;
-}
-
-bool MidiEventQueue::pushSysex(const Bit8u *sysexData, Bit32u sysexLength, Bit32u timestamp) {
-	Bit32u newEndPosition = (endPosition + 1) & ringBufferMask;
-	// Is ring buffer full?
-	if (startPosition == newEndPosition) return false;
-	ringBuffer[endPosition].setSysex(sysexData, sysexLength, timestamp);
-	endPosition = newEndPosition;
-	return true;
-}
-
-const MidiEvent *MidiEventQueue::peekMidiEvent() {
-	return (startPosition == endPosition) ? NULL : &ringBuffer[startPosition];
-}
-
-void MidiEventQueue::dropMidiEvent() {
-	// Is ring buffer empty?
-	if (startPosition != endPosition) {
-		startPosition = (startPosition + 1) & ringBufferMask;
-	}
-}
-
-bool MidiEventQueue::isFull() const {
-	return startPosition == ((endPosition + 1) & ringBufferMask);
-}
-
 unsigned int Synth::getStereoOutputSampleRate() const {
 	return (analog == NULL) ? SAMPLE_RATE : analog->getOutputSampleRate();
 }
 
 void Renderer::render(SampleFormatConverter &converter, Bit32u len) {
+	double renderStartTime = startStage();
+	double traceStartTime = startTrace();
 	if (!synth.isEnabled) {
 		synth.renderedSampleCount += synth.analog->getDACStreamsLength(len);
+		synth.polyphonyStatistics.renderedSamples += synth.analog->getDACStreamsLength(len);
+		double analogStartTime = startStage();
 		synth.analog->process(NULL, NULL, NULL, NULL, NULL, NULL, NULL, len);
+		endStage(statistics.analog, analogStartTime);
 		converter.addSilence(len << 1);
+		endStage(statistics.total, renderStartTime);
+		endTrace("render", traceStartTime, "frames", len);
 		return;
 	}
+	Bit32u frameCount = len;
 
 	// As in AnalogOutputMode_ACCURATE mode output is upsampled, buffer size MAX_SAMPLES_PER_RUN is more than enough.
+	// Only the leading passLength samples are actually used, so that the buffers stay in cache from one stage to the next.
 	Sample tmpNonReverbLeft[MAX_SAMPLES_PER_RUN], tmpNonReverbRight[MAX_SAMPLES_PER_RUN];
 	Sample tmpReverbDryLeft[MAX_SAMPLES_PER_RUN], tmpReverbDryRight[MAX_SAMPLES_PER_RUN];
 	Sample tmpReverbWetLeft[MAX_SAMPLES_PER_RUN], tmpReverbWetRight[MAX_SAMPLES_PER_RUN];
 
 	while (len > 0) {
-		Bit32u thisPassLen = len > MAX_SAMPLES_PER_RUN ? MAX_SAMPLES_PER_RUN : len;
-		synth.renderStreams(tmpNonReverbLeft, tmpNonReverbRight, tmpReverbDryLeft, tmpReverbDryRight, tmpReverbWetLeft, tmpReverbWetRight, synth.analog->getDACStreamsLength(thisPassLen));
+		Bit32u thisPassLen = len > passLength ? passLength : len;
+		SampleFormatConverter convNonReverbLeft(tmpNonReverbLeft), convNonReverbRight(tmpNonReverbRight);
+		SampleFormatConverter convReverbDryLeft(tmpReverbDryLeft), convReverbDryRight(tmpReverbDryRight);
+		SampleFormatConverter convReverbWetLeft(tmpReverbWetLeft), convReverbWetRight(tmpReverbWetRight);
+		renderStreamsWithEvents(
+			convNonReverbLeft, convNonReverbRight,
+			convReverbDryLeft, convReverbDryRight,
+			convReverbWetLeft, convReverbWetRight,
+			synth.analog->getDACStreamsLength(thisPassLen));
+		double analogStartTime = startStage();
 		synth.analog->process(converter.sampleBuffer, tmpNonReverbLeft, tmpNonReverbRight, tmpReverbDryLeft, tmpReverbDryRight, tmpReverbWetLeft, tmpReverbWetRight, thisPassLen);
-		converter.convert(thisPassLen << 1);
+		endStage(statistics.analog, analogStartTime);
+		if (converter.isConversionNeeded()) {
+			double conversionStartTime = startStage();
+			converter.convert(thisPassLen << 1, convertSamplesKernel);
+			endStage(statistics.conversion, conversionStartTime);
+		} else {
+			converter.convert(thisPassLen << 1, convertSamplesKernel);
+		}
 		len -= thisPassLen;
 	}
+	endStage(statistics.total, renderStartTime);
+	endTrace("render", traceStartTime, "frames", frameCount);
 }
 
 void Synth::render(Bit16s *stream, Bit32u len) {
@@ -1700,45 +2363,40 @@ void Renderer::renderStreams(
 	SampleFormatConverter &reverbDryLeft, SampleFormatConverter &reverbDryRight,
 	SampleFormatConverter &reverbWetLeft, SampleFormatConverter &reverbWetRight,
 	Bit32u len)
+{
+	double renderStartTime = startStage();
+	double traceStartTime = startTrace();
+	renderStreamsWithEvents(nonReverbLeft, nonReverbRight, reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, len);
+	endStage(statistics.total, renderStartTime);
+	endTrace("renderStreams", traceStartTime, "frames", len);
+}
+
+void Renderer::renderStreamsWithEvents(
+	SampleFormatConverter &nonReverbLeft, SampleFormatConverter &nonReverbRight,
+	SampleFormatConverter &reverbDryLeft, SampleFormatConverter &reverbDryRight,
+	SampleFormatConverter &reverbWetLeft, SampleFormatConverter &reverbWetRight,
+	Bit32u len)
 {
 	while (len > 0) {
-		// We need to ensure zero-duration notes will play so add minimum 1-sample delay.
-		Bit32u thisLen = 1;
-		if (!synth.isAbortingPoly()) {
-			const MidiEvent *nextEvent = synth.midiQueue->peekMidiEvent();
-			Bit32s samplesToNextEvent = (nextEvent != NULL) ? Bit32s(nextEvent->timestamp - synth.renderedSampleCount) : MAX_SAMPLES_PER_RUN;
-			if (samplesToNextEvent > 0) {
-				thisLen = len > MAX_SAMPLES_PER_RUN ? MAX_SAMPLES_PER_RUN : len;
-				if (thisLen > (Bit32u)samplesToNextEvent) {
-					thisLen = samplesToNextEvent;
-				}
-			} else {
-				if (nextEvent->sysexData == NULL) {
-					synth.playMsgNow(nextEvent->shortMessageData);
-					// If a poly is aborting we don't drop the event from the queue.
-					// Instead, we'll return to it again when the abortion is done.
-					if (!synth.isAbortingPoly()) {
-						synth.midiQueue->dropMidiEvent();
-					}
-				} else {
-					synth.playSysexNow(nextEvent->sysexData, nextEvent->sysexLength);
-					synth.midiQueue->dropMidiEvent();
-				}
-			}
-		}
-		doRenderStreams(
+		Bit32u thisPassLen = len > passLength ? passLength : len;
+		double passTraceStartTime = startTrace();
+		renderPass(
 			nonReverbLeft.sampleBuffer, nonReverbRight.sampleBuffer,
 			reverbDryLeft.sampleBuffer, reverbDryRight.sampleBuffer,
 			reverbWetLeft.sampleBuffer, reverbWetRight.sampleBuffer,
-			thisLen);
-		nonReverbLeft.convert(thisLen);
-		nonReverbRight.convert(thisLen);
-		reverbDryLeft.convert(thisLen);
-		reverbDryRight.convert(thisLen);
-		reverbWetLeft.convert(thisLen);
-		reverbWetRight.convert(thisLen);
-		len -= thisLen;
+			thisPassLen);
+		double conversionStartTime = startStage();
+		nonReverbLeft.convert(thisPassLen, convertSamplesKernel);
+		nonReverbRight.convert(thisPassLen, convertSamplesKernel);
+		reverbDryLeft.convert(thisPassLen, convertSamplesKernel);
+		reverbDryRight.convert(thisPassLen, convertSamplesKernel);
+		reverbWetLeft.convert(thisPassLen, convertSamplesKernel);
+		reverbWetRight.convert(thisPassLen, convertSamplesKernel);
+		endStage(statistics.conversion, conversionStartTime);
+		endTrace("renderPass", passTraceStartTime, "frames", thisPassLen);
+		len -= thisPassLen;
 	}
+	synth.refreshDirtyMemoryRegions();
 }
 
 void Synth::renderStreams(
@@ -1825,7 +2483,139 @@ void Renderer::convertSamplesToOutput(Sample *buffer, Bit32u len) {
 #endif
 }
 
-void Renderer::doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len) {
+Renderer::~Renderer() {
+	closeThreadPool();
+}
+
+void Renderer::selectKernels(SIMDLevel simdLevel) {
+	convertSamplesKernel = selectConvertSamplesKernel(simdLevel);
+	mixPartialOutputKernel = selectMixPartialOutputKernel(simdLevel);
+}
+
+void Renderer::setThreadCount(Bit32u threadCount) {
+	requestedThreadCount = threadCount;
+	if (synth.opened) {
+		closeThreadPool();
+		openThreadPool();
+	}
+}
+
+void Renderer::setPassLength(Bit32u length) {
+	if (length < 1) length = 1;
+	if (length > MAX_SAMPLES_PER_RUN) length = MAX_SAMPLES_PER_RUN;
+	passLength = length;
+}
+
+Bit32u Renderer::getPassLength() const {
+	return passLength;
+}
+
+Bit32u Renderer::getThreadCount() const {
+	return threadPool == NULL ? 1 : threadPool->getThreadCount();
+}
+
+void Renderer::setStatisticsEnabled(bool enabled) {
+#if MT32EMU_RENDER_STATISTICS
+	statisticsEnabled = enabled;
+#else
+	(void)enabled;
+#endif
+}
+
+bool Renderer::isStatisticsEnabled() const {
+	return statisticsEnabled;
+}
+
+const RenderStatistics &Renderer::getStatistics() const {
+	return statistics;
+}
+
+void Renderer::resetStatistics() {
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+void Renderer::openThreadPool() {
+	Bit32u threadCount = requestedThreadCount < synth.partialCount ? requestedThreadCount : synth.partialCount;
+	threadPool = RenderThreadPool::createRenderThreadPool(threadCount);
+	if (threadPool == NULL) {
+		if (requestedThreadCount > 1) synth.printDebug("Multi-threaded rendering unavailable, using a single thread");
+		return;
+	}
+	partialRenderJobs = new PartialRenderJob[synth.partialCount];
+	partialBuffers = new Sample[2 * MAX_SAMPLES_PER_RUN * synth.partialCount];
+	for (unsigned int i = 0; i < synth.partialCount; i++) {
+		partialRenderJobs[i].leftBuffer = partialBuffers + 2 * MAX_SAMPLES_PER_RUN * i;
+		partialRenderJobs[i].rightBuffer = partialRenderJobs[i].leftBuffer + MAX_SAMPLES_PER_RUN;
+	}
+}
+
+void Renderer::closeThreadPool() {
+	delete threadPool;
+	threadPool = NULL;
+	delete[] partialRenderJobs;
+	partialRenderJobs = NULL;
+	delete[] partialBuffers;
+	partialBuffers = NULL;
+}
+
+void Renderer::runJob(Bit32u jobIndex) {
+	PartialRenderJob &job = partialRenderJobs[jobIndex];
+	Synth::muteSampleBuffer(job.leftBuffer, threadedRunLength);
+	Synth::muteSampleBuffer(job.rightBuffer, threadedRunLength);
+	job.rendered = job.partial->produceOutput(job.leftBuffer, job.rightBuffer, threadedRunLength);
+}
+
+void Renderer::renderPartials(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Bit32u len) {
+	if (threadPool != NULL && len >= MIN_SAMPLES_PER_THREADED_RUN) {
+		renderPartialsThreaded(nonReverbLeft, nonReverbRight, reverbDryLeft, reverbDryRight, len);
+		return;
+	}
+	PartialManager &partialManager = *synth.partialManager;
+	for (unsigned int i = partialManager.getNextActivePartialNum(0); i < synth.getPartialCount(); i = partialManager.getNextActivePartialNum(i + 1)) {
+		if (partialManager.shouldReverb(i)) {
+			partialManager.produceOutput(i, reverbDryLeft, reverbDryRight, len);
+		} else {
+			partialManager.produceOutput(i, nonReverbLeft, nonReverbRight, len);
+		}
+	}
+}
+
+void Renderer::renderPartialsThreaded(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Bit32u len) {
+	// Collect the partials that are about to produce output. Ring modulating slaves are rendered along with their masters,
+	// so they are skipped here. Whether a partial should reverb can't change while rendering others.
+	PartialManager &partialManager = *synth.partialManager;
+	Bit32u jobCount = 0;
+	for (unsigned int i = partialManager.getNextActivePartialNum(0); i < synth.getPartialCount(); i = partialManager.getNextActivePartialNum(i + 1)) {
+		Partial *partial = partialManager.getPartial(i);
+		if (partial->alreadyOutputed || partial->isRingModulatingSlave()) continue;
+		PartialRenderJob &job = partialRenderJobs[jobCount++];
+		job.partial = partial;
+		job.slave = partial->getRingModulatingSlave();
+		job.reverb = partial->shouldReverb();
+		job.rendered = false;
+		partial->deferDeactivation();
+		if (job.slave != NULL) job.slave->deferDeactivation();
+	}
+
+	threadedRunLength = len;
+	threadPool->run(*this, jobCount);
+
+	for (Bit32u jobIndex = 0; jobIndex < jobCount; jobIndex++) {
+		PartialRenderJob &job = partialRenderJobs[jobIndex];
+		if (job.rendered) {
+			mixPartialOutputKernel(job.reverb ? reverbDryLeft : nonReverbLeft, job.leftBuffer, len);
+			mixPartialOutputKernel(job.reverb ? reverbDryRight : nonReverbRight, job.rightBuffer, len);
+		}
+		// Notify polys about deactivated partials in the same order as sequential rendering would do
+		job.partial->completeDeferredDeactivation();
+		if (job.slave != NULL) job.slave->completeDeferredDeactivation();
+	}
+}
+
+// Renders a pass of the streams. MIDI events are dispatched at their timestamps within the pass, and only rendering
+// of partials is split into segments between the events. The remaining stages process the whole pass at once,
+// except that the reverb is brought up to date before anything that may change its configuration or state.
+void Renderer::renderPass(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len) {
 	// Even if LA32 output isn't desired, we proceed anyway with temp buffers
 	Sample tmpBufNonReverbLeft[MAX_SAMPLES_PER_RUN], tmpBufNonReverbRight[MAX_SAMPLES_PER_RUN];
 	if (nonReverbLeft == NULL) nonReverbLeft = tmpBufNonReverbLeft;
@@ -1835,55 +2625,118 @@ void Renderer::doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sa
 	if (reverbDryLeft == NULL) reverbDryLeft = tmpBufReverbDryLeft;
 	if (reverbDryRight == NULL) reverbDryRight = tmpBufReverbDryRight;
 
-	if (synth.isEnabled) {
-		Synth::muteSampleBuffer(nonReverbLeft, len);
-		Synth::muteSampleBuffer(nonReverbRight, len);
-		Synth::muteSampleBuffer(reverbDryLeft, len);
-		Synth::muteSampleBuffer(reverbDryRight, len);
+	Synth::muteSampleBuffer(nonReverbLeft, len);
+	Synth::muteSampleBuffer(nonReverbRight, len);
+	Synth::muteSampleBuffer(reverbDryLeft, len);
+	Synth::muteSampleBuffer(reverbDryRight, len);
 
-		for (unsigned int i = 0; i < synth.getPartialCount(); i++) {
-			if (synth.partialManager->shouldReverb(i)) {
-				synth.partialManager->produceOutput(i, reverbDryLeft, reverbDryRight, len);
+	// The reverb is processed in runs of samples rendered with the synth either enabled or not
+	Bit32u reverbRunStart = 0;
+	bool reverbRunEnabled = synth.isEnabled;
+	Bit32u renderedLen = 0;
+	while (renderedLen < len) {
+		// We need to ensure zero-duration notes will play so add minimum 1-sample delay.
+		Bit32u segmentLen = 1;
+		if (!synth.isAbortingPoly()) {
+			const MidiEvent *nextEvent = synth.midiQueue->peekMidiEvent();
+			Bit32s samplesToNextEvent = (nextEvent != NULL) ? Bit32s(nextEvent->timestamp - synth.renderedSampleCount) : Bit32s(len - renderedLen);
+			if (samplesToNextEvent > 0) {
+				segmentLen = len - renderedLen;
+				if (segmentLen > (Bit32u)samplesToNextEvent) {
+					segmentLen = samplesToNextEvent;
+				}
 			} else {
-				synth.partialManager->produceOutput(i, nonReverbLeft, nonReverbRight, len);
+				if (nextEvent->sysexData != NULL) {
+					// SysEx may reconfigure or reset the reverb, so it must have processed the preceding samples by now
+					processReverb(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, reverbRunStart, renderedLen, reverbRunEnabled);
+					reverbRunStart = renderedLen;
+				}
+				double midiStartTime = startStage();
+				double traceStartTime = startTrace();
+				if (nextEvent->sysexData == NULL) {
+					Bit32u msg = nextEvent->shortMessageData;
+					synth.playMsgNow(msg);
+					// If a poly is aborting we don't drop the event from the queue.
+					// Instead, we'll return to it again when the abortion is done.
+					if (!synth.isAbortingPoly()) {
+						synth.midiQueue->dropMidiEvent();
+					}
+					endTrace("playMsgNow", traceStartTime, "message", msg);
+				} else {
+					Bit32u sysexLength = nextEvent->sysexLength;
+					synth.playSysexNow(nextEvent->sysexData, sysexLength);
+					synth.midiQueue->dropMidiEvent();
+					endTrace("playSysexNow", traceStartTime, "length", sysexLength);
+				}
+				endStage(statistics.midi, midiStartTime);
 			}
 		}
-
-		produceLA32Output(reverbDryLeft, len);
-		produceLA32Output(reverbDryRight, len);
-
-		if (synth.isReverbEnabled()) {
-			synth.reverbModel->process(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, len);
-			if (reverbWetLeft != NULL) convertSamplesToOutput(reverbWetLeft, len);
-			if (reverbWetRight != NULL) convertSamplesToOutput(reverbWetRight, len);
-		} else {
-			Synth::muteSampleBuffer(reverbWetLeft, len);
-			Synth::muteSampleBuffer(reverbWetRight, len);
+		if (synth.isEnabled != reverbRunEnabled) {
+			processReverb(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, reverbRunStart, renderedLen, reverbRunEnabled);
+			reverbRunStart = renderedLen;
+			reverbRunEnabled = synth.isEnabled;
 		}
-
-		// Don't bother with conversion if the output is going to be unused
-		if (nonReverbLeft != tmpBufNonReverbLeft) {
-			produceLA32Output(nonReverbLeft, len);
-			convertSamplesToOutput(nonReverbLeft, len);
+		if (synth.isAbortingPoly()) {
+			synth.polyphonyStatistics.abortWaitSamples += segmentLen;
 		}
-		if (nonReverbRight != tmpBufNonReverbRight) {
-			produceLA32Output(nonReverbRight, len);
-			convertSamplesToOutput(nonReverbRight, len);
+		synth.polyphonyStatistics.renderedSamples += segmentLen;
+		synth.activePartialSampleSum += double(synth.partialManager->getActivePartialCount()) * segmentLen;
+		if (synth.isEnabled) {
+			double partialsStartTime = startStage();
+			renderPartials(nonReverbLeft + renderedLen, nonReverbRight + renderedLen, reverbDryLeft + renderedLen, reverbDryRight + renderedLen, segmentLen);
+			endStage(statistics.partials, partialsStartTime);
 		}
-		if (reverbDryLeft != tmpBufReverbDryLeft) convertSamplesToOutput(reverbDryLeft, len);
-		if (reverbDryRight != tmpBufReverbDryRight) convertSamplesToOutput(reverbDryRight, len);
-	} else {
-		// Avoid muting buffers that wasn't requested
-		if (nonReverbLeft != tmpBufNonReverbLeft) Synth::muteSampleBuffer(nonReverbLeft, len);
-		if (nonReverbRight != tmpBufNonReverbRight) Synth::muteSampleBuffer(nonReverbRight, len);
-		if (reverbDryLeft != tmpBufReverbDryLeft) Synth::muteSampleBuffer(reverbDryLeft, len);
-		if (reverbDryRight != tmpBufReverbDryRight) Synth::muteSampleBuffer(reverbDryRight, len);
+		synth.partialManager->clearAlreadyOutputed();
+		synth.renderedSampleCount += segmentLen;
+		renderedLen += segmentLen;
+	}
+	processReverb(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, reverbRunStart, len, reverbRunEnabled);
+
+	// The conversions below leave silence intact, so there is no need to skip the samples rendered while the synth was disabled
+	double conversionStartTime = startStage();
+	// Don't bother with conversion if the output is going to be unused
+	if (nonReverbLeft != tmpBufNonReverbLeft) {
+		produceLA32Output(nonReverbLeft, len);
+		convertSamplesToOutput(nonReverbLeft, len);
+	}
+	if (nonReverbRight != tmpBufNonReverbRight) {
+		produceLA32Output(nonReverbRight, len);
+		convertSamplesToOutput(nonReverbRight, len);
+	}
+	if (reverbDryLeft != tmpBufReverbDryLeft) convertSamplesToOutput(reverbDryLeft, len);
+	if (reverbDryRight != tmpBufReverbDryRight) convertSamplesToOutput(reverbDryRight, len);
+	endStage(statistics.conversion, conversionStartTime);
+}
+
+// Processes the reverb input rendered in the range of samples [start, end) of the pass.
+void Renderer::processReverb(Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u start, Bit32u end, bool enabled) {
+	if (start == end) return;
+	Bit32u len = end - start;
+	if (reverbWetLeft != NULL) reverbWetLeft += start;
+	if (reverbWetRight != NULL) reverbWetRight += start;
+	if (!enabled) {
 		Synth::muteSampleBuffer(reverbWetLeft, len);
 		Synth::muteSampleBuffer(reverbWetRight, len);
+		return;
 	}
+	reverbDryLeft += start;
+	reverbDryRight += start;
+
+	double conversionStartTime = startStage();
+	produceLA32Output(reverbDryLeft, len);
+	produceLA32Output(reverbDryRight, len);
+	endStage(statistics.conversion, conversionStartTime);
 
-	synth.partialManager->clearAlreadyOutputed();
-	synth.renderedSampleCount += len;
+	if (synth.isReverbEnabled()) {
+		double reverbStartTime = startStage();
+		synth.reverbModel->process(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, len);
+		if (reverbWetLeft != NULL) convertSamplesToOutput(reverbWetLeft, len);
+		if (reverbWetRight != NULL) convertSamplesToOutput(reverbWetRight, len);
+		endStage(statistics.reverb, reverbStartTime);
+	} else {
+		Synth::muteSampleBuffer(reverbWetLeft, len);
+		Synth::muteSampleBuffer(reverbWetRight, len);
+	}
 }
 
 void Synth::printPartialUsage(unsigned long sampleOffset) {
@@ -1897,12 +2750,7 @@ void Synth::printPartialUsage(unsigned long sampleOffset) {
 }
 
 bool Synth::hasActivePartials() const {
-	for (unsigned int partialNum = 0; partialNum < getPartialCount(); partialNum++) {
-		if (partialManager->getPartial(partialNum)->isActive()) {
-			return true;
-		}
-	}
-	return false;
+	return partialManager->hasActivePartials();
 }
 
 bool Synth::isAbortingPoly() const {
@@ -36,8 +36,12 @@ class Part;
 class Poly;
 class Partial;
 class PartialManager;
+class PatchCacheStore;
 class Renderer;
 class ROMImage;
+class StateReader;
+class StateWriter;
+class TraceRecorder;
 
 class PatchTempMemoryRegion;
 class RhythmTempMemoryRegion;
@@ -52,6 +56,7 @@ struct ControlROMFeatureSet;
 struct ControlROMMap;
 struct PCMWaveEntry;
 struct MemParams;
+struct PatchCache;
 
 const Bit8u SYSEX_MANUFACTURER_ROLAND = 0x41;
 
@@ -95,6 +100,48 @@ protected:
 	virtual void onProgramChanged(int /* partNum */, const char * /* soundGroupName */, const char * /* patchName */) {}
 };
 
+// Time spent in a processing stage of the renderer along with the number of times the stage was run.
+struct RenderStageStatistics {
+	double seconds;
+	Bit32u runCount;
+};
+
+// Render statistics accumulated by the synth, see Synth::getRenderStatistics().
+struct RenderStatistics {
+	// Complete render() and renderStreams() calls, this includes all the stages below
+	RenderStageStatistics total;
+	// Processing of the queued MIDI events
+	RenderStageStatistics midi;
+	// Generation of the LA32 output by the partials
+	RenderStageStatistics partials;
+	// BReverbModel processing
+	RenderStageStatistics reverb;
+	// Emulation of the analogue circuits
+	RenderStageStatistics analog;
+	// DAC input emulation and sample format conversion
+	RenderStageStatistics conversion;
+};
+
+// Polyphony usage accumulated by the synth, see Synth::getPolyphonyStatistics().
+// Parts are indexed 0..7 for Part 1..8, 8 for Rhythm.
+struct PolyphonyStatistics {
+	// Number of notes not played because not enough partials could be freed, per part
+	Bit32u partialAllocationFailures[9];
+	// Number of notes not played because there was no free poly, per part
+	Bit32u polyAllocationFailures[9];
+	// Number of polys aborted to free up partials, indexed by PolyAbortReason and the part the aborted poly belonged to
+	Bit32u abortedPolys[4][9];
+	// Maximum number of partials active at once
+	Bit32u peakActivePartials;
+	// Number of active partials averaged over renderedSamples
+	double averageActivePartials;
+	// Number of samples rendered (at the sample rate 32000 Hz)
+	Bit32u renderedSamples;
+	// Number of samples rendered while processing of MIDI events was suspended until an aborting poly finishes,
+	// which emulates the busy-wait loop of the MCU
+	Bit32u abortWaitSamples;
+};
+
 class Synth {
 friend class Part;
 friend class Partial;
@@ -103,9 +150,13 @@ friend class Poly;
 friend class Renderer;
 friend class RhythmPart;
 friend class TVA;
+friend class TVF;
 friend class TVP;
 
 private:
+	static const unsigned int MEMORY_REGION_COUNT = 8;
+	static const unsigned int MEMORY_PAGE_COUNT = 128; // Pages of 16K addresses, selected by the first byte of a sysex address
+
 	PatchTempMemoryRegion *patchTempMemoryRegion;
 	RhythmTempMemoryRegion *rhythmTempMemoryRegion;
 	TimbreTempMemoryRegion *timbreTempMemoryRegion;
@@ -114,6 +165,9 @@ private:
 	SystemMemoryRegion *systemMemoryRegion;
 	DisplayMemoryRegion *displayMemoryRegion;
 	ResetMemoryRegion *resetMemoryRegion;
+	// All the regions ordered by address and, for each page, the index of the first region that ends past the page start
+	MemoryRegion *memoryRegions[MEMORY_REGION_COUNT];
+	Bit8u memoryRegionIndexByPage[MEMORY_PAGE_COUNT];
 
 	Bit8u *paddedTimbreMaxTable;
 
@@ -123,8 +177,9 @@ private:
 
 	const ControlROMFeatureSet *controlROMFeatures;
 	const ControlROMMap *controlROMMap;
-	Bit8u controlROMData[CONTROL_ROM_SIZE];
-	Bit16s *pcmROMData;
+	const Bit8u *controlROMData; // Shared among synths opened with the same ROM, see ROMDataCache
+	const Bit16s *pcmROMData; // Ditto
+	const Bit32u *pcmROMLogData; // Ditto, converted to the log-space for the integer LA32 wave generator on first use
 	size_t pcmROMSize; // This is in 16-bit samples, therefore half the number of bytes in the ROM
 
 	Bit8u soundGroupIx[128]; // For each standard timbre
@@ -134,6 +189,7 @@ private:
 	Bit8s chantable[32]; // FIXME: Need explanation why 32 is set, obviously it should be 16
 
 	MidiEventQueue *midiQueue;
+	Bit32u midiQueueSysexStorageSize; // As requested by the client, 0 means the default size
 	volatile Bit32u lastReceivedMIDIEventTimestamp;
 	volatile Bit32u renderedSampleCount;
 
@@ -151,6 +207,9 @@ private:
 
 	bool reversedStereoEnabled;
 
+	SIMDLevel requestedSIMDLevel;
+	SIMDLevel simdLevel; // Resolved in open(), the DSP routines are selected accordingly
+
 	bool opened;
 
 	bool isDefaultReportHandler;
@@ -158,17 +217,26 @@ private:
 
 	PartialManager *partialManager;
 	Part *parts[9];
+	PatchCacheStore *patchCacheStore;
 
 	// When a partial needs to be aborted to free it up for use by a new Poly,
 	// the controller will busy-loop waiting for the sound to finish.
 	// We emulate this by delaying new MIDI events processing until abortion finishes.
 	Poly *abortingPoly;
 
+	TraceRecorder *traceRecorder;
+	Bit32u traceTrack;
+
+	PolyphonyStatistics polyphonyStatistics;
+	double activePartialSampleSum; // Sum of the active partial count over rendered samples, averageActivePartials is derived on demand
+
 	Analog *analog;
 	Renderer &renderer;
 
 	Bit32u addMIDIInterfaceDelay(Bit32u len, Bit32u timestamp);
 	bool isAbortingPoly() const;
+	void traceInstant(const char *name, const char *argName, Bit32u argValue);
+	void countPolyAbort(PolyAbortReason reason, unsigned int partNum);
 
 	void readSysex(unsigned char channel, const Bit8u *sysex, Bit32u len) const;
 	void initMemoryRegions();
@@ -176,9 +244,14 @@ private:
 	MemoryRegion *findMemoryRegion(Bit32u addr);
 	void writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u len, const Bit8u *data);
 	void readMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u len, Bit8u *data);
+	// Refreshes the parts affected by the memory regions written since the last call, coalescing consecutive writes.
+	// Called before a short MIDI message is played and after rendering, so the parts always see the latest memory contents.
+	void refreshDirtyMemoryRegions();
 
 	bool loadControlROM(const ROMImage &controlROMImage);
 	bool loadPCMROM(const ROMImage &pcmROMImage);
+	const Bit32u *getPCMROMLogData();
+	void selectSIMDLevel();
 
 	bool initPCMList(Bit16u mapAddress, Bit16u count);
 	bool initTimbres(Bit16u mapAddress, Bit16u offset, int timbreCount, int startTimbre, bool compressed);
@@ -202,6 +275,21 @@ private:
 	// partNum should be 0..7 for Part 1..8, or 8 for Rhythm
 	const Part *getPart(unsigned int partNum) const;
 
+	// Helpers to store the emulation state, the objects are referred to by their positions within the synth.
+	// loadStatePayload() returns false if the state is rejected before the synth is modified.
+	void saveStatePayload(StateWriter &writer) const;
+	bool loadStatePayload(StateReader &reader);
+	void saveMemoryRegionDirtyRange(StateWriter &writer, const MemoryRegion *region) const;
+	void loadMemoryRegionDirtyRange(StateReader &reader, MemoryRegion *region);
+	void savePartPointer(StateWriter &writer, const Part *part) const;
+	Part *loadPartPointer(StateReader &reader) const;
+	void saveMemParamsPointer(StateWriter &writer, const void *pointer) const;
+	const void *loadMemParamsPointer(StateReader &reader, size_t objectSize) const;
+	void savePolyPointer(StateWriter &writer, const Poly *poly) const;
+	Poly *loadPolyPointer(StateReader &reader) const;
+	void savePatchCache(StateWriter &writer, const PatchCache &cache) const;
+	void loadPatchCache(StateReader &reader, PatchCache &cache) const;
+
 public:
 	static inline Bit16s clipSampleEx(Bit32s sampleEx) {
 		// Clamp values above 32767 to 32767, and values below -32768 to -32768
@@ -244,6 +332,14 @@ public:
 	// See comment for AnalogOutputMode.
 	MT32EMU_EXPORT static unsigned int getStereoOutputSampleRate(AnalogOutputMode analogOutputMode);
 
+	// Sets the directory for the on-disk cache of the unscrambled PCM ROM data, NULL (default) disables the cache.
+	// When enabled, open() memory-maps the cache file instead of decoding the PCM ROM, the file is created
+	// on the first use of each PCM ROM. The setting is process-wide and affects subsequent opening of synths only.
+	MT32EMU_EXPORT static void setPCMROMCacheDirectory(const char *directory);
+
+	// Returns the highest level of SIMD instruction set extensions the library is compiled for which the CPU supports.
+	MT32EMU_EXPORT static SIMDLevel getSupportedSIMDLevel();
+
 	// Optionally sets callbacks for reporting various errors, information and debug messages
 	MT32EMU_EXPORT Synth(ReportHandler *useReportHandler = NULL);
 	MT32EMU_EXPORT ~Synth();
@@ -265,20 +361,34 @@ public:
 	MT32EMU_EXPORT bool isOpen() const;
 
 	// All the enqueued events are processed by the synth immediately.
+	// Must not be called while other threads enqueue MIDI events.
 	MT32EMU_EXPORT void flushMIDIQueue();
 
 	// Sets size of the internal MIDI event queue. The queue size is set to the minimum power of 2 that is greater or equal to the size specified.
-	// The queue is flushed before reallocation.
+	// The queue is flushed before reallocation, so it must not be called while other threads enqueue MIDI events.
 	// Returns the actual queue size being used.
 	MT32EMU_EXPORT Bit32u setMIDIEventQueueSize(Bit32u);
 
+	// Configures size of the storage for SysEx data of the events in the internal MIDI event queue. The storage is preallocated
+	// along with the queue, so no memory is allocated while enqueuing SysEx messages. The size is rounded up to a power of 2
+	// within the range [1 KiB, 1 GiB]. SysEx messages longer than a half of the storage may be rejected even if the queue is empty.
+	// The default value 0 makes the storage size proportional to the queue size, with a minimum of 128 KiB and a maximum of 16 MiB.
+	// The setting persists through reopening the synth. If the synth is open, the queue is flushed and reallocated,
+	// so it must not be called while other threads enqueue MIDI events.
+	// Returns the actual storage size being used or 0 if the synth is closed.
+	MT32EMU_EXPORT Bit32u configureMIDIEventQueueSysexStorage(Bit32u storageBufferSize);
+
 	// Enqueues a MIDI event for subsequent playback.
 	// The MIDI event will be processed not before the specified timestamp.
 	// The timestamp is measured as the global rendered sample count since the synth was created (at the native sample rate 32000 Hz).
 	// The minimum delay involves emulation of the delay introduced while the event is transferred via MIDI interface
 	// and emulation of the MCU busy-loop while it frees partials for use by a new Poly.
-	// Calls from multiple threads must be synchronised, although, no synchronisation is required with the rendering thread.
-	// The methods return false if the MIDI event queue is full and the message cannot be enqueued.
+	// The queue is lock-free, so any number of threads may enqueue events simultaneously with no synchronisation,
+	// neither it is required with the rendering thread. Events are processed in the order of their timestamps, events with
+	// equal timestamps in the order they are enqueued in. An event enqueued with a timestamp earlier than that of an event
+	// already processed is processed as soon as possible.
+	// The methods return false if the MIDI event queue is full and the message cannot be enqueued. SysEx data is copied
+	// into a storage preallocated along with the queue, which may run out of space as well.
 
 	// Enqueues a single short MIDI message to play at specified time. The message must contain a status byte.
 	MT32EMU_EXPORT bool playMsg(Bit32u msg, Bit32u timestamp);
@@ -369,6 +479,54 @@ public:
 	// Returns whether left and right output channels are swapped.
 	MT32EMU_EXPORT bool isReversedStereoEnabled() const;
 
+	// Sets the number of threads used to render partials, including the thread that invokes render methods.
+	// Values greater than 1 enable a pool of worker threads when the synth is open (or once it gets opened).
+	// The output is bit-identical regardless of the number of threads used. Multi-threaded rendering is only
+	// available if the library is built with MT32EMU_USE_RENDER_THREADS, otherwise this setting has no effect.
+	// When the synth is open, the pool is recreated straight away, so this must not be called while rendering.
+	MT32EMU_EXPORT void setRenderThreadCount(Bit32u threadCount);
+	// Returns the number of threads actually used to render partials. Returns 1 if the synth isn't open.
+	MT32EMU_EXPORT Bit32u getRenderThreadCount() const;
+
+	// Sets the maximum number of samples rendered in a single pass through all the stages of rendering, from partials
+	// to the sample format conversion. Longer runs are split into passes, and shorter passes keep the intermediate buffers
+	// in cache. The value is clamped to the range 1..MAX_SAMPLES_PER_RUN, the default is DEFAULT_RENDER_PASS_LENGTH.
+	// The output is unaffected. Must not be called while rendering.
+	MT32EMU_EXPORT void setRenderPassLength(Bit32u length);
+	// Returns the maximum number of samples rendered in a single pass.
+	MT32EMU_EXPORT Bit32u getRenderPassLength() const;
+
+	// Sets the level of SIMD instruction set extensions the DSP routines are allowed to use. SIMDLevel_AUTO (default) selects
+	// the highest level supported by the CPU, unless the environment variable MT32EMU_SIMD_LEVEL names another one. A level
+	// the CPU doesn't support is reduced to the supported one. As the output is bit-identical regardless of the level, forcing
+	// a lower one is only useful for testing and benchmarking. Takes effect when the synth is opened.
+	MT32EMU_EXPORT void setSIMDLevel(SIMDLevel level);
+	// Returns the level of SIMD instruction set extensions used by the open synth or the level set with setSIMDLevel() otherwise.
+	MT32EMU_EXPORT SIMDLevel getSIMDLevel() const;
+
+	// Enables or disables accumulating the time spent in each stage of rendering, disabled by default.
+	// The output is unaffected. Has no effect unless the library is built with MT32EMU_RENDER_STATISTICS enabled.
+	// The methods dealing with the render statistics must be synchronised with the thread performing sample rendering.
+	MT32EMU_EXPORT void setRenderStatisticsEnabled(bool enabled);
+	// Returns whether render statistics are being accumulated.
+	MT32EMU_EXPORT bool isRenderStatisticsEnabled() const;
+	// Fills in the render statistics accumulated since the synth was created or the statistics were last reset.
+	MT32EMU_EXPORT void getRenderStatistics(RenderStatistics &statistics) const;
+	// Resets all the accumulated render statistics to zeros.
+	MT32EMU_EXPORT void resetRenderStatistics();
+
+	// Fills in the polyphony usage statistics accumulated since the synth was opened or the statistics were last reset.
+	// These are always collected. Must be synchronised with the thread performing sample rendering.
+	MT32EMU_EXPORT void getPolyphonyStatistics(PolyphonyStatistics &statistics) const;
+	// Resets all the polyphony usage statistics to zeros.
+	MT32EMU_EXPORT void resetPolyphonyStatistics();
+
+	// Attaches a recorder to capture the timeline of rendering: render calls, the passes they are split into,
+	// dispatching of MIDI events and aborting of polys. The events are recorded into a new track with the specified name.
+	// NULL detaches the recorder. The recorder must be detached before it is destroyed. Must not be called while rendering.
+	MT32EMU_EXPORT void setTraceRecorder(TraceRecorder *recorder, const char *trackName = "mt32emu Synth");
+	MT32EMU_EXPORT TraceRecorder *getTraceRecorder() const;
+
 	// Returns actual sample rate used in emulation of stereo analog circuitry of hardware units.
 	// See comment for render() below.
 	MT32EMU_EXPORT unsigned int getStereoOutputSampleRate() const;
@@ -429,6 +587,25 @@ public:
 
 	// Stores internal state of emulated synth into an array provided (as it would be acquired from hardware).
 	MT32EMU_EXPORT void readMemory(Bit32u addr, Bit32u len, Bit8u *data);
+
+	// Returns the size of the buffer sufficient to save the current emulation state, or 0 if the synth is closed.
+	// The size depends on the number of active partials and pending MIDI events, so it may change over time.
+	MT32EMU_EXPORT size_t getStateSize() const;
+
+	// Saves the complete emulation state into the buffer provided, so that loadState() continues rendering bit-exactly
+	// from the same point. This includes the synth memory, the playing notes, the reverb and the analogue filter history,
+	// as well as the events pending in the internal MIDI queue. The state is only valid for a synth opened with the same ROMs,
+	// partial count, analogue output mode and reverb compatibility mode, and built with the same sample format.
+	// Other settings (such as the output gains, DAC input mode, MIDI delay mode, reversed stereo and the reverb override)
+	// and the state of MIDI stream parsers are not saved.
+	// Must not be called while rendering. Returns false if the synth is closed or the buffer is too small.
+	MT32EMU_EXPORT bool saveState(Bit8u *buffer, size_t bufferSize) const;
+
+	// Restores the emulation state saved by saveState(), replacing the events in the internal MIDI queue.
+	// Must not be called while rendering or enqueuing MIDI events.
+	// Returns false if the synth is closed, the data is damaged or the state is incompatible with the synth configuration.
+	// If the data is rejected before restoring began, the synth is left intact, otherwise it is reset.
+	MT32EMU_EXPORT bool loadState(const Bit8u *buffer, size_t bufferSize);
 }; // class Synth
 
 } // namespace MT32Emu
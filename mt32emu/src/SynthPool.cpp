@@ -0,0 +1,435 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "internals.h"
+
+#include "SynthPool.h"
+#include "Atomics.h"
+#include "Synth.h"
+
+#if MT32EMU_USE_RENDER_THREADS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+namespace MT32Emu {
+
+// The instance slot is free and may be taken by addInstance()
+static const Bit32u INSTANCE_FREE = 0;
+// The instance is waiting for a worker to render the next block
+static const Bit32u INSTANCE_IDLE = 1;
+// A worker is rendering a block
+static const Bit32u INSTANCE_RENDERING = 2;
+// removeInstance() waits for the worker to complete the block being rendered
+static const Bit32u INSTANCE_REMOVAL_REQUESTED = 3;
+// The instance is being removed, the workers leave it alone
+static const Bit32u INSTANCE_REMOVING = 4;
+
+struct SynthPoolInstance {
+	volatile Bit32u state;
+	Synth *synth;
+
+	// Single-producer single-consumer ring of interleaved stereo frames. The positions are counted in frames
+	// and wrap around naturally. The write position is only advanced by the thread that claimed the instance,
+	// the read position is only advanced by the thread reading the output.
+	Bit16s *fifo;
+	volatile Bit32u writePosition;
+	volatile Bit32u readPosition;
+
+	volatile Bit32u underrunCount;
+};
+
+#if MT32EMU_USE_RENDER_THREADS
+
+// Lets idle workers sleep until something changes. The counter is incremented by each notification,
+// so a notification that comes after the waiter has sampled the counter is never lost.
+struct SynthPoolSignal {
+	volatile Bit32u counter;
+#ifdef _WIN32
+	volatile LONG waiterCount;
+	HANDLE semaphore;
+
+	bool init() {
+		counter = 0;
+		waiterCount = 0;
+		semaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+		return semaphore != NULL;
+	}
+
+	void deinit() {
+		CloseHandle(semaphore);
+	}
+
+	void notify() {
+		InterlockedIncrement(reinterpret_cast<volatile LONG *>(&counter));
+		LONG wakeupCount = InterlockedExchange(&waiterCount, 0);
+		if (wakeupCount > 0) {
+			ReleaseSemaphore(semaphore, wakeupCount, NULL);
+		}
+	}
+
+	void wait(Bit32u lastCounter) {
+		InterlockedIncrement(&waiterCount);
+		// If the counter has changed meanwhile, the semaphore may be released excessively which only causes a spurious wakeup
+		if (Atomics::load(counter) != lastCounter) return;
+		WaitForSingleObject(semaphore, INFINITE);
+	}
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+
+	bool init() {
+		counter = 0;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&changed, NULL);
+		return true;
+	}
+
+	void deinit() {
+		pthread_cond_destroy(&changed);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	void notify() {
+		pthread_mutex_lock(&mutex);
+		Atomics::store(counter, counter + 1);
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	void wait(Bit32u lastCounter) {
+		pthread_mutex_lock(&mutex);
+		while (counter == lastCounter) {
+			pthread_cond_wait(&changed, &mutex);
+		}
+		pthread_mutex_unlock(&mutex);
+	}
+#endif
+
+	Bit32u getCounter() const {
+		return Atomics::load(counter);
+	}
+};
+
+struct SynthPoolWorker {
+	SynthPoolData *data;
+	Bit32u index;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+#endif // #if MT32EMU_USE_RENDER_THREADS
+
+struct SynthPoolData {
+	Bit32u maxInstanceCount;
+	Bit32u blockLength;
+	Bit32u fifoLength;
+	SynthPoolInstance *instances;
+	Bit16s *fifoMemory;
+
+	Bit32u workerCount;
+	volatile Bit32u quit;
+#if MT32EMU_USE_RENDER_THREADS
+	SynthPoolWorker *workers;
+	SynthPoolSignal signal;
+#endif
+
+	Bit32u getFreeFrameCount(const SynthPoolInstance &instance) const {
+		return fifoLength - (Atomics::load(instance.writePosition) - Atomics::load(instance.readPosition));
+	}
+
+	// Must only be invoked by the thread that claimed the instance.
+	void renderBlock(SynthPoolInstance &instance) {
+		Bit32u writePosition = instance.writePosition;
+		Bit32u offset = writePosition & (fifoLength - 1);
+		Bit32u firstPartLength = fifoLength - offset;
+		if (firstPartLength >= blockLength) {
+			instance.synth->render(instance.fifo + 2 * offset, blockLength);
+		} else {
+			instance.synth->render(instance.fifo + 2 * offset, firstPartLength);
+			instance.synth->render(instance.fifo, blockLength - firstPartLength);
+		}
+		Atomics::store(instance.writePosition, writePosition + blockLength);
+	}
+
+#if MT32EMU_USE_RENDER_THREADS
+	bool tryRenderBlock(SynthPoolInstance &instance) {
+		if (Atomics::load(instance.state) != INSTANCE_IDLE || getFreeFrameCount(instance) < blockLength) return false;
+		if (!Atomics::compareAndSwap(instance.state, INSTANCE_IDLE, INSTANCE_RENDERING)) return false;
+		// The slot may have been reused by another instance since the check above, so it is repeated.
+		// The free space may only grow while the instance is claimed.
+		bool hasRoom = getFreeFrameCount(instance) >= blockLength;
+		if (hasRoom) renderBlock(instance);
+		if (!Atomics::compareAndSwap(instance.state, INSTANCE_RENDERING, INSTANCE_IDLE)) {
+			// removeInstance() is waiting
+			Atomics::compareAndSwap(instance.state, INSTANCE_REMOVAL_REQUESTED, INSTANCE_REMOVING);
+			signal.notify();
+		}
+		return hasRoom;
+	}
+
+	// Renders a block for each own instance that has room in its FIFO. If none has, steals a block of another instance.
+	// Returns false if there is nothing to render.
+	bool renderPendingBlocks(Bit32u workerIndex) {
+		bool rendered = false;
+		for (Bit32u i = workerIndex; i < maxInstanceCount; i += workerCount) {
+			if (tryRenderBlock(instances[i])) rendered = true;
+		}
+		if (rendered) return true;
+		for (Bit32u n = 1; n < maxInstanceCount; n++) {
+			Bit32u i = (workerIndex + n) % maxInstanceCount;
+			if (i % workerCount != workerIndex && tryRenderBlock(instances[i])) return true;
+		}
+		return false;
+	}
+
+	void runWorker(Bit32u workerIndex) {
+		while (!Atomics::load(quit)) {
+			Bit32u lastCounter = signal.getCounter();
+			if (!renderPendingBlocks(workerIndex)) {
+				signal.wait(lastCounter);
+			}
+		}
+	}
+
+#ifdef _WIN32
+	static DWORD WINAPI workerMain(LPVOID context) {
+		SynthPoolWorker &worker = *static_cast<SynthPoolWorker *>(context);
+		worker.data->runWorker(worker.index);
+		return 0;
+	}
+#else
+	static void *workerMain(void *context) {
+		SynthPoolWorker &worker = *static_cast<SynthPoolWorker *>(context);
+		worker.data->runWorker(worker.index);
+		return NULL;
+	}
+#endif
+
+	// Stops and joins the first startedWorkerCount workers.
+	void stopWorkers(Bit32u startedWorkerCount) {
+		Atomics::store(quit, 1);
+		signal.notify();
+		for (Bit32u i = 0; i < startedWorkerCount; i++) {
+#ifdef _WIN32
+			WaitForSingleObject(workers[i].thread, INFINITE);
+			CloseHandle(workers[i].thread);
+#else
+			pthread_join(workers[i].thread, NULL);
+#endif
+		}
+	}
+
+	void startWorkers(Bit32u requestedWorkerCount) {
+		workerCount = 0;
+		workers = NULL;
+		if (requestedWorkerCount == 0 || !signal.init()) return;
+		workers = new SynthPoolWorker[requestedWorkerCount];
+		// The worker count must be final before the workers start
+		workerCount = requestedWorkerCount;
+		for (Bit32u i = 0; i < requestedWorkerCount; i++) {
+			workers[i].data = this;
+			workers[i].index = i;
+#ifdef _WIN32
+			workers[i].thread = CreateThread(NULL, 0, workerMain, &workers[i], 0, NULL);
+			if (workers[i].thread == NULL) {
+#else
+			if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) {
+#endif
+				// Fall back to rendering in the reading threads
+				stopWorkers(i);
+				signal.deinit();
+				delete[] workers;
+				workers = NULL;
+				workerCount = 0;
+				return;
+			}
+		}
+	}
+
+	void deinitWorkers() {
+		if (workerCount == 0) return;
+		stopWorkers(workerCount);
+		signal.deinit();
+		delete[] workers;
+		workers = NULL;
+	}
+
+	void notifyWorkers() {
+		if (workerCount > 0) signal.notify();
+	}
+#else // #if MT32EMU_USE_RENDER_THREADS
+	void startWorkers(Bit32u) {
+		workerCount = 0;
+	}
+
+	void deinitWorkers() {}
+
+	void notifyWorkers() {}
+#endif // #if MT32EMU_USE_RENDER_THREADS
+};
+
+SynthPool::SynthPool(Bit32u maxInstanceCount, Bit32u workerThreadCount, Bit32u blockLength, Bit32u fifoLength) : data(*new SynthPoolData) {
+	if (blockLength == 0) blockLength = DEFAULT_BLOCK_LENGTH;
+	Bit32u minFIFOLength = 2 * blockLength;
+	if (fifoLength < minFIFOLength) fifoLength = minFIFOLength;
+	Bit32u roundedFIFOLength = 1;
+	while (roundedFIFOLength < fifoLength) {
+		roundedFIFOLength <<= 1;
+	}
+	data.maxInstanceCount = maxInstanceCount;
+	data.blockLength = blockLength;
+	data.fifoLength = roundedFIFOLength;
+	data.quit = 0;
+	data.instances = new SynthPoolInstance[maxInstanceCount];
+	data.fifoMemory = new Bit16s[2 * size_t(roundedFIFOLength) * maxInstanceCount];
+	for (Bit32u i = 0; i < maxInstanceCount; i++) {
+		SynthPoolInstance &instance = data.instances[i];
+		instance.state = INSTANCE_FREE;
+		instance.synth = NULL;
+		instance.fifo = data.fifoMemory + 2 * size_t(roundedFIFOLength) * i;
+		instance.writePosition = 0;
+		instance.readPosition = 0;
+		instance.underrunCount = 0;
+	}
+	data.startWorkers(maxInstanceCount == 0 ? 0 : workerThreadCount);
+}
+
+SynthPool::~SynthPool() {
+	data.deinitWorkers();
+	for (Bit32u i = 0; i < data.maxInstanceCount; i++) {
+		delete data.instances[i].synth;
+	}
+	delete[] data.fifoMemory;
+	delete[] data.instances;
+	delete &data;
+}
+
+Bit32u SynthPool::getMaxInstanceCount() const {
+	return data.maxInstanceCount;
+}
+
+Bit32u SynthPool::getWorkerThreadCount() const {
+	return data.workerCount;
+}
+
+Bit32u SynthPool::getBlockLength() const {
+	return data.blockLength;
+}
+
+Bit32u SynthPool::getFIFOLength() const {
+	return data.fifoLength;
+}
+
+int SynthPool::addInstance(Synth *synth) {
+	if (synth == NULL || !synth->isOpen()) return -1;
+	for (Bit32u i = 0; i < data.maxInstanceCount; i++) {
+		SynthPoolInstance &instance = data.instances[i];
+		if (Atomics::load(instance.state) != INSTANCE_FREE) continue;
+		instance.synth = synth;
+		// A worker may still be checking the free space of the slot as it was before removal
+		Atomics::store(instance.writePosition, 0);
+		Atomics::store(instance.readPosition, 0);
+		Atomics::store(instance.underrunCount, 0);
+		Atomics::store(instance.state, INSTANCE_IDLE);
+		data.notifyWorkers();
+		return int(i);
+	}
+	return -1;
+}
+
+void SynthPool::removeInstance(Bit32u instanceIndex) {
+	if (instanceIndex >= data.maxInstanceCount) return;
+	SynthPoolInstance &instance = data.instances[instanceIndex];
+	if (Atomics::load(instance.state) == INSTANCE_FREE) return;
+	// Between the attempts, a worker may release the instance and the same or another worker may claim it again,
+	// so retry until either the idle instance is taken over or the removal is requested from the rendering worker.
+	while (!Atomics::compareAndSwap(instance.state, INSTANCE_IDLE, INSTANCE_REMOVING)) {
+#if MT32EMU_USE_RENDER_THREADS
+		if (!Atomics::compareAndSwap(instance.state, INSTANCE_RENDERING, INSTANCE_REMOVAL_REQUESTED)) continue;
+		// The worker hands the instance over once the block is rendered
+		for (;;) {
+			Bit32u lastCounter = data.signal.getCounter();
+			if (Atomics::load(instance.state) == INSTANCE_REMOVING) break;
+			data.signal.wait(lastCounter);
+		}
+		break;
+#endif
+	}
+	delete instance.synth;
+	instance.synth = NULL;
+	Atomics::store(instance.state, INSTANCE_FREE);
+}
+
+Synth *SynthPool::getSynth(Bit32u instanceIndex) const {
+	if (instanceIndex >= data.maxInstanceCount) return NULL;
+	return data.instances[instanceIndex].synth;
+}
+
+Bit32u SynthPool::readOutput(Bit32u instanceIndex, Bit16s *stream, Bit32u frameCount) {
+	if (instanceIndex >= data.maxInstanceCount) return 0;
+	SynthPoolInstance &instance = data.instances[instanceIndex];
+	if (Atomics::load(instance.state) == INSTANCE_FREE) return 0;
+	if (data.workerCount == 0) {
+		// The reading thread is the only one rendering the instance
+		while (instance.writePosition - instance.readPosition < frameCount && data.getFreeFrameCount(instance) >= data.blockLength) {
+			data.renderBlock(instance);
+		}
+	}
+	Bit32u readPosition = instance.readPosition;
+	Bit32u bufferedFrameCount = Atomics::load(instance.writePosition) - readPosition;
+	Bit32u readFrameCount = bufferedFrameCount < frameCount ? bufferedFrameCount : frameCount;
+	Bit32u offset = readPosition & (data.fifoLength - 1);
+	Bit32u firstPartLength = data.fifoLength - offset;
+	if (firstPartLength >= readFrameCount) {
+		memcpy(stream, instance.fifo + 2 * offset, 2 * sizeof(Bit16s) * readFrameCount);
+	} else {
+		memcpy(stream, instance.fifo + 2 * offset, 2 * sizeof(Bit16s) * firstPartLength);
+		memcpy(stream + 2 * firstPartLength, instance.fifo, 2 * sizeof(Bit16s) * (readFrameCount - firstPartLength));
+	}
+	Atomics::store(instance.readPosition, readPosition + readFrameCount);
+	if (readFrameCount < frameCount) {
+		Atomics::store(instance.underrunCount, instance.underrunCount + 1);
+	}
+	// Workers skip the instances without room for a block, so they need to know once there is
+	Bit32u freeFrameCount = data.fifoLength - bufferedFrameCount;
+	if (freeFrameCount < data.blockLength && freeFrameCount + readFrameCount >= data.blockLength) {
+		data.notifyWorkers();
+	}
+	return readFrameCount;
+}
+
+Bit32u SynthPool::getBufferedFrameCount(Bit32u instanceIndex) const {
+	if (instanceIndex >= data.maxInstanceCount) return 0;
+	const SynthPoolInstance &instance = data.instances[instanceIndex];
+	return Atomics::load(instance.writePosition) - Atomics::load(instance.readPosition);
+}
+
+Bit32u SynthPool::getUnderrunCount(Bit32u instanceIndex) const {
+	if (instanceIndex >= data.maxInstanceCount) return 0;
+	return Atomics::load(data.instances[instanceIndex].underrunCount);
+}
+
+} // namespace MT32Emu
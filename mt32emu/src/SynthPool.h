@@ -0,0 +1,88 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_SYNTH_POOL_H
+#define MT32EMU_SYNTH_POOL_H
+
+#include "globals.h"
+#include "Types.h"
+
+namespace MT32Emu {
+
+class Synth;
+struct SynthPoolData;
+
+// Hosts a number of independent Synth instances and renders their output ahead of time in a fixed pool of worker threads.
+// Each instance has a lock-free output FIFO. Whenever there is room for another block in the FIFO, a worker renders
+// the block. Workers prefer the instances assigned to them and steal blocks of other instances when they run out of own work,
+// so the load stays balanced when the instances are read unevenly. Synths opened with the same ROMs share the ROM data.
+// THREAD SAFETY:
+// addInstance() and removeInstance() must not run concurrently with each other. The output of an instance must be read
+// by a single thread at a time, and an instance must not be read while being removed. Different instances may be read
+// by different threads. MIDI events may be sent to the synths from any thread, since the MIDI event queue is lock-free.
+// Timestamps of the events are relative to the rendered output, which is ahead of the output read by up to the FIFO length.
+// Other methods of the synths must not be used while they are in the pool.
+// Without worker threads (or when the library is built without MT32EMU_USE_RENDER_THREADS), output is rendered on demand
+// in the thread calling readOutput().
+class MT32EMU_EXPORT SynthPool {
+public:
+	static const Bit32u DEFAULT_BLOCK_LENGTH = 512;
+	static const Bit32u DEFAULT_FIFO_LENGTH = 4096;
+
+	// maxInstanceCount sets the number of instances the pool can host at a time.
+	// blockLength sets the number of frames rendered for an instance in one go.
+	// fifoLength sets the capacity of the output FIFO of each instance in frames. It is rounded up to a power of 2
+	// no less than twice the block length.
+	SynthPool(Bit32u maxInstanceCount, Bit32u workerThreadCount, Bit32u blockLength = DEFAULT_BLOCK_LENGTH, Bit32u fifoLength = DEFAULT_FIFO_LENGTH);
+	~SynthPool();
+
+	Bit32u getMaxInstanceCount() const;
+
+	// Returns the number of worker threads actually started.
+	Bit32u getWorkerThreadCount() const;
+
+	Bit32u getBlockLength() const;
+	Bit32u getFIFOLength() const;
+
+	// Hands over an open synth to the pool, which deletes it when the instance is removed or the pool is destroyed.
+	// Returns the instance index or -1 if the pool is full or the synth isn't open.
+	int addInstance(Synth *synth);
+
+	// Waits for the block being rendered for the instance to complete (if any), then deletes the synth.
+	// The output that hasn't been read yet is discarded.
+	void removeInstance(Bit32u instanceIndex);
+
+	// Returns the synth of the instance or NULL if there is no instance with the index specified.
+	Synth *getSynth(Bit32u instanceIndex) const;
+
+	// Copies up to frameCount rendered stereo frames into the interleaved stream and returns the number of frames copied.
+	// Never waits for the workers, fewer frames are returned when the instance falls behind.
+	Bit32u readOutput(Bit32u instanceIndex, Bit16s *stream, Bit32u frameCount);
+
+	// Backlog metrics intended for load balancing.
+	// Returns the number of frames rendered ahead and not yet read.
+	Bit32u getBufferedFrameCount(Bit32u instanceIndex) const;
+	// Returns the number of readOutput() calls since the instance was added that got fewer frames than requested.
+	Bit32u getUnderrunCount(Bit32u instanceIndex) const;
+
+private:
+	SynthPoolData &data;
+};
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_SYNTH_POOL_H
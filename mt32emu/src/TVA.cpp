@@ -26,6 +26,7 @@
 #include "Part.h"
 #include "Partial.h"
 #include "Poly.h"
+#include "StateStream.h"
 #include "Synth.h"
 #include "Tables.h"
 
@@ -367,4 +368,33 @@ void TVA::nextPhase() {
 	startRamp((Bit8u)newTarget, (Bit8u)newIncrement, newPhase);
 }
 
+void TVA::saveState(StateWriter &writer) const {
+	const Synth *synth = partial->getSynth();
+	synth->savePartPointer(writer, part);
+	synth->saveMemParamsPointer(writer, partialParam);
+	synth->saveMemParamsPointer(writer, patchTemp);
+	synth->saveMemParamsPointer(writer, rhythmTemp);
+	writer.writeBool(playing);
+	writer.writeBit32s(biasAmpSubtraction);
+	writer.writeBit32s(veloAmpSubtraction);
+	writer.writeBit32s(keyTimeSubtraction);
+	writer.writeBit8u(target);
+	writer.writeBit32s(phase);
+}
+
+void TVA::loadState(StateReader &reader) {
+	const Synth *synth = partial->getSynth();
+	part = synth->loadPartPointer(reader);
+	partialParam = static_cast<const TimbreParam::PartialParam *>(synth->loadMemParamsPointer(reader, sizeof(TimbreParam::PartialParam)));
+	patchTemp = static_cast<const MemParams::PatchTemp *>(synth->loadMemParamsPointer(reader, sizeof(MemParams::PatchTemp)));
+	rhythmTemp = static_cast<const MemParams::RhythmTemp *>(synth->loadMemParamsPointer(reader, sizeof(MemParams::RhythmTemp)));
+	playing = reader.readBool();
+	biasAmpSubtraction = reader.readBit32s();
+	veloAmpSubtraction = reader.readBit32s();
+	keyTimeSubtraction = reader.readBit32s();
+	target = reader.readBit8u();
+	phase = reader.readIndex(TVA_PHASE_DEAD + 1);
+	if (part == NULL || partialParam == NULL || patchTemp == NULL) reader.fail();
+}
+
 } // namespace MT32Emu
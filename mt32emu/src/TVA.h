@@ -27,6 +27,8 @@ namespace MT32Emu {
 class LA32Ramp;
 class Part;
 class Partial;
+class StateReader;
+class StateWriter;
 
 // Note that when entering nextPhase(), newPhase is set to phase + 1, and the descriptions/names below refer to
 // newPhase's value.
@@ -93,6 +95,10 @@ public:
 
 	bool isPlaying() const;
 	int getPhase() const;
+
+	// Store and restore the envelope state, the ramp is handled by the partial
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 }; // class TVA
 
 } // namespace MT32Emu
@@ -21,6 +21,8 @@
 #include "LA32Ramp.h"
 #include "Partial.h"
 #include "Poly.h"
+#include "StateStream.h"
+#include "Synth.h"
 #include "Tables.h"
 
 namespace MT32Emu {
@@ -230,4 +232,23 @@ void TVF::nextPhase() {
 	startRamp(newTarget, newIncrement, newPhase);
 }
 
+void TVF::saveState(StateWriter &writer) const {
+	partial->getSynth()->saveMemParamsPointer(writer, partialParam);
+	writer.writeBit8u(baseCutoff);
+	writer.writeBit32s(keyTimeSubtraction);
+	writer.writeBit32u(levelMult);
+	writer.writeBit8u(target);
+	writer.writeBit32u(phase);
+}
+
+void TVF::loadState(StateReader &reader) {
+	partialParam = static_cast<const TimbreParam::PartialParam *>(partial->getSynth()->loadMemParamsPointer(reader, sizeof(TimbreParam::PartialParam)));
+	baseCutoff = reader.readBit8u();
+	keyTimeSubtraction = reader.readBit32s();
+	levelMult = reader.readBit32u();
+	target = reader.readBit8u();
+	phase = reader.readBit32u();
+	if (partialParam == NULL) reader.fail();
+}
+
 } // namespace MT32Emu
@@ -26,6 +26,8 @@ namespace MT32Emu {
 
 class LA32Ramp;
 class Partial;
+class StateReader;
+class StateWriter;
 
 class TVF {
 private:
@@ -54,6 +56,10 @@ public:
 	Bit8u getBaseCutoff() const;
 	void handleInterrupt();
 	void startDecay();
+
+	// Store and restore the envelope state, the ramp is handled by the partial
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 }; // class TVF
 
 } // namespace MT32Emu
@@ -23,6 +23,7 @@
 #include "Part.h"
 #include "Partial.h"
 #include "Poly.h"
+#include "StateStream.h"
 #include "Synth.h"
 #include "TVA.h"
 
@@ -294,6 +295,17 @@ Bit16u TVP::nextPitch() {
 	return pitch;
 }
 
+Bit32u TVP::getSamplesBeforeProcessing() const {
+	return counter == 0 ? 0 : Bit32u(maxCounter - counter);
+}
+
+void TVP::nextPitches(Bit16u *pitches, Bit32u length) {
+	for (Bit32u i = 0; i < length; i++) {
+		pitches[i] = pitch;
+	}
+	counter = (counter + int(length)) % maxCounter;
+}
+
 void TVP::process() {
 	if (phase == 0) {
 		targetPitchOffsetReached();
@@ -327,4 +339,43 @@ void TVP::process() {
 	updatePitch();
 }
 
+void TVP::saveState(StateWriter &writer) const {
+	const Synth *synth = partial->getSynth();
+	synth->savePartPointer(writer, part);
+	synth->saveMemParamsPointer(writer, partialParam);
+	synth->saveMemParamsPointer(writer, patchTemp);
+	writer.writeBit32s(counter);
+	writer.writeBit32u(timeElapsed);
+	writer.writeBit32s(phase);
+	writer.writeBit32u(basePitch);
+	writer.writeBit32s(targetPitchOffsetWithoutLFO);
+	writer.writeBit32s(currentPitchOffset);
+	writer.writeBit16s(lfoPitchOffset);
+	writer.writeBit8u(Bit8u(timeKeyfollowSubtraction));
+	writer.writeBit16s(pitchOffsetChangePerBigTick);
+	writer.writeBit16u(targetPitchOffsetReachedBigTick);
+	writer.writeBit32u(shifts);
+	writer.writeBit16u(pitch);
+}
+
+void TVP::loadState(StateReader &reader) {
+	const Synth *synth = partial->getSynth();
+	part = synth->loadPartPointer(reader);
+	partialParam = static_cast<const TimbreParam::PartialParam *>(synth->loadMemParamsPointer(reader, sizeof(TimbreParam::PartialParam)));
+	patchTemp = static_cast<const MemParams::PatchTemp *>(synth->loadMemParamsPointer(reader, sizeof(MemParams::PatchTemp)));
+	counter = reader.readIndex(maxCounter);
+	timeElapsed = reader.readBit32u();
+	phase = reader.readBit32s();
+	basePitch = reader.readBit32u();
+	targetPitchOffsetWithoutLFO = reader.readBit32s();
+	currentPitchOffset = reader.readBit32s();
+	lfoPitchOffset = reader.readBit16s();
+	timeKeyfollowSubtraction = Bit8s(reader.readBit8u());
+	pitchOffsetChangePerBigTick = reader.readBit16s();
+	targetPitchOffsetReachedBigTick = reader.readBit16u();
+	shifts = reader.readBit32u();
+	pitch = reader.readBit16u();
+	if (part == NULL || partialParam == NULL || patchTemp == NULL) reader.fail();
+}
+
 } // namespace MT32Emu
@@ -26,6 +26,8 @@ namespace MT32Emu {
 
 class Part;
 class Partial;
+class StateReader;
+class StateWriter;
 
 class TVP {
 private:
@@ -66,7 +68,15 @@ public:
 	void reset(const Part *part, const TimbreParam::PartialParam *partialParam);
 	Bit32u getBasePitch() const;
 	Bit16u nextPitch();
+	// Returns the number of subsequent calls to nextPitch() which don't process the envelope and the LFO and thus return the same pitch
+	Bit32u getSamplesBeforeProcessing() const;
+	// Equivalent to length calls to nextPitch() storing the results. Processing must not be due meanwhile, see above.
+	void nextPitches(Bit16u *pitches, Bit32u length);
 	void startDecay();
+
+	// Store and restore the pitch envelope state
+	void saveState(StateWriter &writer) const;
+	void loadState(StateReader &reader);
 }; // class TVP
 
 } // namespace MT32Emu
@@ -80,6 +80,16 @@ Tables::Tables() {
 		exp9[i] = Bit16u(8191.5f - EXP2F(13.0f + ~i / 512.0f));
 	}
 
+	// Precomputed interpolation of the exponent table, this gives exactly the same values as the LA32 model in the log-space computes.
+	for (int fract = 0; fract < 4096; fract++) {
+		int expTabIndex = fract >> 3;
+		int extraBits = ~fract & 7;
+		int expTabEntry2 = 8191 - exp9[expTabIndex];
+		int expTabEntry1 = expTabIndex == 0 ? 8191 : (8191 - exp9[expTabIndex - 1]);
+		interpolatedExp[fract] = Bit16u(expTabEntry2 + (((expTabEntry1 - expTabEntry2) * extraBits) >> 3));
+	}
+	interpolatedExp[4096] = 0;
+
 	// There is a logarithmic sine table inside the LA32 chip. The table contains 13-bit integer values.
 	for (int i = 1; i < 512; i++) {
 		logsin9[i] = Bit16u(0.5f - LOG2F(sin((i + 0.5f) / 1024.0f * FLOAT_PI)) * 1024.0f);
@@ -54,6 +54,10 @@ public:
 	Bit16u exp9[512];
 	Bit16u logsin9[512];
 
+	// Results of interpolation of exp9 for every possible 12-bit fractional log value, see LA32Utilites::interpolateExp().
+	// The extra trailing entry allows for reading pairs of adjacent 16-bit values at any index.
+	Bit16u interpolatedExp[4097];
+
 	const Bit8u *resAmpDecayFactor;
 }; // class Tables
 
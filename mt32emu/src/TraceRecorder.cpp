@@ -0,0 +1,205 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "internals.h"
+
+#include "TraceRecorder.h"
+#include "Atomics.h"
+#include "Clock.h"
+
+namespace MT32Emu {
+
+static const Bit32u MAX_CAPACITY = 1 << 24;
+static const Bit32u EVENT_BUSY = 0xFFFFFFFF;
+
+struct TraceEvent {
+	// Set to the index of the event + 1 once the event is completely written, EVENT_BUSY while being written
+	volatile Bit32u sequence;
+	char phase;
+	Bit32u track;
+	const char *name;
+	const char *argName;
+	Bit32u argValue;
+	double startTime;
+	double duration;
+};
+
+struct TraceTrack {
+	volatile Bit32u named;
+	char name[TraceRecorder::MAX_TRACK_NAME_LENGTH + 1];
+};
+
+// Writes a string quoted and escaped as required by JSON.
+static void writeJSONString(FILE *file, const char *str) {
+	fputc('"', file);
+	for (const unsigned char *c = reinterpret_cast<const unsigned char *>(str); *c != 0; c++) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', file);
+			fputc(*c, file);
+		} else if (*c < 0x20) {
+			fprintf(file, "\\u%04x", *c);
+		} else {
+			fputc(*c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+// Writes the time in microseconds with nanosecond precision. Unlike printing doubles, this doesn't depend on the current locale.
+static void writeMicroseconds(FILE *file, double seconds) {
+	if (seconds < 0.0) seconds = 0.0;
+	Bit32u wholeSeconds = Bit32u(seconds);
+	Bit32u nanos = Bit32u((seconds - wholeSeconds) * 1e9 + 0.5);
+	if (nanos >= 1000000000) {
+		wholeSeconds++;
+		nanos -= 1000000000;
+	}
+	if (wholeSeconds > 0) {
+		fprintf(file, "%u%06u.%03u", wholeSeconds, nanos / 1000, nanos % 1000);
+	} else {
+		fprintf(file, "%u.%03u", nanos / 1000, nanos % 1000);
+	}
+}
+
+double TraceRecorder::getTime() {
+	return Clock::getSeconds();
+}
+
+TraceRecorder::TraceRecorder(Bit32u capacity) : writeCount(0), trackCount(0) {
+	Bit32u size = 1;
+	while (size < capacity && size < MAX_CAPACITY) {
+		size <<= 1;
+	}
+	events = new TraceEvent[size];
+	for (Bit32u i = 0; i < size; i++) {
+		events[i].sequence = 0;
+	}
+	capacityMask = size - 1;
+	tracks = new TraceTrack[MAX_TRACK_COUNT];
+	for (Bit32u i = 0; i < MAX_TRACK_COUNT; i++) {
+		tracks[i].named = 0;
+	}
+	startTime = getTime();
+}
+
+TraceRecorder::~TraceRecorder() {
+	delete[] events;
+	delete[] tracks;
+}
+
+Bit32u TraceRecorder::getCapacity() const {
+	return capacityMask + 1;
+}
+
+Bit32u TraceRecorder::addTrack(const char *name) {
+	Bit32u track;
+	do {
+		track = Atomics::load(trackCount);
+	} while (!Atomics::compareAndSwap(trackCount, track, track + 1));
+	if (track < MAX_TRACK_COUNT && name != NULL) {
+		strncpy(tracks[track].name, name, MAX_TRACK_NAME_LENGTH);
+		tracks[track].name[MAX_TRACK_NAME_LENGTH] = 0;
+		Atomics::store(tracks[track].named, 1);
+	}
+	return track;
+}
+
+void TraceRecorder::recordSpan(Bit32u track, const char *name, double spanStartTime, double spanEndTime, const char *argName, Bit32u argValue) {
+	record('X', track, name, spanStartTime, spanEndTime - spanStartTime, argName, argValue);
+}
+
+void TraceRecorder::recordInstant(Bit32u track, const char *name, double time, const char *argName, Bit32u argValue) {
+	record('i', track, name, time, 0.0, argName, argValue);
+}
+
+void TraceRecorder::record(char phase, Bit32u track, const char *name, double eventStartTime, double duration, const char *argName, Bit32u argValue) {
+	Bit32u index;
+	do {
+		index = Atomics::load(writeCount);
+	} while (!Atomics::compareAndSwap(writeCount, index, index + 1));
+	TraceEvent &event = events[index & capacityMask];
+	// Another thread that has lapped the ring buffer may still be writing this slot, then the event is dropped
+	Bit32u sequence = Atomics::load(event.sequence);
+	if (sequence == EVENT_BUSY || !Atomics::compareAndSwap(event.sequence, sequence, EVENT_BUSY)) return;
+	event.phase = phase;
+	event.track = track;
+	event.name = name;
+	event.argName = argName;
+	event.argValue = argValue;
+	event.startTime = eventStartTime;
+	event.duration = duration;
+	Atomics::store(event.sequence, index + 1);
+}
+
+Bit32u TraceRecorder::getRecordedEventCount() const {
+	return Atomics::load(writeCount);
+}
+
+void TraceRecorder::clear() {
+	for (Bit32u i = 0; i <= capacityMask; i++) {
+		events[i].sequence = 0;
+	}
+	Atomics::store(writeCount, 0);
+}
+
+bool TraceRecorder::writeChromeTrace(const char *filename) const {
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) return false;
+	fputs("{\"traceEvents\": [", file);
+	bool first = true;
+	Bit32u namedTrackCount = Atomics::load(trackCount);
+	if (namedTrackCount > MAX_TRACK_COUNT) namedTrackCount = MAX_TRACK_COUNT;
+	for (Bit32u track = 0; track < namedTrackCount; track++) {
+		if (!Atomics::load(tracks[track].named)) continue;
+		fprintf(file, "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": ", first ? "" : ",", track);
+		writeJSONString(file, tracks[track].name);
+		fputs("}}", file);
+		first = false;
+	}
+	Bit32u eventCount = Atomics::load(writeCount);
+	Bit32u firstIndex = eventCount > capacityMask ? eventCount - capacityMask - 1 : 0;
+	for (Bit32u index = firstIndex; index != eventCount; index++) {
+		const TraceEvent &event = events[index & capacityMask];
+		// Skip events not completely written yet
+		if (Atomics::load(event.sequence) != index + 1) continue;
+		fprintf(file, "%s\n  {\"name\": ", first ? "" : ",");
+		writeJSONString(file, event.name);
+		fprintf(file, ", \"cat\": \"mt32emu\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %u, \"ts\": ", event.phase, event.track);
+		writeMicroseconds(file, event.startTime - startTime);
+		if (event.phase == 'X') {
+			fputs(", \"dur\": ", file);
+			writeMicroseconds(file, event.duration);
+		} else {
+			fputs(", \"s\": \"t\"", file);
+		}
+		if (event.argName != NULL) {
+			fputs(", \"args\": {", file);
+			writeJSONString(file, event.argName);
+			fprintf(file, ": %u}", event.argValue);
+		}
+		fputc('}', file);
+		first = false;
+	}
+	fputs("\n], \"displayTimeUnit\": \"ms\"}\n", file);
+	bool success = !ferror(file);
+	return fclose(file) == 0 && success;
+}
+
+} // namespace MT32Emu
@@ -0,0 +1,85 @@
+/* Copyright (C) 2003, 2004, 2005, 2006, 2008, 2009 Dean Beeler, Jerome Fisher
+ * Copyright (C) 2011-2015 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_TRACE_RECORDER_H
+#define MT32EMU_TRACE_RECORDER_H
+
+#include "globals.h"
+#include "Types.h"
+
+namespace MT32Emu {
+
+struct TraceEvent;
+struct TraceTrack;
+
+// Records a timeline of events into a ring buffer of fixed capacity and writes it out as a JSON file
+// in the Chrome trace event format, which can be viewed in chrome://tracing or Perfetto UI.
+// The events are grouped in tracks, each one is displayed as a separate thread. Once the ring buffer is full,
+// the oldest events are overwritten. Time is measured in seconds by the same monotonic clock as getTime() returns.
+// The event names and argument names are not copied, so they must remain valid as long as the recorder exists
+// (string literals are best suited). Any number of threads may record events simultaneously, no locking is involved.
+// THREAD SAFETY:
+// clear() and writeChromeTrace() must not be called while events are being recorded. Events recorded meanwhile
+// may be lost or (in case of concurrent overwriting) omitted from the output.
+class MT32EMU_EXPORT TraceRecorder {
+public:
+	static const Bit32u DEFAULT_CAPACITY = 65536;
+	static const Bit32u MAX_TRACK_COUNT = 64;
+	static const Bit32u MAX_TRACK_NAME_LENGTH = 63;
+
+	// Returns the current time of the clock used to timestamp the events.
+	static double getTime();
+
+	// The capacity is given in events and rounded up to a power of 2.
+	explicit TraceRecorder(Bit32u capacity = DEFAULT_CAPACITY);
+	~TraceRecorder();
+
+	Bit32u getCapacity() const;
+
+	// Adds a new track to record events into and returns its identifier. The name is copied (up to MAX_TRACK_NAME_LENGTH chars).
+	// No more than MAX_TRACK_COUNT tracks may be named, the excess tracks are displayed unnamed.
+	Bit32u addTrack(const char *name);
+
+	// Records an event which lasted from startTime till endTime. Optionally, an integer argument with the specified name is attached.
+	void recordSpan(Bit32u track, const char *name, double startTime, double endTime, const char *argName = NULL, Bit32u argValue = 0);
+
+	// Records an instant event that happened at the specified time.
+	void recordInstant(Bit32u track, const char *name, double time, const char *argName = NULL, Bit32u argValue = 0);
+
+	// Returns the total number of events recorded since creation or the last call of clear(), including those overwritten.
+	Bit32u getRecordedEventCount() const;
+
+	// Discards all the recorded events. The tracks are retained.
+	void clear();
+
+	// Writes the events currently held in the ring buffer to the specified file. Returns false on I/O error.
+	bool writeChromeTrace(const char *filename) const;
+
+private:
+	TraceEvent *events; // Ring buffer
+	Bit32u capacityMask;
+	volatile Bit32u writeCount;
+	TraceTrack *tracks; // Array, MAX_TRACK_COUNT items
+	volatile Bit32u trackCount;
+	double startTime;
+
+	void record(char phase, Bit32u track, const char *name, double eventStartTime, double duration, const char *argName, Bit32u argValue);
+};
+
+} // namespace MT32Emu
+
+#endif // #ifndef MT32EMU_TRACE_RECORDER_H
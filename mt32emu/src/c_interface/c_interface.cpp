@@ -37,6 +37,8 @@ static mt32emu_bit32u getLibraryVersionInt(mt32emu_const_context);
 static const char *getLibraryVersionString(mt32emu_const_context);
 static mt32emu_report_handler_version getSupportedReportHandlerVersionID(mt32emu_const_context);
 static unsigned int getStereoOutputSamplerate(mt32emu_const_context, const mt32emu_analog_output_mode analog_output_mode);
+static void setPCMROMCacheDirectory(mt32emu_const_context, const char *directory);
+static mt32emu_simd_level getSupportedSIMDLevel(mt32emu_const_context);
 
 static const mt32emu_synth_i_v0 SYNTH_VTABLE = {
 	getSynthVersionID,
@@ -53,6 +55,7 @@ static const mt32emu_synth_i_v0 SYNTH_VTABLE = {
 	mt32emu_get_actual_stereo_output_samplerate,
 	mt32emu_flush_midi_queue,
 	mt32emu_set_midi_event_queue_size,
+	mt32emu_configure_midi_event_queue_sysex_storage,
 	mt32emu_set_midi_receiver,
 	mt32emu_parse_stream,
 	mt32emu_parse_stream_at,
@@ -95,6 +98,21 @@ static const mt32emu_synth_i_v0 SYNTH_VTABLE = {
 	mt32emu_get_playing_notes,
 	mt32emu_get_patch_name,
 	mt32emu_read_memory,
+	mt32emu_get_state_size,
+	mt32emu_save_state,
+	mt32emu_load_state,
+	setPCMROMCacheDirectory,
+	mt32emu_set_render_statistics_enabled,
+	mt32emu_is_render_statistics_enabled,
+	mt32emu_get_render_statistics,
+	mt32emu_reset_render_statistics,
+	mt32emu_get_polyphony_statistics,
+	mt32emu_reset_polyphony_statistics,
+	mt32emu_set_render_pass_length,
+	mt32emu_get_render_pass_length,
+	getSupportedSIMDLevel,
+	mt32emu_set_simd_level,
+	mt32emu_get_simd_level,
 	getSupportedReportHandlerVersionID
 };
 
@@ -361,6 +379,14 @@ unsigned int getStereoOutputSamplerate(mt32emu_const_context, const mt32emu_anal
 	return mt32emu_get_stereo_output_samplerate(analog_output_mode);
 }
 
+void setPCMROMCacheDirectory(mt32emu_const_context, const char *directory) {
+	mt32emu_set_pcm_rom_cache_directory(directory);
+}
+
+mt32emu_simd_level getSupportedSIMDLevel(mt32emu_const_context) {
+	return mt32emu_get_supported_simd_level();
+}
+
 } // namespace MT32Emu
 
 // C-visible implementation
@@ -475,6 +501,10 @@ unsigned int mt32emu_get_stereo_output_samplerate(const mt32emu_analog_output_mo
 	return Synth::getStereoOutputSampleRate((AnalogOutputMode)analog_output_mode);
 }
 
+void mt32emu_set_pcm_rom_cache_directory(const char *directory) {
+	Synth::setPCMROMCacheDirectory(directory);
+}
+
 unsigned int mt32emu_get_actual_stereo_output_samplerate(mt32emu_const_context context) {
 	return context.c->synth->getStereoOutputSampleRate();
 }
@@ -487,6 +517,10 @@ mt32emu_bit32u mt32emu_set_midi_event_queue_size(mt32emu_const_context context,
 	return context.c->synth->setMIDIEventQueueSize(queue_size);
 }
 
+mt32emu_bit32u mt32emu_configure_midi_event_queue_sysex_storage(mt32emu_const_context context, const mt32emu_bit32u storage_buffer_size) {
+	return context.c->synth->configureMIDIEventQueueSysexStorage(storage_buffer_size);
+}
+
 mt32emu_midi_receiver_version mt32emu_set_midi_receiver(mt32emu_const_context context, const mt32emu_midi_receiver_i *midi_receiver) {
 	context.c->midiParser->setMIDIReceiver(midi_receiver);
 	return MT32EMU_MIDI_RECEIVER_VERSION_CURRENT;
@@ -674,6 +708,84 @@ void mt32emu_read_memory(mt32emu_const_context context, mt32emu_bit32u addr, mt3
 	context.c->synth->readMemory(addr, len, data);
 }
 
+size_t mt32emu_get_state_size(mt32emu_const_context context) {
+	return context.c->synth->getStateSize();
+}
+
+mt32emu_return_code mt32emu_save_state(mt32emu_const_context context, mt32emu_bit8u *buffer, size_t buffer_size) {
+	if (!context.c->synth->isOpen()) return MT32EMU_RC_NOT_OPENED;
+	return context.c->synth->saveState(buffer, buffer_size) ? MT32EMU_RC_OK : MT32EMU_RC_FAILED;
+}
+
+mt32emu_return_code mt32emu_load_state(mt32emu_const_context context, const mt32emu_bit8u *buffer, size_t buffer_size) {
+	if (!context.c->synth->isOpen()) return MT32EMU_RC_NOT_OPENED;
+	return context.c->synth->loadState(buffer, buffer_size) ? MT32EMU_RC_OK : MT32EMU_RC_FAILED;
+}
+
+void mt32emu_set_render_statistics_enabled(mt32emu_const_context context, const mt32emu_boolean enabled) {
+	context.c->synth->setRenderStatisticsEnabled(enabled == MT32EMU_BOOL_TRUE);
+}
+
+mt32emu_boolean mt32emu_is_render_statistics_enabled(mt32emu_const_context context) {
+	return context.c->synth->isRenderStatisticsEnabled() ? MT32EMU_BOOL_TRUE : MT32EMU_BOOL_FALSE;
+}
+
+static void convertRenderStageStatistics(mt32emu_render_stage_statistics &stage, const RenderStageStatistics &source) {
+	stage.seconds = source.seconds;
+	stage.run_count = source.runCount;
+}
+
+void mt32emu_get_render_statistics(mt32emu_const_context context, mt32emu_render_statistics *statistics) {
+	RenderStatistics source;
+	context.c->synth->getRenderStatistics(source);
+	convertRenderStageStatistics(statistics->total, source.total);
+	convertRenderStageStatistics(statistics->midi, source.midi);
+	convertRenderStageStatistics(statistics->partials, source.partials);
+	convertRenderStageStatistics(statistics->reverb, source.reverb);
+	convertRenderStageStatistics(statistics->analog, source.analog);
+	convertRenderStageStatistics(statistics->conversion, source.conversion);
+}
+
+void mt32emu_reset_render_statistics(mt32emu_const_context context) {
+	context.c->synth->resetRenderStatistics();
+}
+
+void mt32emu_get_polyphony_statistics(mt32emu_const_context context, mt32emu_polyphony_statistics *statistics) {
+	PolyphonyStatistics source;
+	context.c->synth->getPolyphonyStatistics(source);
+	memcpy(statistics->partial_allocation_failures, source.partialAllocationFailures, sizeof(statistics->partial_allocation_failures));
+	memcpy(statistics->poly_allocation_failures, source.polyAllocationFailures, sizeof(statistics->poly_allocation_failures));
+	memcpy(statistics->aborted_polys, source.abortedPolys, sizeof(statistics->aborted_polys));
+	statistics->peak_active_partials = source.peakActivePartials;
+	statistics->average_active_partials = source.averageActivePartials;
+	statistics->rendered_samples = source.renderedSamples;
+	statistics->abort_wait_samples = source.abortWaitSamples;
+}
+
+void mt32emu_reset_polyphony_statistics(mt32emu_const_context context) {
+	context.c->synth->resetPolyphonyStatistics();
+}
+
+void mt32emu_set_render_pass_length(mt32emu_const_context context, const mt32emu_bit32u length) {
+	context.c->synth->setRenderPassLength(length);
+}
+
+mt32emu_bit32u mt32emu_get_render_pass_length(mt32emu_const_context context) {
+	return context.c->synth->getRenderPassLength();
+}
+
+mt32emu_simd_level mt32emu_get_supported_simd_level() {
+	return (mt32emu_simd_level)Synth::getSupportedSIMDLevel();
+}
+
+void mt32emu_set_simd_level(mt32emu_const_context context, const mt32emu_simd_level level) {
+	context.c->synth->setSIMDLevel((SIMDLevel)level);
+}
+
+mt32emu_simd_level mt32emu_get_simd_level(mt32emu_const_context context) {
+	return (mt32emu_simd_level)context.c->synth->getSIMDLevel();
+}
+
 mt32emu_report_handler_version mt32emu_get_supported_report_handler_version() {
 	return MT32EMU_REPORT_HANDLER_VERSION_CURRENT;
 }
@@ -101,6 +101,13 @@ MT32EMU_EXPORT mt32emu_boolean mt32emu_is_open(mt32emu_const_context context);
  */
 MT32EMU_EXPORT unsigned int mt32emu_get_stereo_output_samplerate(const mt32emu_analog_output_mode analog_output_mode);
 
+/**
+ * Sets the directory for the on-disk cache of the unscrambled PCM ROM data, NULL (default) disables the cache.
+ * When enabled, opening a synth memory-maps the cache file instead of decoding the PCM ROM. The file is created
+ * on the first use of each PCM ROM. The setting is process-wide and affects subsequent opening of synths only.
+ */
+MT32EMU_EXPORT void mt32emu_set_pcm_rom_cache_directory(const char *directory);
+
 /**
  * Returns actual output sample rate used in emulation of stereo analog circuitry of hardware units.
  * See comment for mt32emu_analog_output_mode.
@@ -117,6 +124,15 @@ MT32EMU_EXPORT void mt32emu_flush_midi_queue(mt32emu_const_context context);
  */
 MT32EMU_EXPORT mt32emu_bit32u mt32emu_set_midi_event_queue_size(mt32emu_const_context context, const mt32emu_bit32u queue_size);
 
+/**
+ * Configures size of the storage for SysEx data of the events in the internal MIDI event queue. The storage is preallocated
+ * along with the queue, so no memory is allocated while enqueuing SysEx messages. The size is rounded up to a power of 2
+ * within the range [1 KiB, 1 GiB]. The default value 0 makes the storage size proportional to the queue size.
+ * If the synth is open, the queue is flushed and reallocated.
+ * Returns the actual storage size being used or 0 if the synth is closed.
+ */
+MT32EMU_EXPORT mt32emu_bit32u mt32emu_configure_midi_event_queue_sysex_storage(mt32emu_const_context context, const mt32emu_bit32u storage_buffer_size);
+
 /**
  * Installs custom MIDI receiver object intended for receiving MIDI messages generated by MIDI stream parser.
  * MIDI stream parser is involved when functions mt32emu_parse_stream() and mt32emu_play_short_message() or the likes are called.
@@ -328,6 +344,70 @@ MT32EMU_EXPORT const char *mt32emu_get_patch_name(mt32emu_const_context context,
 /** Stores internal state of emulated synth into an array provided (as it would be acquired from hardware). */
 MT32EMU_EXPORT void mt32emu_read_memory(mt32emu_const_context context, mt32emu_bit32u addr, mt32emu_bit32u len, mt32emu_bit8u *data);
 
+/**
+ * Returns the size of the buffer sufficient to save the current emulation state, or 0 if the synth is not open.
+ * The size depends on the number of playing notes and pending MIDI events, so it may change over time.
+ */
+MT32EMU_EXPORT size_t mt32emu_get_state_size(mt32emu_const_context context);
+
+/**
+ * Saves the complete emulation state into the buffer provided, so that mt32emu_load_state() continues rendering bit-exactly
+ * from the same point. The state includes the pending MIDI events but not the settings, such as the output gains.
+ * The state is only valid for a synth opened with the same ROMs, partial count, analog output mode and reverb compatibility mode.
+ * Must not be called while rendering.
+ * Returns MT32EMU_RC_OK on success, MT32EMU_RC_NOT_OPENED if the synth is not open or MT32EMU_RC_FAILED if the buffer is too small.
+ */
+MT32EMU_EXPORT mt32emu_return_code mt32emu_save_state(mt32emu_const_context context, mt32emu_bit8u *buffer, size_t buffer_size);
+
+/**
+ * Restores the emulation state saved by mt32emu_save_state(). Must not be called while rendering or enqueuing MIDI events.
+ * Returns MT32EMU_RC_OK on success, MT32EMU_RC_NOT_OPENED if the synth is not open or MT32EMU_RC_FAILED if the data is damaged
+ * or incompatible with the synth configuration.
+ */
+MT32EMU_EXPORT mt32emu_return_code mt32emu_load_state(mt32emu_const_context context, const mt32emu_bit8u *buffer, size_t buffer_size);
+
+/**
+ * Enables or disables accumulating the time spent in each stage of rendering, disabled by default. The output is unaffected.
+ * Has no effect unless the library is built with MT32EMU_RENDER_STATISTICS enabled.
+ * The functions dealing with the render statistics must be synchronised with the thread performing sample rendering.
+ */
+MT32EMU_EXPORT void mt32emu_set_render_statistics_enabled(mt32emu_const_context context, const mt32emu_boolean enabled);
+/** Returns whether render statistics are being accumulated. */
+MT32EMU_EXPORT mt32emu_boolean mt32emu_is_render_statistics_enabled(mt32emu_const_context context);
+/** Fills in the render statistics accumulated since the synth context was created or the statistics were last reset. */
+MT32EMU_EXPORT void mt32emu_get_render_statistics(mt32emu_const_context context, mt32emu_render_statistics *statistics);
+/** Resets all the accumulated render statistics to zeros. */
+MT32EMU_EXPORT void mt32emu_reset_render_statistics(mt32emu_const_context context);
+
+/**
+ * Fills in the polyphony usage statistics accumulated since the synth was opened or the statistics were last reset.
+ * These are always collected. Must be synchronised with the thread performing sample rendering.
+ */
+MT32EMU_EXPORT void mt32emu_get_polyphony_statistics(mt32emu_const_context context, mt32emu_polyphony_statistics *statistics);
+/** Resets all the polyphony usage statistics to zeros. */
+MT32EMU_EXPORT void mt32emu_reset_polyphony_statistics(mt32emu_const_context context);
+
+/**
+ * Sets the maximum number of samples rendered in a single pass through all the stages of rendering.
+ * Longer runs are split into passes, and shorter passes keep the intermediate buffers in cache.
+ * The value is clamped to the range 1..MT32EMU_MAX_SAMPLES_PER_RUN, the default is MT32EMU_DEFAULT_RENDER_PASS_LENGTH.
+ * The output is unaffected. Must not be called while rendering.
+ */
+MT32EMU_EXPORT void mt32emu_set_render_pass_length(mt32emu_const_context context, const mt32emu_bit32u length);
+/** Returns the maximum number of samples rendered in a single pass. */
+MT32EMU_EXPORT mt32emu_bit32u mt32emu_get_render_pass_length(mt32emu_const_context context);
+
+/** Returns the most capable set of SIMD instructions supported by the CPU, the DSP routines are compiled for. */
+MT32EMU_EXPORT mt32emu_simd_level mt32emu_get_supported_simd_level();
+/**
+ * Selects the variant of the DSP routines used by the synth. MT32EMU_SL_AUTO (default) picks the best one supported
+ * by the CPU, unless overridden by the MT32EMU_SIMD_LEVEL environment variable. Levels not supported by the CPU
+ * are lowered to the supported one. All variants produce the same output. Takes effect when the synth is opened.
+ */
+MT32EMU_EXPORT void mt32emu_set_simd_level(mt32emu_const_context context, const mt32emu_simd_level level);
+/** Returns the SIMD level in use if the synth is open, or the one requested otherwise. */
+MT32EMU_EXPORT mt32emu_simd_level mt32emu_get_simd_level(mt32emu_const_context context);
+
 /* === Interface handling === */
 
 /**
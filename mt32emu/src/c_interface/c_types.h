@@ -68,6 +68,7 @@ typedef enum mt32emu_analog_output_mode mt32emu_analog_output_mode;
 typedef enum mt32emu_dac_input_mode mt32emu_dac_input_mode;
 typedef enum mt32emu_midi_delay_mode mt32emu_midi_delay_mode;
 typedef enum mt32emu_partial_state mt32emu_partial_state;
+typedef enum mt32emu_simd_level mt32emu_simd_level;
 #endif
 
 /** Contains identifiers and descriptions of ROM files being used. */
@@ -98,6 +99,49 @@ typedef struct {
 	float *reverbWetRight;
 } mt32emu_dac_output_float_streams;
 
+/** Time spent in a processing stage of the renderer along with the number of times the stage was run. */
+typedef struct {
+	double seconds;
+	mt32emu_bit32u run_count;
+} mt32emu_render_stage_statistics;
+
+/** Render statistics accumulated by the synth, see mt32emu_get_render_statistics(). */
+typedef struct {
+	/** Complete rendering calls, this includes all the stages below */
+	mt32emu_render_stage_statistics total;
+	/** Processing of the queued MIDI events */
+	mt32emu_render_stage_statistics midi;
+	/** Generation of the LA32 output by the partials */
+	mt32emu_render_stage_statistics partials;
+	/** Reverb model processing */
+	mt32emu_render_stage_statistics reverb;
+	/** Emulation of the analogue circuits */
+	mt32emu_render_stage_statistics analog;
+	/** DAC input emulation and sample format conversion */
+	mt32emu_render_stage_statistics conversion;
+} mt32emu_render_statistics;
+
+/**
+ * Polyphony usage accumulated by the synth, see mt32emu_get_polyphony_statistics().
+ * Parts are indexed 0..7 for Part 1..8, 8 for Rhythm.
+ */
+typedef struct {
+	/** Number of notes not played because not enough partials could be freed, per part */
+	mt32emu_bit32u partial_allocation_failures[9];
+	/** Number of notes not played because there was no free poly, per part */
+	mt32emu_bit32u poly_allocation_failures[9];
+	/** Number of polys aborted to free up partials, indexed by mt32emu_poly_abort_reason and the part the aborted poly belonged to */
+	mt32emu_bit32u aborted_polys[4][9];
+	/** Maximum number of partials active at once */
+	mt32emu_bit32u peak_active_partials;
+	/** Number of active partials averaged over rendered_samples */
+	double average_active_partials;
+	/** Number of samples rendered (at the sample rate 32000 Hz) */
+	mt32emu_bit32u rendered_samples;
+	/** Number of samples rendered while processing of MIDI events was suspended until an aborting poly finishes */
+	mt32emu_bit32u abort_wait_samples;
+} mt32emu_polyphony_statistics;
+
 /* === Interface handling === */
 
 /** Report handler interface versions */
@@ -231,6 +275,7 @@ typedef struct {
 	unsigned int (*getActualStereoOutputSamplerate)(mt32emu_const_context context);
 	void (*flushMIDIQueue)(mt32emu_const_context context);
 	mt32emu_bit32u (*setMIDIEventQueueSize)(mt32emu_const_context context, const mt32emu_bit32u queue_size);
+	mt32emu_bit32u (*configureMIDIEventQueueSysexStorage)(mt32emu_const_context context, const mt32emu_bit32u storage_buffer_size);
 	mt32emu_midi_receiver_version (*setMIDIReceiver)(mt32emu_const_context context, const mt32emu_midi_receiver_i *midi_receiver);
 
 	void (*parseStream)(mt32emu_const_context context, const mt32emu_bit8u *stream, mt32emu_bit32u length);
@@ -282,6 +327,21 @@ typedef struct {
 	unsigned int (*getPlayingNotes)(mt32emu_const_context context, unsigned int part_number, mt32emu_bit8u *keys, mt32emu_bit8u *velocities);
 	const char *(*getPatchName)(mt32emu_const_context context, unsigned int part_number);
 	void (*readMemory)(mt32emu_const_context context, mt32emu_bit32u addr, mt32emu_bit32u len, mt32emu_bit8u *data);
+	size_t (*getStateSize)(mt32emu_const_context context);
+	mt32emu_return_code (*saveState)(mt32emu_const_context context, mt32emu_bit8u *buffer, size_t buffer_size);
+	mt32emu_return_code (*loadState)(mt32emu_const_context context, const mt32emu_bit8u *buffer, size_t buffer_size);
+	void (*setPCMROMCacheDirectory)(mt32emu_const_context _unused_, const char *directory);
+	void (*setRenderStatisticsEnabled)(mt32emu_const_context context, const mt32emu_boolean enabled);
+	mt32emu_boolean (*isRenderStatisticsEnabled)(mt32emu_const_context context);
+	void (*getRenderStatistics)(mt32emu_const_context context, mt32emu_render_statistics *statistics);
+	void (*resetRenderStatistics)(mt32emu_const_context context);
+	void (*getPolyphonyStatistics)(mt32emu_const_context context, mt32emu_polyphony_statistics *statistics);
+	void (*resetPolyphonyStatistics)(mt32emu_const_context context);
+	void (*setRenderPassLength)(mt32emu_const_context context, const mt32emu_bit32u length);
+	mt32emu_bit32u (*getRenderPassLength)(mt32emu_const_context context);
+	mt32emu_simd_level (*getSupportedSIMDLevel)(mt32emu_const_context _unused_);
+	void (*setSIMDLevel)(mt32emu_const_context context, const mt32emu_simd_level level);
+	mt32emu_simd_level (*getSIMDLevel)(mt32emu_const_context context);
 	mt32emu_report_handler_version (*getSupportedReportHandlerVersionID)(mt32emu_const_context _unused_);
 } mt32emu_synth_i_v0;
 
@@ -103,6 +103,7 @@ struct Synth : public Interface {
 	virtual unsigned int MT32EMU_METHOD getActualStereoOutputSamplerate() = 0;
 	virtual void MT32EMU_METHOD flushMIDIQueue() = 0;
 	virtual mt32emu_bit32u MT32EMU_METHOD setMIDIEventQueueSize(const mt32emu_bit32u queue_size) = 0;
+	virtual mt32emu_bit32u MT32EMU_METHOD configureMIDIEventQueueSysexStorage(const mt32emu_bit32u storage_buffer_size) = 0;
 	virtual mt32emu_midi_receiver_version MT32EMU_METHOD setMIDIReceiver(const MidiReceiver *midi_receiver) = 0;
 
 	virtual void MT32EMU_METHOD parseStream(const mt32emu_bit8u *stream, mt32emu_bit32u length) = 0;
@@ -154,6 +155,21 @@ struct Synth : public Interface {
 	virtual unsigned int MT32EMU_METHOD getPlayingNotes(unsigned int part_number, mt32emu_bit8u *keys, mt32emu_bit8u *velocities) = 0;
 	virtual const char * MT32EMU_METHOD getPatchName(unsigned int part_number) = 0;
 	virtual void MT32EMU_METHOD readMemory(mt32emu_bit32u addr, mt32emu_bit32u len, mt32emu_bit8u *data) = 0;
+	virtual size_t MT32EMU_METHOD getStateSize() = 0;
+	virtual mt32emu_return_code MT32EMU_METHOD saveState(mt32emu_bit8u *buffer, size_t buffer_size) = 0;
+	virtual mt32emu_return_code MT32EMU_METHOD loadState(const mt32emu_bit8u *buffer, size_t buffer_size) = 0;
+	virtual void MT32EMU_METHOD setPCMROMCacheDirectory(const char *directory) = 0;
+	virtual void MT32EMU_METHOD setRenderStatisticsEnabled(const mt32emu_boolean enabled) = 0;
+	virtual mt32emu_boolean MT32EMU_METHOD isRenderStatisticsEnabled() = 0;
+	virtual void MT32EMU_METHOD getRenderStatistics(mt32emu_render_statistics *statistics) = 0;
+	virtual void MT32EMU_METHOD resetRenderStatistics() = 0;
+	virtual void MT32EMU_METHOD getPolyphonyStatistics(mt32emu_polyphony_statistics *statistics) = 0;
+	virtual void MT32EMU_METHOD resetPolyphonyStatistics() = 0;
+	virtual void MT32EMU_METHOD setRenderPassLength(const mt32emu_bit32u length) = 0;
+	virtual mt32emu_bit32u MT32EMU_METHOD getRenderPassLength() = 0;
+	virtual mt32emu_simd_level MT32EMU_METHOD getSupportedSIMDLevel() = 0;
+	virtual void MT32EMU_METHOD setSIMDLevel(const mt32emu_simd_level level) = 0;
+	virtual mt32emu_simd_level MT32EMU_METHOD getSIMDLevel() = 0;
 	virtual mt32emu_report_handler_version MT32EMU_METHOD getSupportedReportHandlerVersionID() = 0;
 
 private:
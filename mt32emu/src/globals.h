@@ -69,6 +69,15 @@
  */
 #define MT32EMU_MAX_SAMPLES_PER_RUN 4096
 
+/* The default length of a render pass, see Synth::setRenderPassLength().
+ * Longer runs are split into passes of at most this many samples, and each pass goes through all the stages
+ * of rendering (partials, reverb, analogue circuit emulation and sample format conversion) back to back.
+ * The value is chosen so that the intermediate buffers of a pass stay in the L1 data cache.
+ * Must not exceed MT32EMU_MAX_SAMPLES_PER_RUN. Similarly to the length given to render(), it has no effect on the generated
+ * audio.
+ */
+#define MT32EMU_DEFAULT_RENDER_PASS_LENGTH 512
+
 /* The default size of the internal MIDI event queue.
  * It holds the incoming MIDI events before the rendering engine actually processes them.
  * The main goal is to fairly emulate the real hardware behaviour which obviously
@@ -102,6 +111,9 @@ const unsigned int DEFAULT_MAX_PARTIALS = MT32EMU_DEFAULT_MAX_PARTIALS;
 const unsigned int MAX_SAMPLES_PER_RUN = MT32EMU_MAX_SAMPLES_PER_RUN;
 #undef MT32EMU_MAX_SAMPLES_PER_RUN
 
+const unsigned int DEFAULT_RENDER_PASS_LENGTH = MT32EMU_DEFAULT_RENDER_PASS_LENGTH;
+#undef MT32EMU_DEFAULT_RENDER_PASS_LENGTH
+
 const unsigned int DEFAULT_MIDI_EVENT_QUEUE_SIZE = MT32EMU_DEFAULT_MIDI_EVENT_QUEUE_SIZE;
 #undef MT32EMU_DEFAULT_MIDI_EVENT_QUEUE_SIZE
 
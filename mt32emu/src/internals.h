@@ -99,6 +99,37 @@
 #define MT32EMU_BOSS_REVERB_PRECISE_MODE 0
 #endif
 
+// 0: Use only portable C++ code in the wave generator and renderer.
+// 1: Compile SIMD optimised routines (SSE2, AVX, AVX2) where supported by the compiler. The routines for the best instruction set
+//    the CPU supports are selected in Synth::open(), see Synth::setSIMDLevel(). The output is bit-identical either way.
+#ifndef MT32EMU_USE_SIMD
+#define MT32EMU_USE_SIMD 1
+#endif
+
+// The x86 SIMD routines are compiled for each instruction set regardless of the compiler options, hence the target attribute
+// is required for GCC and Clang. MSVC allows the use of intrinsics for any instruction set anyway.
+#if MT32EMU_USE_SIMD && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define MT32EMU_USE_X86_SIMD 1
+#define MT32EMU_X86_TARGET(isa) __attribute__((target(isa)))
+#elif MT32EMU_USE_SIMD && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MT32EMU_USE_X86_SIMD 1
+#define MT32EMU_X86_TARGET(isa)
+#else
+#define MT32EMU_USE_X86_SIMD 0
+#endif
+
+// 0: Partials are always rendered in the calling thread, Synth::setRenderThreadCount() has no effect.
+// 1: Enables a pool of worker threads (POSIX threads or Win32 API) to render partials, see Synth::setRenderThreadCount().
+#ifndef MT32EMU_USE_RENDER_THREADS
+#define MT32EMU_USE_RENDER_THREADS 0
+#endif
+
+// 0: Render statistics are not collected, Synth::getRenderStatistics() always reports zeros.
+// 1: The renderer measures the time spent in each processing stage while enabled with Synth::setRenderStatisticsEnabled().
+#ifndef MT32EMU_RENDER_STATISTICS
+#define MT32EMU_RENDER_STATISTICS 1
+#endif
+
 namespace MT32Emu {
 
 enum PolyState {
@@ -54,6 +54,8 @@
 #include "FileStream.h"
 #include "ROMInfo.h"
 #include "Synth.h"
+#include "SynthPool.h"
+#include "TraceRecorder.h"
 #include "MidiStreamParser.h"
 
 #else /* MT32EMU_API_TYPE == 0 */
@@ -0,0 +1,561 @@
+/* Copyright (C) 2011-2015 Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <mt32emu/mt32emu.h>
+
+// MIDI events are sent by the workloads in ticks of 10 ms, the output is rendered in between.
+static const unsigned int TICKS_PER_SECOND = 100;
+static const unsigned int MAX_FRAMES_PER_TICK = 96000 / TICKS_PER_SECOND;
+static const unsigned int STREAMS_SAMPLE_RATE = 32000;
+
+static const unsigned int DEFAULT_DURATION = 5;
+
+static const unsigned int TIMBRE_BANK_SIZE = 64;
+static const unsigned int TIMBRE_PARAM_SIZE = 246;
+static const unsigned int TIMBRES_PER_UPLOAD = 8;
+
+static const MT32Emu::DACInputMode DAC_INPUT_MODES[] = {
+	MT32Emu::DACInputMode_NICE,
+	MT32Emu::DACInputMode_PURE,
+	MT32Emu::DACInputMode_GENERATION1,
+	MT32Emu::DACInputMode_GENERATION2
+};
+
+static const char * const DAC_INPUT_MODE_NAMES[] = {
+	"NICE",
+	"PURE",
+	"GENERATION1",
+	"GENERATION2"
+};
+
+static const MT32Emu::AnalogOutputMode ANALOG_OUTPUT_MODES[] = {
+	MT32Emu::AnalogOutputMode_DIGITAL_ONLY,
+	MT32Emu::AnalogOutputMode_COARSE,
+	MT32Emu::AnalogOutputMode_ACCURATE,
+	MT32Emu::AnalogOutputMode_OVERSAMPLED
+};
+
+static const char * const ANALOG_OUTPUT_MODE_NAMES[] = {
+	"DIGITAL_ONLY",
+	"COARSE",
+	"ACCURATE",
+	"OVERSAMPLED"
+};
+
+enum RenderMethod {
+	RenderMethod_STEREO,
+	RenderMethod_STREAMS
+};
+
+static const char * const RENDER_METHOD_NAMES[] = {
+	"render",
+	"renderStreams"
+};
+
+enum SampleFormat {
+	SampleFormat_S16,
+	SampleFormat_FLOAT
+};
+
+static const char * const SAMPLE_FORMAT_NAMES[] = {
+	"s16",
+	"float"
+};
+
+struct Workload {
+	const char *name;
+	// Invoked once after the synth is opened
+	void (*start)(MT32Emu::Synth &synth);
+	// Invoked before rendering each tick
+	void (*tick)(MT32Emu::Synth &synth, unsigned int tickIx);
+};
+
+struct Options {
+	const char *romDir;
+	const char *outputFilename;
+	unsigned int duration;
+	unsigned int renderThreadCount;
+	unsigned int renderPassLength;
+
+	// Negative values select all the variants
+	int workloadIx;
+	int analogOutputModeIx;
+	int dacInputModeIx;
+	int renderMethodIx;
+	int sampleFormatIx;
+};
+
+struct RunResult {
+	unsigned long frameCount;
+	unsigned int sampleRate;
+	double midiSeconds;
+	double renderSeconds;
+	MT32Emu::RenderStatistics renderStatistics;
+};
+
+struct Buffers {
+	MT32Emu::Bit16s stereo[2 * MAX_FRAMES_PER_TICK];
+	float stereoFloat[2 * MAX_FRAMES_PER_TICK];
+	MT32Emu::Bit16s streams[6][MAX_FRAMES_PER_TICK];
+	float streamsFloat[6][MAX_FRAMES_PER_TICK];
+};
+
+// Keeps the debug output and LCD messages from mixing with the results.
+class QuietReportHandler : public MT32Emu::ReportHandler {
+protected:
+	void printDebug(const char *, va_list) {}
+	void showLCDMessage(const char *) {}
+};
+
+static QuietReportHandler quietReportHandler;
+
+static MT32Emu::Bit8u timbreBank[TIMBRE_BANK_SIZE][TIMBRE_PARAM_SIZE];
+
+static double getSeconds() {
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return double(counter.QuadPart) / double(frequency.QuadPart);
+#else
+	timeval time;
+	gettimeofday(&time, NULL);
+	return time.tv_sec + time.tv_usec * 1e-6;
+#endif
+}
+
+// Sends a "Data set 1" SysEx message addressed to the MT-32 memory. The address is in the padded SysEx form.
+static void writeMemory(MT32Emu::Synth &synth, MT32Emu::Bit32u address, const MT32Emu::Bit8u *data, MT32Emu::Bit32u length) {
+	MT32Emu::Bit8u sysex[TIMBRE_PARAM_SIZE + 10];
+	sysex[0] = 0xF0;
+	sysex[1] = 0x41;
+	sysex[2] = 0x10;
+	sysex[3] = 0x16;
+	sysex[4] = 0x12;
+	sysex[5] = (address >> 16) & 0x7F;
+	sysex[6] = (address >> 8) & 0x7F;
+	sysex[7] = address & 0x7F;
+	memcpy(sysex + 8, data, length);
+	sysex[8 + length] = MT32Emu::Synth::calcSysexChecksum(sysex + 5, length + 3);
+	sysex[9 + length] = 0xF7;
+	synth.playSysex(sysex, length + 10);
+}
+
+static void playNote(MT32Emu::Synth &synth, unsigned int channel, unsigned int key, unsigned int velocity) {
+	synth.playMsg(0x90 | channel | (key << 8) | (velocity << 16));
+}
+
+static void stopNote(MT32Emu::Synth &synth, unsigned int channel, unsigned int key) {
+	synth.playMsg(0x80 | channel | (key << 8) | (64 << 16));
+}
+
+static void allNotesOff(MT32Emu::Synth &synth, unsigned int channel) {
+	synth.playMsg(0xB0 | channel | (0x40 << 8)); // Release sustain pedal
+	synth.playMsg(0xB0 | channel | (0x7B << 8));
+}
+
+static void startNone(MT32Emu::Synth &) {}
+
+// Sustained string and organ sounds on all the melodic parts, 32 keys held in total.
+// Most of the timbres use more than a single partial, so the partials are constantly being stolen.
+static void startChords(MT32Emu::Synth &synth) {
+	static const unsigned int PROGRAMS[] = {48, 49, 50, 51, 52, 53, 16, 17};
+	for (unsigned int part = 0; part < 8; part++) {
+		synth.playMsg(0xC0 | (part + 1) | (PROGRAMS[part] << 8));
+	}
+}
+
+static void tickChords(MT32Emu::Synth &synth, unsigned int tickIx) {
+	static const unsigned int CHORDS[][4] = {{48, 52, 55, 60}, {45, 48, 52, 57}, {41, 45, 48, 53}, {43, 47, 50, 55}};
+	if (tickIx % (2 * TICKS_PER_SECOND) != 0) return;
+	const unsigned int *chord = CHORDS[(tickIx / (2 * TICKS_PER_SECOND)) % 4];
+	for (unsigned int part = 0; part < 8; part++) {
+		unsigned int channel = part + 1;
+		allNotesOff(synth, channel);
+		synth.playMsg(0xB0 | channel | (0x40 << 8) | (127 << 16)); // Hold pedal
+		for (unsigned int i = 0; i < 4; i++) {
+			playNote(synth, channel, chord[i] + 12 * (part % 3), 100);
+		}
+	}
+}
+
+// Sixteenth notes at 125 BPM on the rhythm part with up to four instruments struck at once.
+static void tickDrums(MT32Emu::Synth &synth, unsigned int tickIx) {
+	static const unsigned int PATTERN[16][4] = {
+		{36, 42, 49, 0}, {42, 0, 0, 0}, {42, 38, 0, 0}, {42, 0, 0, 0},
+		{36, 42, 0, 0}, {42, 64, 0, 0}, {38, 42, 63, 0}, {42, 0, 0, 0},
+		{36, 42, 0, 0}, {36, 42, 0, 0}, {38, 42, 50, 0}, {42, 62, 0, 0},
+		{36, 46, 0, 0}, {42, 47, 0, 0}, {38, 40, 45, 42}, {41, 43, 51, 56}
+	};
+	static const unsigned int TICKS_PER_STEP = 12;
+	if (tickIx % TICKS_PER_STEP != 0) return;
+	unsigned int step = tickIx / TICKS_PER_STEP;
+	const unsigned int *keys = PATTERN[step % 16];
+	for (unsigned int i = 0; i < 4 && keys[i] != 0; i++) {
+		playNote(synth, 9, keys[i], 60 + (step * 37 + i * 11) % 68);
+	}
+}
+
+// Uploads the 64 timbres of group A to the memory timbres in banks of 8 every half a second while playing
+// on parts which use the memory timbres being overwritten, so the affected parts are refreshed.
+static void startSysex(MT32Emu::Synth &synth) {
+	for (unsigned int i = 0; i < TIMBRE_BANK_SIZE; i++) {
+		// Timbre group A starts at 08 00 00, each timbre occupies 256 bytes, that is 02 00 in the padded form
+		synth.readMemory((0x08 << 14) | ((i << 1) << 7), TIMBRE_PARAM_SIZE, timbreBank[i]);
+	}
+	for (unsigned int part = 0; part < 4; part++) {
+		// Timbre group "memory", timbre number
+		const MT32Emu::Bit8u patch[] = {2, MT32Emu::Bit8u(part)};
+		writeMemory(synth, 0x030000 | (part << 4), patch, sizeof(patch));
+	}
+}
+
+static void tickSysex(MT32Emu::Synth &synth, unsigned int tickIx) {
+	if (tickIx % (TICKS_PER_SECOND / 2) != 0) return;
+	unsigned int upload = tickIx / (TICKS_PER_SECOND / 2);
+	for (unsigned int i = 0; i < TIMBRES_PER_UPLOAD; i++) {
+		unsigned int sourceTimbre = (upload * TIMBRES_PER_UPLOAD + i) % TIMBRE_BANK_SIZE;
+		writeMemory(synth, 0x080000 | ((i << 1) << 8), timbreBank[sourceTimbre], TIMBRE_PARAM_SIZE);
+	}
+	for (unsigned int part = 0; part < 4; part++) {
+		unsigned int channel = part + 1;
+		allNotesOff(synth, channel);
+		playNote(synth, channel, 48 + 7 * part + upload % 12, 100);
+	}
+}
+
+// Short staccato chords once in three seconds with the longest reverb setting, so the reverb tails dominate.
+static void startReverb(MT32Emu::Synth &synth) {
+	// Reverb mode "Hall", time 8, level 7
+	static const MT32Emu::Bit8u REVERB_SETTINGS[] = {1, 7, 7};
+	writeMemory(synth, 0x100001, REVERB_SETTINGS, sizeof(REVERB_SETTINGS));
+	synth.playMsg(0xC1 | (1 << 8));
+}
+
+static void tickReverb(MT32Emu::Synth &synth, unsigned int tickIx) {
+	static const unsigned int KEYS[] = {60, 64, 67, 72};
+	unsigned int phase = tickIx % (3 * TICKS_PER_SECOND);
+	if (phase == 0) {
+		for (unsigned int i = 0; i < 4; i++) {
+			playNote(synth, 1, KEYS[i], 127);
+		}
+	} else if (phase == TICKS_PER_SECOND / 5) {
+		for (unsigned int i = 0; i < 4; i++) {
+			stopNote(synth, 1, KEYS[i]);
+		}
+	}
+}
+
+static void tickNone(MT32Emu::Synth &, unsigned int) {}
+
+static const Workload WORKLOADS[] = {
+	{"chords", startChords, tickChords},
+	{"drums", startNone, tickDrums},
+	{"sysex", startSysex, tickSysex},
+	{"reverb", startReverb, tickReverb},
+	{"idle", startNone, tickNone}
+};
+
+static const unsigned int WORKLOAD_COUNT = sizeof(WORKLOADS) / sizeof(WORKLOADS[0]);
+
+static void printUsage() {
+	fprintf(stderr, "Usage: mt32emu-bench [option...]\n"
+		"Renders synthetic workloads with all the combinations of the selected settings and prints the results in JSON.\n"
+		"  -m, --rom-dir <directory>          Directory in which ROMs are stored (including trailing path separator)\n"
+		"  -o, --output <filename>            Output file (default: standard output)\n"
+		"  -d, --duration <seconds>           Duration of each workload (default: %u)\n"
+		"  -t, --render-threads <count>       Number of threads to render partials (default: 1)\n"
+		"  -p, --render-pass-length <frames>  Maximum number of frames rendered in a single pass (default: %u)\n"
+		"  -w, --workload <name>              One of: chords, drums, sysex, reverb, idle (default: all)\n"
+		"  -a, --analog-output-mode <0..3>    0: DIGITAL_ONLY, 1: COARSE, 2: ACCURATE, 3: OVERSAMPLED (default: all)\n"
+		"  -i, --dac-input-mode <0..3>        0: NICE, 1: PURE, 2: GENERATION1, 3: GENERATION2 (default: all)\n"
+		"  -r, --render-method <method>       One of: render, renderStreams (default: all)\n"
+		"  -f, --sample-format <format>       One of: s16, float (default: all)\n", DEFAULT_DURATION, MT32Emu::DEFAULT_RENDER_PASS_LENGTH);
+}
+
+static int findName(const char *name, const char * const *names, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		if (strcmp(name, names[i]) == 0) return int(i);
+	}
+	return -1;
+}
+
+static bool parseNumber(const char *value, long minValue, long maxValue, long &number) {
+	char *end;
+	number = strtol(value, &end, 10);
+	return *value != 0 && *end == 0 && minValue <= number && number <= maxValue;
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+	static const char * const OPTIONS[] = {
+		"-m", "--rom-dir", "-o", "--output", "-d", "--duration", "-t", "--render-threads",
+		"-w", "--workload", "-a", "--analog-output-mode", "-i", "--dac-input-mode", "-r", "--render-method",
+		"-f", "--sample-format", "-p", "--render-pass-length"
+	};
+	const char *workloadNames[WORKLOAD_COUNT];
+	for (unsigned int i = 0; i < WORKLOAD_COUNT; i++) {
+		workloadNames[i] = WORKLOADS[i].name;
+	}
+	options.romDir = "";
+	options.outputFilename = NULL;
+	options.duration = DEFAULT_DURATION;
+	options.renderThreadCount = 1;
+	options.renderPassLength = MT32Emu::DEFAULT_RENDER_PASS_LENGTH;
+	options.workloadIx = -1;
+	options.analogOutputModeIx = -1;
+	options.dacInputModeIx = -1;
+	options.renderMethodIx = -1;
+	options.sampleFormatIx = -1;
+	for (int argIx = 1; argIx < argc; argIx++) {
+		const char *arg = argv[argIx];
+		if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) return false;
+		int optionIx = findName(arg, OPTIONS, sizeof(OPTIONS) / sizeof(OPTIONS[0]));
+		if (optionIx < 0 || argIx + 1 == argc) {
+			fprintf(stderr, "Invalid option or missing value: %s\n", arg);
+			return false;
+		}
+		const char *value = argv[++argIx];
+		bool valid = true;
+		long number;
+		switch (optionIx / 2) {
+		case 0:
+			options.romDir = value;
+			break;
+		case 1:
+			options.outputFilename = value;
+			break;
+		case 2:
+			valid = parseNumber(value, 1, 24 * 3600, number);
+			options.duration = (unsigned int)number;
+			break;
+		case 3:
+			valid = parseNumber(value, 1, 256, number);
+			options.renderThreadCount = (unsigned int)number;
+			break;
+		case 4:
+			options.workloadIx = findName(value, workloadNames, WORKLOAD_COUNT);
+			valid = options.workloadIx >= 0;
+			break;
+		case 5:
+			valid = parseNumber(value, 0, 3, number);
+			options.analogOutputModeIx = int(number);
+			break;
+		case 6:
+			valid = parseNumber(value, 0, 3, number);
+			options.dacInputModeIx = int(number);
+			break;
+		case 7:
+			options.renderMethodIx = findName(value, RENDER_METHOD_NAMES, 2);
+			valid = options.renderMethodIx >= 0;
+			break;
+		case 8:
+			options.sampleFormatIx = findName(value, SAMPLE_FORMAT_NAMES, 2);
+			valid = options.sampleFormatIx >= 0;
+			break;
+		case 9:
+			valid = parseNumber(value, 1, MT32Emu::MAX_SAMPLES_PER_RUN, number);
+			options.renderPassLength = (unsigned int)number;
+			break;
+		}
+		if (!valid) {
+			fprintf(stderr, "Invalid value for option %s: %s\n", arg, value);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool openROM(MT32Emu::FileStream &file, const char *romDir, const char *name, const char *fallbackName) {
+	char pathName[2048];
+	if (strlen(romDir) + strlen(name) >= sizeof(pathName) || strlen(romDir) + strlen(fallbackName) >= sizeof(pathName)) return false;
+	strcat(strcpy(pathName, romDir), name);
+	if (file.open(pathName)) return true;
+	strcat(strcpy(pathName, romDir), fallbackName);
+	return file.open(pathName);
+}
+
+static void renderTick(MT32Emu::Synth &synth, RenderMethod renderMethod, SampleFormat sampleFormat, unsigned int frameCount, Buffers &buffers) {
+	if (renderMethod == RenderMethod_STEREO) {
+		if (sampleFormat == SampleFormat_S16) {
+			synth.render(buffers.stereo, frameCount);
+		} else {
+			synth.render(buffers.stereoFloat, frameCount);
+		}
+	} else {
+		if (sampleFormat == SampleFormat_S16) {
+			MT32Emu::Bit16s (&s)[6][MAX_FRAMES_PER_TICK] = buffers.streams;
+			synth.renderStreams(s[0], s[1], s[2], s[3], s[4], s[5], frameCount);
+		} else {
+			float (&s)[6][MAX_FRAMES_PER_TICK] = buffers.streamsFloat;
+			synth.renderStreams(s[0], s[1], s[2], s[3], s[4], s[5], frameCount);
+		}
+	}
+}
+
+// Renders the workload in a newly opened synth. The time spent in opening the synth is not accounted.
+static bool runWorkload(const MT32Emu::ROMImage &controlROMImage, const MT32Emu::ROMImage &pcmROMImage, const Options &options,
+	const Workload &workload, RenderMethod renderMethod, SampleFormat sampleFormat, MT32Emu::AnalogOutputMode analogOutputMode,
+	MT32Emu::DACInputMode dacInputMode, Buffers &buffers, RunResult &result)
+{
+	MT32Emu::Synth synth(&quietReportHandler);
+	if (!synth.open(controlROMImage, pcmROMImage, analogOutputMode)) {
+		fprintf(stderr, "Error opening MT32Emu synthesizer.\n");
+		return false;
+	}
+	synth.setDACInputMode(dacInputMode);
+	synth.setRenderThreadCount(options.renderThreadCount);
+	synth.setRenderPassLength(options.renderPassLength);
+	synth.setRenderStatisticsEnabled(true);
+	result.sampleRate = renderMethod == RenderMethod_STEREO ? synth.getStereoOutputSampleRate() : STREAMS_SAMPLE_RATE;
+	unsigned int framesPerTick = result.sampleRate / TICKS_PER_SECOND;
+	unsigned int tickCount = options.duration * TICKS_PER_SECOND;
+	result.frameCount = (unsigned long)framesPerTick * tickCount;
+	result.midiSeconds = 0.0;
+	result.renderSeconds = 0.0;
+
+	double startTime = getSeconds();
+	workload.start(synth);
+	for (unsigned int tickIx = 0; tickIx < tickCount; tickIx++) {
+		workload.tick(synth, tickIx);
+		double midiEndTime = getSeconds();
+		result.midiSeconds += midiEndTime - startTime;
+		renderTick(synth, renderMethod, sampleFormat, framesPerTick, buffers);
+		startTime = getSeconds();
+		result.renderSeconds += startTime - midiEndTime;
+	}
+	synth.getRenderStatistics(result.renderStatistics);
+	return true;
+}
+
+static void printRun(FILE *outputFile, bool first, const Workload &workload, RenderMethod renderMethod, SampleFormat sampleFormat,
+	int analogOutputModeIx, int dacInputModeIx, const RunResult &result)
+{
+	double seconds = result.midiSeconds + result.renderSeconds;
+	double audioSeconds = double(result.frameCount) / result.sampleRate;
+	fprintf(outputFile, "%s\n    {\"workload\": \"%s\", \"method\": \"%s\", \"format\": \"%s\", ", first ? "" : ",",
+		workload.name, RENDER_METHOD_NAMES[renderMethod], SAMPLE_FORMAT_NAMES[sampleFormat]);
+	if (analogOutputModeIx < 0) {
+		fprintf(outputFile, "\"analog_output_mode\": null, ");
+	} else {
+		fprintf(outputFile, "\"analog_output_mode\": \"%s\", ", ANALOG_OUTPUT_MODE_NAMES[analogOutputModeIx]);
+	}
+	fprintf(outputFile, "\"dac_input_mode\": \"%s\", \"sample_rate\": %u, \"frames\": %lu,\n",
+		DAC_INPUT_MODE_NAMES[dacInputModeIx], result.sampleRate, result.frameCount);
+	fprintf(outputFile, "     \"seconds\": %.6f, \"frames_per_second\": %.1f, \"realtime_factor\": %.3f,\n",
+		seconds, seconds > 0.0 ? result.frameCount / seconds : 0.0, seconds > 0.0 ? audioSeconds / seconds : 0.0);
+	fprintf(outputFile, "     \"stages\": {\"midi\": %.6f, \"render\": %.6f},\n", result.midiSeconds, result.renderSeconds);
+	// Measured by the library within the render calls, note the MIDI events are dispatched there
+	const MT32Emu::RenderStatistics &statistics = result.renderStatistics;
+	fprintf(outputFile, "     \"render_stages\": {\"midi\": %.6f, \"partials\": %.6f, \"reverb\": %.6f, \"analog\": %.6f, \"conversion\": %.6f}}",
+		statistics.midi.seconds, statistics.partials.seconds, statistics.reverb.seconds, statistics.analog.seconds, statistics.conversion.seconds);
+	fflush(outputFile);
+}
+
+static bool runBenchmark(const MT32Emu::ROMImage &controlROMImage, const MT32Emu::ROMImage &pcmROMImage, const Options &options, FILE *outputFile) {
+	Buffers *buffers = new Buffers;
+	const MT32Emu::ROMInfo *controlROMInfo = controlROMImage.getROMInfo();
+	fprintf(outputFile, "{\n  \"library_version\": \"%s\",\n  \"control_rom\": \"%s\",\n  \"duration\": %u,\n  \"render_threads\": %u,\n  \"render_pass_length\": %u,\n  \"runs\": [",
+		MT32Emu::Synth::getLibraryVersionString(), controlROMInfo->shortName, options.duration, options.renderThreadCount,
+		options.renderPassLength);
+	bool first = true;
+	bool success = true;
+	for (unsigned int workloadIx = 0; workloadIx < WORKLOAD_COUNT && success; workloadIx++) {
+		if (options.workloadIx >= 0 && int(workloadIx) != options.workloadIx) continue;
+		const Workload &workload = WORKLOADS[workloadIx];
+		for (int renderMethodIx = 0; renderMethodIx < 2 && success; renderMethodIx++) {
+			if (options.renderMethodIx >= 0 && renderMethodIx != options.renderMethodIx) continue;
+			RenderMethod renderMethod = RenderMethod(renderMethodIx);
+			for (int sampleFormatIx = 0; sampleFormatIx < 2 && success; sampleFormatIx++) {
+				if (options.sampleFormatIx >= 0 && sampleFormatIx != options.sampleFormatIx) continue;
+				SampleFormat sampleFormat = SampleFormat(sampleFormatIx);
+				for (int analogOutputModeIx = 0; analogOutputModeIx < 4 && success; analogOutputModeIx++) {
+					if (options.analogOutputModeIx >= 0 && analogOutputModeIx != options.analogOutputModeIx) continue;
+					// The streams are taken before the analogue circuit emulation, so it makes no difference there
+					if (renderMethod == RenderMethod_STREAMS && options.analogOutputModeIx < 0 && analogOutputModeIx > 0) continue;
+					for (int dacInputModeIx = 0; dacInputModeIx < 4 && success; dacInputModeIx++) {
+						if (options.dacInputModeIx >= 0 && dacInputModeIx != options.dacInputModeIx) continue;
+						RunResult result;
+						success = runWorkload(controlROMImage, pcmROMImage, options, workload, renderMethod, sampleFormat,
+							ANALOG_OUTPUT_MODES[analogOutputModeIx], DAC_INPUT_MODES[dacInputModeIx], *buffers, result);
+						if (!success) break;
+						printRun(outputFile, first, workload, renderMethod, sampleFormat,
+							renderMethod == RenderMethod_STREAMS ? -1 : analogOutputModeIx, dacInputModeIx, result);
+						first = false;
+					}
+				}
+			}
+		}
+	}
+	fprintf(outputFile, "\n  ]\n}\n");
+	delete buffers;
+	return success;
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return -1;
+	}
+	MT32Emu::FileStream controlROMFile;
+	MT32Emu::FileStream pcmROMFile;
+	if (!openROM(controlROMFile, options.romDir, "CM32L_CONTROL.ROM", "MT32_CONTROL.ROM")) {
+		fprintf(stderr, "Control ROM not found.\n");
+		return 1;
+	}
+	if (!openROM(pcmROMFile, options.romDir, "CM32L_PCM.ROM", "MT32_PCM.ROM")) {
+		fprintf(stderr, "PCM ROM not found.\n");
+		return 1;
+	}
+	const MT32Emu::ROMImage *controlROMImage = MT32Emu::ROMImage::makeROMImage(&controlROMFile);
+	const MT32Emu::ROMImage *pcmROMImage = MT32Emu::ROMImage::makeROMImage(&pcmROMFile);
+	int exitCode = 0;
+	if (controlROMImage->getROMInfo() == NULL || pcmROMImage->getROMInfo() == NULL) {
+		fprintf(stderr, "Unknown ROM image.\n");
+		exitCode = 1;
+	} else {
+		FILE *outputFile = stdout;
+		if (options.outputFilename != NULL) {
+			outputFile = fopen(options.outputFilename, "w");
+		}
+		if (outputFile == NULL) {
+			fprintf(stderr, "Error opening file '%s' for writing.\n", options.outputFilename);
+			exitCode = 1;
+		} else {
+			if (!runBenchmark(*controlROMImage, *pcmROMImage, options, outputFile)) {
+				exitCode = 1;
+			}
+			if (outputFile != stdout) {
+				fclose(outputFile);
+			}
+		}
+	}
+	MT32Emu::ROMImage::freeROMImage(controlROMImage);
+	MT32Emu::ROMImage::freeROMImage(pcmROMImage);
+	return exitCode;
+}
@@ -84,6 +84,7 @@ Master::Master() {
 	}
 	instance = this;
 	maxSessions = 0;
+	traceRecorder = NULL;
 
 	moveToThread(QCoreApplication::instance()->thread());
 
@@ -143,6 +144,13 @@ Master::~Master() {
 		audioDriverIt.remove();
 	}
 
+	if (traceRecorder != NULL) {
+		if (!traceRecorder->writeChromeTrace(traceFileName.toLocal8Bit().constData())) {
+			qDebug() << "Failed to write trace file" << traceFileName;
+		}
+		delete traceRecorder;
+	}
+
 	MasterClock::cleanup();
 }
 
@@ -205,6 +213,9 @@ void Master::showCommandLineHelp() {
 		"	during this run only.\n"
 		"-max_sessions <number of sessions>\n"
 		"	exit after this number of MIDI sessions are finished.\n"
+		"-trace <trace file>\n"
+		"	record a timeline of rendering and audio callbacks and\n"
+		"	write it to a Chrome trace event file on exit.\n"
 		"\n"
 		"Commands:\n"
 		"play <SMF file...>\n"
@@ -240,6 +251,14 @@ void Master::processCommandLine(QStringList args) {
 				QMessageBox::warning(NULL, "Error", "The maximum number of sessions must be specified in command line with \"-max_sessions\" option.");
 				showCommandLineHelp();
 			}
+		} else if (QString::compare(command, "-trace", Qt::CaseInsensitive) == 0) {
+			if (args.count() > argIx) {
+				traceFileName = args.at(argIx++);
+				if (traceRecorder == NULL) traceRecorder = new MT32Emu::TraceRecorder;
+			} else {
+				QMessageBox::warning(NULL, "Error", "The trace file name must be specified in command line with \"-trace\" option.");
+				showCommandLineHelp();
+			}
 		} else {
 			QMessageBox::warning(NULL, "Error", "Illegal command line option " + command + " specified.");
 			showCommandLineHelp();
@@ -305,6 +324,10 @@ QSettings *Master::getSettings() const {
 	return settings;
 }
 
+MT32Emu::TraceRecorder *Master::getTraceRecorder() const {
+	return traceRecorder;
+}
+
 QString Master::getDefaultSynthProfileName() {
 	return synthProfileName;
 }
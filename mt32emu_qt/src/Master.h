@@ -34,6 +34,9 @@ private:
 
 	unsigned int maxSessions;
 
+	MT32Emu::TraceRecorder *traceRecorder;
+	QString traceFileName;
+
 	explicit Master();
 	explicit Master(Master &);
 	~Master();
@@ -61,6 +64,7 @@ public:
 	void freeROMImages(const MT32Emu::ROMImage* &controlROMImage, const MT32Emu::ROMImage* &pcmROMImage);
 	QSystemTrayIcon *getTrayIcon() const;
 	QSettings *getSettings() const;
+	MT32Emu::TraceRecorder *getTraceRecorder() const;
 	bool isPinned(const SynthRoute *synthRoute) const;
 	void setPinned(SynthRoute *synthRoute);
 	void startPinnedSynthRoute();
@@ -107,7 +107,11 @@ QSynth::QSynth(QObject *parent) :
 	controlROMImage(NULL), pcmROMImage(NULL), reportHandler(this), sampleRateConverter(NULL)
 {
 	synthMutex = new QMutex(QMutex::Recursive);
-	synth = new Synth(&reportHandler);
+	traceRecorder = Master::getInstance()->getTraceRecorder();
+	if (traceRecorder != NULL) {
+		audioTraceTrack = traceRecorder->addTrack("mt32emu-qt audio callback");
+	}
+	createSynth();
 }
 
 QSynth::~QSynth() {
@@ -117,6 +121,11 @@ QSynth::~QSynth() {
 	delete synthMutex;
 }
 
+void QSynth::createSynth() {
+	synth = new Synth(&reportHandler);
+	if (traceRecorder != NULL) synth->setTraceRecorder(traceRecorder);
+}
+
 bool QSynth::isOpen() const {
 	return state == SynthState_OPEN;
 }
@@ -177,7 +186,9 @@ Bit32u QSynth::convertOutputToSynthTimestamp(quint64 timestamp) {
 }
 
 void QSynth::render(Bit16s *buffer, uint length) {
+	double callbackStartTime = traceRecorder != NULL ? TraceRecorder::getTime() : 0.0;
 	synthMutex->lock();
+	double lockTime = traceRecorder != NULL ? TraceRecorder::getTime() : 0.0;
 	if (!isOpen()) {
 		synthMutex->unlock();
 
@@ -192,6 +203,12 @@ void QSynth::render(Bit16s *buffer, uint length) {
 		synth->render(buffer, length);
 	}
 	synthMutex->unlock();
+	if (traceRecorder != NULL) {
+		double unlockTime = TraceRecorder::getTime();
+		traceRecorder->recordSpan(audioTraceTrack, "synthMutex wait", callbackStartTime, lockTime);
+		traceRecorder->recordSpan(audioTraceTrack, "synthMutex held", lockTime, unlockTime);
+		traceRecorder->recordSpan(audioTraceTrack, "audio callback", callbackStartTime, unlockTime, "frames", length);
+	}
 	emit audioBlockRendered();
 }
 
@@ -229,7 +246,7 @@ bool QSynth::open(uint targetSampleRate, SampleRateConverter::SRCQuality srcQual
 	// We're now in a partially-open state - better to properly close.
 	synth->close(true);
 	delete synth;
-	synth = new Synth(&reportHandler);
+	createSynth();
 	return false;
 }
 
@@ -435,7 +452,7 @@ bool QSynth::reset() {
 		// We're now in a partially-open state - better to properly close.
 		synth->close(true);
 		delete synth;
-		synth = new Synth(&reportHandler);
+		createSynth();
 		synthMutex->unlock();
 		midiMutex.unlock();
 		setState(SynthState_CLOSED);
@@ -463,7 +480,7 @@ void QSynth::close() {
 	synth->close();
 	// This effectively resets rendered frame counter, audioStream is also going down
 	delete synth;
-	synth = new Synth(&reportHandler);
+	createSynth();
 	if (sampleRateConverter != NULL) {
 		delete sampleRateConverter;
 		sampleRateConverter = NULL;
@@ -102,6 +102,10 @@ private:
 	double sampleRateRatio;
 	SampleRateConverter *sampleRateConverter;
 
+	MT32Emu::TraceRecorder *traceRecorder;
+	MT32Emu::Bit32u audioTraceTrack;
+
+	void createSynth();
 	void setState(SynthState newState);
 	void freeROMImages();
 	MT32Emu::Bit32u convertOutputToSynthTimestamp(quint64 timestamp);